@@ -40,6 +40,78 @@
 #define FLEXCAN_MECR_ECCDIS		(0x01 << 8)
 #define FLEXCAN_MECR_NCEFAFRZ		(0x01 << 7)
 
+/* CAN FD registers */
+#define FLEXCAN_FDCTRL			0xC00
+#define FLEXCAN_FDCBT			0xC04
+#define FLEXCAN_FDCRC			0xC08
+
+#define FLEXCAN_MCR_FDEN		(0x01 << 11)
+#define FLEXCAN_CTRL2_ISOCANFDEN	(0x01 << 12)
+
+/* CAN FD control register (FDCTRL) bits */
+#define FLEXCAN_FDCTRL_FDRATE		(0x01 << 31)
+#define FLEXCAN_FDCTRL_MBDSR(r, dsr)	((dsr) << (16 + 3 * (r)))	/* Payload of RAM region r: 8 << dsr bytes */
+#define FLEXCAN_FDCTRL_TDCEN		(0x01 << 15)
+#define FLEXCAN_FDCTRL_TDCOFF_SHIFT	8
+#define FLEXCAN_FDCTRL_TDCOFF_MAXVAL	0x1F
+#define FLEXCAN_FD_NUM_REGIONS		4
+
+/* CAN FD bit timing register (FDCBT) fields */
+#define FLEXCAN_FDCBT_FPRESDIV_SHIFT	20
+#define FLEXCAN_FDCBT_FPRESDIV_MAXVAL	0x3FF
+#define FLEXCAN_FDCBT_FRJW_SHIFT	16
+#define FLEXCAN_FDCBT_FRJW_MAXVAL	0x7
+#define FLEXCAN_FDCBT_FPROPSEG_SHIFT	10
+#define FLEXCAN_FDCBT_FPROPSEG_MAXVAL	0x1F
+#define FLEXCAN_FDCBT_FPSEG1_SHIFT	5
+#define FLEXCAN_FDCBT_FPSEG1_MAXVAL	0x7
+#define FLEXCAN_FDCBT_FPSEG2_SHIFT	0
+#define FLEXCAN_FDCBT_FPSEG2_MAXVAL	0x7
+
+/* High resolution timestamp of mailbox n (HR_TIME_STAMPn) */
+#define FLEXCAN_HR_TIME_STAMP(n)	(0xC30 + 4 * (n))
+
+#define FLEXCAN_CTRL2_TSTAMPCAP_MASK	(0x03 << 6)
+#define FLEXCAN_CTRL2_TSTAMPCAP_EOF	(0x01 << 6)	/* Capture at the end of the frame */
+
+/* Enhanced Rx FIFO registers */
+#define FLEXCAN_ERFCR			0xC0C
+#define FLEXCAN_ERFIER			0xC10
+#define FLEXCAN_ERFSR			0xC14
+
+/* Enhanced Rx FIFO output element and filter elements (ERFFELn) */
+#define FLEXCAN_ERFIFO_OFFSET		0x2000
+#define FLEXCAN_ERFFEL_OFFSET		0x1000		/* From FLEXCAN_ERFIFO_OFFSET */
+#define FLEXCAN_ERFIFO_MEM_SIZE		0x1200
+#define FLEXCAN_ERFFEL_NUM		128
+
+/* Enhanced Rx FIFO control register (ERFCR) bits */
+#define FLEXCAN_ERFCR_ERFEN		(0x01 << 31)
+#define FLEXCAN_ERFCR_NEXIF_SHIFT	16
+#define FLEXCAN_ERFCR_NFE_SHIFT		8
+#define FLEXCAN_ERFCR_ERFWM_SHIFT	0
+
+/* Enhanced Rx FIFO interrupt enable (ERFIER) and status (ERFSR) bits */
+#define FLEXCAN_ERFIER_ERFOVFIE		(0x01 << 30)
+#define FLEXCAN_ERFIER_ERFDAIE		(0x01 << 28)
+#define FLEXCAN_ERFSR_ERFUFW		(0x01 << 31)
+#define FLEXCAN_ERFSR_ERFOVF		(0x01 << 30)
+#define FLEXCAN_ERFSR_ERFWMI		(0x01 << 29)
+#define FLEXCAN_ERFSR_ERFDA		(0x01 << 28)
+#define FLEXCAN_ERFSR_ERFCLR		(0x01 << 27)
+
+/*
+ * Enhanced Rx FIFO filter elements, filter and mask scheme (FSCH = 0).
+ * Extended ID filters take two words and are placed first, standard ID
+ * filters take one word. The ID hit word follows the frame payload.
+ */
+#define FLEXCAN_ERFFEL_STD(id, mask)	((((id) & 0x7FF) << 16) | ((mask) & 0x7FF))
+#define FLEXCAN_ERFFEL_EXT_ID(id)	((id) & 0x1FFFFFFF)
+#define FLEXCAN_ERFFEL_EXT_MASK(mask)	((mask) & 0x1FFFFFFF)
+#define FLEXCAN_ERFIFO_MAX_EXT_FILTERS	(FLEXCAN_ERFFEL_NUM / 2)
+#define FLEXCAN_ERFIFO_IDHIT_WORD(len)	(2 + ((len) + 3) / 4)
+#define FLEXCAN_ERFIFO_IDHIT_MASK	0x7F
+
 
 /* S32G support 128MB */
 #undef RINGO_CAN_REG_SIZE_FLEXCAN
@@ -48,6 +120,7 @@
 #undef RINGO_CAN_NUM_MAILBOX_FLEXCAN
 #undef RINGO_CAN_MAILBOX_SIZE
 #undef FLEXCAN_SET_MODE_RETRIES
+#undef RINGO_CAN_CLK_PE
 
 #define RINGO_CAN_REG_SIZE_FLEXCAN	0x80
 #define RINGO_CAN_MEM_SIZE_FLEXCAN	0x800
@@ -55,6 +128,7 @@
 #define RINGO_CAN_NUM_MAILBOX_FLEXCAN	128
 #define RINGO_CAN_MAILBOX_SIZE		4
 #define FLEXCAN_SET_MODE_RETRIES	255
+#define RINGO_CAN_CLK_PE		80000000
 
 #undef RINGO_CANMC_MAXMB_MASK
 #define RINGO_CANMC_MAXMB_MASK		0x0000007F    /* 128 MBs */
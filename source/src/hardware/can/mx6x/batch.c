@@ -0,0 +1,137 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Batched raw frames.
+ *
+ * The batch devctls take frames from, or add them to, the libcan queues of
+ * a raw device just like the single frame devctls libcan implements, only
+ * several per message pass. Received frames stay in the libcan rx queue
+ * until read, so single frame and batch reads can be mixed. Tx frames are
+ * all queued first and then handed to can_drvr_transmit(), which starts
+ * as many of them as there are free tx mailboxes.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+/* Read queued frames from a raw rx device */
+static int can_batch_rx(CANDEV_RINGO *dev, CAN_BATCH *batch)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    CAN_BATCH_FRAME     *frame;
+    canmsg_t            *rxmsg;
+    uint32_t             n;
+
+    // Rx ring and CAN FD frames do not go through the libcan queue
+    if(dev->mbxid >= (int)devinfo->txmbxstart && dev->mbxid < (int)devinfo->num_mailboxes)
+        return(EINVAL);
+    if(devinfo->rxring || (devinfo->iflags & INFO_FLAGS_FD))
+        return(EINVAL);
+
+    for(n = 0; n < batch->count && n < CAN_BATCH_MAX; n++)
+    {
+        rxmsg = canmsg_dequeue_element(dev->cdev.msg_queue);
+        if(!rxmsg)
+            break;
+
+        frame = &batch->frame[n];
+        frame->mid = rxmsg->cmsg.mid;
+        frame->timestamp = rxmsg->cmsg.ext.timestamp;
+        frame->len = rxmsg->cmsg.len;
+        frame->flags = rxmsg->cmsg.ext.is_extended_mid ? CAN_BATCH_FLAG_IDE : 0;
+        memcpy(frame->dat, rxmsg->cmsg.dat, CAN_MSG_DATA_MAX);
+
+        canmsg_queue_element(dev->cdev.free_queue, rxmsg);
+    }
+    batch->count = n;
+
+    return (n) ? EOK : EAGAIN;
+}
+
+/* Queue frames on the raw tx device and start them */
+static int can_batch_tx(CANDEV_RINGO *dev, CAN_BATCH *batch)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    CAN_BATCH_FRAME     *frame;
+    canmsg_t            *txmsg;
+    uint32_t             n;
+
+    if(dev->mbxid != (int)devinfo->txmbxstart || batch->count > CAN_BATCH_MAX)
+        return(EINVAL);
+    for(n = 0; n < batch->count; n++)
+    {
+        if(batch->frame[n].len > CAN_MSG_DATA_MAX)
+            return(EINVAL);
+    }
+
+    for(n = 0; n < batch->count; n++)
+    {
+        txmsg = canmsg_dequeue_element(dev->cdev.free_queue);
+        if(!txmsg)
+            break;
+
+        frame = &batch->frame[n];
+        txmsg->cmsg.mid = frame->mid;
+        txmsg->cmsg.len = frame->len;
+        txmsg->cmsg.ext.is_extended_mid = (frame->flags & CAN_BATCH_FLAG_IDE) ? 1 : 0;
+        txmsg->cmsg.ext.is_remote_frame = 0;
+        memcpy(txmsg->cmsg.dat, frame->dat, CAN_MSG_DATA_MAX);
+
+        canmsg_queue_element(dev->cdev.msg_queue, txmsg);
+    }
+    batch->count = n;
+    if(!n)
+        return(EAGAIN);
+
+    can_drvr_transmit(&dev->cdev);
+
+    return(EOK);
+}
+
+/* Batch devctls, raw mode only */
+int can_batch_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data)
+{
+    if(dev->devinfo->mode != CANDEV_MODE_RAW_FRAME)
+        return(EINVAL);
+
+    switch(dcmd)
+    {
+        case CAN_DEVCTL_RX_FRAME_RAW_BATCH:
+            return can_batch_rx(dev, (CAN_BATCH *)data);
+        case CAN_DEVCTL_TX_FRAME_RAW_BATCH:
+            return can_batch_tx(dev, (CAN_BATCH *)data);
+        default:
+            return(ENOTSUP);
+    }
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
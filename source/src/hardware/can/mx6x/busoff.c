@@ -0,0 +1,229 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Bus-off recovery (-e).
+ *
+ * The FlexCAN would rejoin the bus on its own after 128 occurrences of 11
+ * recessive bits and send whatever the tx mailboxes still hold. Instead,
+ * automatic recovery is disabled (CTRL1[BOFFREC]) and the driver recovers:
+ *
+ *  - On the bus-off interrupt the ISR holds the tx mailboxes that were still
+ *    waiting to transmit (code back to INACTIVE, frame kept in place) and
+ *    stops refilling them. Queued frames stay in the device tx queues.
+ *  - The recovery thread waits the backoff delay, which doubles with every
+ *    bus-off up to the maximum and starts over at the minimum once the bus
+ *    stayed up for the maximum delay, then lets the controller rejoin.
+ *  - Once it is error active or passive again the held mailboxes are
+ *    re-armed and the queues drained as usual. If the bus was off for more
+ *    than the age limit the held and queued frames are stale and flushed
+ *    instead.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <hw/inout.h>
+#include <sys/neutrino.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+/* Hold the tx mailboxes still waiting to transmit. Called from the ISR */
+void can_busoff_enter(CANDEV_RINGO_INFO *devinfo)
+{
+    can_msg_obj_t       *mb;
+    uint32_t             i, code;
+
+    InterruptLock(&devinfo->txlock);
+    devinfo->busoff = 1;
+    devinfo->busoff_cycles = ClockCycles();
+    for(i = devinfo->txmbxstart; i < devinfo->txmbxstart + devinfo->numtx; i++)
+    {
+        mb = can_mb(devinfo, i);
+        code = (mb->canmcf & MSG_BUF_CODE_MASK) >> MSG_BUF_CODE_SHIFT;
+        if(code == TRANS_CODE_TRANSMIT_ONCE)
+        {
+            mb->canmcf = (mb->canmcf & ~MSG_BUF_CODE_MASK) | (TRANS_CODE_NOT_READY << MSG_BUF_CODE_SHIFT);
+            devinfo->busoff_held[i / 32] |= 1 << (i % 32);
+        }
+    }
+    InterruptUnlock(&devinfo->txlock);
+}
+
+/* Drop the frames queued on a tx device, called with txlock held */
+static void can_busoff_flush(CANDEV_RINGO *dev)
+{
+    canmsg_t            *txmsg;
+
+    while((txmsg = canmsg_dequeue_element(dev->cdev.msg_queue)))
+        canmsg_queue_element(dev->cdev.free_queue, txmsg);
+    dev->txbusy = 0;
+}
+
+/* Resume transmission after the controller rejoined the bus */
+static void can_busoff_resume(CANDEV_RINGO_INFO *devinfo, int stale)
+{
+    CANDEV_RINGO        *dev;
+    can_msg_obj_t       *mb;
+    uint32_t             i;
+
+    InterruptLock(&devinfo->txlock);
+    for(i = devinfo->txmbxstart; i < devinfo->txmbxstart + devinfo->numtx; i++)
+    {
+        dev = devinfo->devlist[i].owner;
+        if(stale)
+        {
+            if(dev->mbxid == (int)i)
+                can_busoff_flush(dev);
+        }
+        else if(devinfo->busoff_held[i / 32] & (1 << (i % 32)))
+        {
+            mb = can_mb(devinfo, i);
+            mb->canmcf = (mb->canmcf & ~MSG_BUF_CODE_MASK) | (TRANS_CODE_TRANSMIT_ONCE << MSG_BUF_CODE_SHIFT);
+        }
+    }
+    memset(devinfo->busoff_held, 0, sizeof(devinfo->busoff_held));
+    devinfo->busoff = 0;
+    InterruptUnlock(&devinfo->txlock);
+
+    // CAN FD frames wait in the driver's own tx queue
+    if(stale && (devinfo->iflags & INFO_FLAGS_FD))
+    {
+        InterruptLock(&devinfo->fdlock);
+        devinfo->fdtxq.tail = devinfo->fdtxq.head;
+        InterruptUnlock(&devinfo->fdlock);
+    }
+
+    // Start what was queued meanwhile, or after a flush what is queued next
+    for(i = devinfo->txmbxstart; i < devinfo->txmbxstart + devinfo->numtx; i++)
+    {
+        if(devinfo->devlist[i].owner == &devinfo->devlist[i])
+            can_drvr_transmit(&devinfo->devlist[i].cdev);
+    }
+}
+
+/* Convert ClockCycles() to milliseconds */
+static inline uint64_t can_cycles2ms(CANDEV_RINGO_INFO *devinfo, uint64_t cycles)
+{
+    return cycles / (devinfo->cycles_per_sec / 1000);
+}
+
+static void can_busoff_sleep(uint32_t ms)
+{
+    struct timespec      ts = { ms / 1000, (ms % 1000) * 1000000 };
+
+    nanosleep(&ts, NULL);
+}
+
+/* Recovery thread, woken by the ISR when the controller goes bus-off */
+static void *can_busoff_thread(void *arg)
+{
+    CANDEV_RINGO_INFO       *devinfo = arg;
+    const struct sigevent   *event;
+    struct _pulse            pulse;
+    uint64_t                 now, off_ms;
+    uint32_t                 backoff = devinfo->busoff_min_ms;
+    uint64_t                 up_cycles = 0;
+
+    // Register access and InterruptLock() need I/O privileges
+    ThreadCtl(PRIVITY_FLAGS, 0);
+
+    for(;;)
+    {
+        if(MsgReceivePulse(devinfo->busoff_chid, &pulse, sizeof(pulse), NULL) == -1)
+            continue;
+
+        // Client wakeup the ISR returned the bus-off event in place of
+        InterruptLock(&devinfo->txlock);
+        event = devinfo->busoff_wake;
+        devinfo->busoff_wake = NULL;
+        InterruptUnlock(&devinfo->txlock);
+        if(event)
+            can_deliver_event(event);
+
+        // A bus that stayed up long enough starts over at the minimum backoff
+        if(up_cycles && can_cycles2ms(devinfo, devinfo->busoff_cycles - up_cycles) >= devinfo->busoff_max_ms)
+            backoff = devinfo->busoff_min_ms;
+        can_busoff_sleep(backoff);
+        if(backoff < devinfo->busoff_max_ms)
+            backoff = (backoff * 2 < devinfo->busoff_max_ms) ? backoff * 2 : devinfo->busoff_max_ms;
+
+        // Rejoin: 128 occurrences of 11 recessive bits, then keep recovery manual
+        set_port32(devinfo->base + RINGO_CANCTRL, RINGO_CANCTRL_BOFFREC, 0);
+        while((in32(devinfo->base + RINGO_CANESR) & RINGO_CANES_FCS_MASK) >= RINGO_CANES_FCS_BUS_OFF)
+            can_busoff_sleep(1);
+        set_port32(devinfo->base + RINGO_CANCTRL, RINGO_CANCTRL_BOFFREC, RINGO_CANCTRL_BOFFREC);
+
+        now = ClockCycles();
+        off_ms = can_cycles2ms(devinfo, now - devinfo->busoff_cycles);
+        can_busoff_resume(devinfo, devinfo->busoff_age_ms && off_ms > devinfo->busoff_age_ms);
+        up_cycles = now;
+    }
+
+    return(NULL);
+}
+
+/* Disable automatic bus-off recovery and start the recovery thread */
+void can_busoff_init(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit)
+{
+    pthread_t           tid;
+    int                 coid;
+
+    devinfo->busoff_min_ms = devinit->busoff_min_ms;
+    devinfo->busoff_max_ms = devinit->busoff_max_ms;
+    devinfo->busoff_age_ms = devinit->busoff_age_ms;
+
+    devinfo->busoff_chid = ChannelCreate(0);
+    if(devinfo->busoff_chid == -1)
+    {
+        perror("Bus-off recovery: ChannelCreate failed");
+        exit(EXIT_FAILURE);
+    }
+    coid = ConnectAttach(0, 0, devinfo->busoff_chid, _NTO_SIDE_CHANNEL, 0);
+    if(coid == -1)
+    {
+        perror("Bus-off recovery: ConnectAttach failed");
+        exit(EXIT_FAILURE);
+    }
+    // Recovery goes at the priority of the tx clients
+    SIGEV_PULSE_INIT(&devinfo->busoff_event, coid,
+                     devinfo->devlist[devinfo->txmbxstart].cdev.event.sigev_priority,
+                     _PULSE_CODE_MINAVAIL, 0);
+
+    if(pthread_create(&tid, NULL, can_busoff_thread, devinfo) != EOK)
+    {
+        fprintf(stderr, "Bus-off recovery: pthread_create failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    set_port32(devinfo->base + RINGO_CANCTRL, RINGO_CANCTRL_BOFFREC, RINGO_CANCTRL_BOFFREC);
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
@@ -0,0 +1,375 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * CAN FD raw frame mode (-f, S32G only).
+ *
+ * libcan messages hold 8 data bytes, so CAN FD frames bypass the libcan
+ * queues: received frames are stored in devinfo->fdrxq, a lock free ring
+ * filled by the ISR, and read with CAN_DEVCTL_RX_FRAME_RAW_FD. Frames to
+ * send are queued in devinfo->fdtxq with CAN_DEVCTL_TX_FRAME_RAW_FD. Classic raw frames written with
+ * CAN_DEVCTL_TX_FRAME_RAW still go out through the same tx mailbox.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic.h>
+#include <gulliver.h>
+#include <hw/inout.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+/* Serializes the readers of the CAN FD receive queue */
+static pthread_mutex_t  can_fd_rx_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* CAN FD data length code to payload length */
+static const uint8_t can_fd_dlc2len[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+
+/* Smallest data length code holding len bytes */
+static uint32_t can_fd_len2dlc(uint32_t len)
+{
+    uint32_t    dlc = 8;
+
+    if(len <= 8)
+        return len;
+    while(can_fd_dlc2len[dlc] < len)
+        dlc++;
+    return dlc;
+}
+
+/* Program CAN FD operation. Called during can_init_hw() while in freeze mode */
+void can_fd_init(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit)
+{
+#if defined(S32G_FLEXCAN)
+    uint32_t    fdctrl = 0, tdcoff, r;
+
+    // ISO CAN FD protocol
+    set_port32(devinfo->base + RINGO_CANMC, FLEXCAN_MCR_FDEN, FLEXCAN_MCR_FDEN);
+    set_port32(devinfo->base + RINGO_CANCTRL2, FLEXCAN_CTRL2_ISOCANFDEN, FLEXCAN_CTRL2_ISOCANFDEN);
+
+    // Same payload size in every RAM region
+    for(r = 0; r < FLEXCAN_FD_NUM_REGIONS; r++)
+        fdctrl |= FLEXCAN_FDCTRL_MBDSR(r, __builtin_ctz(devinfo->fd_payload) - 3);
+
+    if(devinfo->iflags & INFO_FLAGS_FD_BRS)
+    {
+        out32(devinfo->base + FLEXCAN_FDCBT, (devinit->fbr_presdiv << FLEXCAN_FDCBT_FPRESDIV_SHIFT) |
+                                             (devinit->fbr_rjw << FLEXCAN_FDCBT_FRJW_SHIFT) |
+                                             (devinit->fbr_propseg << FLEXCAN_FDCBT_FPROPSEG_SHIFT) |
+                                             (devinit->fbr_pseg1 << FLEXCAN_FDCBT_FPSEG1_SHIFT) |
+                                             (devinit->fbr_pseg2 << FLEXCAN_FDCBT_FPSEG2_SHIFT));
+        fdctrl |= FLEXCAN_FDCTRL_FDRATE;
+
+        // Transceiver delay compensation is needed at the fast data rates
+        if(devinit->fbr_presdiv <= 1)
+        {
+            tdcoff = (devinit->fbr_propseg + devinit->fbr_pseg1 + 2) * (devinit->fbr_presdiv + 1);
+            if(tdcoff > FLEXCAN_FDCTRL_TDCOFF_MAXVAL)
+                tdcoff = FLEXCAN_FDCTRL_TDCOFF_MAXVAL;
+            fdctrl |= FLEXCAN_FDCTRL_TDCEN | (tdcoff << FLEXCAN_FDCTRL_TDCOFF_SHIFT);
+        }
+    }
+    out32(devinfo->base + FLEXCAN_FDCTRL, fdctrl);
+
+    // Larger mailboxes: fewer of them fit in the message buffer RAM
+    set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_MAXMB_MASK,
+               devinfo->mbs_per_region * FLEXCAN_FD_NUM_REGIONS - 1);
+#endif
+}
+
+/*
+ * Decode a received classic or CAN FD frame. The frame is read from a
+ * mailbox or an Rx FIFO output element, ctrl is its control/status word.
+ */
+void can_fd_read(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl, CAN_FD_MSG *msg)
+{
+    volatile uint32_t   *data = &mb->canmdl;
+    uint32_t             val32, i, max;
+
+    msg->mid = mb->canmid & RINGO_CANMID_MASK_EXT;
+    msg->timestamp = ctrl & 0x0000FFFF;
+    msg->timestamp_ns = can_timestamp(devinfo, mb, ctrl);
+    msg->len = can_fd_dlc2len[(ctrl & MSG_BUF_DLC_MASK) >> MSG_BUF_DLC_SHIFT];
+    msg->flags = 0;
+    if(ctrl & MB_CNT_EDL)
+        msg->flags |= CAN_FD_FLAG_EDL;
+    else if(msg->len > 8)
+        msg->len = 8;
+    if(ctrl & MB_CNT_BRS)
+        msg->flags |= CAN_FD_FLAG_BRS;
+    if(ctrl & MB_CNT_ESI)
+        msg->flags |= CAN_FD_FLAG_ESI;
+    if(ctrl & MB_CNT_IDE)
+        msg->flags |= CAN_FD_FLAG_IDE;
+    if(ctrl & MB_CNT_RTR)
+        msg->flags |= CAN_FD_FLAG_RTR;
+
+    // An Enhanced Rx FIFO element always holds 64 bytes, a mailbox only its
+    // configured payload; never read past it into the next mailbox
+    if((volatile uint32_t *)mb != devinfo->erfifo)
+    {
+        max = (devinfo->iflags & INFO_FLAGS_FD) ? devinfo->fd_payload : CAN_MSG_DATA_MAX;
+        if(msg->len > max)
+            msg->len = max;
+    }
+
+    // Data is received MSB first in each word
+    for(i = 0; i < (msg->len + 3) / 4; i++)
+    {
+        val32 = data[i];
+        if(devinfo->iflags & INFO_FLAGS_ENDIAN_SWAP)
+            ENDIAN_SWAP32(&val32);
+        memcpy(&msg->dat[i * 4], &val32, sizeof(val32));
+    }
+}
+
+/*
+ * Store a received frame in the CAN FD receive queue. When it is full the
+ * frame is dropped (-O new), or it overwrites the oldest one and the reader
+ * skips what was overwritten. Either way the ISR never touches tail.
+ */
+void can_fd_rx(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl)
+{
+    CAN_FD_QUEUE        *q = &devinfo->fdrxq;
+    CANDEV_RINGO        *dev = &devinfo->devlist[devinfo->rxmbxstart];
+    uint32_t             head = q->head;
+    uint32_t             queued = head - q->tail;
+
+    if(queued >= q->size)
+    {
+        devinfo->stats.sw_receive_q_full++;
+        dev->mbstats.q_full++;
+        if(devinfo->iflags & INFO_FLAGS_RX_DROP_NEW)
+            return;
+        queued = q->size - 1;
+    }
+    can_fd_read(devinfo, mb, ctrl, &q->msg[head & (q->size - 1)]);
+    q->cycles[head & (q->size - 1)] = devinfo->ts_cycles;
+
+    // Publish the frame before the new head
+    __cpu_membarrier();
+    q->head = head + 1;
+    can_mb_stats_rx(dev, queued + 1);
+
+    devinfo->stats.received_frames++;
+}
+
+/*
+ * Take the oldest frame out of the CAN FD receive queue, the consumer side
+ * of can_fd_rx(). A frame the ISR may be overwriting while it is copied is
+ * skipped.
+ */
+static int can_fd_rx_get(CAN_FD_QUEUE *q, CAN_FD_MSG *msg, uint64_t *cycles)
+{
+    uint32_t             tail = q->tail;
+    uint32_t             head;
+
+    for(;;)
+    {
+        head = q->head;
+        if(head == tail)
+            break;
+        // Frames overwritten since the last read are gone
+        if(head - tail >= q->size)
+            tail = head - q->size + 1;
+
+        __cpu_membarrier();
+        *msg = q->msg[tail & (q->size - 1)];
+        *cycles = q->cycles[tail & (q->size - 1)];
+        __cpu_membarrier();
+        if(q->head - tail < q->size)
+        {
+            q->tail = tail + 1;
+            return(EOK);
+        }
+    }
+    q->tail = tail;
+
+    return(EAGAIN);
+}
+
+/* Fill the tx mailbox with a frame and start its transmission */
+static void can_fd_ringo_tx(CANDEV_RINGO *dev, CAN_FD_MSG *msg)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    can_msg_obj_t       *mb = can_mb(devinfo, dev->mbxid);
+    volatile uint32_t   *data = &mb->canmdl;
+    uint32_t             can_mcf, val32, dlc, i;
+
+    dlc = can_fd_len2dlc(msg->len);
+    can_mcf = (TRANS_CODE_NOT_READY << MSG_BUF_CODE_SHIFT) | (dlc << MSG_BUF_DLC_SHIFT);
+    if(msg->flags & CAN_FD_FLAG_IDE)
+        can_mcf |= MB_CNT_IDE | MB_CNT_SRR;
+    if(msg->flags & CAN_FD_FLAG_EDL)
+    {
+        can_mcf |= MB_CNT_EDL;
+        if((msg->flags & CAN_FD_FLAG_BRS) && (devinfo->iflags & INFO_FLAGS_FD_BRS))
+            can_mcf |= MB_CNT_BRS;
+    }
+    else if(msg->flags & CAN_FD_FLAG_RTR)
+    {
+        can_mcf |= MB_CNT_RTR;
+    }
+    mb->canmcf = can_mcf;
+
+    // Data is transmitted MSB first in each word, pad up to the DLC length
+    for(i = 0; i < (can_fd_dlc2len[dlc] + 3) / 4; i++)
+    {
+        memcpy(&val32, &msg->dat[i * 4], sizeof(val32));
+        if(devinfo->iflags & INFO_FLAGS_ENDIAN_SWAP)
+            ENDIAN_SWAP32(&val32);
+        data[i] = val32;
+    }
+    mb->canmid = msg->mid;
+
+    // Transmission active
+    mb->canmcf = can_mcf | (TRANS_CODE_TRANSMIT_ONCE << MSG_BUF_CODE_SHIFT);
+}
+
+/*
+ * Start the next queued frame on the tx mailbox, CAN FD frames first.
+ * Called with fdlock held, returns 0 when both queues are empty.
+ */
+static int can_fd_tx_start(CANDEV_RINGO *dev)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    CAN_FD_QUEUE        *q = &devinfo->fdtxq;
+    CAN_FD_MSG           msg;
+    canmsg_t            *txmsg;
+
+    if(q->head != q->tail)
+    {
+        can_fd_ringo_tx(dev, &q->msg[q->tail & (q->size - 1)]);
+        q->tail++;
+        return 1;
+    }
+
+    if((txmsg = canmsg_dequeue_element(dev->cdev.msg_queue)))
+    {
+        // Classic raw frame
+        memset(&msg, 0, sizeof(msg));
+        msg.mid = txmsg->cmsg.mid;
+        msg.len = (txmsg->cmsg.len > CAN_MSG_DATA_MAX) ? CAN_MSG_DATA_MAX : txmsg->cmsg.len;
+        msg.flags = (txmsg->cmsg.ext.is_extended_mid) ? CAN_FD_FLAG_IDE : 0;
+        memcpy(msg.dat, txmsg->cmsg.dat, CAN_MSG_DATA_MAX);
+        can_fd_ringo_tx(dev, &msg);
+        canmsg_queue_element(dev->cdev.free_queue, txmsg);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* LIBCAN transmit in CAN FD mode: start the mailbox unless a frame is in flight */
+void can_fd_transmit(CANDEV_RINGO *dev)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+
+    InterruptLock(&devinfo->fdlock);
+    if(!(dev->dflags & CANDEV_RINGO_TX_ENABLED) && can_fd_tx_start(dev))
+        atomic_set(&dev->dflags, CANDEV_RINGO_TX_ENABLED);
+    InterruptUnlock(&devinfo->fdlock);
+}
+
+/* Transmit complete interrupt in CAN FD mode */
+void can_fd_tx_done(CANDEV_RINGO *dev)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+
+    InterruptLock(&devinfo->fdlock);
+    if(!can_fd_tx_start(dev))
+        atomic_clr(&dev->dflags, CANDEV_RINGO_TX_ENABLED);
+    InterruptUnlock(&devinfo->fdlock);
+}
+
+/* CAN FD raw frame devctls */
+int can_fd_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    CAN_FD_MSG          *msg = (CAN_FD_MSG *)data;
+    CAN_FD_QUEUE        *q;
+    uint64_t             cycles;
+    int                  status = EOK;
+
+    if(!(devinfo->iflags & INFO_FLAGS_FD))
+        return(EINVAL);
+
+    switch(dcmd)
+    {
+        case CAN_DEVCTL_TX_FRAME_RAW_FD:
+            // Make sure this is the transmit mailbox and the frame fits in it
+            if((dev->mbxid < devinfo->txmbxstart) ||
+               (msg->len > ((msg->flags & CAN_FD_FLAG_EDL) ? devinfo->fd_payload : CAN_MSG_DATA_MAX)) ||
+               ((msg->flags & CAN_FD_FLAG_EDL) && (msg->flags & CAN_FD_FLAG_RTR)))
+                return(EINVAL);
+
+            q = &devinfo->fdtxq;
+            // Padding bytes up to the next valid CAN FD length are sent as zero
+            memset(&msg->dat[msg->len], 0, CAN_FD_DATA_MAX - msg->len);
+
+            InterruptLock(&devinfo->fdlock);
+            if(q->head - q->tail == q->size)
+            {
+                status = EAGAIN;
+            }
+            else
+            {
+                q->msg[q->head & (q->size - 1)] = *msg;
+                q->head++;
+                if(!(dev->dflags & CANDEV_RINGO_TX_ENABLED))
+                {
+                    atomic_set(&dev->dflags, CANDEV_RINGO_TX_ENABLED);
+                    can_fd_tx_start(dev);
+                }
+            }
+            InterruptUnlock(&devinfo->fdlock);
+            break;
+
+        case CAN_DEVCTL_RX_FRAME_RAW_FD:
+            // Make sure this is the receive mailbox
+            if(dev->mbxid >= devinfo->txmbxstart)
+                return(EINVAL);
+
+            q = &devinfo->fdrxq;
+            pthread_mutex_lock(&can_fd_rx_mutex);
+            status = can_fd_rx_get(q, msg, &cycles);
+            pthread_mutex_unlock(&can_fd_rx_mutex);
+            if(status == EOK)
+                can_mb_stats_latency(&dev->mbstats, ClockCycles() - cycles);
+            break;
+
+        default:
+            return(ENOTSUP);
+    }
+
+    return(status);
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
@@ -57,7 +57,7 @@
 //#define DEBUG_DRVR
 
 /* Function prototypes */
-void can_ringo_tx(CANDEV_RINGO *cdev, canmsg_t *txmsg);
+void can_ringo_tx(CANDEV_RINGO *dev, int mbxid, canmsg_t *txmsg);
 void can_ringo_debug(CANDEV_RINGO *dev);
 void can_print_mailbox(CANDEV_RINGO_INFO *devinfo);
 void can_print_reg(CANDEV_RINGO_INFO *devinfo);
@@ -68,196 +68,295 @@ void set_port32(unsigned port, uint32_t mask, uint32_t data)
     out32(port, (in32(port) & ~mask) | (data & mask));
 }
 
-const struct sigevent *can_mb_intr_s32g(CANDEV_RINGO_INFO  *devinfo )
+/*
+ * Mailbox interrupt flag registers in mailbox order, 32 mailboxes per register.
+ * Only the mailboxes enabled in devinfo->mbxmask are serviced by the ISR.
+ */
+static const uint32_t can_iflag_reg[] = {
+    RINGO_CANIFLAG1,        /* MB0-31   */
+    RINGO_CANIFLAG2,        /* MB32-63  */
+#if defined(S32G_FLEXCAN)
+    RINGO_CANIFLAG3,        /* MB64-95  */
+    RINGO_CANIFLAG4,        /* MB96-127 */
+#endif
+};
+#define CAN_NUM_IFLAG_REGS    (sizeof(can_iflag_reg) / sizeof(can_iflag_reg[0]))
+
+/* Build the per IFLAG register masks of the mailboxes owned by the driver */
+void can_init_mbxmask(CANDEV_RINGO_INFO *devinfo)
 {
-    struct sigevent         *event = NULL;
-    CANDEV_RINGO            *devlist = devinfo->devlist;
-    uint32_t                 irqsrc1, irqsrc2, irqsrc3, irqsrc4;
-    uint32_t                 ctrl, canmcf_ide = 0;
-    uint32_t                 iflag_rx[2] = {0}, iflag_tx[2] = {0};
-    uint32_t                 oflag_rx[2] = {0}, oflag_tx[2] = {0};
-    uint32_t                 rx_irq_reg[2] = {0}, tx_irq_reg[2] = {0};
-    canmsg_t                *txmsg = NULL;
-    canmsg_t                *rxmsg = NULL;
-    uint32_t                 mbxid = 0;         /* mailbox index */
+    uint32_t    i;
+
+    memset(devinfo->mbxmask, 0, sizeof(devinfo->mbxmask));
+    // Rx devices are not backed by mailboxes when receiving through an Rx FIFO
+    if(!(devinfo->iflags & INFO_FLAGS_RX_ANY_FIFO))
+    {
+        for(i = devinfo->rxmbxstart; i < (devinfo->rxmbxstart + devinfo->numrx); i++)
+        {
+            devinfo->mbxmask[i / 32] |= MAILBOX(i % 32);
+        }
+    }
+    for(i = devinfo->txmbxstart; i < (devinfo->txmbxstart + devinfo->numtx); i++)
+    {
+        devinfo->mbxmask[i / 32] |= MAILBOX(i % 32);
+    }
+}
+
+/*
+ * Copy a received frame into the device's receive queue.
+ * The frame is read from a mailbox or from an Rx FIFO output element, which
+ * share the same layout. ctrl is the already read control/status word.
+ * Software filter devices to wake are noted in wake.
+ */
+void can_rx_copy(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO *dev, can_msg_obj_t *mb, uint32_t ctrl, uint32_t *wake)
+{
+    // Raw frames go straight to the shared memory rx ring when there is one
+    if (devinfo->rxring) {
+        can_rxring_put(devinfo, mb, ctrl);
+        return;
+    }
+
+    // Raw frames accepted by a software filter go to the filter devices instead
+    if (devinfo->swf_ndevs && dev->mbxid == devinfo->rxmbxstart && can_swf_rx(devinfo, mb, ctrl, wake)) {
+        devinfo->stats.received_frames++;
+        return;
+    }
+
+    if (can_rx_queue(devinfo, dev, mb, ctrl)) {
+        devinfo->stats.received_frames++;
+    }
+}
+
+/* Queue a received frame on a device. Returns 0 when the frame is dropped */
+int can_rx_queue(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO *dev, can_msg_obj_t *mb, uint32_t ctrl)
+{
+    canmsg_t                *rxmsg;
     uint32_t                *val32;
-    int                      i, n;
 
-    irqsrc1 = in32(devinfo->base + RINGO_CANIFLAG1);   /* for rx0-31  */
-    irqsrc2 = in32(devinfo->base + RINGO_CANIFLAG2);   /* for rx32-64 */
-    irqsrc3 = in32(devinfo->base + RINGO_CANIFLAG3);   /* for tx0-31  */
-    irqsrc4 = in32(devinfo->base + RINGO_CANIFLAG4);   /* for rx32-64 */
+    // Get the next free receive message or overwrite the oldest
+    rxmsg = canmsg_dequeue_element(dev->cdev.free_queue);
+    // if no queue elements are free, re-use the oldest rx message
+    if (!rxmsg) {
+        devinfo->stats.sw_receive_q_full++;
+        dev->mbstats.q_full++;
+        // or keep the queued ones and drop the new frame (-O new)
+        if (devinfo->iflags & INFO_FLAGS_RX_DROP_NEW) {
+            return 0;
+        }
+        rxmsg = canmsg_dequeue_element(dev->cdev.msg_queue);
+        if (!rxmsg) {
+            // Both queues are empty, the frame is dropped
+            return 0;
+        }
+    }
+
+    /* Retrieve the message length from the DLC field */
+    rxmsg->cmsg.len = (ctrl & MSG_BUF_DLC_MASK) >> MSG_BUF_DLC_SHIFT;
 
-    if (devinfo->mode == CANDEV_MODE_RAW_FRAME) {
-        // Get the id of the mailbox that generated the interrupt
-        iflag_rx[0] = irqsrc1 & RAW_MODE_RX_IRQ;
-        iflag_tx[0] = irqsrc1 & RAW_MODE_TX_IRQ;
-        oflag_tx[0] = iflag_tx[0];
-        iflag_tx[0] = iflag_tx[0] >> (devinfo->numrx + devinfo->rxmbxstart);
-        tx_irq_reg[0] = RINGO_CANIFLAG1;
-    } else {
-        // Get the id of the mailbox that generated the interrupt
-        iflag_rx[0] = irqsrc1;
-        iflag_rx[1] = irqsrc2;
-        iflag_tx[0] = irqsrc3;
-        iflag_tx[1] = irqsrc4;
-        oflag_tx[0] = iflag_tx[0];
-        oflag_tx[1] = iflag_tx[1];
-        rx_irq_reg[0] = RINGO_CANIFLAG1;
-        rx_irq_reg[1] = RINGO_CANIFLAG2;
-        tx_irq_reg[0] = RINGO_CANIFLAG3;
-        tx_irq_reg[1] = RINGO_CANIFLAG4;
+    /* Save the message ID */
+    rxmsg->cmsg.mid = mb->canmid;
+    /* Save message timestamp */
+    rxmsg->cmsg.ext.timestamp = ctrl & 0x0000FFFF;
+
+    rxmsg->cmsg.ext.is_extended_mid = (ctrl & MB_CNT_IDE) > 0;
+
+    /*
+     *  Access the data as a uint32_t array for endian conversion
+     *  and copy data from receive mailbox to receive message
+     */
+    val32 = (uint32_t *)rxmsg->cmsg.dat;
+    val32[0] = mb->canmdl;
+    val32[1] = mb->canmdh;
+
+    if(devinfo->iflags & INFO_FLAGS_ENDIAN_SWAP) {
+        // Convert from Big Endian to Little Endian since data is received MSB
+        ENDIAN_SWAP32(&val32[0]);
+        ENDIAN_SWAP32(&val32[1]);
     }
 
-    // Determine if transmit or receive interrupt
-    for(n = 0; n < 2; n++) {
+    // Add populated element to the receive queue
+    canmsg_queue_element(dev->cdev.msg_queue, rxmsg);
+    can_mb_stats_rx(dev, dev->cdev.msg_queue->cnt);
+    return 1;
+}
 
-        if(iflag_rx[n] > 0) {
-	// receive interrupt
-            oflag_rx[n] = iflag_rx[n];
-            for(i = 0; (i < (devinfo->rxmbxstart + devinfo->numrx + n * 32)) && (iflag_rx[n] > 0); i++) {
-                if(iflag_rx[n] & 1) {
-                    mbxid = i + (n * 32);
-                    break;
-                } else {
-                    iflag_rx[n] = iflag_rx[n] >> 1;
-                }
-            }
+/*
+ * Read a received frame out of a mailbox and release the mailbox.
+ * Returns 0 when the mailbox stayed BUSY, it is left pending for the next pass.
+ */
+static inline int can_mb_rx(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO *dev, int mbxid, uint32_t *wake)
+{
+    can_msg_obj_t           *mb = can_mb(devinfo, mbxid);
+    uint32_t                 ctrl;
+    int                      retries = FLEXCAN_MB_BUSY_RETRIES;
 
-            // Get the next free receive message or overwrite the oldest
-            rxmsg = canmsg_dequeue_element(devlist[mbxid].cdev.free_queue);
-            // if no queue elements are free, re-use the oldest rx message
-            if (!rxmsg) {
-                rxmsg = canmsg_dequeue_element(devlist[mbxid].cdev.msg_queue);
-                devinfo->stats.sw_receive_q_full++;
-                if (!rxmsg) {
-                    /* Break from the while loop, both queus are full */
-                    break;
-                }
-            }
-            /*
-             * Reading the canmcf control status word of the message mbx
-             * buffer triggers a lock for that buffer.  It stays locked until
-             * the free running timer is read, preventing corruption issues
-             * due to a new message filling the mailbox.  A shadow register
-             * takes care of preserving new messages.
-             */
+    /*
+     * Reading the canmcf control status word of the message mbx
+     * buffer triggers a lock for that buffer.  It stays locked until
+     * the free running timer is read, preventing corruption issues
+     * due to a new message filling the mailbox.  A shadow register
+     * takes care of preserving new messages.
+     */
 
-            /*
-             * Make sure that the mailbox is not busy - CPU access is not permitted while busy.
-             */
-            while (((ctrl = devinfo->canmsg[mbxid].canmcf) & (REC_CODE_BUSY << 24)) != 0);
-            /* Retrieve the message length from the DLC field */
-            rxmsg->cmsg.len = (ctrl & MSG_BUF_DLC_MASK) >> MSG_BUF_DLC_SHIFT;
+    /*
+     * Make sure that the mailbox is not busy - CPU access is not permitted while busy.
+     * BUSY only lasts while the FlexCAN moves a frame in, don't wait for it in the ISR
+     * any longer than that.
+     */
+    while (((ctrl = mb->canmcf) & (REC_CODE_BUSY << 24)) != 0) {
+        if (--retries == 0) {
+            dev->mbstats.busy_skips++;
+            return 0;
+        }
+    }
 
-            /* Save the message ID */
-            rxmsg->cmsg.mid = devinfo->canmsg[mbxid].canmid;
-            /* Save message timestamp */
-            rxmsg->cmsg.ext.timestamp = ctrl & 0x0000FFFF;
-            canmcf_ide = ctrl & MB_CNT_IDE;
+    if ((devinfo->iflags & INFO_FLAGS_FD) && !devinfo->rxring) {
+        can_fd_rx(devinfo, mb, ctrl);
+    } else {
+        can_rx_copy(devinfo, dev, mb, ctrl, wake);
+    }
 
-            rxmsg->cmsg.ext.is_extended_mid = canmcf_ide > 0;
+    /* Set mailbox to empty */
+    mb->canmcf =
+          ((mb->canmcf & ~MSG_BUF_CODE_MASK) |
+           (REC_CODE_EMPTY << MSG_BUF_CODE_SHIFT) | (ctrl & MB_CNT_IDE));
 
-            /*
-             *  Access the data as a uint32_t array for endian conversion
-             *  and copy data from receive mailbox to receive message
-             */
-            val32 = (uint32_t *)rxmsg->cmsg.dat;
-            val32[0] = devinfo->canmsg[mbxid].canmdl;
-            val32[1] = devinfo->canmsg[mbxid].canmdh;
-
-            if(devinfo->iflags & INFO_FLAGS_ENDIAN_SWAP) {
-                // Convert from Big Endian to Little Endian since data is received MSB
-                ENDIAN_SWAP32(&val32[0]);
-                ENDIAN_SWAP32(&val32[1]);
-            }
+    /* Unlock the message buffer by reading the CAN free running timer */
+    devinfo->timer = in32(devinfo->base + RINGO_CANTIMER);
+    return 1;
+}
 
-            /* Set mailbox to empty */
-            devinfo->canmsg[mbxid].canmcf =
-                  ((devinfo->canmsg[mbxid].canmcf & ~MSG_BUF_CODE_MASK) |
-                   (REC_CODE_EMPTY << MSG_BUF_CODE_SHIFT) | canmcf_ide );
+/*
+ * Start queued messages on the free tx mailboxes of a device, called with
+ * txlock held. The tx mailboxes act as a hardware queue: the FlexCAN sends
+ * the lowest message ID first, or with -w the lowest numbered mailbox. In
+ * the latter case the mailboxes are only refilled once all are done, so
+ * messages keep their queue order. Nothing waits for the bus, completed
+ * mailboxes are refilled from the tx interrupt.
+ */
+static void can_tx_fill(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO *dev)
+{
+    canmsg_t                *txmsg;
+    canmsg_t                 schedmsg;
+    uint32_t                 free;
+    int                      bit;
 
-            /* Unlock the message buffer by reading the CAN free running timer */
-            devinfo->timer = in32(devinfo->base + RINGO_CANTIMER);
+    if ((devinfo->iflags & INFO_FLAGS_LBUF) && dev->txbusy) {
+        return;
+    }
+    // Frames stay queued while the bus is off
+    if (devinfo->busoff) {
+        return;
+    }
 
-            /* Clear receive mailbox interrupts by writing a 1 to the interrupt source */
-            out32(devinfo->base + rx_irq_reg[n], oflag_rx[n]);
+    free = ~dev->txbusy & (0xFFFFFFFF >> (32 - dev->txmbs));
+    // Due scheduled frames go ahead of the queued ones
+    while (free && devinfo->sched_ready && dev->mbxid == devinfo->txmbxstart &&
+           can_txsched_get(devinfo, &schedmsg)) {
+        bit = __builtin_ctz(free);
+        free &= free - 1;
+        dev->txbusy |= MAILBOX(bit);
+        can_ringo_tx(dev, dev->mbxid + bit, &schedmsg);
+    }
+    while (free && (txmsg = canmsg_dequeue_element(dev->cdev.msg_queue))) {
+        bit = __builtin_ctz(free);
+        free &= free - 1;
+        dev->txbusy |= MAILBOX(bit);
+        can_ringo_tx(dev, dev->mbxid + bit, txmsg);
 
-            // Add populated element to the receive queue
-            canmsg_queue_element(devlist[mbxid].cdev.msg_queue, rxmsg);
-            devinfo->stats.received_frames++;
+        // tx message is copied - return element to free queue
+        canmsg_queue_element(dev->cdev.free_queue, txmsg);
+    }
+}
 
-            /* Check for one or more blocked clients and return event to
-               event handler */
-            if (devlist[mbxid].cdev.wait_client_queue->cnt) {
-                event = &devlist[mbxid].cdev.event;
-            }
+/* Transmit complete - refill the device's tx mailboxes */
+static inline void can_mb_tx(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO *dev, int mbxid)
+{
+    devinfo->stats.transmitted_frames++;
+    dev->mbstats.frames++;
+
+    // CAN FD mode feeds the mailbox from both the CAN FD and the raw frame queue
+    if (devinfo->iflags & INFO_FLAGS_FD) {
+        can_fd_tx_done(dev);
+        return;
+    }
 
-            if (event)
-                return event;
+    mbxid -= dev->mbxid;
+    InterruptLock(&devinfo->txlock);
+    dev->txbusy &= ~MAILBOX(mbxid);
+    can_tx_fill(devinfo, dev);
+    InterruptUnlock(&devinfo->txlock);
+}
+
+/*
+ * Service every pending mailbox in one interrupt.
+ *
+ * The IFLAG registers are walked with count-trailing-zeros and each mailbox
+ * is drained, so a burst of frames costs one kernel interrupt entry rather
+ * than one per frame. Only one event can be returned, so the devices with
+ * blocked clients are collected in a bitmap for the whole interrupt and
+ * woken through can_wake_event(): directly when there is one, by the
+ * wakeup thread otherwise. An rx mailbox that stays BUSY keeps its IFLAG
+ * bit and is retried on the next pass.
+ */
+const struct sigevent *can_mb_intr(CANDEV_RINGO_INFO *devinfo)
+{
+    CANDEV_RINGO            *devlist = devinfo->devlist;
+    CANDEV_RINGO            *dev;
+    uint32_t                 wake[CAN_WAKE_WORDS] = { 0 };
+    uint32_t                 pending, serviced, n;
+    int                      bit, mbxid;
+
+    do {
+        serviced = 0;
+        // Reference for the 64 bit timestamps of the frames read in this pass
+        can_timestamp_sync(devinfo);
+
+        // Empty the Rx FIFO first, it is the receive path in the FIFO modes
+        if (devinfo->iflags & INFO_FLAGS_RX_ANY_FIFO) {
+            serviced += can_rxfifo_intr(devinfo, wake);
         }
 
-        if(iflag_tx[n] > 0) {
-        // Transmit interrupt
-            out32(devinfo->base + tx_irq_reg[n], oflag_tx[n]);
-            for(i = devinfo->txmbxstart;
-                (i < (devinfo->txmbxstart + devinfo->numtx + n * 32)) && (iflag_tx[n] > 0); i++) {
-                if(iflag_tx[n] & 1) {
-                    mbxid = i + n * 32;
-                    break;
+        for(n = 0; n < CAN_NUM_IFLAG_REGS; n++) {
+            pending = in32(devinfo->base + can_iflag_reg[n]) & devinfo->mbxmask[n];
+
+            while(pending) {
+                bit = __builtin_ctz(pending);
+                mbxid = n * 32 + bit;
+                dev = devlist[mbxid].owner;
+                pending &= pending - 1;
+
+                if (mbxid < (devinfo->rxmbxstart + devinfo->numrx)) {
+                    if (!can_mb_rx(devinfo, dev, mbxid, wake)) {
+                        continue;
+                    }
+                    /* Clear receive mailbox interrupt by writing a 1 to the interrupt source */
+                    out32(devinfo->base + can_iflag_reg[n], MAILBOX(bit));
                 } else {
-                    iflag_tx[n] = iflag_tx[n] >> 1;
+                    /* Clear transmit mailbox interrupt before the mailbox is refilled */
+                    out32(devinfo->base + can_iflag_reg[n], MAILBOX(bit));
+                    can_mb_tx(devinfo, dev, mbxid);
                 }
-            }
+                serviced++;
+                devinfo->isr_frames++;
 
-            /*
-             * Transmit mailbox processing
-             */
-            devinfo->stats.transmitted_frames++;
-
-            // Determine if there is another message to transmit
-            txmsg = canmsg_dequeue_element(devlist[mbxid].cdev.msg_queue);
-            if (txmsg) {
-                // Transmit next message
-                can_ringo_tx(&devlist[mbxid], txmsg);
-
-                // tx message is copied - return element to free queue
-                canmsg_queue_element(devlist[mbxid].cdev.free_queue, txmsg);
-            } else {
-                // No more transmit messages, end transmission
-                atomic_clr(&devlist[mbxid].dflags, CANDEV_RINGO_TX_ENABLED);
-            }
-
-            if (devlist[mbxid].cdev.wait_client_queue->cnt) {
-                event = &devlist[mbxid].cdev.event;
+                /* Check for one or more blocked clients */
+                if (can_dev_waiting(dev)) {
+                    can_wake_add(wake, dev);
+                }
             }
-            if (event)
-                return event;
         }
-        // Clear Mailbox Interrupt Flag
-        out32(devinfo->base + rx_irq_reg[n], oflag_rx[n]);
-        out32(devinfo->base + tx_irq_reg[n], oflag_tx[n]);
-    }
-    return event;
+    } while(serviced);
+
+    return can_wake_event(devinfo, wake);
 }
 
-const struct sigevent *can_intr(void *area, int id)
+/* Interrupt handling proper, can_intr() accounts for its cost */
+static const struct sigevent *can_intr_service(CANDEV_RINGO_INFO *devinfo)
 {
-    struct sigevent         *event = NULL;
-    CANDEV_RINGO_INFO       *devinfo = area;
-    CANDEV_RINGO            *devlist = devinfo->devlist;
-    uint32_t                 estat, irqsrc1, irqsrc2, ctrl, canmcf_ide = 0;
-#ifdef S32G_FLEXCAN
-    uint32_t                 irqsrc3, irqsrc4;
-#endif
-    uint32_t                 iflag_rx = 0, iflag_tx = 0, oflag_rx = 0;
-    uint32_t                 tx_irq_reg=0, oflag_tx=0;
-    canmsg_t                *txmsg = NULL;
-    canmsg_t                *rxmsg = NULL;
-    uint32_t                 mbxid = 0;         /* mailbox index */
-    uint32_t                *val32;
-    int                      i = 0;
-    static int               erroractive = 1;
+    const struct sigevent   *event;
+    uint32_t                 estat;
+    int                      busoff = 0;
 
     devinfo->stats.total_interrupts++;
 
@@ -365,6 +464,12 @@ const struct sigevent *can_intr(void *area, int id)
             atomic_set(&devinfo->canestat, RINGO_CANES_BOFFINT);
             devinfo->stats.bus_off_state_count++;
             devinfo->stats.total_frame_errors++;
+            // Hold the tx mailboxes until the recovery thread brings the bus back
+            if(devinfo->busoff_min_ms && !devinfo->busoff)
+            {
+                can_busoff_enter(devinfo);
+                busoff = 1;
+            }
 
             // Clear interrupt source
             out32(devinfo->base + RINGO_CANESR, RINGO_CANES_BOFFINT);
@@ -384,225 +489,123 @@ const struct sigevent *can_intr(void *area, int id)
           */
         /* Going back to Error Active can happen without an error Int ? */
         if((estat & RINGO_CANES_FCS_MASK) == 0) {
-        if (!erroractive) {
+        if (!devinfo->erroractive) {
             /* Going error active */
             }
-            erroractive = 1;
+            devinfo->erroractive = 1;
         }
 
         if((estat & RINGO_CANES_FCS_MASK) == RINGO_CANES_FCS_ERROR_PASSIVE) {
-            if (erroractive) {
+            if (devinfo->erroractive) {
                 /* Going error passive */
                 devinfo->stats.error_passive_state_count++;
             }
-            erroractive = 0;
+            devinfo->erroractive = 0;
         }
 
         // Clear Out All CANESR Interrupts
         out32(devinfo->base + RINGO_CANESR, in32(devinfo->base + RINGO_CANESR) | 0xffffffff);
     }
 
-    /*
-     * Loop as long as the CAN controller shows interrupts.
-     * Check for message object interrupts.
-     */
-    // Check for Mailbox Interrupts
-    while(1)
+    // Drain all pending mailboxes
+    event = can_mb_intr(devinfo);
+    // The recovery thread passes on the client wakeup
+    if(busoff)
     {
+        devinfo->busoff_wake = event;
+        event = &devinfo->busoff_event;
+    }
 
-#if defined(S32G_FLEXCAN)
-        irqsrc1 = in32(devinfo->base + RINGO_CANIFLAG1);
-        irqsrc2 = in32(devinfo->base + RINGO_CANIFLAG2);
-        irqsrc3 = in32(devinfo->base + RINGO_CANIFLAG3);
-        irqsrc4 = in32(devinfo->base + RINGO_CANIFLAG4);
-        if( (irqsrc1 == 0) && (irqsrc2 == 0) && (irqsrc3 == 0) && (irqsrc4 == 0))
-            break;
-        can_mb_intr_s32g(devinfo);
-#else
-        irqsrc1 = in32(devinfo->base + RINGO_CANIFLAG1);
-        irqsrc2 = in32(devinfo->base + RINGO_CANIFLAG2);
-        if( (irqsrc1 == 0) && (irqsrc2 == 0) )
-            break;
-
-        if (devinfo->mode == CANDEV_MODE_RAW_FRAME) {
-
-            // Get the id of the mailbox that generated the interrupt
-            iflag_rx = irqsrc1 & RAW_MODE_RX_IRQ;
-            iflag_tx = irqsrc1 & RAW_MODE_TX_IRQ;
-            oflag_tx = iflag_tx;
-            iflag_tx = iflag_tx >> (devinfo->numrx + devinfo->rxmbxstart);
-            tx_irq_reg = RINGO_CANIFLAG1;
-        }
-        else
-        {
-            // Get the id of the mailbox that generated the interrupt
-            iflag_rx = irqsrc1;
-            iflag_tx = irqsrc2;
-            oflag_tx = iflag_tx;
-            tx_irq_reg = RINGO_CANIFLAG2;
-        }
-        // Determine if it is a transmit or receive interrupt
-        if(iflag_rx > 0)
-        {
-            oflag_rx = iflag_rx;
-            for(i = 0; (i < (devinfo->rxmbxstart + devinfo->numrx)) && (iflag_rx > 0); i++)
-            {
-                if(iflag_rx & 1)
-                {
-                    mbxid = i;
-                    break;
-                }
-                else
-                    iflag_rx = iflag_rx >> 1;
-            }
-
-            // Get the next free receive message or overwrite the oldest
-            rxmsg = canmsg_dequeue_element(devlist[mbxid].cdev.free_queue);
-            // if no queue elements are free, re-use the oldest rx message
-            if (!rxmsg)
-            {
-                rxmsg = canmsg_dequeue_element(devlist[mbxid].cdev.msg_queue);
-                devinfo->stats.sw_receive_q_full++;
-                if (!rxmsg) {
-                    /* Break from the while loop, both queus are full */
-                    break;
-                }
-            }
-            /*
-             * Reading the canmcf control status word of the message mbx
-             * buffer triggers a lock for that buffer.  It stays locked until
-             * the free running timer is read, preventing corruption issues
-             * due to a new message filling the mailbox.  A shadow register
-             * takes care of preserving new messages.
-             */
-
-            /*
-             * Make sure that the mailbox is not busy - CPU access is not permitted while busy.
-             */
-            while (((ctrl = devinfo->canmsg[mbxid].canmcf) & (REC_CODE_BUSY << 24)) != 0);
-            /* Retrieve the message length from the DLC field */
-            rxmsg->cmsg.len = (ctrl & MSG_BUF_DLC_MASK) >> MSG_BUF_DLC_SHIFT;
-
-            /* Save the message ID */
-            rxmsg->cmsg.mid = devinfo->canmsg[mbxid].canmid;
-            /* Save message timestamp */
-            rxmsg->cmsg.ext.timestamp = ctrl & 0x0000FFFF;
-            canmcf_ide = ctrl & MB_CNT_IDE;
-
-            rxmsg->cmsg.ext.is_extended_mid = canmcf_ide > 0;
+    return(event);
+}
 
-            /*
-             *  Access the data as a uint32_t array for endian conversion
-             *  and copy data from receive mailbox to receive message
-             */
-            val32 = (uint32_t *)rxmsg->cmsg.dat;
-            val32[0] = devinfo->canmsg[mbxid].canmdl;
-            val32[1] = devinfo->canmsg[mbxid].canmdh;
+const struct sigevent *can_intr(void *area, int id)
+{
+    CANDEV_RINGO_INFO       *devinfo = area;
+    const struct sigevent   *event;
+    uint64_t                 start = ClockCycles();
 
-            if(devinfo->iflags & INFO_FLAGS_ENDIAN_SWAP)
-            {
-                // Convert from Big Endian to Little Endian since data is received MSB
-                ENDIAN_SWAP32(&val32[0]);
-                ENDIAN_SWAP32(&val32[1]);
-            }
+    event = can_intr_service(devinfo);
 
-            /* Set mailbox to empty */
-            devinfo->canmsg[mbxid].canmcf =
-                  ((devinfo->canmsg[mbxid].canmcf & ~MSG_BUF_CODE_MASK) |
-                   (REC_CODE_EMPTY << MSG_BUF_CODE_SHIFT) | canmcf_ide );
+    // Cost of the interrupt handling whichever way it returned, see can_ringo_debug()
+    devinfo->isr_cycles += ClockCycles() - start;
 
-            /* Unlock the message buffer by reading the CAN free running timer */
-            devinfo->timer = in32(devinfo->base + RINGO_CANTIMER);
+    return(event);
+}
 
-            /* Clear receive mailbox interrupts by writing a 1 to the interrupt source */
-            out32(devinfo->base + RINGO_CANIFLAG1, oflag_rx);
+/* LIBCAN driver transmit function */
+void can_drvr_transmit(CANDEV *cdev)
+{
+    CANDEV_RINGO         *dev = (CANDEV_RINGO *)cdev;
+    CANDEV_RINGO_INFO    *devinfo = dev->devinfo;
 
-            // Add populated element to the receive queue
-            canmsg_queue_element(devlist[mbxid].cdev.msg_queue, rxmsg);
-            devinfo->stats.received_frames++;
+    if(devinfo->iflags & INFO_FLAGS_FD)
+    {
+        can_fd_transmit(dev);
+        return;
+    }
 
-            /* Check for one or more blocked clients and return event to
-               event handler */
-            if (devlist[mbxid].cdev.wait_client_queue->cnt)
-            {
-                event = &devlist[mbxid].cdev.event;
-            }
+    // Start the new messages on free tx mailboxes, busy ones are refilled by the ISR
+    InterruptLock(&devinfo->txlock);
+    can_tx_fill(devinfo, dev);
+    InterruptUnlock(&devinfo->txlock);
+}
 
-            if (event)
-                return event;
-        }
+/*
+ * Enter freeze mode. Filter and mask registers, and the Rx FIFO filter
+ * table, can only be written while the FlexCAN is frozen. Returns EIO when
+ * the freeze is not acknowledged, the FlexCAN is left running.
+ */
+int can_freeze(CANDEV_RINGO_INFO *devinfo)
+{
+    int                      timeout = 20000;
 
-        if(iflag_tx > 0)
+    // Enable Freeze Mode capability
+    set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_FRZ, RINGO_CANMC_FRZ);
+    // Enter Freeze Mode
+    set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_HALT, RINGO_CANMC_HALT);
+    // Wait for indication that FlexCAN in Freeze Mode
+    while((in32(devinfo->base + RINGO_CANMC) & RINGO_CANMC_FRZACK) != RINGO_CANMC_FRZACK)
+    {
+        if(timeout-- == 0)
         {
-            out32(devinfo->base + tx_irq_reg, oflag_tx);
-            for(i = devinfo->txmbxstart;
-                (i < (devinfo->txmbxstart + devinfo->numtx)) && (iflag_tx > 0); i++)
-            {
-                if(iflag_tx & 1)
-                {
-                    mbxid = i;
-                    break;
-                }
-                else
-                    iflag_tx = iflag_tx >> 1;
-            }
-            /*
-             * Transmit mailbox processing
-             */
-            devinfo->stats.transmitted_frames++;
-
-            // Determine if there is another message to transmit
-            txmsg = canmsg_dequeue_element(devlist[mbxid].cdev.msg_queue);
-            if (txmsg)
-            {
-                // Transmit next message
-                can_ringo_tx(&devlist[mbxid], txmsg);
-
-                // tx message is copied - return element to free queue
-                canmsg_queue_element(devlist[mbxid].cdev.free_queue, txmsg);
-            }
-            else
-            {
-                // No more transmit messages, end transmission
-                atomic_clr(&devlist[mbxid].dflags, CANDEV_RINGO_TX_ENABLED);
-            }
-
-            if (devlist[mbxid].cdev.wait_client_queue->cnt)
-            {
-                event = &devlist[mbxid].cdev.event;
-            }
-            if (event)
-                return event;
+            fprintf(stderr, "FlexCAN Freeze Mode failed: FRZ_ACK timeout!\n");
+            can_unfreeze(devinfo);
+            return(EIO);
         }
-        // Clear Mailbox Interrupt Flag
-        out32(devinfo->base + RINGO_CANIFLAG1, irqsrc1);
-        out32(devinfo->base + RINGO_CANIFLAG2, irqsrc2);
-#endif
     }
-    return event;
+    return(EOK);
 }
 
-/* LIBCAN driver transmit function */
-void can_drvr_transmit(CANDEV *cdev)
+/* Take FlexCAN out of freeze mode */
+void can_unfreeze(CANDEV_RINGO_INFO *devinfo)
 {
-    CANDEV_RINGO         *dev = (CANDEV_RINGO *)cdev;
+    uint32_t                 cantest;
+    int                      i;
 
-    canmsg_t             *txmsg;
+    set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_HALT, 0);
 
-    // Make sure transmit isn't already in progress and there is valid data
-    if(!(dev->dflags & CANDEV_RINGO_TX_ENABLED) &&
-       (txmsg = canmsg_dequeue_element(cdev->msg_queue)))
-    {
-        // Indicate transmit is in progress
-        atomic_set(&dev->dflags, CANDEV_RINGO_TX_ENABLED);
-        // Start transmission
-        can_ringo_tx(dev, txmsg);
-        // tx message is copied - return element to free queue
-        canmsg_queue_element(cdev->free_queue, txmsg);
+    for (i = 0; i < FLEXCAN_SET_MODE_RETRIES; i++) {
+        cantest = in32(devinfo->base + RINGO_CANMC);
+        if (!(cantest & (RINGO_CANMC_NOTRDY | RINGO_CANMC_FRZACK))) {
+            break;
+        }
     }
-#if defined(S32V_FLEXCAN) || defined(S32G_FLEXCAN)
-    atomic_clr(&dev->dflags, CANDEV_RINGO_TX_ENABLED);
-#endif
+}
+
+/* Change the message ID of a mailbox, keeping the rx mailbox index in sync */
+static void can_mid_set(CANDEV_RINGO_INFO *devinfo, int mbxid, uint32_t mid)
+{
+    can_msg_obj_t           *mb = can_mb(devinfo, mbxid);
+    int                      indexed;
+
+    indexed = devinfo->midhash && mbxid >= devinfo->rxmbxstart &&
+              mbxid < (devinfo->rxmbxstart + devinfo->numrx);
+    if (indexed)
+        can_midhash_del(devinfo, mbxid);
+    mb->canmid = (mb->canmid & ~RINGO_CANMID_MASK_EXT) | mid;
+    if (indexed)
+        can_midhash_add(devinfo, mbxid);
 }
 
 void set_imask_s32g(CANDEV_RINGO_INFO *devinfo, int mbxid, char value)
@@ -626,10 +629,66 @@ int can_drvr_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
     CANDEV_RINGO            *dev = (CANDEV_RINGO *)cdev;
     CANDEV_RINGO_INFO       *devinfo = dev->devinfo;
     int                      mbxid = dev->mbxid;
-    int                      timeout = 20000, i;
-    uint32_t                 cantest = 0, offset = 0;
-    uint32_t                *canmid = &dev->devinfo->canmsg[mbxid].canmid;
-    uint32_t                *canmcf = &dev->devinfo->canmsg[mbxid].canmcf;
+    uint32_t                 offset = 0;
+    uint32_t                *canmid = &can_mb(devinfo, mbxid)->canmid;
+    uint32_t                *canmcf = &can_mb(devinfo, mbxid)->canmcf;
+
+    // Per device statistics and batches, for every device
+    switch(dcmd)
+    {
+        case CAN_DEVCTL_GET_MB_STATS:
+            memcpy(data, &dev->mbstats, sizeof(dev->mbstats));
+            return(EOK);
+        case CAN_DEVCTL_CLEAR_MB_STATS:
+            // Counts of an ISR pass running meanwhile may survive, which is harmless
+            memset(&dev->mbstats, 0, sizeof(dev->mbstats));
+            return(EOK);
+        case CAN_DEVCTL_RX_FRAME_RAW_BATCH:
+        case CAN_DEVCTL_TX_FRAME_RAW_BATCH:
+            return can_batch_devctl(dev, dcmd, data);
+        case CAN_DEVCTL_TX_SCHED_ADD:
+        case CAN_DEVCTL_TX_SCHED_CANCEL:
+            return can_txsched_devctl(dev, dcmd, data);
+        default:
+            break;
+    }
+
+    // Software filter devices have no mailbox behind them
+    if(mbxid >= (int)devinfo->num_mailboxes)
+    {
+        switch(dcmd)
+        {
+            case CAN_DEVCTL_SWF_ADD:
+            case CAN_DEVCTL_SWF_CLEAR:
+            case CAN_DEVCTL_SET_MID:
+            case CAN_DEVCTL_GET_MID:
+            case CAN_DEVCTL_SET_MFILTER:
+            case CAN_DEVCTL_GET_MFILTER:
+            case CAN_DEVCTL_SET_PRIO:
+            case CAN_DEVCTL_GET_PRIO:
+            case CAN_DEVCTL_TX_FRAME_RAW_FD:
+            case CAN_DEVCTL_RX_FRAME_RAW_FD:
+            case CAN_DEVCTL_RX_RING_NOTIFY:
+                return can_swf_devctl(dev, dcmd, data);
+            default:
+                break;
+        }
+    }
+
+    // Rx devices of the Rx FIFO receive modes have no mailbox behind them
+    if((devinfo->iflags & INFO_FLAGS_RX_ANY_FIFO) && (mbxid < devinfo->txmbxstart))
+    {
+        switch(dcmd)
+        {
+            case CAN_DEVCTL_SET_MID:
+            case CAN_DEVCTL_GET_MID:
+            case CAN_DEVCTL_SET_MFILTER:
+            case CAN_DEVCTL_GET_MFILTER:
+                return can_rxfifo_devctl(dev, dcmd, data);
+            default:
+                break;
+        }
+    }
 
     switch(dcmd)
     {
@@ -641,7 +700,7 @@ int can_drvr_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
             // Disable Object
             set_imask_s32g(devinfo, mbxid, 0);
             // Set new message ID
-            *canmid = (*canmid & ~RINGO_CANMID_MASK_EXT) | data->mid;
+            can_mid_set(devinfo, mbxid, data->mid);
             // Enable Object
             set_imask_s32g(devinfo, mbxid, 1);
 #else
@@ -651,7 +710,7 @@ int can_drvr_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
             else
                 set_port32(devinfo->base + RINGO_CANIMASK2, MAILBOX(mbxid), 0);
             // Set new message ID
-            *canmid = (*canmid & ~RINGO_CANMID_MASK_EXT) | data->mid;
+            can_mid_set(devinfo, mbxid, data->mid);
             // Enable Object
             if(mbxid < devinfo->txmbxstart)
                 set_port32(devinfo->base + RINGO_CANIMASK1, MAILBOX(mbxid), MAILBOX(mbxid));
@@ -676,19 +735,8 @@ int can_drvr_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
              * module is in freeze mode. Outside of freeze mode, write accesses are
              * blocked and read accesses return all zeros.
              */
-            // Enable Freeze Mode capability
-            set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_FRZ, RINGO_CANMC_FRZ);
-             // Enter Freeze Mode
-            set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_HALT, RINGO_CANMC_HALT);
-            // Wait for indication that FlexCAN in Freeze Mode
-            while((in32(devinfo->base + RINGO_CANMC) & RINGO_CANMC_FRZACK) != RINGO_CANMC_FRZACK)
-            {
-                if(timeout-- == 0)
-                {
-                    perror("FlexCAN Freeze Mode failed: FRZ_ACK timeout!\n");
-                    exit(EXIT_FAILURE);
-                }
-            }
+            if(can_freeze(devinfo) != EOK)
+                return(EIO);
 
             // Disable mailbox events
 #if defined(S32G_FLEXCAN)
@@ -712,14 +760,7 @@ int can_drvr_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
 #endif
 
             // Take FlexCAN out of freeze mode
-            set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_HALT, 0);
-
-            for (i = 0; i < FLEXCAN_SET_MODE_RETRIES; i++) {
-                cantest = in32(devinfo->base + RINGO_CANMC);
-                if (!(cantest & (RINGO_CANMC_NOTRDY | RINGO_CANMC_FRZACK))) {
-                    break;
-                }
-            }
+            can_unfreeze(devinfo);
             break;
 
         case CAN_DEVCTL_GET_MFILTER:
@@ -731,21 +772,8 @@ int can_drvr_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
              * The FLEXCAN must be in Freeze mode for the filter registers to be accessed.
              * Halt FlexCAN and wait for freeze acknowledge (pending TXs and RXs done
              */
-
-            // Enable Freeze Mode capability
-            set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_FRZ, RINGO_CANMC_FRZ);
-             // Enter Freeze Mode
-            set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_HALT, RINGO_CANMC_HALT);
-
-            // Wait for indication that FlexCAN is in Freeze Mode
-            while((in32(devinfo->base + RINGO_CANMC) & RINGO_CANMC_FRZACK) != RINGO_CANMC_FRZACK)
-            {
-                if(timeout-- == 0)
-                {
-                    perror("FlexCAN Freeze Mode failed: FRZ_ACK timeout!\n");
-                    exit(EXIT_FAILURE);
-                }
-            }
+            if(can_freeze(devinfo) != EOK)
+                return(EIO);
 
             offset = mbxid * 0x4;
 
@@ -753,14 +781,7 @@ int can_drvr_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
             data->mfilter = in32(devinfo->canlam + offset);
 
             // Take FlexCAN out of freeze mode and continue
-            set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_HALT, 0);
-
-            for (i = 0; i < FLEXCAN_SET_MODE_RETRIES; i++) {
-                cantest = in32(devinfo->base + RINGO_CANMC);
-                if (!(cantest & (RINGO_CANMC_NOTRDY | RINGO_CANMC_FRZACK))) {
-                    break;
-                }
-            }
+            can_unfreeze(devinfo);
             break;
 
         case CAN_DEVCTL_SET_PRIO:
@@ -835,6 +856,14 @@ int can_drvr_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
                 return(EINVAL);
             }
             break;
+        case CAN_DEVCTL_TX_FRAME_RAW_FD:
+            /* No break */
+        case CAN_DEVCTL_RX_FRAME_RAW_FD:
+            return can_fd_devctl(dev, dcmd, data);
+
+        case CAN_DEVCTL_RX_RING_NOTIFY:
+            return can_rxring_devctl(dev, dcmd, data);
+
         case CAN_DEVCTL_ERROR:
             // Read current state of CAN Error and Status register
             data->error.drvr1 = in32(devinfo->base + RINGO_CANESR);
@@ -880,61 +909,64 @@ int can_drvr_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
     return(EOK);
 }
 
-/* Initialize CAN device registers */
-void can_init_intr(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit, uint32_t mdriver_intr)
+/*
+ * Attach an interrupt vector of the unit to the ISR, or to the interrupt
+ * thread when the unit has one. index numbers the vectors of the unit.
+ */
+static int can_attach_intr(CANDEV_RINGO_INFO *devinfo, int vector, int index)
 {
+    int                      iid;
 
-#if defined(S32G_FLEXCAN)
-    // Attach interrupt handler for ERROR interrupts
-    devinfo->iidsys = InterruptAttach(devinit->irqsys, can_intr, devinfo, 0, _NTO_INTR_FLAGS_TRK_MSK | _NTO_INTR_FLAGS_END);
-    if(devinfo->iidsys == -1)
+    if(devinfo->intr_runmask)
+        iid = can_intr_thread_attach(devinfo, vector, index);
+    else
+        iid = InterruptAttach(vector, can_intr, devinfo, 0, _NTO_INTR_FLAGS_TRK_MSK | _NTO_INTR_FLAGS_END);
+    if(iid == -1)
     {
         perror("InterruptAttach irqsys");
         exit(EXIT_FAILURE);
     }
+
+    return(iid);
+}
+
+/* Initialize CAN device registers */
+void can_init_intr(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit, uint32_t mdriver_intr)
+{
+    // Bus-off recovery by the driver instead of the FlexCAN
+    if(devinit->busoff_min_ms)
+        can_busoff_init(devinfo, devinit);
+
+    // Each unit may service its interrupts in a thread pinned to its own cores
+    if(devinit->intr_runmask)
+        can_intr_thread_init(devinfo, devinit);
+
+#if defined(S32G_FLEXCAN)
+    // Attach interrupt handler for ERROR interrupts
+    devinfo->iidsys = can_attach_intr(devinfo, devinit->irqsys, 0);
     // Attach interrupt handler for MB 0~7 interrupts
-    devinfo->iidsys1 = InterruptAttach(devinit->irqsys+2, can_intr, devinfo, 0, _NTO_INTR_FLAGS_TRK_MSK | _NTO_INTR_FLAGS_END);
-    if(devinfo->iidsys1 == -1)
-    {
-        perror("InterruptAttach irqsys");
-        exit(EXIT_FAILURE);
-    }
+    devinfo->iidsys1 = can_attach_intr(devinfo, devinit->irqsys+2, 1);
     // Attach interrupt handler for MB 8~127 interrupts
-    devinfo->iidsys2 = InterruptAttach(devinit->irqsys+3, can_intr, devinfo, 0, _NTO_INTR_FLAGS_TRK_MSK | _NTO_INTR_FLAGS_END);
-    if(devinfo->iidsys2 == -1)
-    {
-        perror("InterruptAttach irqsys");
-        exit(EXIT_FAILURE);
-    }
-
+    devinfo->iidsys2 = can_attach_intr(devinfo, devinit->irqsys+3, 2);
 #else
     // Attach interrupt handler for system interrupts
-    devinfo->iidsys = InterruptAttach(devinit->irqsys, can_intr, devinfo, 0, _NTO_INTR_FLAGS_TRK_MSK | _NTO_INTR_FLAGS_END);
-    if(devinfo->iidsys == -1)
-    {
-        perror("InterruptAttach irqsys");
-        exit(EXIT_FAILURE);
-    }
+    devinfo->iidsys = can_attach_intr(devinfo, devinit->irqsys, 0);
 #endif
 
     /* Interrupts on Rx, Tx, any Status change and data overrun */
-    if (devinfo->mode == CANDEV_MODE_RAW_FRAME) {
-        // Enable raw mailbox interrupts (MB1 to MB2)
-        out32(devinfo->base + RINGO_CANIMASK1, (RAW_MODE_TX_IRQ | RAW_MODE_RX_IRQ));
-    }
-    else
-    {
+    // Enable interrupts of the rx and tx mailboxes only. In raw mode this is the
+    // single rx/tx pair, otherwise all user mailboxes (1st and last mbox are
+    // reserved on i.MX6x, see Errata ERR005829).
+    can_init_mbxmask(devinfo);
+    out32(devinfo->base + RINGO_CANIMASK1, devinfo->mbxmask[0]);
+    out32(devinfo->base + RINGO_CANIMASK2, devinfo->mbxmask[1]);
 #if defined(S32G_FLEXCAN)
-        out32(devinfo->base + RINGO_CANIMASK1, 0xFFFFFFFF);
-        out32(devinfo->base + RINGO_CANIMASK2, 0xFFFFFFFF);
-        out32(devinfo->base + RINGO_CANIMASK3, 0xFFFFFFFF);
-        out32(devinfo->base + RINGO_CANIMASK4, 0xFFFFFFFF);
-#else
-        // Enable mailbox interrupts (MB1 to MB62) - 1st and last mbox reserved. See Errata ERR005829
-        out32(devinfo->base + RINGO_CANIMASK1, 0xFFFFFFFE);
-        out32(devinfo->base + RINGO_CANIMASK2, 0x7FFFFFFF);
+    out32(devinfo->base + RINGO_CANIMASK3, devinfo->mbxmask[2]);
+    out32(devinfo->base + RINGO_CANIMASK4, devinfo->mbxmask[3]);
 #endif
-    }
+    // Rx FIFO frame available and overflow interrupts
+    if(devinfo->iflags & INFO_FLAGS_RX_ANY_FIFO)
+        can_rxfifo_init_intr(devinfo);
 
     // Add mini-driver's bufferred CAN messages if mini-driver is active.
     if(devinit->flags & INIT_FLAGS_MDRIVER_INIT && mdriver_intr != -1)
@@ -1036,6 +1068,14 @@ void can_init_hw(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit)
     set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_IDAM_FormatA, RINGO_CANMC_IDAM_FormatA);
     // Maximum MBs in use
     set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_MAXMB_MASK, RINGO_CANMC_MAXMB_MAXVAL);
+    // CAN FD: mailbox payload size, data phase bit timing and fewer, larger mailboxes
+    if(devinfo->iflags & INFO_FLAGS_FD)
+        can_fd_init(devinfo, devinit);
+#if defined(S32G_FLEXCAN)
+    // Mailboxes capture the high resolution timestamp at the end of the frame
+    if(devinfo->hrts_freq)
+        set_port32(devinfo->base + RINGO_CANCTRL2, FLEXCAN_CTRL2_TSTAMPCAP_MASK, FLEXCAN_CTRL2_TSTAMPCAP_EOF);
+#endif
 
     /* 2. Initialize the Control Register */
     // Disable Bus-Off Interrupt
@@ -1144,58 +1184,72 @@ void can_init_hw(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit)
     counter = 0;
     for(i = devinfo->rxmbxstart; i < (devinfo->rxmbxstart + devinfo->numrx); i++)
     {
+        // Rx FIFO receive modes: the message ID goes into the FIFO filter table
+        if(devinfo->iflags & INFO_FLAGS_RX_ANY_FIFO)
+        {
+            devinfo->devlist[i].mid = (devinit->midrx + CANMID_DEFAULT * counter++) &
+                                      (canmcf_ide ? RINGO_CANMID_MASK_EXT : RINGO_CANMID_MASK_STD);
+            devinfo->devlist[i].mfilter = canlam;
+            continue;
+        }
         // Disable mailbox to configure message object
         // The control/status word of all message buffers are written
          // as an inactive receive message buffer.
-        devinfo->canmsg[i].canmcf = ((REC_CODE_NOT_ACTIVE & 0x0F) << 24);
+        can_mb(devinfo, i)->canmcf = ((REC_CODE_NOT_ACTIVE & 0x0F) << 24);
         // Initialize default receive message ID
         if (canmcf_ide)
         {    // Extended frame
-            devinfo->canmsg[i].canmid = (devinit->midrx + CANMID_DEFAULT * counter++) & RINGO_CANMID_MASK_EXT;
+            can_mb(devinfo, i)->canmid = (devinit->midrx + CANMID_DEFAULT * counter++) & RINGO_CANMID_MASK_EXT;
         }
         else
         {    // Standard frame
-            devinfo->canmsg[i].canmid = (devinit->midrx + CANMID_DEFAULT * counter++) & RINGO_CANMID_MASK_STD;
+            can_mb(devinfo, i)->canmid = (devinit->midrx + CANMID_DEFAULT * counter++) & RINGO_CANMID_MASK_STD;
         }
-        devinfo->canmsg[i].canmdl = 0x0;
-        devinfo->canmsg[i].canmdh = 0x0;
+        can_mb(devinfo, i)->canmdl = 0x0;
+        can_mb(devinfo, i)->canmdh = 0x0;
         // Put MB into rx queue
-        devinfo->canmsg[i].canmcf = ((REC_CODE_EMPTY & 0x0F) << 24) | canmcf_ide;
+        can_mb(devinfo, i)->canmcf = ((REC_CODE_EMPTY & 0x0F) << 24) | canmcf_ide;
     }
 
+    // Set up the Rx FIFO and its filter table from the rx device message IDs
+    if(devinfo->iflags & INFO_FLAGS_RX_ANY_FIFO)
+        can_rxfifo_init(devinfo);
+    else
+        can_midhash_build(devinfo);
+
     // Configure Transmit Mailboxes
     counter = 0;
     for(i = devinfo->txmbxstart; i < (devinfo->txmbxstart + devinfo->numtx); i++)
     {
         // Disable mailbox to configure message object
         // Trasmission inactive, Set message data size
-        devinfo->canmsg[i].canmcf = ((TRANS_CODE_NOT_READY & 0x0F) << 24) | (8 << 16) | canmcf_ide;
+        can_mb(devinfo, i)->canmcf = ((TRANS_CODE_NOT_READY & 0x0F) << 24) | (8 << 16) | canmcf_ide;
         // Initialize default transmit message ID
         if (canmcf_ide)
         {    // Extended frame
-            devinfo->canmsg[i].canmid = (devinit->midtx + CANMID_DEFAULT * counter++) & RINGO_CANMID_MASK_EXT;
+            can_mb(devinfo, i)->canmid = (devinit->midtx + CANMID_DEFAULT * counter++) & RINGO_CANMID_MASK_EXT;
         }
         else
         {    // Standard frame
-            devinfo->canmsg[i].canmid = (devinit->midtx + CANMID_DEFAULT * counter++) & RINGO_CANMID_MASK_STD;
+            can_mb(devinfo, i)->canmid = (devinit->midtx + CANMID_DEFAULT * counter++) & RINGO_CANMID_MASK_STD;
         }
-        devinfo->canmsg[i].canmdl = 0x0;
-        devinfo->canmsg[i].canmdh = 0x0;
+        can_mb(devinfo, i)->canmdl = 0x0;
+        can_mb(devinfo, i)->canmdh = 0x0;
     }
 
 #if !defined(S32V_FLEXCAN) && !defined(S32G_FLEXCAN)
     // Errata ERR005829 step 7: mark first valid maibox as an INACTIVE mailbox
-    devinfo->canmsg[CAN_FIRST_MAILBOX_INDEX].canmcf = (TRANS_CODE_NOT_READY & 0x0F) << 24;
-    devinfo->canmsg[CAN_FIRST_MAILBOX_INDEX].canmid = 0;
-    devinfo->canmsg[CAN_FIRST_MAILBOX_INDEX].canmdl = 0x0;
-    devinfo->canmsg[CAN_FIRST_MAILBOX_INDEX].canmdh = 0x0;
+    can_mb(devinfo, CAN_FIRST_MAILBOX_INDEX)->canmcf = (TRANS_CODE_NOT_READY & 0x0F) << 24;
+    can_mb(devinfo, CAN_FIRST_MAILBOX_INDEX)->canmid = 0;
+    can_mb(devinfo, CAN_FIRST_MAILBOX_INDEX)->canmdl = 0x0;
+    can_mb(devinfo, CAN_FIRST_MAILBOX_INDEX)->canmdh = 0x0;
 
     // Also take the last mailbox out of service. This is not part of the errata
     // but introduced to keep the number of tx and rx mailboxes equal.
-    devinfo->canmsg[CAN_LAST_MAILBOX_INDEX].canmcf = (TRANS_CODE_NOT_READY & 0x0F) << 24;
-    devinfo->canmsg[CAN_LAST_MAILBOX_INDEX].canmid = 0;
-    devinfo->canmsg[CAN_LAST_MAILBOX_INDEX].canmdl = 0x0;
-    devinfo->canmsg[CAN_LAST_MAILBOX_INDEX].canmdh = 0x0;
+    can_mb(devinfo, CAN_LAST_MAILBOX_INDEX)->canmcf = (TRANS_CODE_NOT_READY & 0x0F) << 24;
+    can_mb(devinfo, CAN_LAST_MAILBOX_INDEX)->canmid = 0;
+    can_mb(devinfo, CAN_LAST_MAILBOX_INDEX)->canmdl = 0x0;
+    can_mb(devinfo, CAN_LAST_MAILBOX_INDEX)->canmdh = 0x0;
 #endif
 
 #if defined(S32V_FLEXCAN) || defined(S32G_FLEXCAN)
@@ -1260,34 +1314,24 @@ void can_init_hw(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit)
 #endif
 }
 
-/* Transmit a CAN message from the specified mailbox */
-void can_ringo_tx(CANDEV_RINGO *dev, canmsg_t *txmsg)
+/*
+ * Fill a free tx mailbox and start its transmission. The mailbox is
+ * inactive (never used, or its transmission completed), so it can be
+ * written at any time, whatever the state of the bus.
+ */
+void can_ringo_tx(CANDEV_RINGO *dev, int mbxid, canmsg_t *txmsg)
 {
     CANDEV_RINGO_INFO        *devinfo = dev->devinfo;
-    int                       mbxid = dev->mbxid;
+    can_msg_obj_t            *mb = can_mb(devinfo, mbxid);
     // Access the data as a uint32_t array
     uint32_t                 *val32 = (uint32_t *)txmsg->cmsg.dat;
     uint32_t                  can_mcf;
 
-    /*
-     * IDLE - Idle Status. The IDLE bit indicates, when there is activity
-     * on the CAN bus
-     * 1 - The CAN bus is Idle
-     *
-     * TX/RX - Transmission/receive status.
-     * Indicates when the FlexCAN module is transmitting or receiving a message.
-     * TX/RX has no meaning, when IDLE = 1
-     * 0 - FlexCAN is receiving when IDLE = 0
-     * 1 - FlexCAN is transmitting when IDLE = 0
-     */
-    // Wait till bus available
-    while((in32(devinfo->base + RINGO_CANESR) & RINGO_CANES_IDLE) == 0);
-
     /*
      * Set mailbox to inactive while filling it.
      * Also set the msg length in the mcf to the actual message length
      */
-    can_mcf = devinfo->canmsg[mbxid].canmcf;
+    can_mcf = mb->canmcf;
     can_mcf &= ~(MSG_BUF_CODE_MASK | MSG_BUF_DLC_MASK);
     can_mcf |= TRANS_CODE_NOT_READY << MSG_BUF_CODE_SHIFT;
     can_mcf |= txmsg->cmsg.len << MSG_BUF_DLC_SHIFT;
@@ -1302,16 +1346,16 @@ void can_ringo_tx(CANDEV_RINGO *dev, canmsg_t *txmsg)
         can_mcf |= (txmsg->cmsg.ext.is_extended_mid) ? RINGO_CANMCF_IDE : 0;
     }
 
-    devinfo->canmsg[mbxid].canmcf = can_mcf;
+    mb->canmcf = can_mcf;
     // Copy message data into transmit mailbox
-    devinfo->canmsg[mbxid].canmdl = val32[0];
-    devinfo->canmsg[mbxid].canmdh = val32[1];
+    mb->canmdl = val32[0];
+    mb->canmdh = val32[1];
 
     if(devinfo->iflags & INFO_FLAGS_ENDIAN_SWAP)
     {
         // Convert from Little Endian to Big Endian since data is transmitted MSB
-        ENDIAN_SWAP32(&devinfo->canmsg[mbxid].canmdl);
-        ENDIAN_SWAP32(&devinfo->canmsg[mbxid].canmdh);
+        ENDIAN_SWAP32(&mb->canmdl);
+        ENDIAN_SWAP32(&mb->canmdh);
     }
 
     /*
@@ -1321,27 +1365,34 @@ void can_ringo_tx(CANDEV_RINGO *dev, canmsg_t *txmsg)
      */
     if (devinfo->mode == CANDEV_MODE_RAW_FRAME)
     {
-        devinfo->canmsg[mbxid].canmid = txmsg->cmsg.mid;
+        mb->canmid = txmsg->cmsg.mid;
     } else {
         if (txmsg->cmsg.mid != CAN_MSG_MID_UNKNOWN) {
-            devinfo->canmsg[mbxid].canmid = txmsg->cmsg.mid;
+            mb->canmid = txmsg->cmsg.mid;
         }
     }
 
     // Transmission active
-    devinfo->canmsg[mbxid].canmcf |= ((TRANS_CODE_TRANSMIT_ONCE & 0x0F) << 24);
+    mb->canmcf |= ((TRANS_CODE_TRANSMIT_ONCE & 0x0F) << 24);
 
 
 #if !defined(S32V_FLEXCAN) && !defined(S32G_FLEXCAN)
     // Errata ERR005829 step 8: Write twice INACTIVE (0x8) twice to first mailbox
-    devinfo->canmsg[CAN_FIRST_MAILBOX_INDEX].canmcf = (TRANS_CODE_NOT_READY & 0x0F) << 24;
-    devinfo->canmsg[CAN_FIRST_MAILBOX_INDEX].canmcf = (TRANS_CODE_NOT_READY & 0x0F) << 24;
+    can_mb(devinfo, CAN_FIRST_MAILBOX_INDEX)->canmcf = (TRANS_CODE_NOT_READY & 0x0F) << 24;
+    can_mb(devinfo, CAN_FIRST_MAILBOX_INDEX)->canmcf = (TRANS_CODE_NOT_READY & 0x0F) << 24;
 #endif
 }
 
 /* Print out debug information */
 void can_ringo_debug(CANDEV_RINGO *dev)
 {
+    CANDEV_RINGO_INFO       *devinfo = dev->devinfo;
+    uint64_t                 frames = devinfo->isr_frames;
+
+    fprintf(stderr, "\nInterrupts %u, frames %llu, %llu cycles per frame, %u rx queue overwrites, %u expired tx frames\n",
+            devinfo->stats.total_interrupts, (unsigned long long)frames,
+            (unsigned long long)(frames ? devinfo->isr_cycles / frames : 0), devinfo->stats.sw_receive_q_full,
+            devinfo->sched_expired);
     fprintf(stderr, "\nCAN REG\n");
     can_print_reg(dev->devinfo);
     fprintf(stderr, "\nMailboxes\n");
@@ -1389,8 +1440,8 @@ void can_print_mailbox(CANDEV_RINGO_INFO *devinfo)
         {
             fprintf(stderr, "rx%d\t%02d\t0x%08X\t0x%08X\t0x%08X\t0x%08X\t\n",
                     devinfo->devlist[i].cdev.dev_unit, i,
-                    devinfo->canmsg[i].canmid, devinfo->canmsg[i].canmcf,
-                    devinfo->canmsg[i].canmdh, devinfo->canmsg[i].canmdl);
+                    can_mb(devinfo, i)->canmid, can_mb(devinfo, i)->canmcf,
+                    can_mb(devinfo, i)->canmdh, can_mb(devinfo, i)->canmdl);
         }
     }
 
@@ -1403,8 +1454,8 @@ void can_print_mailbox(CANDEV_RINGO_INFO *devinfo)
         {
             fprintf(stderr, "tx%d\t%02d\t0x%08X\t0x%08X\t0x%08X\t0x%08X\t\n",
                     devinfo->devlist[i].cdev.dev_unit, i,
-                    devinfo->canmsg[i].canmid, devinfo->canmsg[i].canmcf,
-                    devinfo->canmsg[i].canmdh, devinfo->canmsg[i].canmdl);
+                    can_mb(devinfo, i)->canmid, can_mb(devinfo, i)->canmcf,
+                    can_mb(devinfo, i)->canmdh, can_mb(devinfo, i)->canmdl);
         }
     }
 
@@ -1417,8 +1468,8 @@ void can_print_mailbox(CANDEV_RINGO_INFO *devinfo)
         {
             fprintf(stderr, "%d\t%02d\t0x%08X\t0x%08X\t0x%08X\t0x%08X\t\n",
                     devinfo->devlist[i].cdev.dev_unit, i,
-                    devinfo->canmsg[i].canmid, devinfo->canmsg[i].canmcf,
-                    devinfo->canmsg[i].canmdh, devinfo->canmsg[i].canmdl);
+                    can_mb(devinfo, i)->canmid, can_mb(devinfo, i)->canmcf,
+                    can_mb(devinfo, i)->canmdh, can_mb(devinfo, i)->canmdl);
         }
     }
 }
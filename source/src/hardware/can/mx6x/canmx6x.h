@@ -22,6 +22,7 @@
 #ifndef _CANMX6X_H_INCLUDED
 #define _CANMX6X_H_INCLUDED
 
+#include <atomic.h>
 #include <hw/mx6x-can.h>
 
 /*
@@ -43,9 +44,156 @@ void can_options(CANDEV_RINGO_INIT *devinit, int argc, char *argv[]);
 void can_init_mailbox(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit);
 void can_init_hw(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit);
 void can_init_intr(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit, uint32_t mdriver_intr);
+const struct sigevent *can_intr(void *area, int id);
+void can_init_mbxmask(CANDEV_RINGO_INFO *devinfo);
 void can_print_reg(CANDEV_RINGO_INFO *devinfo);
 void can_print_mailbox(CANDEV_RINGO_INFO *devinfo);
 void set_port32(unsigned port, uint32_t mask, uint32_t data);
+int can_freeze(CANDEV_RINGO_INFO *devinfo);
+void can_unfreeze(CANDEV_RINGO_INFO *devinfo);
+void can_rx_copy(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO *dev, can_msg_obj_t *mb, uint32_t ctrl, uint32_t *wake);
+int can_rx_queue(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO *dev, can_msg_obj_t *mb, uint32_t ctrl);
+
+/* Rx FIFO receive engine */
+void can_rxfifo_init(CANDEV_RINGO_INFO *devinfo);
+void can_rxfifo_init_intr(CANDEV_RINGO_INFO *devinfo);
+int can_rxfifo_intr(CANDEV_RINGO_INFO *devinfo, uint32_t *wake);
+int can_rxfifo_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data);
+
+/* CAN FD */
+void can_fd_init(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit);
+void can_fd_read(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl, CAN_FD_MSG *msg);
+void can_fd_rx(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl);
+void can_fd_transmit(CANDEV_RINGO *dev);
+void can_fd_tx_done(CANDEV_RINGO *dev);
+int can_fd_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data);
+
+/* Shared memory rx ring */
+void can_rxring_create(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit);
+void can_rxring_put(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl);
+int can_rxring_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data);
+
+/* 64 bit receive timestamps */
+void can_timestamp_init(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit);
+void can_timestamp_sync(CANDEV_RINGO_INFO *devinfo);
+uint64_t can_timestamp(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl);
+
+/* Message ID to rx mailbox index */
+void can_midhash_build(CANDEV_RINGO_INFO *devinfo);
+void can_midhash_add(CANDEV_RINGO_INFO *devinfo, uint32_t mbxid);
+void can_midhash_del(CANDEV_RINGO_INFO *devinfo, uint32_t mbxid);
+int can_midhash_find(CANDEV_RINGO_INFO *devinfo, uint32_t canmid);
+
+/*
+ * Multiplicative hash of a message ID into 32 - shift bits, shared by the
+ * mailbox index and the software filter table. The top bits of the product
+ * depend on every ID bit, so 29 bit IDs differing only in their upper bits
+ * (J1939 PGNs from one source address) still spread over all buckets.
+ */
+static inline uint32_t can_midhash(uint32_t id, uint32_t shift)
+{
+    return (id * 0x9E3779B1) >> shift;
+}
+
+/* Software acceptance filters */
+void can_swf_init(CANDEV_RINGO_INFO *devinfo);
+int can_swf_rx(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl, uint32_t *wake);
+int can_swf_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data);
+
+/* Bus-off recovery */
+void can_busoff_init(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit);
+void can_busoff_enter(CANDEV_RINGO_INFO *devinfo);
+
+/* Scheduled transmission */
+int can_txsched_get(CANDEV_RINGO_INFO *devinfo, canmsg_t *txmsg);
+int can_txsched_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data);
+
+/* Batched raw frames */
+int can_batch_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data);
+
+/* Wakeups of an interrupt */
+void can_wake_init(CANDEV_RINGO_INFO *devinfo);
+const struct sigevent *can_wake_event(CANDEV_RINGO_INFO *devinfo, const uint32_t *wake);
+
+/* Interrupt thread */
+void can_intr_thread_init(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit);
+int can_intr_thread_attach(CANDEV_RINGO_INFO *devinfo, int vector, int index);
+
+/* Deliver a libcan device event (a pulse) from thread context */
+static inline void can_deliver_event(const struct sigevent *event)
+{
+    MsgSendPulsePtr(event->sigev_coid, event->sigev_priority, event->sigev_code, event->sigev_value.sival_ptr);
+}
+
+/* The ISR has to return an event for the device: libcan clients are blocked on it */
+static inline int can_dev_waiting(CANDEV_RINGO *dev)
+{
+    return dev->cdev.wait_client_queue->cnt;
+}
+
+/* Count a frame delivery latency of cycles in a device's log2 histogram */
+static inline void can_mb_stats_latency(CAN_MB_STATS *stats, uint64_t cycles)
+{
+    int                  bucket = cycles ? 64 - __builtin_clzll(cycles) : 0;
+
+    stats->latency[(bucket < CAN_MB_STATS_BUCKETS) ? bucket : (CAN_MB_STATS_BUCKETS - 1)]++;
+}
+
+/* Count a received frame queued on a device holding queued frames */
+static inline void can_mb_stats_rx(CANDEV_RINGO *dev, uint32_t queued)
+{
+    dev->mbstats.frames++;
+    if(queued > dev->mbstats.queued_max)
+        dev->mbstats.queued_max = queued;
+}
+
+/*
+ * Event for a device can_wake_add() noted, from the ISR or the wakeup
+ * thread.
+ */
+static inline const struct sigevent *can_dev_event(CANDEV_RINGO *dev)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    uint64_t             cycles = dev->wake_cycles;
+
+    dev->wake_cycles = 0;
+    dev->mbstats.wakeups++;
+    // Receive devices: time since the ISR pass that queued the wakeup, later
+    // passes may have run by the time the wakeup thread gets here. A wakeup
+    // queued again while the thread delivers the previous one has no stamp
+    // and is not counted. CAN FD frames count when the devctl hands them
+    // out instead.
+    if(cycles && (dev->mbxid < (int)devinfo->txmbxstart || dev->mbxid >= (int)devinfo->num_mailboxes) &&
+       (!(devinfo->iflags & INFO_FLAGS_FD) || devinfo->rxring))
+        can_mb_stats_latency(&dev->mbstats, ClockCycles() - cycles);
+
+    return &dev->cdev.event;
+}
+
+/* Note a device can_dev_waiting() reported in the wake bitmap of an ISR pass */
+static inline void can_wake_add(uint32_t *wake, CANDEV_RINGO *dev)
+{
+    uint32_t             i = dev - dev->devinfo->devlist;
+
+    // The first pass still waiting for its wakeup sets the latency reference
+    if(!dev->wake_cycles)
+        dev->wake_cycles = dev->devinfo->ts_cycles;
+    wake[i / 32] |= 1 << (i % 32);
+}
+
+/*
+ * Message buffer of a mailbox. With CAN FD payloads above 8 bytes mailboxes
+ * are larger than can_msg_obj_t and are packed per 512 byte RAM region.
+ */
+static inline can_msg_obj_t *can_mb(CANDEV_RINGO_INFO *devinfo, uint32_t mbxid)
+{
+    if(devinfo->mbsize == sizeof(can_msg_obj_t))
+        return &devinfo->canmsg[mbxid];
+
+    return (can_msg_obj_t *)((uintptr_t)devinfo->canmsg +
+                             (mbxid / devinfo->mbs_per_region) * RINGO_CAN_MB_REGION_SIZE +
+                             (mbxid % devinfo->mbs_per_region) * devinfo->mbsize);
+}
 
 #endif
 
@@ -62,8 +62,7 @@ const struct {
     [CAN_BR_250K] = {    0x13,    0x04,    0x07,    0x01,    1},
     [CAN_BR_500K] = {    0x09,    0x04,    0x07,    0x01,    1},
     [CAN_BR_1M]   = {    0x04,    0x04,    0x07,    0x01,    1},
-#endif
-#ifdef S32V_FLEXCAN
+#elif defined(S32V_FLEXCAN)
     /*  FlexCAN Clock Rate: 40 MHz, Sample-Point at: 87.5%  */
     /*                presdiv, propseg,   pseg1,   pseg2,  rjw */
     [CAN_BR_50K]  = {    0x31,    0x04,    0x07,    0x01,    1},
@@ -82,6 +81,26 @@ const struct {
 #endif
 };
 
+#ifdef S32G_FLEXCAN
+typedef enum {CAN_FD_BR_1M, CAN_FD_BR_2M, CAN_FD_BR_4M, CAN_FD_BR_5M} fd_bitrate_sel_t;
+
+/* CAN FD data phase bitrates */
+const struct {
+    unsigned int presdiv;
+    unsigned int propseg;
+    unsigned int pseg1;
+    unsigned int pseg2;
+    unsigned int rjw;
+} predefined_fd_bitrates[4] = {
+    /*  FlexCAN Clock Rate: 80 MHz, Sample-Point at: 80% (75% at 5M)  */
+    /*                   presdiv, propseg,   pseg1,   pseg2,  rjw */
+    [CAN_FD_BR_1M]   = {    0x03,    0x07,    0x07,    0x03,    3},
+    [CAN_FD_BR_2M]   = {    0x01,    0x07,    0x07,    0x03,    3},
+    [CAN_FD_BR_4M]   = {    0x00,    0x07,    0x07,    0x03,    3},
+    [CAN_FD_BR_5M]   = {    0x00,    0x05,    0x05,    0x03,    3},
+};
+#endif
+
 //#define DEBUG_DRVR
 
 // Function prototypes
@@ -151,6 +170,7 @@ void device_init(int argc, char *argv[])
 {
     int                     opt, hwi_can = -1;
     int                     numcan = 0, id = 0;
+    unsigned                core;
     char                   *cp;
     CANDEV_HWINFO           can = {0};
 
@@ -168,7 +188,7 @@ void device_init(int argc, char *argv[])
         },
         RINGO_CAN0_REG_BASE,                     /* port */
         RINGO_CAN0_MEM_BASE,                     /* mem */
-        RINGO_CAN_CLK_PLL,                       /* clk */
+        RINGO_CAN_CLK_PE,                        /* clk */
         0,                                       /* bitrate */
         predefined_bitrates[CAN_BR_50K].presdiv, /* br_presdiv */
         predefined_bitrates[CAN_BR_50K].propseg, /* br_propseg */
@@ -184,13 +204,14 @@ void device_init(int argc, char *argv[])
         0x100C0000,                              /* midrx */
         0x100C0000,                              /* midtx */
         0x0,                                     /* timestamp */
+        0,                                       /* fd_payload - 64 bytes in CAN FD mode */
     };
 
     // Process command line options and create associated devices
     while(optind < argc)
     {
         // Process dash options
-        while((opt = getopt(argc, argv, "ab:B:c:Di:l:m:Mn:pRsStu:vwxz"))
+        while((opt = getopt(argc, argv, "ab:B:c:d:De:E:fF:H:i:I:k:l:m:Mn:O:pr:RsStT:u:vwxz"))
               != -1)
         {
             switch(opt){
@@ -258,9 +279,99 @@ void device_init(int argc, char *argv[])
                     exit(EXIT_FAILURE);
                 }
                 break;
+#if defined(S32G_FLEXCAN)
+            case 'd': {
+                    fd_bitrate_sel_t br;
+
+                    if(strncmp(optarg, "1M", 2) == 0) {
+                        br = CAN_FD_BR_1M;
+                    } else if(strncmp(optarg, "2M", 2) == 0) {
+                        br = CAN_FD_BR_2M;
+                    } else if(strncmp(optarg, "4M", 2) == 0) {
+                        br = CAN_FD_BR_4M;
+                    } else if(strncmp(optarg, "5M", 2) == 0) {
+                        br = CAN_FD_BR_5M;
+                    } else {
+                        fprintf(stderr, "Unrecognized data bitrate value passed in -d option\n");
+                        exit(EXIT_FAILURE);
+                    }
+
+                    devinit.fbr_presdiv = predefined_fd_bitrates[br].presdiv;
+                    devinit.fbr_propseg = predefined_fd_bitrates[br].propseg;
+                    devinit.fbr_pseg1   = predefined_fd_bitrates[br].pseg1;
+                    devinit.fbr_pseg2   = predefined_fd_bitrates[br].pseg2;
+                    devinit.fbr_rjw     = predefined_fd_bitrates[br].rjw;
+                    devinit.flags |= INIT_FLAGS_FD | INIT_FLAGS_FD_BRS;
+                }
+                break;
+
+            case 'E':
+                // Values to program the data phase bitrate manually
+                devinit.fbr_presdiv = strtoul(optarg, &optarg, 0);
+
+                if((cp = strchr(optarg, ',')))
+                {
+                    cp += 1;    // Skip over the ','
+                    devinit.fbr_propseg = strtoul(cp, &cp, 0);
+                }
+                if(cp && (cp = strchr(cp, ',')))
+                {
+                    cp += 1;    // Skip over the ','
+                    devinit.fbr_pseg1 = strtoul(cp, &cp, 0);
+                }
+                if(cp && (cp = strchr(cp, ',')))
+                {
+                    cp += 1;    // Skip over the ','
+                    devinit.fbr_pseg2 = strtoul(cp, &cp, 0);
+                }
+                if(cp && (cp = strchr(cp, ',')))
+                {
+                    cp += 1;    // Skip over the ','
+                    devinit.fbr_rjw = strtoul(cp, &cp, 0);
+                }
+
+                // Check for valid data phase bitrate settings
+                if(devinit.fbr_presdiv > FLEXCAN_FDCBT_FPRESDIV_MAXVAL ||
+                   devinit.fbr_propseg > FLEXCAN_FDCBT_FPROPSEG_MAXVAL ||
+                   devinit.fbr_rjw > FLEXCAN_FDCBT_FRJW_MAXVAL ||
+                   devinit.fbr_pseg1 > FLEXCAN_FDCBT_FPSEG1_MAXVAL ||
+                   devinit.fbr_pseg2 > FLEXCAN_FDCBT_FPSEG2_MAXVAL ||
+                   devinit.fbr_pseg2 == 0)
+                {
+                    fprintf(stderr, "Invalid manual data bitrate settings\n");
+                    exit(EXIT_FAILURE);
+                }
+                devinit.flags |= INIT_FLAGS_FD | INIT_FLAGS_FD_BRS;
+                break;
+            case 'f':
+                devinit.flags |= INIT_FLAGS_FD;
+                break;
+            case 'H':
+                devinit.hrts_freq = strtoul(optarg, NULL, 0);
+                break;
+#endif
             case 'D':
                 devinit.flags &= ~INIT_FLAGS_MDRIVER_INIT;
                 break;
+            case 'F':
+                devinit.flags &= ~(INIT_FLAGS_RX_FIFO | INIT_FLAGS_RX_EFIFO);
+                if(strcmp(optarg, "mb") == 0) {
+                    break;
+                }
+#if defined(S32V_FLEXCAN) || defined(S32G_FLEXCAN)
+                if(strcmp(optarg, "fifo") == 0) {
+                    devinit.flags |= INIT_FLAGS_RX_FIFO;
+                    break;
+                }
+#endif
+#if defined(S32G_FLEXCAN)
+                if(strcmp(optarg, "efifo") == 0) {
+                    devinit.flags |= INIT_FLAGS_RX_EFIFO;
+                    break;
+                }
+#endif
+                fprintf(stderr, "Unsupported receive mode passed in -F option\n");
+                exit(EXIT_FAILURE);
             case 'i':
                 devinit.midrx = strtoul(optarg, &optarg, 16);
                 if((cp = strchr(optarg, ',')))
@@ -268,6 +379,10 @@ void device_init(int argc, char *argv[])
                     devinit.midtx = strtoul(cp + 1, NULL, 0);
                 }
                 break;
+            case 'l':
+                // Mailbox payload size, only used in CAN FD mode
+                devinit.fd_payload = strtoul(optarg, NULL, 0);
+                break;
             case 'm':
                 devinit.flags |= INIT_FLAGS_TIMESTAMP;
                 devinit.timestamp = strtoul(optarg, NULL, 16);
@@ -278,6 +393,44 @@ void device_init(int argc, char *argv[])
             case 'q':
                 devinit.cinit.waitq_size = strtoul(optarg, NULL, 0);
                 break;
+            case 'e':
+                // Bus-off recovery: backoff_min[,backoff_max[,age]] in ms
+                devinit.busoff_min_ms = strtoul(optarg, &cp, 0);
+                devinit.busoff_max_ms = (*cp == ',') ? strtoul(cp + 1, &cp, 0) : 1000;
+                devinit.busoff_age_ms = (*cp == ',') ? strtoul(cp + 1, NULL, 0) : 0;
+                if(devinit.busoff_max_ms < devinit.busoff_min_ms)
+                    devinit.busoff_max_ms = devinit.busoff_min_ms;
+                break;
+            case 'I':
+                // Interrupt thread of the next unit: core[,priority]
+                core = strtoul(optarg, &cp, 0);
+                if(core >= 32)
+                {
+                    fprintf(stderr, "Invalid core in -I option\n");
+                    exit(EXIT_FAILURE);
+                }
+                devinit.intr_runmask = 1 << core;
+                devinit.intr_prio = (*cp == ',') ? strtoul(cp + 1, NULL, 0) : CAN_INTR_THREAD_PRIO;
+                break;
+            case 'k':
+                devinit.swf_ndevs = strtoul(optarg, NULL, 0);
+                break;
+            case 'O':
+                if(strcmp(optarg, "new") == 0) {
+                    devinit.flags |= INIT_FLAGS_RX_DROP_NEW;
+                } else if(strcmp(optarg, "old") == 0) {
+                    devinit.flags &= ~INIT_FLAGS_RX_DROP_NEW;
+                } else {
+                    fprintf(stderr, "Unrecognized overflow policy passed in -O option\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'T':
+                devinit.raw_txmbs = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                devinit.rxring_size = strtoul(optarg, NULL, 0);
+                break;
             case 'R':
                 devinit.cinit.mode = CANDEV_MODE_RAW_FRAME;
                 devinit.numrx = RAW_MODE_RX_NUM_MBOX;
@@ -387,8 +540,9 @@ void device_init(int argc, char *argv[])
 
             // Create the CAN device
             create_device(&devinit);
-            // Reset unit number for next device
+            // Reset unit number and interrupt thread for next device
             devinit.cinit.can_unit = 0;
+            devinit.intr_runmask = 0;
             numcan++;
         }
     }
@@ -439,18 +593,139 @@ void create_device(CANDEV_RINGO_INIT *devinit)
         exit(EXIT_FAILURE);
     }
     memset(devinfo, 0, sizeof(*devinfo));
+    devinfo->erroractive = 1;
 
 
     // Set up CAN operation mode - single RX and TX mailboxes using raw frames
     // or multi-mailbox, I/O based communications
     devinfo->mode = devinit->cinit.mode;
 
+    // The raw tx device may queue messages on several tx mailboxes
+    if(devinit->raw_txmbs && devinfo->mode == CANDEV_MODE_RAW_FRAME)
+    {
+        if(devinit->raw_txmbs > 32 || (devinit->raw_txmbs > 1 && (devinit->flags & INIT_FLAGS_FD)))
+        {
+            fprintf(stderr, "Raw mode uses 1 to 32 tx mailboxes, 1 with CAN FD\n");
+            exit(EXIT_FAILURE);
+        }
+        devinit->numtx = devinit->raw_txmbs;
+    }
+
     // Setup the RX and TX mailbox sizes
     devinfo->numrx = devinit->numrx;
     devinfo->numtx = devinit->numtx;
     devinfo->rxmbxstart = CAN_FIRST_USER_MAILBOX_INDEX;
     devinfo->txmbxstart = CAN_FIRST_USER_MAILBOX_INDEX + devinfo->numrx;
 
+    if(devinit->flags & INIT_FLAGS_EXTENDED_MID)
+        devinfo->iflags |= INFO_FLAGS_EXTENDED_MID;
+
+    // Rx FIFO receive modes: each rx device is an ID filter element of the FIFO
+    if(devinit->flags & INIT_FLAGS_RX_FIFO)
+    {
+        if(devinfo->numrx > RX_FIFO_MAX_FILTERS)
+        {
+            fprintf(stderr, "Rx FIFO supports at most %d rx devices\n", RX_FIFO_MAX_FILTERS);
+            exit(EXIT_FAILURE);
+        }
+        devinfo->iflags |= INFO_FLAGS_RX_FIFO;
+        devinfo->rffn = RX_FIFO_RFFN(devinfo->numrx);
+        // The FIFO and its filter table occupy the first mailboxes
+        if(devinfo->txmbxstart < RX_FIFO_FIRST_FREE_MBX(devinfo->rffn))
+            devinfo->txmbxstart = RX_FIFO_FIRST_FREE_MBX(devinfo->rffn);
+    }
+#if defined(S32G_FLEXCAN)
+    else if(devinit->flags & INIT_FLAGS_RX_EFIFO)
+    {
+        if(devinfo->numrx > ((devinfo->iflags & INFO_FLAGS_EXTENDED_MID) ?
+                             FLEXCAN_ERFIFO_MAX_EXT_FILTERS : FLEXCAN_ERFFEL_NUM))
+        {
+            fprintf(stderr, "Too many rx devices for the Enhanced Rx FIFO filter table\n");
+            exit(EXIT_FAILURE);
+        }
+        devinfo->iflags |= INFO_FLAGS_RX_EFIFO;
+    }
+#endif
+
+    // Mailboxes hold 8 data bytes unless CAN FD selects a larger payload
+    devinfo->mbsize = sizeof(can_msg_obj_t);
+    devinfo->mbs_per_region = RINGO_CAN_MB_REGION_SIZE / devinfo->mbsize;
+    if(devinit->flags & INIT_FLAGS_FD)
+    {
+        if(devinfo->mode != CANDEV_MODE_RAW_FRAME || (devinfo->iflags & INFO_FLAGS_RX_ANY_FIFO))
+        {
+            fprintf(stderr, "CAN FD requires raw mode (-R) with mailbox receive (-F mb)\n");
+            exit(EXIT_FAILURE);
+        }
+        devinfo->fd_payload = devinit->fd_payload ? devinit->fd_payload : CAN_FD_DATA_MAX;
+        if(devinfo->fd_payload != 8 && devinfo->fd_payload != 16 &&
+           devinfo->fd_payload != 32 && devinfo->fd_payload != 64)
+        {
+            fprintf(stderr, "Invalid CAN FD payload size passed in -l option (8, 16, 32 or 64)\n");
+            exit(EXIT_FAILURE);
+        }
+        devinfo->mbsize = 8 + devinfo->fd_payload;
+        devinfo->mbs_per_region = RINGO_CAN_MB_REGION_SIZE / devinfo->mbsize;
+        devinfo->iflags |= INFO_FLAGS_FD;
+        if(devinit->flags & INIT_FLAGS_FD_BRS)
+            devinfo->iflags |= INFO_FLAGS_FD_BRS;
+
+        // CAN FD frames are queued by the driver, libcan queues hold 8 bytes.
+        // Both queues index with a mask, free running indexes wrap at 2^32
+        for(devinfo->fdrxq.size = 1; devinfo->fdrxq.size < devinit->cinit.msgq_size; devinfo->fdrxq.size <<= 1)
+            ;
+        devinfo->fdtxq.size = devinfo->fdrxq.size;
+        devinfo->fdrxq.msg = _smalloc(sizeof(CAN_FD_MSG) * devinfo->fdrxq.size);
+        devinfo->fdtxq.msg = _smalloc(sizeof(CAN_FD_MSG) * devinfo->fdtxq.size);
+        devinfo->fdrxq.cycles = _smalloc(sizeof(uint64_t) * devinfo->fdrxq.size);
+        if(!devinfo->fdrxq.msg || !devinfo->fdtxq.msg || !devinfo->fdrxq.cycles)
+        {
+            fprintf(stderr, "CAN FD queues: _smalloc failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+#if defined(S32G_FLEXCAN)
+    // High resolution timestamps are read from the per mailbox HR_TIME_STAMPn registers
+    if(devinit->hrts_freq)
+    {
+        if(devinfo->iflags & INFO_FLAGS_RX_ANY_FIFO)
+        {
+            fprintf(stderr, "High resolution timestamps require mailbox receive (-F mb)\n");
+            exit(EXIT_FAILURE);
+        }
+        devinfo->hrts_freq = devinit->hrts_freq;
+    }
+#endif
+
+    // Shared memory rx ring replaces the raw rx device queue
+    if(devinit->rxring_size)
+    {
+        if(devinfo->mode != CANDEV_MODE_RAW_FRAME ||
+           (devinit->rxring_size & (devinit->rxring_size - 1)))
+        {
+            fprintf(stderr, "Shared memory rx ring requires raw mode (-R) and a power of two size\n");
+            exit(EXIT_FAILURE);
+        }
+        can_rxring_create(devinfo, devinit);
+    }
+
+    // Software filter rx devices share the raw rx mailbox
+    if(devinit->swf_ndevs)
+    {
+        if(devinfo->mode != CANDEV_MODE_RAW_FRAME || devinit->rxring_size ||
+           (devinfo->iflags & (INFO_FLAGS_RX_ANY_FIFO | INFO_FLAGS_FD)))
+        {
+            fprintf(stderr, "Software filters require raw mode (-R) with mailbox receive, without -f or -r\n");
+            exit(EXIT_FAILURE);
+        }
+        if(devinit->swf_ndevs > CAN_SWF_MAX_DEVS)
+        {
+            fprintf(stderr, "At most %d software filter devices\n", CAN_SWF_MAX_DEVS);
+            exit(EXIT_FAILURE);
+        }
+    }
+
     // Setup the resmgr device unit numbers for rx and tx channels
     // NOTE: Errata ERR005829 has required us to reduce the number of mailboxes
     // and also adjust the mapping between mailbox number and resource manager
@@ -473,15 +748,18 @@ void create_device(CANDEV_RINGO_INIT *devinit)
         tx_dev_unit_num += 1;
 #endif
     }
+    // Tx mailboxes may have been moved up past the Rx FIFO
+    if(devinfo->num_mailboxes < devinfo->txmbxstart + devinfo->numtx)
+        devinfo->num_mailboxes = devinfo->txmbxstart + devinfo->numtx;
 
-    // Allocate an array of devices - one for each mailbox
-    devlist = (void *) _smalloc(sizeof(*devlist) * devinfo->num_mailboxes);
+    // Allocate an array of devices - one for each mailbox, then the software filter devices
+    devlist = (void *) _smalloc(sizeof(*devlist) * (devinfo->num_mailboxes + devinit->swf_ndevs));
     if(!devlist)
     {
         fprintf(stderr, "devlist: _smalloc failed\n");
         exit(EXIT_FAILURE);
     }
-    memset(devlist, 0, sizeof(*devlist) * devinfo->num_mailboxes);
+    memset(devlist, 0, sizeof(*devlist) * (devinfo->num_mailboxes + devinit->swf_ndevs));
 
     // Map device registers
     devinfo->base = mmap_device_io(RINGO_CAN_REG_SIZE_FLEXCAN, devinit->port);
@@ -491,8 +769,11 @@ void create_device(CANDEV_RINGO_INIT *devinit)
         exit(EXIT_FAILURE);
     }
 
-    // Determine if there is an active mini-driver and initialize driver to support it
-    if(devinit->flags & INIT_FLAGS_MDRIVER_INIT)
+    // Determine if there is an active mini-driver and initialize driver to support it.
+    // The mini-driver receives into classic mailboxes, the Rx FIFO and CAN FD modes
+    // need a full hardware init.
+    if((devinit->flags & INIT_FLAGS_MDRIVER_INIT) &&
+       !(devinfo->iflags & (INFO_FLAGS_RX_ANY_FIFO | INFO_FLAGS_FD)) && !devinfo->hrts_freq)
     {
         mdriver_intr = mdriver_init(devinfo, devinit);
     }
@@ -521,6 +802,20 @@ void create_device(CANDEV_RINGO_INIT *devinit)
         exit(EXIT_FAILURE);
     }
 
+#if defined(S32G_FLEXCAN)
+    // Map Enhanced Rx FIFO output and filter memory
+    if(devinfo->iflags & INFO_FLAGS_RX_EFIFO)
+    {
+        devinfo->erfifo = mmap_device_memory(NULL, FLEXCAN_ERFIFO_MEM_SIZE,
+                    PROT_READ|PROT_WRITE|PROT_NOCACHE, 0, devinit->port + FLEXCAN_ERFIFO_OFFSET);
+        if(devinfo->erfifo == MAP_FAILED)
+        {
+            perror("CAN ERFIFO: Can't map device memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+#endif
+
     // Setup device info
     devinfo->devlist = devlist;
     strcpy(devinfo->initinfo.description,"MX6X FlexCAN");
@@ -538,6 +833,11 @@ void create_device(CANDEV_RINGO_INIT *devinit)
 
     devinfo->iflags |= INFO_FLAGS_ENDIAN_SWAP;
 
+    if(devinit->flags & INIT_FLAGS_LBUF)
+        devinfo->iflags |= INFO_FLAGS_LBUF;
+    if(devinit->flags & INIT_FLAGS_RX_DROP_NEW)
+        devinfo->iflags |= INFO_FLAGS_RX_DROP_NEW;
+
     // Initialize all device mailboxes
     for(i = 0; i < devinfo->num_mailboxes; i++)
     {
@@ -549,9 +849,23 @@ void create_device(CANDEV_RINGO_INIT *devinit)
         // for those mailboxes which actually get exposed through the resmgr.
         devlist[i].cdev.dev_unit = -1;
         devinfo->devlist[i].cdev.devtype = -1;
+        // Each mailbox is its own device with one tx mailbox, except the
+        // raw tx device which owns all tx mailboxes
+        devlist[i].owner = &devlist[i];
+        devlist[i].txmbs = 1;
+        if(devinfo->mode == CANDEV_MODE_RAW_FRAME && i >= devinfo->txmbxstart &&
+           i < (devinfo->txmbxstart+devinfo->numtx))
+        {
+            devlist[i].owner = &devlist[devinfo->txmbxstart];
+            devlist[i].txmbs = devinfo->numtx;
+            if(i > devinfo->txmbxstart)
+                continue;
+        }
 
         // Only expose the 'USER' mailboxes to the resource manager.
-        if(i >= devinfo->rxmbxstart && i < (devinfo->txmbxstart+devinfo->numtx))
+        // Mailboxes between the rx and tx ranges belong to the Rx FIFO.
+        if(i >= devinfo->rxmbxstart && i < (devinfo->txmbxstart+devinfo->numtx) &&
+           (i < (devinfo->rxmbxstart+devinfo->numrx) || i >= devinfo->txmbxstart))
         {
             // Set device mailbox as transmit or receive and set resmgr unit number
             if(i < devinfo->txmbxstart)
@@ -573,8 +887,31 @@ void create_device(CANDEV_RINGO_INIT *devinit)
         }
     }
 
+    // Software filter devices follow the mailbox devices, rx units continue after the tx units
+    devinfo->swf_devs = &devlist[devinfo->num_mailboxes];
+    devinfo->swf_ndevs = devinit->swf_ndevs;
+    for(i = devinfo->num_mailboxes; i < devinfo->num_mailboxes + devinfo->swf_ndevs; i++)
+    {
+        devlist[i].mbxid = i;
+        devlist[i].devinfo = devinfo;
+        devlist[i].owner = &devlist[i];
+        devinit->cinit.devtype = CANDEV_TYPE_RX;
+        devinit->cinit.dev_unit = tx_dev_unit_num++;
+        can_resmgr_init_device(&devlist[i].cdev, (CANDEV_INIT *)devinit);
+        can_resmgr_create_device(&devlist[i].cdev);
+    }
+    can_wake_init(devinfo);
+    if(devinfo->swf_ndevs)
+        can_swf_init(devinfo);
+
     if(!(devinit->flags & INIT_FLAGS_MDRIVER_INIT) || mdriver_intr == -1)
         can_init_hw(devinfo, devinit);
+    else
+        // Index the message IDs the mini-driver left in the rx mailboxes
+        can_midhash_build(devinfo);
+
+    // Conversion of the receive timestamps to nanoseconds
+    can_timestamp_init(devinfo, devinit);
 
 #ifdef DEBUG_DRVR
     can_print_reg(devinfo);
@@ -0,0 +1,131 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Interrupt thread.
+ *
+ * With -I a unit services its interrupts in a thread of its own instead of
+ * the ISR: the interrupt vectors are attached with InterruptAttachEvent()
+ * and deliver a pulse carrying the index of the vector. The thread is
+ * restricted to the cores of its runmask and runs at its own priority, so
+ * several units in one driver process can each be pinned to a core. It
+ * runs the ISR code unchanged, sends the returned event to libcan and
+ * unmasks the vector again.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/neutrino.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+static void *can_intr_thread(void *arg)
+{
+    CANDEV_RINGO_INFO       *devinfo = arg;
+    const struct sigevent   *event;
+    struct _pulse            pulse;
+    int                      index;
+
+    // Register access and InterruptLock() need I/O privileges
+    ThreadCtl(PRIVITY_FLAGS, 0);
+    if(ThreadCtl(_NTO_TCTL_RUNMASK, (void *)(uintptr_t)devinfo->intr_runmask) == -1)
+        perror("Interrupt thread: runmask");
+
+    for(;;)
+    {
+        if(MsgReceivePulse(devinfo->intr_chid, &pulse, sizeof(pulse), NULL) == -1)
+            continue;
+
+        index = pulse.value.sival_int;
+        event = can_intr(devinfo, devinfo->intr_iid[index]);
+        if(event)
+            can_deliver_event(event);
+        InterruptUnmask(devinfo->intr_vec[index], devinfo->intr_iid[index]);
+    }
+
+    return(NULL);
+}
+
+/* Create the interrupt thread of a unit, before its interrupts are attached */
+void can_intr_thread_init(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit)
+{
+    pthread_attr_t          attr;
+    struct sched_param      param;
+    pthread_t               tid;
+
+    devinfo->intr_runmask = devinit->intr_runmask;
+    devinfo->intr_prio = devinit->intr_prio;
+    devinfo->intr_chid = ChannelCreate(_NTO_CHF_DISCONNECT);
+    if(devinfo->intr_chid == -1)
+    {
+        perror("Interrupt thread: ChannelCreate failed");
+        exit(EXIT_FAILURE);
+    }
+    devinfo->intr_coid = ConnectAttach(0, 0, devinfo->intr_chid, _NTO_SIDE_CHANNEL, 0);
+    if(devinfo->intr_coid == -1)
+    {
+        perror("Interrupt thread: ConnectAttach failed");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = devinit->intr_prio;
+    pthread_attr_setschedparam(&attr, &param);
+    if(pthread_create(&tid, &attr, can_intr_thread, devinfo) != EOK)
+    {
+        fprintf(stderr, "Interrupt thread: pthread_create failed\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+/*
+ * Attach an interrupt vector to the interrupt thread, index tells the
+ * vectors of the unit apart.
+ *
+ * Returns: Interrupt id or -1.
+ */
+int can_intr_thread_attach(CANDEV_RINGO_INFO *devinfo, int vector, int index)
+{
+    struct sigevent          event;
+
+    // The pulse carries the thread priority, receiving it does not lower the thread
+    SIGEV_PULSE_INIT(&event, devinfo->intr_coid, devinfo->intr_prio, _PULSE_CODE_MINAVAIL, index);
+
+    devinfo->intr_vec[index] = vector;
+    devinfo->intr_iid[index] = InterruptAttachEvent(vector, &event, _NTO_INTR_FLAGS_TRK_MSK);
+
+    return devinfo->intr_iid[index];
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
@@ -96,25 +96,13 @@ int mdriver_init(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit)
 }
 
 /*
- * Function to search though all devices to find a matching message ID
+ * Function to find the receive mailbox with a matching message ID
  *
  * Returns: Matching mailbox ID or -1.
  */
 int mdriver_find_mbxid(CANDEV_RINGO_INFO *devinfo, uint32_t canmid)
 {
-	int					i;
-
-	// Search through all receive mailboxes to find a matching message ID
-	for(i = devinfo->rxmbxstart; i < (devinfo->numrx + devinfo->rxmbxstart); i++)
-	{
-		if(canmid == devinfo->canmsg[i].canmid)
-		{
-			return(i);
-		}
-	}
-
-	// Didn't find a match
-	return(-1);
+	return(can_midhash_find(devinfo, canmid));
 }
 
 /*
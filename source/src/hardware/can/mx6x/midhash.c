@@ -0,0 +1,127 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Message ID to rx mailbox index.
+ *
+ * Hash buckets chain the rx mailboxes through devinfo->midnext, each chain
+ * ordered by mailbox number so a lookup returns the same mailbox as a scan
+ * of the rx mailboxes would when several share a message ID. The index is
+ * built once the mailboxes hold their message IDs and follows
+ * CAN_DEVCTL_SET_MID. It is only used from thread context.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+#define CAN_MIDHASH_EMPTY       (-1)
+
+/* Bucket of a message ID, standard and extended IDs spread over all bits */
+static inline uint32_t can_midhash_bucket(CANDEV_RINGO_INFO *devinfo, uint32_t canmid)
+{
+    return can_midhash(canmid & RINGO_CANMID_MASK_EXT, devinfo->midhash_shift);
+}
+
+/* Add an rx mailbox to the index under its current message ID */
+void can_midhash_add(CANDEV_RINGO_INFO *devinfo, uint32_t mbxid)
+{
+    int16_t         *link = &devinfo->midhash[can_midhash_bucket(devinfo, can_mb(devinfo, mbxid)->canmid)];
+
+    while(*link != CAN_MIDHASH_EMPTY && *link < (int)mbxid)
+        link = &devinfo->midnext[*link];
+    devinfo->midnext[mbxid] = *link;
+    *link = mbxid;
+}
+
+/* Remove an rx mailbox from the index, before its message ID changes */
+void can_midhash_del(CANDEV_RINGO_INFO *devinfo, uint32_t mbxid)
+{
+    int16_t         *link = &devinfo->midhash[can_midhash_bucket(devinfo, can_mb(devinfo, mbxid)->canmid)];
+
+    while(*link != CAN_MIDHASH_EMPTY)
+    {
+        if(*link == (int)mbxid)
+        {
+            *link = devinfo->midnext[mbxid];
+            return;
+        }
+        link = &devinfo->midnext[*link];
+    }
+}
+
+/* Build the index from the message IDs of the rx mailboxes */
+void can_midhash_build(CANDEV_RINGO_INFO *devinfo)
+{
+    uint32_t        nbuckets, i;
+
+    // At least twice as many buckets as rx mailboxes keeps the chains short
+    for(nbuckets = 16, devinfo->midhash_shift = 28; nbuckets < 2 * devinfo->numrx; nbuckets <<= 1)
+        devinfo->midhash_shift--;
+
+    if(!devinfo->midhash)
+    {
+        devinfo->midhash = _smalloc(sizeof(*devinfo->midhash) * nbuckets);
+        devinfo->midnext = _smalloc(sizeof(*devinfo->midnext) * devinfo->num_mailboxes);
+        if(!devinfo->midhash || !devinfo->midnext)
+        {
+            fprintf(stderr, "MID index: _smalloc failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(i = 0; i < nbuckets; i++)
+        devinfo->midhash[i] = CAN_MIDHASH_EMPTY;
+
+    for(i = devinfo->rxmbxstart; i < (devinfo->rxmbxstart + devinfo->numrx); i++)
+        can_midhash_add(devinfo, i);
+}
+
+/*
+ * Find the rx mailbox of a message ID, canmid in CANMID register layout.
+ *
+ * Returns: Matching mailbox ID or -1.
+ */
+int can_midhash_find(CANDEV_RINGO_INFO *devinfo, uint32_t canmid)
+{
+    int             mbxid;
+
+    if(!devinfo->midhash)
+        return(-1);
+
+    for(mbxid = devinfo->midhash[can_midhash_bucket(devinfo, canmid)];
+        mbxid != CAN_MIDHASH_EMPTY; mbxid = devinfo->midnext[mbxid])
+    {
+        if(canmid == can_mb(devinfo, mbxid)->canmid)
+            return(mbxid);
+    }
+
+    return(-1);
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
@@ -0,0 +1,310 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Rx FIFO receive engine (-F fifo|efifo).
+ *
+ * Instead of one message buffer per rx device, received frames are buffered
+ * by the FlexCAN Rx FIFO (6 frames deep) or the Enhanced Rx FIFO (up to 20
+ * frames deep on S32G) and read out in bulk by the ISR. Each rx device is
+ * backed by one FIFO ID filter element; the ID hit reported with each frame
+ * selects the device it is queued to. In raw mode every filter accepts all
+ * frames and everything goes to the single rx device.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <hw/inout.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+/* Map a FIFO ID hit to the rx device it was configured for */
+static inline CANDEV_RINGO *can_rxfifo_dev(CANDEV_RINGO_INFO *devinfo, uint32_t idhit)
+{
+    if((devinfo->mode == CANDEV_MODE_RAW_FRAME) || (idhit >= devinfo->numrx))
+        return &devinfo->devlist[devinfo->rxmbxstart];
+
+    return &devinfo->devlist[devinfo->rxmbxstart + idhit];
+}
+
+/* Program the legacy Rx FIFO filter element and mask of rx device 'index' */
+static void can_rxfifo_write_filter(CANDEV_RINGO_INFO *devinfo, uint32_t index)
+{
+    CANDEV_RINGO        *dev = &devinfo->devlist[devinfo->rxmbxstart + index];
+    uint32_t            *filter = (uint32_t *)&devinfo->canmsg[RX_FIFO_FILTER_MBX];
+    uint32_t             ide = (devinfo->iflags & INFO_FLAGS_EXTENDED_MID) ? RX_FIFO_FILTER_IDE : 0;
+    uint32_t             mask = 0;
+
+    // Accept all in raw mode, a zero mask matches both standard and extended frames
+    if((devinfo->mode != CANDEV_MODE_RAW_FRAME) && dev->mfilter)
+        mask = RX_FIFO_FILTER_ID(dev->mfilter) | RX_FIFO_FILTER_IDE;
+
+    filter[index] = RX_FIFO_FILTER_ID(dev->mid) | ide;
+
+    // Only the first filter elements have an individual mask, the rest share RXFGMASK
+    if(index < RX_FIFO_NUM_INDIVIDUAL_MASKS)
+        out32(devinfo->canlam + index * RINGO_CAN_MAILBOX_SIZE, mask);
+}
+
+#if defined(S32G_FLEXCAN)
+/* Program the Enhanced Rx FIFO filter element of rx device 'index' */
+static void can_rxfifo_write_efilter(CANDEV_RINGO_INFO *devinfo, uint32_t index)
+{
+    CANDEV_RINGO        *dev = &devinfo->devlist[devinfo->rxmbxstart + index];
+    volatile uint32_t   *erffel = devinfo->erfifo + FLEXCAN_ERFFEL_OFFSET / 4;
+
+    if(devinfo->iflags & INFO_FLAGS_EXTENDED_MID)
+    {
+        erffel[2 * index] = FLEXCAN_ERFFEL_EXT_ID(dev->mid);
+        erffel[2 * index + 1] = FLEXCAN_ERFFEL_EXT_MASK(dev->mfilter);
+    }
+    else
+    {
+        // Standard ID in CANMID is left aligned at bit 18
+        erffel[index] = FLEXCAN_ERFFEL_STD(dev->mid >> 18, dev->mfilter >> 18);
+    }
+}
+
+/* Enable the Enhanced Rx FIFO and program its filter table (freeze mode) */
+static void can_rxfifo_init_efifo(CANDEV_RINGO_INFO *devinfo)
+{
+    volatile uint32_t   *erffel = devinfo->erfifo + FLEXCAN_ERFFEL_OFFSET / 4;
+    uint32_t             nexif, nwords, i;
+
+    if(devinfo->mode == CANDEV_MODE_RAW_FRAME)
+    {
+        // One extended and one standard filter, both accepting everything
+        nexif = 1;
+        nwords = 4;
+        erffel[0] = FLEXCAN_ERFFEL_EXT_ID(0);
+        erffel[1] = FLEXCAN_ERFFEL_EXT_MASK(0);
+        erffel[2] = FLEXCAN_ERFFEL_STD(0, 0);
+        erffel[3] = FLEXCAN_ERFFEL_STD(0, 0);
+    }
+    else
+    {
+        if(devinfo->iflags & INFO_FLAGS_EXTENDED_MID)
+        {
+            nexif = devinfo->numrx;
+            nwords = 2 * devinfo->numrx;
+        }
+        else
+        {
+            nexif = 0;
+            // Filter elements are allocated in pairs of words
+            nwords = (devinfo->numrx + 1) & ~1;
+        }
+        for(i = 0; i < devinfo->numrx; i++)
+            can_rxfifo_write_efilter(devinfo, i);
+        // Pad an odd standard filter count with a copy of the first filter
+        if(nwords > devinfo->numrx && !nexif)
+            erffel[nwords - 1] = erffel[0];
+    }
+
+    out32(devinfo->base + FLEXCAN_ERFCR, FLEXCAN_ERFCR_ERFEN |
+                                          (nexif << FLEXCAN_ERFCR_NEXIF_SHIFT) |
+                                          ((nwords / 2 - 1) << FLEXCAN_ERFCR_NFE_SHIFT));
+    // Flush anything left over from a previous owner of the FIFO
+    out32(devinfo->base + FLEXCAN_ERFSR, FLEXCAN_ERFSR_ERFCLR | FLEXCAN_ERFSR_ERFUFW |
+                                          FLEXCAN_ERFSR_ERFOVF | FLEXCAN_ERFSR_ERFWMI |
+                                          FLEXCAN_ERFSR_ERFDA);
+}
+#endif
+
+/* Set up the Rx FIFO and its filter table. Called from can_init_hw() in freeze mode */
+void can_rxfifo_init(CANDEV_RINGO_INFO *devinfo)
+{
+    uint32_t            *filter = (uint32_t *)&devinfo->canmsg[RX_FIFO_FILTER_MBX];
+    uint32_t             nfilters, i;
+
+#if defined(S32G_FLEXCAN)
+    if(devinfo->iflags & INFO_FLAGS_RX_EFIFO)
+    {
+        can_rxfifo_init_efifo(devinfo);
+        return;
+    }
+#endif
+
+    nfilters = RX_FIFO_FILTERS_PER_RFFN * (devinfo->rffn + 1);
+
+    set_port32(devinfo->base + RINGO_CANCTRL2, RINGO_CANCTRL2_RFFN_MASK,
+               devinfo->rffn << RINGO_CANCTRL2_RFFN_SHIFT);
+    set_port32(devinfo->base + RINGO_CANMC, RINGO_CANMC_FEN, RINGO_CANMC_FEN);
+
+    for(i = 0; i < devinfo->numrx; i++)
+        can_rxfifo_write_filter(devinfo, i);
+
+    // Unused filter elements repeat the first one, the lowest matching element wins
+    for(; i < nfilters; i++)
+    {
+        filter[i] = filter[0];
+        if(i < RX_FIFO_NUM_INDIVIDUAL_MASKS)
+            out32(devinfo->canlam + i * RINGO_CAN_MAILBOX_SIZE, in32(devinfo->canlam));
+    }
+
+    // Elements without an individual mask match exactly (accept all in raw mode)
+    out32(devinfo->base + RINGO_CANRXFGMASK,
+          (devinfo->mode == CANDEV_MODE_RAW_FRAME) ? 0 : RINGO_CANRXGMASK_MASK);
+
+    // Drop anything that is still in the FIFO
+    out32(devinfo->base + RINGO_CANIFLAG1, IFLAG_RX_FIFO_AVAILABLE |
+                                          IFLAG_RX_FIFO_WARNING | IFLAG_RX_FIFO_OVERFLOW);
+}
+
+/* Enable the Rx FIFO frame available and overflow interrupts */
+void can_rxfifo_init_intr(CANDEV_RINGO_INFO *devinfo)
+{
+#if defined(S32G_FLEXCAN)
+    if(devinfo->iflags & INFO_FLAGS_RX_EFIFO)
+    {
+        out32(devinfo->base + FLEXCAN_ERFIER, FLEXCAN_ERFIER_ERFDAIE | FLEXCAN_ERFIER_ERFOVFIE);
+        return;
+    }
+#endif
+    set_port32(devinfo->base + RINGO_CANIMASK1,
+               IFLAG_RX_FIFO_AVAILABLE | IFLAG_RX_FIFO_OVERFLOW,
+               IFLAG_RX_FIFO_AVAILABLE | IFLAG_RX_FIFO_OVERFLOW);
+}
+
+/*
+ * Drain the Rx FIFO into the rx device queues. Devices with blocked clients
+ * are noted in wake, as on the mailbox path.
+ *
+ * Returns: number of frames read.
+ */
+int can_rxfifo_intr(CANDEV_RINGO_INFO *devinfo, uint32_t *wake)
+{
+    CANDEV_RINGO        *dev;
+    can_msg_obj_t       *mb;
+    uint32_t             iflag, ctrl, idhit;
+    int                  nframes = 0;
+
+#if defined(S32G_FLEXCAN)
+    if(devinfo->iflags & INFO_FLAGS_RX_EFIFO)
+    {
+        mb = (can_msg_obj_t *)devinfo->erfifo;
+        while((iflag = in32(devinfo->base + FLEXCAN_ERFSR)) & FLEXCAN_ERFSR_ERFDA)
+        {
+            ctrl = mb->canmcf;
+            idhit = devinfo->erfifo[FLEXCAN_ERFIFO_IDHIT_WORD((ctrl & MSG_BUF_DLC_MASK) >> MSG_BUF_DLC_SHIFT)] &
+                    FLEXCAN_ERFIFO_IDHIT_MASK;
+            dev = can_rxfifo_dev(devinfo, idhit);
+            can_rx_copy(devinfo, dev, mb, ctrl, wake);
+            // Writing the data available flag pops the element
+            out32(devinfo->base + FLEXCAN_ERFSR, FLEXCAN_ERFSR_ERFDA);
+            nframes++;
+            devinfo->isr_frames++;
+
+            if(can_dev_waiting(dev))
+                can_wake_add(wake, dev);
+        }
+        if(iflag & FLEXCAN_ERFSR_ERFOVF)
+        {
+            devinfo->stats.hw_receive_overflows++;
+            out32(devinfo->base + FLEXCAN_ERFSR, FLEXCAN_ERFSR_ERFOVF | FLEXCAN_ERFSR_ERFWMI);
+        }
+        return nframes;
+    }
+#endif
+
+    mb = &devinfo->canmsg[RX_FIFO_OUTPUT_MBX];
+    while((iflag = in32(devinfo->base + RINGO_CANIFLAG1)) & IFLAG_RX_FIFO_AVAILABLE)
+    {
+        // RXFIR is only valid while the frame is at the FIFO output
+        idhit = in32(devinfo->base + RINGO_CANRXFIR) & RINGO_CANRXFIR_IDHIT_MASK;
+        dev = can_rxfifo_dev(devinfo, idhit);
+
+        // No mailbox lock here: the output stays put until the flag is cleared
+        ctrl = mb->canmcf;
+        can_rx_copy(devinfo, dev, mb, ctrl, wake);
+        // Clearing the frame available flag pops the FIFO
+        out32(devinfo->base + RINGO_CANIFLAG1, IFLAG_RX_FIFO_AVAILABLE);
+        nframes++;
+        devinfo->isr_frames++;
+
+        if(can_dev_waiting(dev))
+            can_wake_add(wake, dev);
+    }
+    if(iflag & IFLAG_RX_FIFO_OVERFLOW)
+    {
+        devinfo->stats.hw_receive_overflows++;
+        out32(devinfo->base + RINGO_CANIFLAG1, IFLAG_RX_FIFO_OVERFLOW | IFLAG_RX_FIFO_WARNING);
+    }
+    return nframes;
+}
+
+/* Message ID and filter devctls of rx devices backed by an Rx FIFO filter element */
+int can_rxfifo_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    uint32_t             index = dev->mbxid - devinfo->rxmbxstart;
+
+    switch(dcmd)
+    {
+        case CAN_DEVCTL_SET_MID:
+            if(devinfo->mode == CANDEV_MODE_RAW_FRAME)
+                return(EINVAL);
+            dev->mid = data->mid & RINGO_CANMID_MASK_EXT;
+            break;
+
+        case CAN_DEVCTL_GET_MID:
+            data->mid = dev->mid;
+            return(EOK);
+
+        case CAN_DEVCTL_SET_MFILTER:
+            if(devinfo->mode == CANDEV_MODE_RAW_FRAME)
+                return(EINVAL);
+            // Legacy FIFO elements past the individual masks share the global mask
+            if(!(devinfo->iflags & INFO_FLAGS_RX_EFIFO) && index >= RX_FIFO_NUM_INDIVIDUAL_MASKS)
+                return(EINVAL);
+            dev->mfilter = data->mfilter & RINGO_CANLAM_MASK;
+            break;
+
+        case CAN_DEVCTL_GET_MFILTER:
+            data->mfilter = dev->mfilter;
+            return(EOK);
+
+        default:
+            return(ENOTSUP);
+    }
+
+    // The filter table can only be written in freeze mode
+    if(can_freeze(devinfo) != EOK)
+        return(EIO);
+#if defined(S32G_FLEXCAN)
+    if(devinfo->iflags & INFO_FLAGS_RX_EFIFO)
+        can_rxfifo_write_efilter(devinfo, index);
+    else
+#endif
+        can_rxfifo_write_filter(devinfo, index);
+    can_unfreeze(devinfo);
+
+    return(EOK);
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
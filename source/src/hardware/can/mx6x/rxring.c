@@ -0,0 +1,139 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Shared memory rx ring (-r, raw mode).
+ *
+ * The ISR decodes every received raw frame directly into a ring that
+ * clients map read-only, replacing the copy into the libcan queue and the
+ * message pass per frame of CAN_DEVCTL_RX_FRAME_RAW_*. See mx6x-can.h for
+ * the ring layout and the reader protocol.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic.h>
+#include <sys/mman.h>
+#include <sys/neutrino.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+/* Create the shared memory object of the unit and map the ring */
+void can_rxring_create(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit)
+{
+    char            name[32];
+    size_t          size;
+    int             fd;
+
+    size = sizeof(CAN_RX_RING) + devinit->rxring_size * sizeof(CAN_FD_MSG);
+    snprintf(name, sizeof(name), CAN_RX_RING_NAME, devinit->cinit.can_unit);
+
+    // Start from a fresh object, clients of a previous driver instance keep their stale mapping
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0444);
+    if(fd == -1)
+    {
+        perror("CAN RX RING: shm_open failed");
+        exit(EXIT_FAILURE);
+    }
+    if(ftruncate(fd, size) == -1)
+    {
+        perror("CAN RX RING: ftruncate failed");
+        exit(EXIT_FAILURE);
+    }
+    devinfo->rxring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(devinfo->rxring == MAP_FAILED)
+    {
+        perror("CAN RX RING: mmap failed");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    devinfo->rxring->size = devinit->rxring_size;
+    devinfo->rxring->head = 0;
+    devinfo->rxring->magic = CAN_RX_RING_MAGIC;
+}
+
+/* Write a received frame into the ring. Called from the ISR */
+void can_rxring_put(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl)
+{
+    CAN_RX_RING     *ring = devinfo->rxring;
+    uint32_t         head = ring->head;
+
+    can_fd_read(devinfo, mb, ctrl, &ring->frame[head & (ring->size - 1)]);
+
+    // Publish the frame before the new head, and the head before rxring_armed is checked
+    __cpu_membarrier();
+    ring->head = head + 1;
+    __cpu_membarrier();
+
+    devinfo->stats.received_frames++;
+    // The armed client gets the frame on the raw rx device as well, as its wakeup
+    if(devinfo->rxring_armed && atomic_clr_value(&devinfo->rxring_armed, 1))
+        can_rx_queue(devinfo, &devinfo->devlist[devinfo->rxmbxstart], mb, ctrl);
+    else
+        can_mb_stats_rx(&devinfo->devlist[devinfo->rxmbxstart], 1);
+}
+
+/* Rx ring devctls of the raw rx device */
+int can_rxring_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    CAN_RX_RING_NOTIFY  *notify = (CAN_RX_RING_NOTIFY *)data;
+    canmsg_t            *msg;
+
+    if(!devinfo->rxring || dev->mbxid != devinfo->rxmbxstart)
+        return(EINVAL);
+
+    switch(dcmd)
+    {
+        case CAN_DEVCTL_RX_RING_NOTIFY:
+            // Drop the frame of an earlier arming the client did not wait for
+            while((msg = canmsg_dequeue_element(dev->cdev.msg_queue)))
+                canmsg_queue_element(dev->cdev.free_queue, msg);
+
+            atomic_set(&devinfo->rxring_armed, 1);
+            __cpu_membarrier();
+            // A frame may have arrived since the client found the ring empty
+            if(devinfo->rxring->head != notify->tail &&
+               atomic_clr_value(&devinfo->rxring_armed, 1))
+            {
+                return(EAGAIN);
+            }
+            break;
+
+        default:
+            return(ENOTSUP);
+    }
+
+    return(EOK);
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
@@ -0,0 +1,328 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Software acceptance filters (-k, raw mode).
+ *
+ * The ranges of all software filter devices are compiled into lookup
+ * tables giving the mask of accepting devices: a direct table for 11 bit
+ * IDs, an open addressing hash for single 29 bit IDs and sorted disjoint
+ * segments for 29 bit ranges. The tables are rebuilt on every change and
+ * swapped in under swf_lock, the ISR only does the lookup.
+ *
+ * Devices with clients to wake are collected with the mailbox devices of
+ * the same ISR pass, see can_wake_event().
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/neutrino.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+#define CAN_SWF_STD_ID(canmid)      (((canmid) & RINGO_CANMID_MASK_STD) >> 18)
+#define CAN_SWF_MAX_ID_STD          0x7FF
+#define CAN_SWF_MAX_ID_EXT          RINGO_CANMID_MASK_EXT
+
+/* Serializes range changes and table rebuilds between devctls */
+static pthread_mutex_t  can_swf_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Range boundary of a device, for building the 29 bit segments */
+typedef struct
+{
+    uint32_t        pos;
+    int             dev;
+    int             delta;
+} can_swf_edge_t;
+
+static inline uint32_t can_swf_hash_slot(CAN_SWF_TABLE *t, uint32_t id)
+{
+    return can_midhash(id, t->hash_shift);
+}
+
+static int can_swf_edge_cmp(const void *a, const void *b)
+{
+    const can_swf_edge_t    *ea = a, *eb = b;
+
+    return (ea->pos > eb->pos) - (ea->pos < eb->pos);
+}
+
+static void can_swf_free(CAN_SWF_TABLE *t)
+{
+    if(t)
+    {
+        free(t->hash);
+        free(t->seg);
+        free(t);
+    }
+}
+
+/* Compile the ranges of all software filter devices into lookup tables */
+static CAN_SWF_TABLE *can_swf_build(CANDEV_RINGO_INFO *devinfo)
+{
+    CAN_SWF_TABLE       *t;
+    CAN_SWF_RANGE       *r;
+    can_swf_edge_t      *edge;
+    uint32_t             nsingle = 0, nedge = 0, nhash, shift, d, i, id, slot;
+    int                  count[CAN_SWF_MAX_DEVS];
+    uint64_t             mask;
+
+    for(d = 0; d < devinfo->swf_ndevs; d++)
+    {
+        for(i = 0; i < devinfo->swf_devs[d].swf_nranges; i++)
+        {
+            r = &devinfo->swf_devs[d].swf_ranges[i];
+            if(!(r->flags & CAN_SWF_RANGE_EXT))
+                continue;
+            if(r->first == r->last)
+                nsingle++;
+            else
+                nedge += 2;
+        }
+    }
+    for(nhash = 16, shift = 28; nhash < 2 * nsingle; nhash <<= 1)
+        shift--;
+
+    t = calloc(1, sizeof(*t));
+    edge = malloc(sizeof(*edge) * (nedge + 1));
+    if(t)
+    {
+        t->hash = malloc(sizeof(*t->hash) * nhash);
+        t->seg = malloc(sizeof(*t->seg) * (nedge + 1));
+    }
+    if(!t || !edge || !t->hash || !t->seg)
+    {
+        can_swf_free(t);
+        free(edge);
+        return(NULL);
+    }
+    t->hash_mask = nhash - 1;
+    t->hash_shift = shift;
+    for(i = 0; i < nhash; i++)
+    {
+        t->hash[i].id = CAN_SWF_HASH_EMPTY;
+        t->hash[i].mask = 0;
+    }
+
+    nedge = 0;
+    for(d = 0; d < devinfo->swf_ndevs; d++)
+    {
+        for(i = 0; i < devinfo->swf_devs[d].swf_nranges; i++)
+        {
+            r = &devinfo->swf_devs[d].swf_ranges[i];
+            if(!(r->flags & CAN_SWF_RANGE_EXT))
+            {
+                for(id = r->first; id <= r->last; id++)
+                    t->std[id] |= 1ULL << d;
+            }
+            else if(r->first == r->last)
+            {
+                for(slot = can_swf_hash_slot(t, r->first);
+                    t->hash[slot].id != CAN_SWF_HASH_EMPTY && t->hash[slot].id != r->first;
+                    slot = (slot + 1) & t->hash_mask)
+                    ;
+                t->hash[slot].id = r->first;
+                t->hash[slot].mask |= 1ULL << d;
+            }
+            else
+            {
+                edge[nedge++] = (can_swf_edge_t){ r->first, d, 1 };
+                edge[nedge++] = (can_swf_edge_t){ r->last + 1, d, -1 };
+            }
+        }
+    }
+
+    // Sweep the range boundaries, a device accepts while any of its ranges is open
+    qsort(edge, nedge, sizeof(*edge), can_swf_edge_cmp);
+    memset(count, 0, sizeof(count));
+    mask = 0;
+    for(i = 0; i < nedge; i++)
+    {
+        count[edge[i].dev] += edge[i].delta;
+        if(count[edge[i].dev])
+            mask |= 1ULL << edge[i].dev;
+        else
+            mask &= ~(1ULL << edge[i].dev);
+        if(i + 1 < nedge && edge[i + 1].pos == edge[i].pos)
+            continue;
+        if(t->nseg && t->seg[t->nseg - 1].mask == mask)
+            continue;
+        t->seg[t->nseg].first = edge[i].pos;
+        t->seg[t->nseg].mask = mask;
+        t->nseg++;
+    }
+    free(edge);
+
+    return(t);
+}
+
+/* Devices accepting a 29 bit message ID */
+static inline uint64_t can_swf_lookup_ext(CAN_SWF_TABLE *t, uint32_t id)
+{
+    uint64_t        mask = 0;
+    uint32_t        slot, lo, hi, mid;
+
+    for(slot = can_swf_hash_slot(t, id); t->hash[slot].id != CAN_SWF_HASH_EMPTY;
+        slot = (slot + 1) & t->hash_mask)
+    {
+        if(t->hash[slot].id == id)
+        {
+            mask = t->hash[slot].mask;
+            break;
+        }
+    }
+
+    // Last segment starting at or below the ID
+    lo = 0;
+    hi = t->nseg;
+    while(lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if(t->seg[mid].first <= id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo)
+        mask |= t->seg[lo - 1].mask;
+
+    return(mask);
+}
+
+/*
+ * Copy a frame of the raw rx mailbox to the software filter devices that
+ * accept it, noting the ones to wake in wake. Called from the ISR. Returns
+ * 0 when no device accepts it.
+ */
+int can_swf_rx(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl, uint32_t *wake)
+{
+    CANDEV_RINGO        *swdev;
+    uint32_t             canmid = mb->canmid;
+    uint64_t             mask, pending;
+    int                  d;
+
+    InterruptLock(&devinfo->swf_lock);
+    if(ctrl & MB_CNT_IDE)
+        mask = can_swf_lookup_ext(devinfo->swf, canmid & RINGO_CANMID_MASK_EXT);
+    else
+        mask = devinfo->swf->std[CAN_SWF_STD_ID(canmid)];
+
+    for(pending = mask; pending; pending &= pending - 1)
+    {
+        d = __builtin_ctzll(pending);
+        swdev = &devinfo->swf_devs[d];
+        can_rx_queue(devinfo, swdev, mb, ctrl);
+        if(can_dev_waiting(swdev))
+            can_wake_add(wake, swdev);
+    }
+    InterruptUnlock(&devinfo->swf_lock);
+
+    return(mask != 0);
+}
+
+/* Set up the software filter devices, before interrupts are attached */
+void can_swf_init(CANDEV_RINGO_INFO *devinfo)
+{
+    uint32_t             d;
+
+    for(d = 0; d < devinfo->swf_ndevs; d++)
+    {
+        devinfo->swf_devs[d].swf_ranges = malloc(sizeof(CAN_SWF_RANGE) * CAN_SWF_MAX_RANGES);
+        if(!devinfo->swf_devs[d].swf_ranges)
+        {
+            fprintf(stderr, "Software filters: malloc failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // No ranges yet, every frame goes to the raw rx device
+    devinfo->swf = can_swf_build(devinfo);
+    if(!devinfo->swf)
+    {
+        fprintf(stderr, "Software filters: malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Devctls of the software filter devices */
+int can_swf_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    CAN_SWF_RANGE       *range = (CAN_SWF_RANGE *)data;
+    CAN_SWF_TABLE       *t, *old;
+    int                  status = EOK;
+    int                  added = 0;
+
+    switch(dcmd)
+    {
+        case CAN_DEVCTL_SWF_ADD:
+            if(range->first > range->last ||
+               range->last > ((range->flags & CAN_SWF_RANGE_EXT) ? CAN_SWF_MAX_ID_EXT : CAN_SWF_MAX_ID_STD))
+                return(EINVAL);
+            pthread_mutex_lock(&can_swf_mutex);
+            if(dev->swf_nranges == CAN_SWF_MAX_RANGES)
+            {
+                pthread_mutex_unlock(&can_swf_mutex);
+                return(ENOSPC);
+            }
+            dev->swf_ranges[dev->swf_nranges++] = *range;
+            added = 1;
+            break;
+
+        case CAN_DEVCTL_SWF_CLEAR:
+            pthread_mutex_lock(&can_swf_mutex);
+            dev->swf_nranges = 0;
+            break;
+
+        default:
+            // The device has no mailbox behind it
+            return(EINVAL);
+    }
+
+    t = can_swf_build(devinfo);
+    if(t)
+    {
+        InterruptLock(&devinfo->swf_lock);
+        old = devinfo->swf;
+        devinfo->swf = t;
+        InterruptUnlock(&devinfo->swf_lock);
+        can_swf_free(old);
+    }
+    else
+    {
+        if(added)
+            dev->swf_nranges--;
+        status = ENOMEM;
+    }
+    pthread_mutex_unlock(&can_swf_mutex);
+
+    return(status);
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
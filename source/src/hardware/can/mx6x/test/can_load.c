@@ -0,0 +1,102 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Traffic generator: runs the driver on the simulated bus at each offered
+ * load and prints frames/s, ISR cycles and register accesses per frame and
+ * the overflow counts. Options after -- go to the driver.
+ *
+ *   can_load [-l load[,load...]] [-m uniform|hot:N|seq] [-u unmatched%] [-n len]
+ *            [-r read_us] [-w tx_fps] [-L latency_ns] [-t ms] [-s seed] [-- driver options]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cansim.h"
+
+static char        *default_args[] = { "dev-can-mx6x", "-b1M", NULL };
+
+int main(int argc, char *argv[])
+{
+    cansim_load_t       load = { 0, "uniform", 0, 8, 0, 0, 2000, 1000000000ULL, 1 };
+    cansim_result_t     res;
+    const char         *loads = "10,25,50,75,90,100";
+    char              **drvargs = default_args;
+    char               *cp;
+    double              secs;
+    int                 opt;
+
+    while((opt = getopt(argc, argv, "l:m:u:n:r:w:L:t:s:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'l': loads = optarg; break;
+            case 'm': load.mix = optarg; break;
+            case 'u': load.unmatched = strtoul(optarg, NULL, 0); break;
+            case 'n': load.len = strtoul(optarg, NULL, 0) > 8 ? 8 : strtoul(optarg, NULL, 0); break;
+            case 'r': load.read_ns = strtoull(optarg, NULL, 0) * 1000; break;
+            case 'w': load.tx_fps = strtoul(optarg, NULL, 0); break;
+            case 'L': load.latency_ns = strtoull(optarg, NULL, 0); break;
+            case 't': load.duration_ns = strtoull(optarg, NULL, 0) * 1000000; break;
+            case 's': load.seed = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: can_load [-l load,...] [-m uniform|hot:N|seq] [-u pct] [-n len] "
+                                "[-r read_us] [-w tx_fps] [-L latency_ns] [-t ms] [-s seed] [-- driver options]\n");
+                return EXIT_FAILURE;
+        }
+    }
+    if(optind < argc)
+    {
+        // The driver's getopt() starts after its argv[0]
+        drvargs = &argv[optind - 1];
+        drvargs[0] = default_args[0];
+    }
+
+    secs = load.duration_ns / 1e9;
+    printf("driver:");
+    for(opt = 1; drvargs[opt]; opt++)
+        printf(" %s", drvargs[opt]);
+    printf("  mix %s, %u%% unmatched, %u bytes, %s, tx %u/s, latency %llu ns, %.3f s\n",
+           load.mix, load.unmatched, load.len, load.read_ns ? "polling readers" : "blocked readers",
+           load.tx_fps, (unsigned long long)load.latency_ns, secs);
+    printf("%5s %9s %9s %9s %9s %7s %9s %8s %8s %8s %8s %6s\n", "load%", "offered/s", "bus/s", "rx/s",
+           "read/s", "calls/s", "cyc/frame", "reg/frm", "hw-ovr", "sw-ovr", "unmatch", "spins");
+    for(cp = (char *)loads; *cp; )
+    {
+        load.load = strtoul(cp, &cp, 0);
+        if(*cp == ',')
+            cp++;
+        if(cansim_run(drvargs, &load, &res) != 0)
+        {
+            fprintf(stderr, "can_load: run at %u%% failed\n", load.load);
+            return EXIT_FAILURE;
+        }
+        printf("%5u %9.0f %9.0f %9.0f %9.0f %7.0f %9.0f %8.1f %8llu %8u %8llu %6u\n", load.load,
+               res.offered / secs, res.bus_frames / secs, res.model.rx_frames / secs, res.delivered / secs,
+               res.handler_calls / secs, res.isr_frames ? (double)res.isr_cycles / res.isr_frames : 0.0,
+               res.isr_frames ? (double)res.isr_regs / res.isr_frames : 0.0,
+               (unsigned long long)res.model.overruns, res.sw_overflows,
+               (unsigned long long)res.model.unmatched, res.spins);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Mailbox ISR benchmark: fills 1, 8, 32 and 64 rx mailboxes, spread over
+ * the IFLAG words, and dispatches the interrupt once the burst is pending.
+ * Prints the handler calls per burst and the cycles and register accesses
+ * per frame, through can_intr() as the kernel calls it and of
+ * can_mb_intr() alone. With blocked readers the devices are woken through
+ * one event, by the wakeup thread when there are several. Options after --
+ * go to the driver.
+ *
+ *   can_mb_bench [-i bursts] [-- driver options]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cansim.h"
+
+#define BENCH_BURSTS        2000
+
+const struct sigevent *can_mb_intr(CANDEV_RINGO_INFO *devinfo);
+
+static char        *default_args[] = { "dev-can-mx6x", "-b1M", NULL };
+static const uint32_t bench_pending[] = { 1, 8, 32, 64 };
+
+static int          bench_blocked;
+
+static void bench_reply(CANDEV *cdev, const struct can_msg *msg)
+{
+    struct can_msg      next;
+
+    (void)msg;
+    while(libcan_read(cdev, &next))
+        ;
+    if(bench_blocked)
+        libcan_block(cdev);
+}
+
+static void bench_drain(void)
+{
+    CANDEV_RINGO_INFO  *devinfo = cansim_devinfo();
+    struct can_msg      msg;
+    uint32_t            i;
+
+    for(i = 0; i < devinfo->numrx; i++)
+    {
+        while(libcan_read(&cansim_rxdev(i)->cdev, &msg))
+            ;
+    }
+}
+
+/* Frames for npending mailboxes, evenly spread over the rx mailboxes */
+static void bench_burst(uint32_t npending)
+{
+    CANDEV_RINGO_INFO  *devinfo = cansim_devinfo();
+    flexcan_frame_t     f;
+    uint32_t            i, stride = devinfo->numrx / npending;
+
+    for(i = 0; i < npending; i++)
+    {
+        cansim_rxframe(i * stride, &f);
+        flexcan_rx(&f);
+    }
+}
+
+static void bench_run(uint32_t npending, uint32_t bursts)
+{
+    CANDEV_RINGO_INFO  *devinfo = cansim_devinfo();
+    uint64_t            frames0, cycles0, regs0, calls, start, mb_cycles = 0, mb_frames = 0;
+    uint32_t            i;
+
+    // Through the interrupt dispatch, as the kernel calls the handler
+    frames0 = devinfo->isr_frames;
+    cycles0 = devinfo->isr_cycles;
+    regs0 = sim_stats.isr_regs;
+    calls = 0;
+    for(i = 0; i < bursts; i++)
+    {
+        bench_burst(npending);
+        calls += cansim_irq(bench_reply);
+        bench_drain();
+    }
+    frames0 = devinfo->isr_frames - frames0;
+
+    // can_mb_intr() on its own, the lines are not asserted for the dispatch
+    if(!bench_blocked)
+    {
+        for(i = 0; i < bursts; i++)
+        {
+            bench_burst(npending);
+            mb_frames -= devinfo->isr_frames;
+            start = ClockCycles();
+            can_mb_intr(devinfo);
+            mb_cycles += ClockCycles() - start;
+            mb_frames += devinfo->isr_frames;
+            bench_drain();
+        }
+    }
+
+    printf("%8s %7u %11.2f %10.1f", bench_blocked ? "blocked" : "idle", npending, (double)calls / bursts,
+           frames0 ? (double)(devinfo->isr_cycles - cycles0) / frames0 : 0.0);
+    if(mb_frames)
+        printf(" %10.1f", (double)mb_cycles / mb_frames);
+    else
+        printf(" %10s", "-");
+    printf(" %9.1f", frames0 ? (double)(sim_stats.isr_regs - regs0) / frames0 : 0.0);
+    printf("%s\n", frames0 == (uint64_t)npending * bursts ? "" : "  frames lost");
+}
+
+int main(int argc, char *argv[])
+{
+    CANDEV_RINGO_INFO  *devinfo;
+    char              **drvargs = default_args;
+    uint32_t            bursts = BENCH_BURSTS, i;
+    int                 opt, nargs;
+
+    while((opt = getopt(argc, argv, "i:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'i': bursts = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: can_mb_bench [-i bursts] [-- driver options]\n");
+                return EXIT_FAILURE;
+        }
+    }
+    if(optind < argc)
+    {
+        // The driver's getopt() starts after its argv[0]
+        drvargs = &argv[optind - 1];
+        drvargs[0] = default_args[0];
+    }
+    for(nargs = 0; drvargs[nargs]; nargs++)
+        ;
+
+    cansim_start(nargs, drvargs);
+    devinfo = cansim_devinfo();
+    if(devinfo->numrx < bench_pending[sizeof(bench_pending) / sizeof(bench_pending[0]) - 1])
+    {
+        fprintf(stderr, "can_mb_bench: %u rx mailboxes, 64 needed\n", devinfo->numrx);
+        return EXIT_FAILURE;
+    }
+
+    printf("%u bursts, %u rx mailboxes\n", bursts, devinfo->numrx);
+    printf("%8s %7s %11s %10s %10s %9s\n", "readers", "pending", "calls/burst", "cyc/frame",
+           "mb cyc/frm", "reg/frm");
+    for(bench_blocked = 0; bench_blocked < 2; bench_blocked++)
+    {
+        // The readers block again in bench_reply() once woken
+        for(i = 0; bench_blocked && i < devinfo->numrx; i++)
+            libcan_block(&cansim_rxdev(i)->cdev);
+        for(i = 0; i < sizeof(bench_pending) / sizeof(bench_pending[0]); i++)
+            bench_run(bench_pending[i], bursts);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,404 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * No driver path spins on a status register. The driver runs on the
+ * simulated bus through a tx burst, receive, error injection, the devctls
+ * that freeze the controller and a bus-off in the middle of a transmission
+ * with recovery (-e), in raw mode with a 4 mailbox tx queue and in I/O mode.
+ * A raw mode run with the shared memory rx ring (-r) checks that a client
+ * armed on the ring is woken through the raw rx device.
+ * in32() counts a register read SIM_SPIN_LIMIT times in a row without a
+ * write or a sleep as a spin; none may show up. The only register allowed
+ * to be polled at all is the ESR, which the bus-off recovery thread reads
+ * once per 1 ms sleep until the controller is back on the bus.
+ *
+ * The waits on the hardware that may legitimately take a while are bounded
+ * instead, and checked against a faulty model: a mailbox that stays BUSY is
+ * left pending and received on a later pass, a freeze that is never
+ * acknowledged fails the devctl with EIO after one bounded spin on the MCR,
+ * and a soft reset that never completes makes the driver exit at start.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "cansim.h"
+
+#define LATENCY_NS          2000
+#define TX_BURST            32
+#define RX_BURST            16
+#define BUSOFF_FRAMES       8
+
+const struct sigevent *can_mb_intr(CANDEV_RINGO_INFO *devinfo);
+
+static char        *raw_args[] = { "dev-can-mx6x", "-b1M", "-R", "-T4", "-e10,40", NULL };
+static char        *io_args[] = { "dev-can-mx6x", "-b1M", "-e10,40", NULL };
+static char        *rxring_args[] = { "dev-can-mx6x", "-b1M", "-R", "-r64", NULL };
+
+static uint64_t     now;
+static unsigned     fail, checks, replies;
+
+static void check(const char *what, int ok)
+{
+    printf("  %-44s %s\n", what, ok ? "ok" : "FAIL");
+    checks++;
+    if(!ok)
+        fail++;
+}
+
+static void reply(CANDEV *cdev, const struct can_msg *msg)
+{
+    struct can_msg      next;
+
+    (void)msg;
+    replies++;
+    while(libcan_read(cdev, &next))
+        ;
+}
+
+static int pending(void)
+{
+    return flexcan_line(FLEXCAN_LINE_ESR) || flexcan_line(FLEXCAN_LINE_MB0_7) || flexcan_line(FLEXCAN_LINE_MB8_127);
+}
+
+/*
+ * Run the bus for ns with only the tx mailboxes talking. With esr_bit set
+ * every transmission fails with that error instead of completing.
+ */
+static void bus_run(uint64_t ns, uint32_t esr_bit)
+{
+    flexcan_frame_t     f;
+    uint64_t            end = now + ns, frame_end = CANSIM_NEVER, irq_at = CANSIM_NEVER, next;
+    int                 mbx = -1;
+
+    while(now < end)
+    {
+        if(irq_at == CANSIM_NEVER && pending())
+            irq_at = now + LATENCY_NS;
+        if(frame_end == CANSIM_NEVER && (mbx = flexcan_tx_next(&f)) >= 0)
+            frame_end = now + (uint64_t)flexcan_frame_bits(&f) * flexcan_bit_ps() / 1000;
+
+        next = end;
+        if(frame_end < next) next = frame_end;
+        if(irq_at < next) next = irq_at;
+        if(sim_next_wakeup() < next) next = sim_next_wakeup();
+        if(flexcan_next_event() < next) next = flexcan_next_event();
+        now = next;
+        cansim_advance(now);
+        libcan_process(reply);
+
+        if(now >= frame_end)
+        {
+            if(esr_bit)
+                flexcan_tx_error(esr_bit);
+            else
+                flexcan_tx_done(mbx);
+            frame_end = CANSIM_NEVER;
+        }
+        if(irq_at <= now)
+        {
+            cansim_irq(reply);
+            irq_at = CANSIM_NEVER;
+        }
+    }
+}
+
+static int tx_raw(uint32_t id)
+{
+    DCMD_DATA           data;
+
+    memset(&data, 0, sizeof(data));
+    data.canmsg.mid = (id << 18) & RINGO_CANMID_MASK_STD;
+    data.canmsg.len = 8;
+    return libcan_devctl(&cansim_txdev(0)->cdev, CAN_DEVCTL_TX_FRAME_RAW, &data);
+}
+
+/* Frames of another node back to back, raw mode receives into a single mailbox */
+static void rx_burst(uint32_t n)
+{
+    flexcan_frame_t     f;
+    uint32_t            i;
+
+    for(i = 0; i < n; i++)
+    {
+        cansim_rxframe(i % cansim_devinfo()->numrx, &f);
+        flexcan_rx(&f);
+        bus_run((uint64_t)flexcan_frame_bits(&f) * flexcan_bit_ps() / 1000, 0);
+    }
+}
+
+/* Spins anywhere fail, sleeping polls only on the ESR */
+static void check_polls(int busoff)
+{
+    char                what[64];
+    uint32_t            esr_polls = 0;
+    int                 i;
+
+    for(i = 0; i < SIM_POLL_MAX && sim_stats.spin[i].count; i++)
+    {
+        snprintf(what, sizeof(what), "spins on register 0x%03x", sim_stats.spin[i].offset);
+        check(what, 0);
+    }
+    for(i = 0; i < SIM_POLL_MAX && sim_stats.sleep[i].count; i++)
+    {
+        if(sim_stats.sleep[i].offset == RINGO_CANESR)
+        {
+            esr_polls = sim_stats.sleep[i].count;
+            continue;
+        }
+        snprintf(what, sizeof(what), "sleeping poll of register 0x%03x", sim_stats.sleep[i].offset);
+        check(what, 0);
+    }
+    if(busoff)
+    {
+        snprintf(what, sizeof(what), "bus-off recovery polled the ESR %u times", esr_polls);
+        check(what, esr_polls > 0);
+    }
+    check("no register spun on", sim_stats.spin[0].count == 0);
+}
+
+static void test_raw(void)
+{
+    CANDEV_RINGO_INFO  *devinfo = cansim_devinfo();
+    DCMD_DATA           data;
+    uint64_t            rx, tx;
+    uint32_t            i, queued = 0;
+
+    // Tx burst through the 4 mailbox queue, refilled from the tx interrupt
+    for(i = 0; i < TX_BURST; i++)
+        queued += tx_raw(0x100 + (i * 7) % TX_BURST) == EOK;
+    bus_run(10000000, 0);
+    check("tx burst queued", queued == TX_BURST);
+    check("tx burst sent", flexcan_stats.tx_frames == TX_BURST);
+
+    // Receive, the ISR drains the burst
+    rx = devinfo->stats.received_frames;
+    rx_burst(RX_BURST);
+    bus_run(1000000, 0);
+    check("rx burst received", devinfo->stats.received_frames - rx == RX_BURST);
+
+    // Receive errors up to the warning level
+    for(i = 0; i < 100; i++)
+        flexcan_rx_error(i & 1 ? RINGO_CANES_STUFFERR : RINGO_CANES_CRCERR);
+    bus_run(1000000, 0);
+    memset(&data, 0, sizeof(data));
+    check("error devctl", libcan_devctl(&cansim_rxdev(0)->cdev, CAN_DEVCTL_ERROR, &data) == EOK);
+    check("rx error counter reported", data.error.drvr3 != 0);
+
+    // Devctls that freeze the controller or read the timer
+    check("get mfilter devctl", libcan_devctl(&cansim_rxdev(0)->cdev, CAN_DEVCTL_GET_MFILTER, &data) == EOK);
+    data.timestamp = 0x1234;
+    check("set timestamp devctl", libcan_devctl(&cansim_rxdev(0)->cdev, CAN_DEVCTL_SET_TIMESTAMP, &data) == EOK);
+    check("get timestamp devctl", libcan_devctl(&cansim_rxdev(0)->cdev, CAN_DEVCTL_GET_TIMESTAMP, &data) == EOK);
+    check("get stats devctl", libcan_devctl(&cansim_rxdev(0)->cdev, CAN_DEVCTL_GET_STATS, &data) == EOK);
+
+    // Bus-off in the middle of a transmission, then recovery after the 10 ms backoff
+    tx = flexcan_stats.tx_frames;
+    for(i = 0; i < BUSOFF_FRAMES; i++)
+        tx_raw(0x200 + i);
+    bus_run(5000000, RINGO_CANES_BITERR_DOMINANT_RECESSIVE);
+    check("bus-off on tx errors", flexcan_stats.busoffs == 1 && devinfo->busoff);
+    check("frames held while bus-off", flexcan_stats.tx_frames == tx);
+    bus_run(50000000, 0);
+    check("recovered", flexcan_stats.recoveries == 1 && !devinfo->busoff);
+    check("held frames sent after recovery", flexcan_stats.tx_frames - tx == BUSOFF_FRAMES);
+
+    check_polls(1);
+}
+
+static void test_io(void)
+{
+    CANDEV_RINGO_INFO  *devinfo = cansim_devinfo();
+    struct can_msg      msg;
+    DCMD_DATA           data;
+    uint64_t            rx;
+    uint32_t            i, queued = 0;
+
+    // Acceptance mask and ID changes freeze the controller
+    memset(&data, 0, sizeof(data));
+    data.mfilter = RINGO_CANMID_MASK_STD;
+    check("set mfilter devctl", libcan_devctl(&cansim_rxdev(0)->cdev, CAN_DEVCTL_SET_MFILTER, &data) == EOK);
+    data.mfilter = 0;
+    check("get mfilter devctl", libcan_devctl(&cansim_rxdev(0)->cdev, CAN_DEVCTL_GET_MFILTER, &data) == EOK &&
+          data.mfilter == RINGO_CANMID_MASK_STD);
+    data.mid = 0x155 << 18;
+    check("set mid devctl", libcan_devctl(&cansim_rxdev(1)->cdev, CAN_DEVCTL_SET_MID, &data) == EOK);
+    data.prio = 1;
+    check("set prio devctl", libcan_devctl(&cansim_txdev(0)->cdev, CAN_DEVCTL_SET_PRIO, &data) == EOK);
+
+    // Tx burst on one device and a receive burst meanwhile
+    memset(&msg, 0, sizeof(msg));
+    msg.len = 8;
+    msg.mid = CAN_MSG_MID_UNKNOWN;
+    for(i = 0; i < TX_BURST; i++)
+        queued += libcan_write(&cansim_txdev(0)->cdev, &msg) == EOK;
+    rx = devinfo->stats.received_frames;
+    rx_burst(RX_BURST);
+    bus_run(10000000, 0);
+    check("tx burst sent", queued == TX_BURST && flexcan_stats.tx_frames == TX_BURST);
+    check("rx burst received", devinfo->stats.received_frames - rx == RX_BURST);
+
+    // Warning and error passive levels, then bus-off and recovery
+    for(i = 0; i < BUSOFF_FRAMES; i++)
+        libcan_write(&cansim_txdev(i)->cdev, &msg);
+    bus_run(5000000, RINGO_CANES_BITERR_RECESSIVE_DOMINANT);
+    check("bus-off on tx errors", flexcan_stats.busoffs == 1);
+    bus_run(50000000, 0);
+    check("recovered and sent", flexcan_stats.recoveries == 1 &&
+          flexcan_stats.tx_frames == TX_BURST + BUSOFF_FRAMES);
+
+    check_polls(1);
+}
+
+/* Shared memory rx ring, the armed client waits on the raw rx device */
+static void test_rxring(void)
+{
+    CANDEV_RINGO_INFO  *devinfo = cansim_devinfo();
+    CANDEV             *rxdev = &cansim_rxdev(0)->cdev;
+    CAN_RX_RING_NOTIFY  notify;
+    struct can_msg      msg;
+
+    memset(&notify, 0, sizeof(notify));
+    check("armed on the empty ring", libcan_devctl(rxdev, CAN_DEVCTL_RX_RING_NOTIFY, (DCMD_DATA *)&notify) == EOK);
+    libcan_block(rxdev);
+    replies = 0;
+    rx_burst(RX_BURST);
+    bus_run(1000000, 0);
+    check("frames written to the ring", devinfo->rxring->head == RX_BURST);
+    check("waiting client woken once", replies == 1 && !libcan_read(rxdev, &msg));
+    check("arming behind the head fails", libcan_devctl(rxdev, CAN_DEVCTL_RX_RING_NOTIFY, (DCMD_DATA *)&notify) == EAGAIN);
+    notify.tail = devinfo->rxring->head;
+    check("armed again after draining", libcan_devctl(rxdev, CAN_DEVCTL_RX_RING_NOTIFY, (DCMD_DATA *)&notify) == EOK);
+
+    check_polls(0);
+}
+
+/* Faulty hardware, I/O mode */
+static void test_faults(void)
+{
+    CANDEV_RINGO_INFO  *devinfo = cansim_devinfo();
+    CANDEV_RINGO       *dev = cansim_rxdev(0);
+    flexcan_frame_t     f;
+    DCMD_DATA           data;
+    uint64_t            rx;
+    int                 i, mcr_spins = 0, other_spins = 0;
+
+    // A mailbox that stays BUSY is left pending for a later pass
+    rx = devinfo->stats.received_frames;
+    cansim_rxframe(0, &f);
+    flexcan_rx(&f);
+    flexcan_mb_busy(dev->mbxid, 1);
+    can_mb_intr(devinfo);
+    check("busy mailbox skipped", dev->mbstats.busy_skips == 1 && devinfo->stats.received_frames == rx);
+    check("busy mailbox left pending", pending());
+    flexcan_mb_busy(dev->mbxid, 0);
+    bus_run(1000000, 0);
+    check("received once no longer busy", devinfo->stats.received_frames - rx == 1);
+
+    // Freeze mode is never acknowledged
+    flexcan_mcr_stuck(RINGO_CANMC_FRZACK);
+    memset(&data, 0, sizeof(data));
+    check("set mfilter devctl gives up", libcan_devctl(&dev->cdev, CAN_DEVCTL_SET_MFILTER, &data) == EIO);
+    check("get mfilter devctl gives up", libcan_devctl(&dev->cdev, CAN_DEVCTL_GET_MFILTER, &data) == EIO);
+    flexcan_mcr_stuck(0);
+    rx = devinfo->stats.received_frames;
+    rx_burst(RX_BURST);
+    bus_run(1000000, 0);
+    check("still receiving", devinfo->stats.received_frames - rx == RX_BURST);
+
+    // The only spins are the two bounded freeze waits
+    for(i = 0; i < SIM_POLL_MAX && sim_stats.spin[i].count; i++)
+    {
+        if(sim_stats.spin[i].offset == RINGO_CANMC)
+            mcr_spins += sim_stats.spin[i].count;
+        else
+            other_spins += sim_stats.spin[i].count;
+    }
+    check("one bounded MCR spin per freeze", mcr_spins == 2 && other_spins == 0);
+}
+
+/* One driver instance per process, the driver keeps its state in globals */
+static int run(const char *name, char *args[], void (*test)(void))
+{
+    int                 status, argc;
+    pid_t               pid;
+
+    for(argc = 0; args[argc]; argc++)
+        ;
+    printf("%s\n", name);
+    fflush(NULL);
+    if((pid = fork()) == -1)
+        return -1;
+    if(pid == 0)
+    {
+        cansim_start(argc, args);
+        test();
+        printf("  %u of %u failed\n", fail, checks);
+        fflush(NULL);
+        _exit(fail ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS ? 0 : -1;
+}
+
+/* A soft reset that never completes: the driver has to exit instead of hanging */
+static int run_stuck_reset(void)
+{
+    int                 status, argc, gave_up;
+    pid_t               pid;
+
+    for(argc = 0; io_args[argc]; argc++)
+        ;
+    printf("soft reset never completes\n");
+    fflush(NULL);
+    if((pid = fork()) == -1)
+        return -1;
+    if(pid == 0)
+    {
+        flexcan_mcr_stuck(RINGO_CANMC_SOFTRST);
+        cansim_start(argc, io_args);
+        _exit(EXIT_SUCCESS);
+    }
+    waitpid(pid, &status, 0);
+    // SIM_SPIN_ABORT would end it with SIGABRT instead
+    gave_up = WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE;
+    printf("  %-44s %s\n", "driver gave up", gave_up ? "ok" : "FAIL");
+    return gave_up ? 0 : -1;
+}
+
+int main(void)
+{
+    int                 failed = 0;
+
+    failed += run("raw mode, 4 tx mailboxes", raw_args, test_raw) != 0;
+    failed += run("I/O mode", io_args, test_io) != 0;
+    failed += run("raw mode, shared memory rx ring", rxring_args, test_rxring) != 0;
+    failed += run("I/O mode, faulty hardware", io_args, test_faults) != 0;
+    failed += run_stuck_reset() != 0;
+
+    printf("can_nospin_test: %d of 5 configurations failed\n", failed);
+
+    return failed ? 1 : 0;
+}
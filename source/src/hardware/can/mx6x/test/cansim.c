@@ -0,0 +1,387 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * The bus around the driver. Other nodes send frames at a configured load
+ * and ID mix, the model arbitrates them against the tx mailboxes frame by
+ * frame on a virtual clock, interrupts reach the driver's handlers after a
+ * fixed latency, and clients read and write through libcan. The driver
+ * keeps its state in globals and parses options with getopt(), so
+ * cansim_run() runs each configuration in a child process. Everything but
+ * the cycle counts is deterministic for a given seed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "cansim.h"
+
+#define EXT_QUEUE           64          /* Frames the other nodes hold back while the bus is busy */
+
+int can_driver_main(int argc, char *argv[]);
+
+static CANDEV_RINGO_INFO *cansim_info;
+
+void cansim_start(int argc, char *argv[])
+{
+    CANDEV             *cdev;
+    int                 unit;
+
+    sim_start();
+    optind = 1;
+    can_driver_main(argc, argv);
+    sim_wait_idle();
+    for(unit = 0; unit < 256; unit++)
+    {
+        if((cdev = libcan_device(CANDEV_TYPE_RX, unit)) != NULL)
+            break;
+    }
+    if(!cdev)
+    {
+        fprintf(stderr, "cansim: the driver created no rx device\n");
+        exit(EXIT_FAILURE);
+    }
+    cansim_info = ((CANDEV_RINGO *)cdev)->devinfo;
+}
+
+CANDEV_RINGO_INFO *cansim_devinfo(void)
+{
+    return cansim_info;
+}
+
+CANDEV_RINGO *cansim_rxdev(uint32_t n)
+{
+    return &cansim_info->devlist[cansim_info->rxmbxstart + n];
+}
+
+CANDEV_RINGO *cansim_txdev(uint32_t n)
+{
+    return &cansim_info->devlist[cansim_info->txmbxstart + n];
+}
+
+/* A frame the n-th rx mailbox accepts, as programmed by the driver */
+void cansim_rxframe(uint32_t n, flexcan_frame_t *f)
+{
+    can_msg_obj_t      *mb = can_mb(cansim_info, cansim_rxdev(n)->mbxid);
+
+    memset(f, 0, sizeof(*f));
+    f->ext = (mb->canmcf & MB_CNT_IDE) != 0;
+    f->id = f->ext ? (mb->canmid & RINGO_CANMID_MASK_EXT) : (mb->canmid & RINGO_CANMID_MASK_STD) >> 18;
+    f->len = 8;
+}
+
+void cansim_advance(uint64_t ns)
+{
+    flexcan_advance(ns);
+    sim_set_time(ns);
+}
+
+int cansim_asserted(int vector)
+{
+    switch(vector - CANSIM_IRQSYS)
+    {
+        case 0:
+            return flexcan_line(FLEXCAN_LINE_ESR);
+        case 2:
+            return flexcan_line(FLEXCAN_LINE_MB0_7);
+        case 3:
+            return flexcan_line(FLEXCAN_LINE_MB8_127);
+        default:
+            return 0;
+    }
+}
+
+static int cansim_pending(void)
+{
+    return flexcan_line(FLEXCAN_LINE_ESR) || flexcan_line(FLEXCAN_LINE_MB0_7) || flexcan_line(FLEXCAN_LINE_MB8_127);
+}
+
+/* Run handlers and driver threads until the interrupt lines settle */
+int cansim_irq(libcan_reply_t reply)
+{
+    int                 n, calls = 0;
+
+    do {
+        n = sim_intr(cansim_asserted);
+        sim_wait_idle();
+        libcan_process(reply);
+        calls += n;
+    } while(n);
+    return calls;
+}
+
+/*
+ * Load runs
+ */
+
+static struct {
+    const cansim_load_t *load;
+    cansim_result_t    *res;
+    uint64_t            rng;
+    flexcan_frame_t    *ids;
+    uint32_t            nids;
+    uint32_t            hot;
+    int                 seqmode;
+    uint32_t            seq;
+    flexcan_frame_t     extq[EXT_QUEUE];
+    uint32_t            exthead, extcnt;
+} run;
+
+static uint32_t cansim_rand(void)
+{
+    run.rng ^= run.rng << 13;
+    run.rng ^= run.rng >> 7;
+    run.rng ^= run.rng << 17;
+    return run.rng >> 32;
+}
+
+/* Exponential gap with the given mean, for Poisson arrivals */
+static uint64_t cansim_gap(uint64_t mean)
+{
+    uint32_t            u = cansim_rand();
+    double              x = (u + 1.0) / 4294967297.0;
+    double              ln = 0, y = (x - 1) / (x + 1), y2 = y * y, t = y;
+    int                 k;
+
+    // ln(x) = 2 atanh((x - 1) / (x + 1)), without libm
+    for(k = 1; k < 200; k += 2)
+    {
+        ln += t / k;
+        t *= y2;
+    }
+    return (uint64_t)(-2 * ln * mean) + 1;
+}
+
+static void cansim_genframe(flexcan_frame_t *f)
+{
+    uint32_t            i;
+
+    if(cansim_rand() % 100 < run.load->unmatched)
+    {
+        // The rx IDs are not used by anyone else, 0x7FF never matches a default one
+        memset(f, 0, sizeof(*f));
+        f->id = 0x7FF;
+        f->ext = run.ids[0].ext;
+        if(f->ext)
+            f->id = RINGO_CANMID_MASK_EXT;
+    }
+    else
+    {
+        if(run.hot)
+            i = cansim_rand() % run.hot;
+        else if(run.seqmode)
+            i = run.seq++ % run.nids;
+        else
+            i = cansim_rand() % run.nids;
+        *f = run.ids[i];
+    }
+    f->len = run.load->len;
+    for(i = 0; i < f->len; i++)
+        f->dat[i] = cansim_rand();
+}
+
+static void cansim_reply(CANDEV *cdev, const struct can_msg *msg)
+{
+    struct can_msg      next;
+
+    (void)msg;
+    run.res->delivered++;
+    while(libcan_read(cdev, &next))
+        run.res->delivered++;
+    libcan_block(cdev);
+}
+
+static void cansim_read_all(void)
+{
+    struct can_msg      msg;
+    uint32_t            i;
+
+    for(i = 0; i < cansim_info->numrx; i++)
+    {
+        while(libcan_read(&cansim_rxdev(i)->cdev, &msg))
+            run.res->delivered++;
+    }
+}
+
+static uint64_t cansim_frame_ns(const flexcan_frame_t *f)
+{
+    return (uint64_t)flexcan_frame_bits(f) * flexcan_bit_ps() / 1000;
+}
+
+static void cansim_child(const cansim_load_t *load, cansim_result_t *res)
+{
+    flexcan_frame_t     cur, tx;
+    struct can_msg      msg;
+    uint64_t            now = 0, next, frame_end = CANSIM_NEVER, arrival, mean, tx_next, read_next;
+    uint64_t            irq_at = CANSIM_NEVER;
+    int                 curmbx = -1, mbx, i;
+
+    memset(res, 0, sizeof(*res));
+    memset(&run, 0, sizeof(run));
+    run.load = load;
+    run.res = res;
+    run.rng = 0x9E3779B97F4A7C15ULL ^ load->seed;
+
+    // The IDs of the rx mailboxes, the other nodes talk to them
+    run.nids = cansim_info->numrx;
+    if(!(run.ids = calloc(run.nids, sizeof(*run.ids))))
+        exit(EXIT_FAILURE);
+    for(i = 0; i < (int)run.nids; i++)
+        cansim_rxframe(i, &run.ids[i]);
+    if(strncmp(load->mix, "hot:", 4) == 0)
+    {
+        run.hot = strtoul(load->mix + 4, NULL, 0);
+        if(run.hot == 0 || run.hot > run.nids)
+            run.hot = run.nids;
+    }
+    else if(strcmp(load->mix, "seq") == 0)
+        run.seqmode = 1;
+
+    run.ids[0].len = load->len;
+    mean = load->load ? cansim_frame_ns(&run.ids[0]) * 100 / load->load : CANSIM_NEVER;
+    arrival = load->load ? cansim_gap(mean) : CANSIM_NEVER;
+    tx_next = load->tx_fps ? 1000000000ULL / load->tx_fps : CANSIM_NEVER;
+    read_next = load->read_ns ? load->read_ns : CANSIM_NEVER;
+    if(!load->read_ns)
+    {
+        for(i = 0; i < (int)cansim_info->numrx; i++)
+            libcan_block(&cansim_rxdev(i)->cdev);
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.len = load->len;
+
+    while(now < load->duration_ns)
+    {
+        next = load->duration_ns;
+        if(frame_end < next) next = frame_end;
+        if(arrival < next) next = arrival;
+        if(tx_next < next) next = tx_next;
+        if(read_next < next) next = read_next;
+        if(irq_at < next) next = irq_at;
+        if(sim_next_wakeup() < next) next = sim_next_wakeup();
+        if(flexcan_next_event() < next) next = flexcan_next_event();
+        now = next;
+        cansim_advance(now);
+        libcan_process(cansim_reply);
+
+        if(now >= frame_end)
+        {
+            if(curmbx >= 0)
+                flexcan_tx_done(curmbx);
+            else
+                flexcan_rx(&cur);
+            res->bus_frames++;
+            frame_end = CANSIM_NEVER;
+        }
+        while(arrival <= now)
+        {
+            if(run.extcnt < EXT_QUEUE)
+            {
+                cansim_genframe(&run.extq[(run.exthead + run.extcnt++) % EXT_QUEUE]);
+                res->offered++;
+            }
+            arrival += cansim_gap(mean);
+        }
+        if(tx_next <= now)
+        {
+            if(libcan_write(&cansim_txdev(0)->cdev, &msg) == EOK)
+                res->written++;
+            else
+                res->write_full++;
+            sim_wait_idle();
+            tx_next += 1000000000ULL / load->tx_fps;
+        }
+        if(read_next <= now)
+        {
+            cansim_read_all();
+            read_next += load->read_ns;
+        }
+        if(irq_at <= now)
+        {
+            res->handler_calls += cansim_irq(cansim_reply);
+            irq_at = CANSIM_NEVER;
+        }
+        if(irq_at == CANSIM_NEVER && cansim_pending())
+            irq_at = now + load->latency_ns;
+
+        // Start of frame: the other nodes and the tx mailboxes arbitrate
+        if(frame_end == CANSIM_NEVER)
+        {
+            mbx = flexcan_tx_next(&tx);
+            if(mbx >= 0 && (!run.extcnt || flexcan_arbitration(&tx) < flexcan_arbitration(&run.extq[run.exthead])))
+            {
+                cur = tx;
+                curmbx = mbx;
+                frame_end = now + cansim_frame_ns(&cur);
+            }
+            else if(run.extcnt)
+            {
+                cur = run.extq[run.exthead];
+                run.exthead = (run.exthead + 1) % EXT_QUEUE;
+                run.extcnt--;
+                curmbx = -1;
+                frame_end = now + cansim_frame_ns(&cur);
+            }
+        }
+    }
+
+    res->model = flexcan_stats;
+    res->handler_calls = sim_stats.isr_calls;
+    res->isr_frames = cansim_info->isr_frames;
+    res->isr_cycles = cansim_info->isr_cycles;
+    res->isr_regs = sim_stats.isr_regs;
+    res->sw_overflows = cansim_info->stats.sw_receive_q_full;
+    for(i = 0; i < SIM_POLL_MAX; i++)
+        res->spins += sim_stats.spin[i].count;
+}
+
+/* One configuration in a child process, the driver cannot be started twice */
+int cansim_run(char *const argv[], const cansim_load_t *load, cansim_result_t *res)
+{
+    int                 fd[2], status, argc;
+    pid_t               pid;
+    ssize_t             n;
+
+    for(argc = 0; argv[argc]; argc++)
+        ;
+    if(pipe(fd) == -1)
+        return -1;
+    fflush(NULL);
+    if((pid = fork()) == -1)
+        return -1;
+    if(pid == 0)
+    {
+        close(fd[0]);
+        cansim_start(argc, (char **)argv);
+        cansim_child(load, res);
+        n = write(fd[1], res, sizeof(*res));
+        _exit(n == sizeof(*res) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(fd[1]);
+    n = read(fd[0], res, sizeof(*res));
+    close(fd[0]);
+    waitpid(pid, &status, 0);
+    if(n != sizeof(*res) || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        return -1;
+    return 0;
+}
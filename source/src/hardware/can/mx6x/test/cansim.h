@@ -0,0 +1,74 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Host harness running the driver against the FlexCAN model, see cansim.c.
+ */
+
+#ifndef __CANSIM_H__
+#define __CANSIM_H__
+
+#include "canmx6x.h"
+#include "proto.h"
+#include "flexcan_model.h"
+
+#define CANSIM_IRQSYS               43          /* RINGO_CAN0_SYSINTR, irqsys of the default unit */
+#define CANSIM_NEVER                UINT64_MAX
+
+/* Traffic of the other nodes and of the local clients */
+typedef struct cansim_load {
+    uint32_t            load;                   /* Bus load offered by the other nodes, percent */
+    const char         *mix;                    /* IDs: uniform, hot:N (first N rx mailboxes) or seq */
+    uint32_t            unmatched;              /* Percent of frames no rx mailbox accepts */
+    uint32_t            len;                    /* Data bytes per frame */
+    uint64_t            read_ns;                /* Clients read every read_ns, 0 for clients blocked in read */
+    uint32_t            tx_fps;                 /* Frames/s a client writes to the first tx device */
+    uint64_t            latency_ns;             /* Interrupt latency */
+    uint64_t            duration_ns;
+    uint32_t            seed;
+} cansim_load_t;
+
+typedef struct cansim_result {
+    uint64_t            offered;                /* Frames the other nodes queued */
+    uint64_t            bus_frames;             /* Frames on the bus, both directions */
+    uint64_t            delivered;              /* Frames read by the clients */
+    uint64_t            written;                /* Frames written by the client */
+    uint64_t            write_full;             /* ... refused, tx queue full */
+    uint64_t            handler_calls;          /* Interrupt handler calls */
+    uint64_t            isr_frames;             /* Driver counters */
+    uint64_t            isr_cycles;
+    uint64_t            isr_regs;               /* Register accesses of the handlers */
+    uint32_t            sw_overflows;           /* Frames dropped on a full receive queue */
+    uint32_t            spins;                  /* Registers spun on */
+    flexcan_stats_t     model;
+} cansim_result_t;
+
+void cansim_start(int argc, char *argv[]);
+CANDEV_RINGO_INFO *cansim_devinfo(void);
+CANDEV_RINGO *cansim_rxdev(uint32_t n);
+CANDEV_RINGO *cansim_txdev(uint32_t n);
+void cansim_rxframe(uint32_t n, flexcan_frame_t *f);
+void cansim_advance(uint64_t ns);
+int cansim_asserted(int vector);
+int cansim_irq(libcan_reply_t reply);
+int cansim_run(char *const argv[], const cansim_load_t *load, cansim_result_t *res);
+
+#endif
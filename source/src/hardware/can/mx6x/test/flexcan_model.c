@@ -0,0 +1,532 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * FlexCAN as the driver sees it: MCR mode handshakes, CTRL bit timing,
+ * ESR/ECR fault confinement, IMASK/IFLAG, RXIMR and the 128 mailboxes with
+ * individual masking (IRMQ) and local priority. Mode changes are acknowledged
+ * at once unless flexcan_mcr_stuck() says otherwise. Mailbox memory is the mapped space itself, so the driver reads
+ * and writes it directly; the registers go through flexcan_in32() and
+ * flexcan_out32(). The legacy and Enhanced Rx FIFO, CAN FD, mailbox locking
+ * and the high resolution timestamps are not modelled.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+#include "flexcan_model.h"
+
+#define MB_OFFSET(n)        (RINGO_CAN_REG_SIZE_FLEXCAN + (n) * sizeof(can_msg_obj_t))
+#define MCR_RESET           (RINGO_CANMC_MDIS | RINGO_CANMC_FRZ | RINGO_CANMC_HALT | RINGO_CANMC_SUPV | 0x0F)
+#define MCR_STATUS          (RINGO_CANMC_NOTRDY | RINGO_CANMC_FRZACK | RINGO_CANMC_LPM_ACK)
+#define ESR_INTS            (RINGO_CANES_TWRNINT | RINGO_CANES_RWRNINT | RINGO_CANES_BOFFINT | \
+                             RINGO_CANES_ERRINT | RINGO_CANES_WAKEINT)
+#define ESR_ERRORS          (0x3F << 10)
+#define ESR_WARNING         96
+#define ESR_PASSIVE         128
+#define ESR_BUSOFF          256
+#define BUSOFF_RECOVERY     (128 * 11)      /* Bits of bus idle to leave bus-off */
+#define NEVER               UINT64_MAX
+
+flexcan_stats_t flexcan_stats;
+
+/* MCR handshake bits that never change, kept across flexcan_attach() */
+static uint32_t     fc_mcr_stuck;
+
+static struct {
+    uint8_t            *space;
+    uint32_t            mcr;                /* Without the status bits */
+    uint32_t            esr_int;            /* Write 1 to clear interrupt flags */
+    uint32_t            esr_err;            /* Error bits, cleared by reading ESR */
+    uint32_t            tec;
+    uint32_t            rec;
+    int                 busoff;
+    uint64_t            recover_at;
+    uint64_t            now;
+    uint32_t            timer_off;
+} fc;
+
+static inline uint32_t *fc_reg(uint32_t offset)
+{
+    return (uint32_t *)(fc.space + offset);
+}
+
+static inline can_msg_obj_t *fc_mb(int n)
+{
+    return (can_msg_obj_t *)(fc.space + MB_OFFSET(n));
+}
+
+static inline int fc_frozen(void)
+{
+    return !(fc.mcr & RINGO_CANMC_MDIS) && (fc.mcr & RINGO_CANMC_FRZ) && (fc.mcr & RINGO_CANMC_HALT);
+}
+
+static inline uint32_t fc_nmb(void)
+{
+    return (fc.mcr & RINGO_CANMC_MAXMB_MASK) + 1;
+}
+
+static void fc_soft_reset(void)
+{
+    static const uint32_t regs[] = {
+        RINGO_CANTIMER, RINGO_CANECR, RINGO_CANESR, RINGO_CANESR2, RINGO_CANIMASK1, RINGO_CANIMASK2,
+        RINGO_CANIMASK3, RINGO_CANIMASK4, RINGO_CANIFLAG1, RINGO_CANIFLAG2, RINGO_CANIFLAG3, RINGO_CANIFLAG4
+    };
+    unsigned            i;
+
+    fc.mcr = (MCR_RESET & ~RINGO_CANMC_MDIS) | (fc.mcr & RINGO_CANMC_MDIS);
+    for(i = 0; i < sizeof(regs) / sizeof(regs[0]); i++)
+        *fc_reg(regs[i]) = 0;
+    fc.esr_int = fc.esr_err = 0;
+    fc.tec = fc.rec = 0;
+    fc.busoff = 0;
+    fc.recover_at = NEVER;
+    fc.timer_off = 0;
+}
+
+void flexcan_attach(void *space)
+{
+    memset(&fc, 0, sizeof(fc));
+    memset(&flexcan_stats, 0, sizeof(flexcan_stats));
+    fc.space = space;
+    fc.mcr = MCR_RESET;
+    fc_soft_reset();
+    fc.mcr = MCR_RESET;
+}
+
+uint32_t flexcan_bit_ps(void)
+{
+    uint32_t            ctrl = *fc_reg(RINGO_CANCTRL);
+    uint64_t            presdiv = (ctrl & RINGO_CANCTRL_PRESDIV_MASK) >> RINGO_CANCTRL_PRESDIV_SHIFT;
+    uint64_t            tq = ((ctrl & RINGO_CANCTRL_PROPSEG_MASK) >> RINGO_CANCTRL_PROPSEG_SHIFT) +
+                             ((ctrl & RINGO_CANCTRL_PSEG1_MASK) >> RINGO_CANCTRL_PSEG1_SHIFT) +
+                             ((ctrl & RINGO_CANCTRL_PSEG2_MASK) >> RINGO_CANCTRL_PSEG2_SHIFT) + 4;
+
+    return (presdiv + 1) * tq * 1000000000000ULL / RINGO_CAN_CLK_PE;
+}
+
+static uint32_t fc_timer(void)
+{
+    return (uint32_t)(fc.now * 1000 / flexcan_bit_ps()) + fc.timer_off;
+}
+
+/*
+ * Fault confinement
+ */
+
+static void fc_counters_changed(uint32_t tec, uint32_t rec)
+{
+    if(fc.mcr & RINGO_CANMC_WRN_EN)
+    {
+        if(tec < ESR_WARNING && fc.tec >= ESR_WARNING)
+            fc.esr_int |= RINGO_CANES_TWRNINT;
+        if(rec < ESR_WARNING && fc.rec >= ESR_WARNING)
+            fc.esr_int |= RINGO_CANES_RWRNINT;
+    }
+    if(!fc.busoff && fc.tec >= ESR_BUSOFF)
+    {
+        fc.busoff = 1;
+        fc.esr_int |= RINGO_CANES_BOFFINT;
+        flexcan_stats.busoffs++;
+        fc.recover_at = (*fc_reg(RINGO_CANCTRL) & RINGO_CANCTRL_BOFFREC) ? NEVER :
+                        fc.now + (uint64_t)BUSOFF_RECOVERY * flexcan_bit_ps() / 1000;
+    }
+}
+
+static void fc_error(uint32_t esr_bit, uint32_t tec_incr, uint32_t rec_incr)
+{
+    uint32_t            tec = fc.tec;
+    uint32_t            rec = fc.rec;
+
+    fc.esr_err |= esr_bit & ESR_ERRORS;
+    fc.esr_int |= RINGO_CANES_ERRINT;
+    fc.tec += tec_incr;
+    fc.rec = rec + rec_incr > 255 ? 255 : rec + rec_incr;
+    fc_counters_changed(tec, rec);
+}
+
+/* Error while transmitting, an error passive node does not count missing ACKs */
+void flexcan_tx_error(uint32_t esr_bit)
+{
+    int                 passive = fc.tec >= ESR_PASSIVE || fc.rec >= ESR_PASSIVE;
+
+    if(fc.busoff)
+        return;
+    fc_error(esr_bit, (esr_bit == RINGO_CANES_ACKERR && passive) ? 0 : 8, 0);
+}
+
+void flexcan_rx_error(uint32_t esr_bit)
+{
+    if(fc.busoff)
+        return;
+    fc_error(esr_bit, 0, 1);
+}
+
+void flexcan_advance(uint64_t now_ns)
+{
+    fc.now = now_ns;
+    if(fc.busoff && now_ns >= fc.recover_at)
+    {
+        fc.busoff = 0;
+        fc.tec = fc.rec = 0;
+        fc.recover_at = NEVER;
+        flexcan_stats.recoveries++;
+    }
+}
+
+uint64_t flexcan_next_event(void)
+{
+    return fc.recover_at;
+}
+
+/*
+ * Registers
+ */
+
+uint32_t flexcan_in32(uint32_t offset)
+{
+    uint32_t            val;
+
+    switch(offset)
+    {
+        case RINGO_CANMC:
+            val = fc.mcr;
+            if(fc.mcr & RINGO_CANMC_MDIS)
+                val |= RINGO_CANMC_LPM_ACK | RINGO_CANMC_NOTRDY;
+            else if(fc_frozen())
+                val |= RINGO_CANMC_FRZACK | RINGO_CANMC_NOTRDY;
+            // A freeze that is never acknowledged, a soft reset that never completes
+            if(fc_mcr_stuck & RINGO_CANMC_FRZACK)
+                val &= ~(RINGO_CANMC_FRZACK | RINGO_CANMC_NOTRDY);
+            return val | (fc_mcr_stuck & RINGO_CANMC_SOFTRST);
+        case RINGO_CANTIMER:
+            return fc_timer() & 0xFFFF;
+        case RINGO_CANECR:
+            return (fc.tec > 255 ? 255 : fc.tec) | (fc.rec << 8);
+        case RINGO_CANESR:
+            val = fc.esr_int | fc.esr_err;
+            if(fc.tec >= ESR_WARNING)
+                val |= RINGO_CANES_TXWARN;
+            if(fc.rec >= ESR_WARNING)
+                val |= RINGO_CANES_RXWARN;
+            if(fc.busoff)
+                val |= RINGO_CANES_FCS_BUS_OFF;
+            else if(fc.tec >= ESR_PASSIVE || fc.rec >= ESR_PASSIVE)
+                val |= RINGO_CANES_FCS_ERROR_PASSIVE;
+            fc.esr_err = 0;
+            return val;
+        default:
+            return *fc_reg(offset);
+    }
+}
+
+void flexcan_out32(uint32_t offset, uint32_t val)
+{
+    uint32_t            old;
+
+    switch(offset)
+    {
+        case RINGO_CANMC:
+            fc.mcr = val & ~(MCR_STATUS | RINGO_CANMC_SOFTRST);
+            if(val & RINGO_CANMC_SOFTRST)
+                fc_soft_reset();
+            break;
+        case RINGO_CANCTRL:
+            old = *fc_reg(offset);
+            *fc_reg(offset) = val;
+            /* Clearing BOFFREC in bus-off starts the recovery */
+            if(fc.busoff && fc.recover_at == NEVER && (old & RINGO_CANCTRL_BOFFREC) && !(val & RINGO_CANCTRL_BOFFREC))
+                fc.recover_at = fc.now + (uint64_t)BUSOFF_RECOVERY * flexcan_bit_ps() / 1000;
+            break;
+        case RINGO_CANTIMER:
+            fc.timer_off = val - (uint32_t)(fc.now * 1000 / flexcan_bit_ps());
+            break;
+        case RINGO_CANECR:
+            if(fc_frozen())
+            {
+                fc.tec = val & RINGO_CANECR_TXECTR;
+                fc.rec = (val & RINGO_CANECR_RXECTR) >> 8;
+            }
+            break;
+        case RINGO_CANESR:
+            fc.esr_int &= ~(val & ESR_INTS);
+            break;
+        case RINGO_CANIFLAG1:
+        case RINGO_CANIFLAG2:
+        case RINGO_CANIFLAG3:
+        case RINGO_CANIFLAG4:
+            *fc_reg(offset) &= ~val;
+            break;
+        default:
+            /* RXIMR only takes writes in freeze mode */
+            if(offset >= RINGO_CANRXIMR0 && offset < RINGO_CANRXIMR0 + RINGO_CANLAM_MEM_SIZE && !fc_frozen())
+                break;
+            *fc_reg(offset) = val;
+            break;
+    }
+}
+
+static inline uint32_t *fc_iflag(int n)
+{
+    static const uint32_t iflag[] = { RINGO_CANIFLAG1, RINGO_CANIFLAG2, RINGO_CANIFLAG3, RINGO_CANIFLAG4 };
+
+    return fc_reg(iflag[n / 32]);
+}
+
+int flexcan_line(int line)
+{
+    uint32_t            ctrl = *fc_reg(RINGO_CANCTRL);
+    uint32_t            esr = fc.esr_int;
+
+    switch(line)
+    {
+        case FLEXCAN_LINE_ESR:
+            return ((esr & RINGO_CANES_BOFFINT) && (ctrl & RINGO_CANCTRL_BOFFMSK)) ||
+                   ((esr & RINGO_CANES_ERRINT) && (ctrl & RINGO_CANCTRL_ERRMASK)) ||
+                   ((esr & RINGO_CANES_TWRNINT) && (ctrl & RINGO_CANCTRL_TWRNMSK)) ||
+                   ((esr & RINGO_CANES_RWRNINT) && (ctrl & RINGO_CANCTRL_RWRNMSK)) ||
+                   ((esr & RINGO_CANES_WAKEINT) && (fc.mcr & RINGO_CANMC_WAKEMSK));
+        case FLEXCAN_LINE_MB0_7:
+            return (*fc_reg(RINGO_CANIFLAG1) & *fc_reg(RINGO_CANIMASK1) & 0xFF) != 0;
+        case FLEXCAN_LINE_MB8_127:
+            return (*fc_reg(RINGO_CANIFLAG1) & *fc_reg(RINGO_CANIMASK1) & ~0xFF) ||
+                   (*fc_reg(RINGO_CANIFLAG2) & *fc_reg(RINGO_CANIMASK2)) ||
+                   (*fc_reg(RINGO_CANIFLAG3) & *fc_reg(RINGO_CANIMASK3)) ||
+                   (*fc_reg(RINGO_CANIFLAG4) & *fc_reg(RINGO_CANIMASK4));
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Bus side
+ */
+
+int flexcan_on_bus(void)
+{
+    return !(fc.mcr & RINGO_CANMC_MDIS) && !fc_frozen() && !fc.busoff;
+}
+
+/* Data frame length without stuff bits, plus the intermission */
+uint32_t flexcan_frame_bits(const flexcan_frame_t *f)
+{
+    return (f->ext ? 64 : 44) + 8 * f->len + 3;
+}
+
+/* Lower wins, a standard frame wins over an extended one with the same base ID */
+uint64_t flexcan_arbitration(const flexcan_frame_t *f)
+{
+    if(f->ext)
+        return ((uint64_t)(f->id >> 18) << 19) | (1 << 18) | (f->id & 0x3FFFF);
+    return (uint64_t)f->id << 19;
+}
+
+static inline uint32_t fc_mid2id(uint32_t mid, int ext)
+{
+    return ext ? (mid & RINGO_CANMID_MASK_EXT) : (mid & RINGO_CANMID_MASK_STD) >> 18;
+}
+
+static void fc_mb2frame(can_msg_obj_t *mb, flexcan_frame_t *f)
+{
+    uint32_t            mcf = mb->canmcf;
+    uint32_t            dl = mb->canmdl;
+    uint32_t            dh = mb->canmdh;
+    int                 i;
+
+    f->ext = (mcf & MB_CNT_IDE) != 0;
+    f->id = fc_mid2id(mb->canmid, f->ext);
+    f->len = (mcf & MSG_BUF_DLC_MASK) >> MSG_BUF_DLC_SHIFT;
+    if(f->len > 8)
+        f->len = 8;
+    for(i = 0; i < 4; i++)
+    {
+        f->dat[i] = dl >> (24 - 8 * i);
+        f->dat[4 + i] = dh >> (24 - 8 * i);
+    }
+}
+
+/* The mailbox that wins the internal arbitration, -1 when none is pending */
+int flexcan_tx_next(flexcan_frame_t *f)
+{
+    uint32_t            ctrl = *fc_reg(RINGO_CANCTRL);
+    uint64_t            best = NEVER;
+    uint64_t            key;
+    flexcan_frame_t     cand;
+    int                 mbxid = -1;
+    uint32_t            n;
+
+    if(!flexcan_on_bus() || (ctrl & RINGO_CANCTRL_LOM))
+        return -1;
+    for(n = 0; n < fc_nmb() && n < FLEXCAN_NUM_MB; n++)
+    {
+        if(((fc_mb(n)->canmcf & MSG_BUF_CODE_MASK) >> MSG_BUF_CODE_SHIFT) != TRANS_CODE_TRANSMIT_ONCE)
+            continue;
+        if(ctrl & RINGO_CANCTRL_LBUF)
+        {
+            fc_mb2frame(fc_mb(n), f);
+            return n;
+        }
+        fc_mb2frame(fc_mb(n), &cand);
+        key = flexcan_arbitration(&cand);
+        if(fc.mcr & RINGO_CANMC_LPRIO_EN)
+            key |= (uint64_t)(fc_mb(n)->canmid >> RINGO_CANMCF_TPL_SHIFT) << 40;
+        if(key < best)
+        {
+            best = key;
+            mbxid = n;
+            *f = cand;
+        }
+    }
+    return mbxid;
+}
+
+static int fc_rx_match(uint32_t n, const flexcan_frame_t *f)
+{
+    can_msg_obj_t      *mb = fc_mb(n);
+    uint32_t            mask = *fc_reg(RINGO_CANRXIMR0 + 4 * n);
+    uint32_t            mbide = (mb->canmcf & MB_CNT_IDE) != 0;
+    uint32_t            mid = f->ext ? f->id : f->id << 18;
+
+    if(((*fc_reg(RINGO_CANCTRL2) & RINGO_CANCTRL2_EACEN) == 0 || (mask & RX_FIFO_FILTER_IDE)) && mbide != f->ext)
+        return 0;
+    if(!f->ext)
+        mask &= RINGO_CANMID_MASK_STD;
+    return ((mid ^ mb->canmid) & mask & RINGO_CANMID_MASK_EXT) == 0;
+}
+
+/*
+ * Move a frame into the first empty matching mailbox, or overwrite the last
+ * matching full one when there is none (IRMQ set).
+ */
+static void fc_store(const flexcan_frame_t *f, int skip)
+{
+    can_msg_obj_t      *mb;
+    uint32_t            code;
+    int                 last = -1;
+    uint32_t            n;
+    int                 i;
+
+    if(fc.mcr & RINGO_CANMC_FEN)
+    {
+        fprintf(stderr, "flexcan: the Rx FIFO is not modelled\n");
+        abort();
+    }
+    for(n = 0; n < fc_nmb() && n < FLEXCAN_NUM_MB; n++)
+    {
+        if((int)n == skip)
+            continue;
+        code = (fc_mb(n)->canmcf & MSG_BUF_CODE_MASK) >> MSG_BUF_CODE_SHIFT;
+        if(code != REC_CODE_EMPTY && code != REC_CODE_FULL && code != REC_CODE_OVERRUN)
+            continue;
+        if(!fc_rx_match(n, f))
+            continue;
+        last = n;
+        if(code == REC_CODE_EMPTY)
+            break;
+    }
+    if(last < 0)
+    {
+        flexcan_stats.unmatched++;
+        return;
+    }
+    mb = fc_mb(last);
+    code = (mb->canmcf & MSG_BUF_CODE_MASK) >> MSG_BUF_CODE_SHIFT;
+    if(code == REC_CODE_EMPTY)
+        code = REC_CODE_FULL;
+    else
+    {
+        code = REC_CODE_OVERRUN;
+        flexcan_stats.overruns++;
+    }
+    mb->canmid = f->ext ? f->id : f->id << 18;
+    mb->canmdl = mb->canmdh = 0;
+    for(i = 0; i < 4; i++)
+    {
+        mb->canmdl |= (uint32_t)f->dat[i] << (24 - 8 * i);
+        mb->canmdh |= (uint32_t)f->dat[4 + i] << (24 - 8 * i);
+    }
+    mb->canmcf = MB_CNT_CODE(code) | (f->ext ? MB_CNT_IDE | MB_CNT_SRR : 0) |
+                 MB_CNT_LENGTH(f->len) | MB_CNT_TIMESTAMP(fc_timer());
+    *fc_iflag(last) |= IFLAG_BUFnM(last % 32);
+    flexcan_stats.rx_frames++;
+}
+
+/* A frame from another node ended on the bus */
+void flexcan_rx(const flexcan_frame_t *f)
+{
+    uint32_t            ctrl = *fc_reg(RINGO_CANCTRL);
+
+    if(!flexcan_on_bus() || (ctrl & RINGO_CANCTRL_LPB))
+    {
+        flexcan_stats.missed++;
+        return;
+    }
+    fc_store(f, -1);
+    if(fc.rec > 127)
+        fc.rec = 120;
+    else if(fc.rec)
+        fc.rec--;
+}
+
+/*
+ * The frame of a mailbox ended on the bus. Returns 0 when the driver took
+ * the mailbox back while it was on the bus.
+ */
+int flexcan_tx_done(int mbxid)
+{
+    can_msg_obj_t      *mb = fc_mb(mbxid);
+    flexcan_frame_t     f;
+
+    if(((mb->canmcf & MSG_BUF_CODE_MASK) >> MSG_BUF_CODE_SHIFT) != TRANS_CODE_TRANSMIT_ONCE)
+        return 0;
+    fc_mb2frame(mb, &f);
+    mb->canmcf = (mb->canmcf & ~(MSG_BUF_CODE_MASK | 0xFFFF)) | MB_CNT_CODE(TRANS_CODE_NOT_READY) |
+                 MB_CNT_TIMESTAMP(fc_timer());
+    *fc_iflag(mbxid) |= IFLAG_BUFnM(mbxid % 32);
+    flexcan_stats.tx_frames++;
+    if(fc.tec)
+        fc.tec--;
+    if(!(fc.mcr & RINGO_CANMC_SRX_DIS))
+        fc_store(&f, mbxid);
+    return 1;
+}
+
+/*
+ * Faults
+ */
+
+/* Hold a mailbox BUSY, as while the FlexCAN moves a frame in, or release it */
+void flexcan_mb_busy(int mbxid, int busy)
+{
+    if(busy)
+        fc_mb(mbxid)->canmcf |= MB_CNT_CODE(REC_CODE_BUSY);
+    else
+        fc_mb(mbxid)->canmcf &= ~MB_CNT_CODE(REC_CODE_BUSY);
+}
+
+/* RINGO_CANMC_FRZACK: freeze is never acknowledged, RINGO_CANMC_SOFTRST: soft reset never completes */
+void flexcan_mcr_stuck(uint32_t bits)
+{
+    fc_mcr_stuck = bits;
+}
@@ -0,0 +1,82 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Register and mailbox model of one S32G FlexCAN, see flexcan_model.c.
+ */
+
+#ifndef __FLEXCAN_MODEL_H__
+#define __FLEXCAN_MODEL_H__
+
+#include <stdint.h>
+
+#define FLEXCAN_SPACE_PHYS          0x02090000  /* RINGO_CAN0_REG_BASE */
+#define FLEXCAN_SPACE_SIZE          0x4000
+#define FLEXCAN_NUM_MB              128
+
+/* Interrupt lines, the driver attaches them at irqsys, irqsys + 2 and irqsys + 3 */
+#define FLEXCAN_LINE_ESR            0           /* Bus-off, error, warnings and wakeup */
+#define FLEXCAN_LINE_MB0_7          1
+#define FLEXCAN_LINE_MB8_127        2
+
+typedef struct flexcan_frame {
+    uint32_t            id;                     /* 11 or 29 bit identifier */
+    uint8_t             ext;
+    uint8_t             len;
+    uint8_t             dat[8];
+} flexcan_frame_t;
+
+typedef struct flexcan_stats {
+    uint64_t            rx_frames;              /* Frames stored in a receive mailbox */
+    uint64_t            overruns;               /* ... overwriting an unread one (code OVERRUN) */
+    uint64_t            unmatched;              /* Frames no receive mailbox accepted */
+    uint64_t            missed;                 /* Frames on the bus while frozen, disabled or bus-off */
+    uint64_t            tx_frames;              /* Frames transmitted from a mailbox */
+    uint64_t            busoffs;
+    uint64_t            recoveries;
+} flexcan_stats_t;
+
+extern flexcan_stats_t flexcan_stats;
+
+/* Register side, through in32() and out32() */
+void flexcan_attach(void *space);
+uint32_t flexcan_in32(uint32_t offset);
+void flexcan_out32(uint32_t offset, uint32_t val);
+
+/* Bus side, called by the harness */
+void flexcan_advance(uint64_t now_ns);
+uint64_t flexcan_next_event(void);
+uint32_t flexcan_bit_ps(void);
+uint32_t flexcan_frame_bits(const flexcan_frame_t *f);
+uint64_t flexcan_arbitration(const flexcan_frame_t *f);
+int flexcan_on_bus(void);
+int flexcan_tx_next(flexcan_frame_t *f);
+int flexcan_tx_done(int mbxid);
+void flexcan_rx(const flexcan_frame_t *f);
+void flexcan_tx_error(uint32_t esr_bit);
+void flexcan_rx_error(uint32_t esr_bit);
+int flexcan_line(int line);
+
+/* Faults, for the driver to give up on */
+void flexcan_mb_busy(int mbxid, int busy);
+void flexcan_mcr_stuck(uint32_t bits);
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * The part of libcan the driver uses, and in place of the resource manager
+ * the client calls of the harness, see libcan.c.
+ */
+
+#ifndef __LIBCAN_H_INCLUDED
+#define __LIBCAN_H_INCLUDED
+
+#include <qnx_host.h>
+#include <devctl.h>
+
+#define CAN_CMD_CODE                0x54
+
+typedef enum {
+    CANDEV_MODE_IO,
+    CANDEV_MODE_RAW_FRAME
+} CANDEV_MODE;
+
+#define CANDEV_TYPE_RX              0
+#define CANDEV_TYPE_TX              1
+
+#define CAN_MSG_DATA_MAX            8
+#define CAN_MSG_MID_UNKNOWN         0xffffffff
+
+typedef struct can_msg_ext {
+    uint32_t            timestamp;
+    uint32_t            is_extended_mid;
+    uint32_t            is_remote_frame;
+} can_msg_ext;
+
+struct can_msg {
+    uint8_t             dat[CAN_MSG_DATA_MAX];
+    uint8_t             len;
+    uint32_t            mid;
+    can_msg_ext         ext;
+};
+
+typedef struct canmsg_entry {
+    struct can_msg      cmsg;
+    struct canmsg_entry *next;
+} canmsg_t;
+
+typedef struct canmsg_list {
+    canmsg_t           *head;
+    canmsg_t           *tail;
+    int                 cnt;
+} canmsg_list_t;
+
+typedef struct client_wait_queue {
+    int                 cnt;                /* Clients blocked on a read */
+} client_wait_queue_t;
+
+struct can_devctl_stats {
+    uint32_t            transmitted_frames;
+    uint32_t            received_frames;
+    uint32_t            missing_ack;
+    uint32_t            total_frame_errors;
+    uint32_t            stuff_errors;
+    uint32_t            form_errors;
+    uint32_t            dom_bit_recess_errors;
+    uint32_t            recess_bit_dom_errors;
+    uint32_t            parity_errors;
+    uint32_t            crc_errors;
+    uint32_t            hw_receive_overflows;
+    uint32_t            sw_receive_q_full;
+    uint32_t            error_warning_state_count;
+    uint32_t            error_passive_state_count;
+    uint32_t            bus_off_state_count;
+    uint32_t            bus_idle_count;
+    uint32_t            power_down_count;
+    uint32_t            wake_up_count;
+    uint32_t            rx_interrupts;
+    uint32_t            tx_interrupts;
+    uint32_t            total_interrupts;
+};
+typedef struct can_devctl_stats CAN_DEVCTL_STATS;
+
+struct can_devctl_error {
+    uint32_t            drvr1;
+    uint32_t            drvr2;
+    uint32_t            drvr3;
+    uint32_t            drvr4;
+    uint32_t            drvr5;
+    uint32_t            drvr6;
+};
+
+struct can_devctl_info {
+    char                description[64];
+    uint32_t            msgq_size;
+    uint32_t            waitq_size;
+    CANDEV_MODE         mode;
+    uint32_t            bit_rate;
+    uint32_t            bit_rate_prescaler;
+    uint32_t            sync_jump_width;
+    uint32_t            time_segment_1;
+    uint32_t            time_segment_2;
+    uint32_t            num_tx_mboxes;
+    uint32_t            num_rx_mboxes;
+    uint32_t            loopback_internal;
+    uint32_t            loopback_external;
+    uint32_t            autobus_on;
+    uint32_t            silent;
+};
+
+typedef union {
+    uint32_t                mid;
+    uint32_t                mfilter;
+    uint32_t                prio;
+    uint32_t                timestamp;
+    struct can_msg          canmsg;
+    struct can_devctl_error error;
+    struct can_devctl_stats stats;
+    struct can_devctl_info  info;
+} DCMD_DATA;
+
+#define CAN_DEVCTL_SET_MID              __DIOT(_DCMD_MISC, CAN_CMD_CODE + 1, uint32_t)
+#define CAN_DEVCTL_GET_MID              __DIOF(_DCMD_MISC, CAN_CMD_CODE + 2, uint32_t)
+#define CAN_DEVCTL_SET_MFILTER          __DIOT(_DCMD_MISC, CAN_CMD_CODE + 3, uint32_t)
+#define CAN_DEVCTL_GET_MFILTER          __DIOF(_DCMD_MISC, CAN_CMD_CODE + 4, uint32_t)
+#define CAN_DEVCTL_SET_PRIO             __DIOT(_DCMD_MISC, CAN_CMD_CODE + 5, uint32_t)
+#define CAN_DEVCTL_GET_PRIO             __DIOF(_DCMD_MISC, CAN_CMD_CODE + 6, uint32_t)
+#define CAN_DEVCTL_SET_TIMESTAMP        __DIOT(_DCMD_MISC, CAN_CMD_CODE + 7, uint32_t)
+#define CAN_DEVCTL_GET_TIMESTAMP        __DIOF(_DCMD_MISC, CAN_CMD_CODE + 8, uint32_t)
+#define CAN_DEVCTL_READ_CANMSG_EXT      __DIOF(_DCMD_MISC, CAN_CMD_CODE + 9, struct can_msg)
+#define CAN_DEVCTL_WRITE_CANMSG_EXT     __DIOT(_DCMD_MISC, CAN_CMD_CODE + 10, struct can_msg)
+#define CAN_DEVCTL_ERROR                __DIOF(_DCMD_MISC, CAN_CMD_CODE + 11, struct can_devctl_error)
+#define CAN_DEVCTL_DEBUG_INFO           __DION(_DCMD_MISC, CAN_CMD_CODE + 12)
+#define CAN_DEVCTL_GET_STATS            __DIOF(_DCMD_MISC, CAN_CMD_CODE + 13, struct can_devctl_stats)
+#define CAN_DEVCTL_GET_INFO             __DIOF(_DCMD_MISC, CAN_CMD_CODE + 14, struct can_devctl_info)
+#define CAN_DEVCTL_RX_FRAME_RAW_NOBLOCK __DIOF(_DCMD_MISC, CAN_CMD_CODE + 15, struct can_msg)
+#define CAN_DEVCTL_RX_FRAME_RAW_BLOCK   __DIOF(_DCMD_MISC, CAN_CMD_CODE + 16, struct can_msg)
+#define CAN_DEVCTL_TX_FRAME_RAW         __DIOT(_DCMD_MISC, CAN_CMD_CODE + 17, struct can_msg)
+
+typedef struct can_dev_init {
+    int                 devtype;
+    int                 can_unit;
+    int                 dev_unit;
+    uint32_t            msgq_size;
+    uint32_t            waitq_size;
+    CANDEV_MODE         mode;
+} CANDEV_INIT;
+
+typedef struct candev {
+    int                 devtype;
+    int                 can_unit;
+    int                 dev_unit;
+    canmsg_list_t      *free_queue;
+    canmsg_list_t      *msg_queue;
+    client_wait_queue_t *wait_client_queue;
+    struct sigevent     event;              /* Wakes the clients, libcan gets it as a pulse */
+    struct candev      *next;
+} CANDEV;
+
+typedef struct can_drvr_funcs {
+    void              (*transmit)(CANDEV *cdev);
+    int               (*devctl)(CANDEV *cdev, int dcmd, DCMD_DATA *data);
+} can_drvr_funcs_t;
+
+canmsg_t *canmsg_dequeue_element(canmsg_list_t *list);
+void canmsg_queue_element(canmsg_list_t *list, canmsg_t *msg);
+void can_resmgr_init(can_drvr_funcs_t *drvr_funcs);
+void can_resmgr_start(void);
+void can_resmgr_init_device(CANDEV *cdev, CANDEV_INIT *cinit);
+void can_resmgr_create_device(CANDEV *cdev);
+
+/*
+ * Client side, called by the harness with the driver threads idle. Reads
+ * and writes never block: a client that would block on an empty receive
+ * queue is counted in wait_client_queue with libcan_block(), and gets its
+ * frame from libcan_process() once the driver sends the device event.
+ */
+typedef void (*libcan_reply_t)(CANDEV *cdev, const struct can_msg *msg);
+
+CANDEV *libcan_device(int devtype, int dev_unit);
+int libcan_read(CANDEV *cdev, struct can_msg *msg);
+int libcan_write(CANDEV *cdev, const struct can_msg *msg);
+int libcan_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data);
+void libcan_block(CANDEV *cdev);
+int libcan_process(libcan_reply_t reply);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * libcan without the resource manager. The device queues behave as in
+ * libcan, the clients are the harness calling libcan_read(), libcan_write()
+ * and libcan_devctl() directly. Device events are pulses on a channel only
+ * the harness receives on, in libcan_process().
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hw/libcan.h>
+
+static can_drvr_funcs_t libcan_funcs;
+static CANDEV          *libcan_devs;
+static int              libcan_chid = -1;
+static int              libcan_coid = -1;
+
+canmsg_t *canmsg_dequeue_element(canmsg_list_t *list)
+{
+    canmsg_t           *msg = list->head;
+
+    if(msg)
+    {
+        list->head = msg->next;
+        if(!list->head)
+            list->tail = NULL;
+        list->cnt--;
+        msg->next = NULL;
+    }
+    return msg;
+}
+
+void canmsg_queue_element(canmsg_list_t *list, canmsg_t *msg)
+{
+    msg->next = NULL;
+    if(list->tail)
+        list->tail->next = msg;
+    else
+        list->head = msg;
+    list->tail = msg;
+    list->cnt++;
+}
+
+void can_resmgr_init(can_drvr_funcs_t *drvr_funcs)
+{
+    libcan_funcs = *drvr_funcs;
+    libcan_chid = sim_channel_create_external();
+    libcan_coid = ConnectAttach(0, 0, libcan_chid, _NTO_SIDE_CHANNEL, 0);
+    if(libcan_chid == -1 || libcan_coid == -1)
+    {
+        fprintf(stderr, "libcan: no channel\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* The harness takes over once the devices are created */
+void can_resmgr_start(void)
+{
+}
+
+void can_resmgr_init_device(CANDEV *cdev, CANDEV_INIT *cinit)
+{
+    canmsg_t           *msgs;
+    uint32_t            i;
+
+    cdev->devtype = cinit->devtype;
+    cdev->can_unit = cinit->can_unit;
+    cdev->dev_unit = cinit->dev_unit;
+    cdev->free_queue = calloc(1, sizeof(*cdev->free_queue));
+    cdev->msg_queue = calloc(1, sizeof(*cdev->msg_queue));
+    cdev->wait_client_queue = calloc(1, sizeof(*cdev->wait_client_queue));
+    msgs = calloc(cinit->msgq_size, sizeof(*msgs));
+    if(!cdev->free_queue || !cdev->msg_queue || !cdev->wait_client_queue || !msgs)
+    {
+        fprintf(stderr, "libcan: calloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for(i = 0; i < cinit->msgq_size; i++)
+        canmsg_queue_element(cdev->free_queue, &msgs[i]);
+    SIGEV_PULSE_INIT(&cdev->event, libcan_coid, 10, _PULSE_CODE_MINAVAIL, cdev);
+}
+
+void can_resmgr_create_device(CANDEV *cdev)
+{
+    cdev->next = libcan_devs;
+    libcan_devs = cdev;
+}
+
+CANDEV *libcan_device(int devtype, int dev_unit)
+{
+    CANDEV             *cdev;
+
+    for(cdev = libcan_devs; cdev; cdev = cdev->next)
+    {
+        if(cdev->devtype == devtype && cdev->dev_unit == dev_unit)
+            return cdev;
+    }
+    return NULL;
+}
+
+/* Take the oldest received frame, 0 when there is none */
+int libcan_read(CANDEV *cdev, struct can_msg *msg)
+{
+    canmsg_t           *rxmsg = canmsg_dequeue_element(cdev->msg_queue);
+
+    if(!rxmsg)
+        return 0;
+    *msg = rxmsg->cmsg;
+    canmsg_queue_element(cdev->free_queue, rxmsg);
+    return 1;
+}
+
+/* Queue a frame and let the driver start it, EAGAIN when the queue is full */
+int libcan_write(CANDEV *cdev, const struct can_msg *msg)
+{
+    canmsg_t           *txmsg = canmsg_dequeue_element(cdev->free_queue);
+
+    if(!txmsg)
+        return EAGAIN;
+    txmsg->cmsg = *msg;
+    canmsg_queue_element(cdev->msg_queue, txmsg);
+    libcan_funcs.transmit(cdev);
+    return EOK;
+}
+
+int libcan_devctl(CANDEV *cdev, int dcmd, DCMD_DATA *data)
+{
+    int                 status = libcan_funcs.devctl(cdev, dcmd, data);
+
+    if(status != EOK)
+        return status;
+    switch(dcmd)
+    {
+        case CAN_DEVCTL_TX_FRAME_RAW:
+            return libcan_write(cdev, &data->canmsg);
+        case CAN_DEVCTL_RX_FRAME_RAW_NOBLOCK:
+        case CAN_DEVCTL_RX_FRAME_RAW_BLOCK:
+            return libcan_read(cdev, &data->canmsg) ? EOK : EAGAIN;
+        default:
+            return EOK;
+    }
+}
+
+void libcan_block(CANDEV *cdev)
+{
+    cdev->wait_client_queue->cnt++;
+}
+
+/* Reply to the blocked clients of the devices whose events came in */
+int libcan_process(libcan_reply_t reply)
+{
+    struct _pulse       pulse;
+    struct can_msg      msg;
+    CANDEV             *cdev;
+    int                 n = 0;
+
+    while(sim_channel_pulse(libcan_chid, &pulse))
+    {
+        cdev = pulse.value.sival_ptr;
+        while(cdev->wait_client_queue->cnt && libcan_read(cdev, &msg))
+        {
+            cdev->wait_client_queue->cnt--;
+            reply(cdev, &msg);
+        }
+        n++;
+    }
+    return n;
+}
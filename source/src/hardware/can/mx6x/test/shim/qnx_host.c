@@ -0,0 +1,712 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Neutrino calls of the driver on a Linux host.
+ *
+ * The driver threads are real threads but only one of them runs at a time:
+ * each holds sim_lock while it runs and gives it up when it blocks in
+ * MsgReceivePulse() or nanosleep(). The harness holds sim_lock as well and
+ * lets the driver threads run until all are blocked in sim_wait_idle(), so
+ * the ISR and the threads never run concurrently and a run is repeatable.
+ *
+ * Time is virtual: nanosleep() and TimerTimeout() wait for the harness to
+ * move the clock with sim_set_time(). ClockCycles() is the host cycle
+ * counter plus the virtual time, so differences taken within a call are
+ * real host cycles and differences across sleeps follow the virtual clock.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "qnx_host.h"
+#include "../flexcan_model.h"
+
+#define SIM_MAX_THREADS     16
+#define SIM_MAX_CHANNELS    16
+#define SIM_MAX_COIDS       32
+#define SIM_MAX_INTRS       8
+#define SIM_PULSE_RING      256
+#define SIM_COID_BASE       0x100
+#define SIM_NEVER           UINT64_MAX
+#define SIM_SPIN_ABORT      (1 << 20)   /* Reads of a spin before giving up */
+#define SIM_INTR_LOOPS      10000       /* Handler calls of one sim_intr() before it is a storm */
+
+typedef struct sim_thread {
+    pthread_cond_t      cv;
+    int                 blocked;
+    int                 woken;
+    uint64_t            deadline;       /* Virtual time to wake up, SIM_NEVER when none */
+    uint64_t            timeout;        /* TimerTimeout() of the next MsgReceivePulse() */
+    int                 timeout_set;
+    void             *(*func)(void *);
+    void               *arg;
+} sim_thread_t;
+
+typedef struct sim_channel {
+    int                 used;
+    struct _pulse       ring[SIM_PULSE_RING];
+    unsigned            head, tail;
+    sim_thread_t       *waiter;
+} sim_channel_t;
+
+typedef struct sim_intr {
+    int                 vector;
+    const struct sigevent *(*handler)(void *, int);
+    void               *area;
+    struct sigevent     event;          /* InterruptAttachEvent() */
+    int                 masked;
+} sim_intr_t;
+
+static pthread_mutex_t  sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   sim_idle = PTHREAD_COND_INITIALIZER;
+static int              sim_running;
+static uint64_t         sim_time;
+static sim_thread_t     sim_threads[SIM_MAX_THREADS];
+static int              sim_nthreads;
+static sim_channel_t    sim_channels[SIM_MAX_CHANNELS];
+static int              sim_coids[SIM_MAX_COIDS];
+static sim_intr_t       sim_intrs[SIM_MAX_INTRS];
+static int              sim_nintrs;
+static int              sim_in_isr;
+static uint64_t         sim_cps;
+static uint8_t         *sim_space;
+
+static __thread sim_thread_t *sim_self;
+
+/* Polling of a status register by the current thread, see in32() */
+static __thread uintptr_t sim_poll_port = -1;
+static __thread uint32_t  sim_poll_val;
+static __thread uint32_t  sim_poll_streak;
+static __thread int       sim_poll_slept;
+
+sim_stats_t             sim_stats;
+
+struct mdriver_entry    sim_syspage_mdriver[1];
+struct strings_entry    sim_syspage_strings;
+struct qtime_entry      sim_syspage_qtime;
+static struct syspage_entry sim_syspage;
+struct syspage_entry   *_syspage_ptr = &sim_syspage;
+
+int __real_pthread_create(pthread_t *tid, const pthread_attr_t *attr, void *(*func)(void *), void *arg);
+int __real_nanosleep(const struct timespec *req, struct timespec *rem);
+
+static inline uint64_t sim_counter(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t    cnt;
+
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(cnt));
+    return cnt;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* Counter rate against CLOCK_MONOTONIC, and the device register space below 4G */
+__attribute__((constructor)) static void sim_init(void)
+{
+    struct timespec     t0, t1, d = { 0, 20000000 };
+    uint64_t            c0, c1, ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    c0 = sim_counter();
+    __real_nanosleep(&d, NULL);
+    c1 = sim_counter();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns = (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+    sim_cps = (c1 - c0) * 1000000000ULL / ns;
+    sim_syspage_qtime.cycles_per_sec = sim_cps;
+
+    // set_port32() takes the register address as an unsigned
+    sim_space = mmap((void *)0x40000000, FLEXCAN_SPACE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+#ifdef MAP_32BIT
+    if(sim_space == MAP_FAILED)
+        sim_space = mmap(NULL, FLEXCAN_SPACE_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+#endif
+    if(sim_space == MAP_FAILED || (uintptr_t)sim_space + FLEXCAN_SPACE_SIZE > UINT32_MAX)
+    {
+        fprintf(stderr, "sim: no device space below 4G\n");
+        exit(EXIT_FAILURE);
+    }
+    flexcan_attach(sim_space);
+}
+
+uint64_t ClockCycles(void)
+{
+    return sim_counter() + sim_time / 1000000000ULL * sim_cps + sim_time % 1000000000ULL * sim_cps / 1000000000ULL;
+}
+
+int ThreadCtl(int cmd, void *data)
+{
+    (void)cmd; (void)data;
+    return 0;
+}
+
+int nanospin_ns(unsigned long nsec)
+{
+    (void)nsec;
+    return 0;
+}
+
+/*
+ * Scheduling, everything below is called with sim_lock held
+ */
+
+static void sim_block(sim_thread_t *t)
+{
+    t->woken = 0;
+    t->blocked = 1;
+    if(--sim_running == 0)
+        pthread_cond_signal(&sim_idle);
+    while(!t->woken)
+        pthread_cond_wait(&t->cv, &sim_lock);
+    t->blocked = 0;
+}
+
+static void sim_wake(sim_thread_t *t)
+{
+    if(t->blocked && !t->woken)
+    {
+        t->woken = 1;
+        sim_running++;
+        pthread_cond_signal(&t->cv);
+    }
+}
+
+void sim_wait_idle(void)
+{
+    while(sim_running)
+        pthread_cond_wait(&sim_idle, &sim_lock);
+}
+
+uint64_t sim_now(void)
+{
+    return sim_time;
+}
+
+uint64_t sim_next_wakeup(void)
+{
+    uint64_t            next = SIM_NEVER;
+    int                 i;
+
+    for(i = 0; i < sim_nthreads; i++)
+    {
+        if(sim_threads[i].blocked && sim_threads[i].deadline < next)
+            next = sim_threads[i].deadline;
+    }
+    return next;
+}
+
+void sim_set_time(uint64_t ns)
+{
+    int                 i, woken;
+
+    if(ns > sim_time)
+        sim_time = ns;
+    do {
+        woken = 0;
+        for(i = 0; i < sim_nthreads; i++)
+        {
+            if(sim_threads[i].blocked && !sim_threads[i].woken && sim_threads[i].deadline <= sim_time)
+            {
+                sim_wake(&sim_threads[i]);
+                woken++;
+            }
+        }
+        sim_wait_idle();
+    } while(woken);
+}
+
+void sim_start(void)
+{
+    pthread_mutex_lock(&sim_lock);
+}
+
+static void *sim_thread_start(void *arg)
+{
+    sim_thread_t       *t = arg;
+
+    pthread_mutex_lock(&sim_lock);
+    sim_self = t;
+    t->func(t->arg);
+    if(--sim_running == 0)
+        pthread_cond_signal(&sim_idle);
+    pthread_mutex_unlock(&sim_lock);
+    return NULL;
+}
+
+/* Attributes (priorities, runmasks) do not matter, only one thread runs */
+int __wrap_pthread_create(pthread_t *tid, const pthread_attr_t *attr, void *(*func)(void *), void *arg)
+{
+    sim_thread_t       *t;
+    pthread_t           id;
+    int                 status;
+
+    (void)attr;
+    if(sim_nthreads == SIM_MAX_THREADS)
+        return EAGAIN;
+    t = &sim_threads[sim_nthreads++];
+    pthread_cond_init(&t->cv, NULL);
+    t->deadline = SIM_NEVER;
+    t->func = func;
+    t->arg = arg;
+    sim_running++;
+    if((status = __real_pthread_create(&id, NULL, sim_thread_start, t)) != 0)
+    {
+        sim_running--;
+        sim_nthreads--;
+        return status;
+    }
+    pthread_detach(id);
+    if(tid)
+        *tid = id;
+    return 0;
+}
+
+int __wrap_nanosleep(const struct timespec *req, struct timespec *rem)
+{
+    sim_thread_t       *t = sim_self;
+
+    if(!t)
+        return __real_nanosleep(req, rem);
+
+    sim_stats.nsleeps++;
+    sim_poll_slept = 1;
+    t->deadline = sim_time + req->tv_sec * 1000000000ULL + req->tv_nsec;
+    while(sim_time < t->deadline)
+        sim_block(t);
+    t->deadline = SIM_NEVER;
+    if(rem)
+        memset(rem, 0, sizeof(*rem));
+    return 0;
+}
+
+/*
+ * Channels and pulses
+ */
+
+static sim_channel_t *sim_channel(int chid)
+{
+    if(chid < 1 || chid > SIM_MAX_CHANNELS || !sim_channels[chid - 1].used)
+        return NULL;
+    return &sim_channels[chid - 1];
+}
+
+int ChannelCreate(unsigned flags)
+{
+    int                 i;
+
+    (void)flags;
+    for(i = 0; i < SIM_MAX_CHANNELS; i++)
+    {
+        if(!sim_channels[i].used)
+        {
+            memset(&sim_channels[i], 0, sizeof(sim_channels[i]));
+            sim_channels[i].used = 1;
+            return i + 1;
+        }
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+int ChannelDestroy(int chid)
+{
+    sim_channel_t      *ch = sim_channel(chid);
+
+    if(!ch)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    ch->used = 0;
+    return 0;
+}
+
+int sim_channel_create_external(void)
+{
+    return ChannelCreate(0);
+}
+
+/* Connections of other processes (the rx ring client) go to a channel of this one */
+int ConnectAttach(uint32_t nd, pid_t pid, int chid, unsigned index, int flags)
+{
+    int                 i;
+
+    (void)nd; (void)pid; (void)index; (void)flags;
+    if(!sim_channel(chid))
+    {
+        errno = ESRCH;
+        return -1;
+    }
+    for(i = 0; i < SIM_MAX_COIDS; i++)
+    {
+        if(!sim_coids[i])
+        {
+            sim_coids[i] = chid;
+            return SIM_COID_BASE + i;
+        }
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+int ConnectDetach(int coid)
+{
+    if(coid < SIM_COID_BASE || coid >= SIM_COID_BASE + SIM_MAX_COIDS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    sim_coids[coid - SIM_COID_BASE] = 0;
+    return 0;
+}
+
+int MsgSendPulsePtr(int coid, int priority, int code, void *value)
+{
+    sim_channel_t      *ch = NULL;
+    struct _pulse      *p;
+
+    (void)priority;
+    if(coid >= SIM_COID_BASE && coid < SIM_COID_BASE + SIM_MAX_COIDS)
+        ch = sim_channel(sim_coids[coid - SIM_COID_BASE]);
+    if(!ch)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if(ch->head - ch->tail == SIM_PULSE_RING)
+    {
+        fprintf(stderr, "sim: pulse queue of channel %d overflowed\n", (int)(ch - sim_channels) + 1);
+        abort();
+    }
+    p = &ch->ring[ch->head++ % SIM_PULSE_RING];
+    memset(p, 0, sizeof(*p));
+    p->code = code;
+    p->value.sival_ptr = value;
+    if(ch->waiter)
+        sim_wake(ch->waiter);
+    return 0;
+}
+
+int MsgSendPulse(int coid, int priority, int code, int value)
+{
+    return MsgSendPulsePtr(coid, priority, code, (void *)(intptr_t)value);
+}
+
+int sim_channel_pulse(int chid, struct _pulse *pulse)
+{
+    sim_channel_t      *ch = sim_channel(chid);
+
+    if(!ch || ch->head == ch->tail)
+        return 0;
+    *pulse = ch->ring[ch->tail++ % SIM_PULSE_RING];
+    return 1;
+}
+
+int TimerTimeout(clockid_t id, int flags, const struct sigevent *notify, const uint64_t *ntime, uint64_t *otime)
+{
+    sim_thread_t       *t = sim_self;
+
+    (void)id; (void)notify; (void)otime;
+    if(!t || !(flags & _NTO_TIMEOUT_RECEIVE))
+        return 0;
+    t->timeout_set = (ntime != NULL);
+    if(ntime)
+        t->timeout = sim_time + *ntime;
+    return 0;
+}
+
+int MsgReceivePulse(int chid, void *pulse, size_t bytes, void *info)
+{
+    sim_thread_t       *t = sim_self;
+    sim_channel_t      *ch = sim_channel(chid);
+    int                 status = -1;
+
+    (void)bytes; (void)info;
+    if(!t || !ch)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    for(;;)
+    {
+        if(sim_channel_pulse(chid, pulse))
+        {
+            status = 0;
+            break;
+        }
+        if(t->timeout_set && sim_time >= t->timeout)
+        {
+            errno = ETIMEDOUT;
+            break;
+        }
+        ch->waiter = t;
+        t->deadline = t->timeout_set ? t->timeout : SIM_NEVER;
+        sim_block(t);
+        ch->waiter = NULL;
+        t->deadline = SIM_NEVER;
+    }
+    t->timeout_set = 0;
+    return status;
+}
+
+void sim_deliver(const struct sigevent *event)
+{
+    if(event && event->sigev_notify == SIGEV_PULSE)
+        MsgSendPulsePtr(event->sigev_coid, event->sigev_priority, event->sigev_code, event->sigev_value.sival_ptr);
+}
+
+/*
+ * Interrupts
+ */
+
+int InterruptAttach(int intr, const struct sigevent *(*handler)(void *, int), const void *area, int size, unsigned flags)
+{
+    sim_intr_t         *r;
+
+    (void)size; (void)flags;
+    if(sim_nintrs == SIM_MAX_INTRS)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    r = &sim_intrs[sim_nintrs];
+    r->vector = intr;
+    r->handler = handler;
+    r->area = (void *)area;
+    return sim_nintrs++;
+}
+
+int InterruptAttachEvent(int intr, const struct sigevent *event, unsigned flags)
+{
+    sim_intr_t         *r;
+
+    (void)flags;
+    if(sim_nintrs == SIM_MAX_INTRS)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    r = &sim_intrs[sim_nintrs];
+    r->vector = intr;
+    r->event = *event;
+    return sim_nintrs++;
+}
+
+int InterruptMask(int intr, int id)
+{
+    (void)intr;
+    if(id < 0 || id >= sim_nintrs)
+        return -1;
+    return ++sim_intrs[id].masked;
+}
+
+int InterruptUnmask(int intr, int id)
+{
+    (void)intr;
+    if(id < 0 || id >= sim_nintrs)
+        return -1;
+    if(sim_intrs[id].masked)
+        sim_intrs[id].masked--;
+    return sim_intrs[id].masked;
+}
+
+/* Only one thread runs at a time, there is nothing to exclude */
+void InterruptLock(intrspin_t *spin)
+{
+    (void)spin;
+}
+
+void InterruptUnlock(intrspin_t *spin)
+{
+    (void)spin;
+}
+
+/*
+ * Call the handlers of the asserted vectors until none is asserted, like
+ * the kernel does for a level triggered line. Returns the handler calls.
+ */
+int sim_intr(int (*asserted)(int vector))
+{
+    const struct sigevent *event;
+    sim_intr_t         *r;
+    uint64_t            start;
+    int                 i, calls = 0, pass;
+
+    do {
+        pass = 0;
+        for(i = 0; i < sim_nintrs; i++)
+        {
+            r = &sim_intrs[i];
+            if(r->masked || !asserted(r->vector))
+                continue;
+            pass++;
+            if(!r->handler)
+            {
+                // The interrupt thread unmasks once it handled the event
+                r->masked++;
+                sim_deliver(&r->event);
+                continue;
+            }
+            sim_in_isr = 1;
+            start = sim_counter();
+            event = r->handler(r->area, i);
+            sim_stats.isr_cycles += sim_counter() - start;
+            sim_stats.isr_calls++;
+            sim_in_isr = 0;
+            sim_deliver(event);
+        }
+        calls += pass;
+        if(calls > SIM_INTR_LOOPS)
+        {
+            fprintf(stderr, "sim: interrupt storm, the handlers do not clear the interrupt sources\n");
+            abort();
+        }
+    } while(pass);
+
+    return calls;
+}
+
+/*
+ * Register access
+ */
+
+uintptr_t mmap_device_io(size_t len, uint64_t io)
+{
+    if(io < FLEXCAN_SPACE_PHYS || io + len > FLEXCAN_SPACE_PHYS + FLEXCAN_SPACE_SIZE)
+    {
+        errno = ENXIO;
+        return MAP_DEVICE_FAILED;
+    }
+    return (uintptr_t)sim_space + (io - FLEXCAN_SPACE_PHYS);
+}
+
+void *mmap_device_memory(void *addr, size_t len, int prot, int flags, uint64_t physical)
+{
+    (void)addr; (void)prot; (void)flags;
+    if(physical < FLEXCAN_SPACE_PHYS || physical + len > FLEXCAN_SPACE_PHYS + FLEXCAN_SPACE_SIZE)
+    {
+        errno = ENXIO;
+        return MAP_FAILED;
+    }
+    return sim_space + (physical - FLEXCAN_SPACE_PHYS);
+}
+
+static void sim_poll_count(sim_poll_t *polls, uint32_t offset)
+{
+    int                 i;
+
+    for(i = 0; i < SIM_POLL_MAX; i++)
+    {
+        if(polls[i].count && polls[i].offset == offset)
+            break;
+        if(!polls[i].count)
+        {
+            polls[i].offset = offset;
+            break;
+        }
+    }
+    if(i < SIM_POLL_MAX)
+        polls[i].count++;
+}
+
+/*
+ * A read returning what the previous read of the same register returned,
+ * with no write or sleep of the thread in between, is a busy poll. After
+ * SIM_SPIN_LIMIT such reads the register counts as spun on. Repeated reads
+ * separated by a sleep count as a sleeping poll instead.
+ */
+uint32_t in32(uintptr_t port)
+{
+    uint32_t            offset = port - (uintptr_t)sim_space;
+    uint32_t            val = flexcan_in32(offset);
+
+    if(sim_in_isr)
+        sim_stats.isr_regs++;
+    if(port == sim_poll_port && val == sim_poll_val)
+    {
+        if(sim_poll_slept)
+        {
+            sim_poll_count(sim_stats.sleep, offset);
+            sim_poll_streak = 0;
+        }
+        else if(++sim_poll_streak == SIM_SPIN_LIMIT)
+            sim_poll_count(sim_stats.spin, offset);
+        else if(sim_poll_streak == SIM_SPIN_ABORT)
+        {
+            fprintf(stderr, "sim: spinning on register 0x%x = 0x%08x\n", offset, val);
+            abort();
+        }
+    }
+    else
+        sim_poll_streak = 0;
+    sim_poll_port = port;
+    sim_poll_val = val;
+    sim_poll_slept = 0;
+    return val;
+}
+
+void out32(uintptr_t port, uint32_t val)
+{
+    if(sim_in_isr)
+        sim_stats.isr_regs++;
+    sim_poll_port = -1;
+    flexcan_out32(port - (uintptr_t)sim_space, val);
+}
+
+/*
+ * No hwinfo section, units are named ringocan0 or default
+ */
+
+unsigned hwi_find_bus(const char *bus, unsigned unit)
+{
+    (void)bus; (void)unit;
+    return HWI_NULL_OFF;
+}
+
+void hwiattr_get_can(unsigned off, hwiattr_can_t *attr)
+{
+    (void)off;
+    memset(attr, 0, sizeof(*attr));
+}
+
+unsigned hwitag_find_ivec(unsigned off, unsigned *instance)
+{
+    (void)off; (void)instance;
+    return HWI_NULL_OFF;
+}
+
+hwi_tag *hwi_tag_find(unsigned off, const char *name, unsigned *instance)
+{
+    (void)off; (void)name; (void)instance;
+    return NULL;
+}
@@ -0,0 +1,202 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Just enough of the QNX interfaces to run the whole FlexCAN driver on a
+ * Linux host against the register model in flexcan_model.c. in32() and
+ * out32() go to the model, channels, pulses and sleeps run on a virtual
+ * clock, see qnx_host.c.
+ */
+
+#ifndef __QNX_HOST_H__
+#define __QNX_HOST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+
+#define EOK                         0
+
+typedef uint64_t    paddr_t;
+
+/*
+ * QNX events. The glibc struct sigevent has no pulse fields, the driver
+ * gets this one instead. System headers declaring the glibc one are all
+ * included above.
+ */
+struct qnx_sigevent {
+    int                 sigev_notify;
+    int                 sigev_coid;
+    int                 sigev_priority;
+    int                 sigev_code;
+    union sigval        sigev_value;
+};
+#define sigevent                    qnx_sigevent
+
+#define SIGEV_PULSE                 4
+#define SIGEV_PULSE_INIT(e, coid, prio, code, val) \
+    ((e)->sigev_notify = SIGEV_PULSE, (e)->sigev_coid = (coid), (e)->sigev_priority = (prio), \
+     (e)->sigev_code = (code), (e)->sigev_value.sival_ptr = (void *)(intptr_t)(val))
+
+struct _pulse {
+    uint16_t            type;
+    uint16_t            subtype;
+    int8_t              code;
+    uint8_t             zero[3];
+    union sigval        value;
+    int32_t             scoid;
+};
+
+/* Neutrino */
+#define _NTO_INTR_FLAGS_END         0x01
+#define _NTO_INTR_FLAGS_TRK_MSK     0x04
+#define _NTO_TCTL_IO                14
+#define _NTO_TCTL_IO_PRIV           25
+#define _NTO_TCTL_RUNMASK           4
+#define _NTO_CHF_DISCONNECT         0x0004
+#define _NTO_SIDE_CHANNEL           0x40000000
+#define _NTO_TIMEOUT_RECEIVE        (1 << 2)
+#define _NTO_COF_CLOEXEC            0
+#define _PULSE_CODE_MINAVAIL        0
+
+typedef struct {
+    volatile unsigned   value;
+} intrspin_t;
+
+uint64_t ClockCycles(void);
+int ThreadCtl(int cmd, void *data);
+int InterruptAttach(int intr, const struct sigevent *(*handler)(void *, int), const void *area, int size, unsigned flags);
+int InterruptAttachEvent(int intr, const struct sigevent *event, unsigned flags);
+int InterruptMask(int intr, int id);
+int InterruptUnmask(int intr, int id);
+void InterruptLock(intrspin_t *spin);
+void InterruptUnlock(intrspin_t *spin);
+int ChannelCreate(unsigned flags);
+int ChannelDestroy(int chid);
+int ConnectAttach(uint32_t nd, pid_t pid, int chid, unsigned index, int flags);
+int ConnectDetach(int coid);
+int MsgReceivePulse(int chid, void *pulse, size_t bytes, void *info);
+int MsgSendPulse(int coid, int priority, int code, int value);
+int MsgSendPulsePtr(int coid, int priority, int code, void *value);
+int TimerTimeout(clockid_t id, int flags, const struct sigevent *notify, const uint64_t *ntime, uint64_t *otime);
+int nanospin_ns(unsigned long nsec);
+
+static inline void __cpu_membarrier(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+/* Registers go to the FlexCAN model, mailbox memory is plain memory */
+uint32_t in32(uintptr_t port);
+void out32(uintptr_t port, uint32_t val);
+uintptr_t mmap_device_io(size_t len, uint64_t io);
+void *mmap_device_memory(void *addr, size_t len, int prot, int flags, uint64_t physical);
+#define MAP_DEVICE_FAILED           ((uintptr_t)-1)
+#define PROT_NOCACHE                0
+
+/* atomic.h */
+static inline void atomic_set(volatile unsigned *loc, unsigned bits) { __atomic_fetch_or(loc, bits, __ATOMIC_SEQ_CST); }
+static inline void atomic_clr(volatile unsigned *loc, unsigned bits) { __atomic_fetch_and(loc, ~bits, __ATOMIC_SEQ_CST); }
+static inline unsigned atomic_set_value(volatile unsigned *loc, unsigned bits) { return __atomic_fetch_or(loc, bits, __ATOMIC_SEQ_CST); }
+static inline unsigned atomic_clr_value(volatile unsigned *loc, unsigned bits) { return __atomic_fetch_and(loc, ~bits, __ATOMIC_SEQ_CST); }
+static inline void atomic_add(volatile unsigned *loc, unsigned incr) { __atomic_fetch_add(loc, incr, __ATOMIC_SEQ_CST); }
+static inline unsigned atomic_add_value(volatile unsigned *loc, unsigned incr) { return __atomic_fetch_add(loc, incr, __ATOMIC_SEQ_CST); }
+static inline void atomic_sub(volatile unsigned *loc, unsigned decr) { __atomic_fetch_sub(loc, decr, __ATOMIC_SEQ_CST); }
+
+/* malloc.h */
+#define _smalloc(size)              malloc(size)
+#define _sfree(ptr, size)           free(ptr)
+
+/* gulliver.h */
+#define ENDIAN_SWAP32(p)            (*(p) = __builtin_bswap32(*(p)))
+
+/* devctl.h */
+#define _DCMD_MISC                  0x05
+#define __DIOF(class, cmd, data)    ((sizeof(data) << 16) + ((class) << 8) + (cmd) + 0x40000000)
+#define __DIOT(class, cmd, data)    ((sizeof(data) << 16) + ((class) << 8) + (cmd) + 0x80000000)
+#define __DIOTF(class, cmd, data)   ((sizeof(data) << 16) + ((class) << 8) + (cmd) + 0xC0000000)
+#define __DION(class, cmd)          (((class) << 8) + (cmd))
+
+/* sys/syspage.h, an empty mini-driver list */
+struct mdriver_entry {
+    uint32_t            intr;
+    uint32_t            name;
+    uint32_t            data_size;
+    paddr_t             data_paddr;
+};
+struct strings_entry { char data[4]; };
+struct qtime_entry { uint64_t cycles_per_sec; };
+struct syspage_entry { struct { uint16_t entry_size; } mdriver; };
+extern struct syspage_entry *_syspage_ptr;
+extern struct mdriver_entry sim_syspage_mdriver[1];
+extern struct strings_entry sim_syspage_strings;
+extern struct qtime_entry sim_syspage_qtime;
+#define SYSPAGE_ENTRY(entry)        (&sim_syspage_##entry)
+
+/* hw/sysinfo.h and drvr/hwinfo.h, no hwinfo section */
+#define HWI_ITEM_BUS_CAN            "can"
+#define HWI_NULL_OFF                0xffffffff
+#define HWI_TAG_NAME_location       "location"
+typedef struct { struct { struct { uint64_t base; } location; int num_irq; } common; int num_memaddr; } hwiattr_can_t;
+typedef union { struct { uint64_t base; } location; } hwi_tag;
+unsigned hwi_find_bus(const char *bus, unsigned unit);
+void hwiattr_get_can(unsigned off, hwiattr_can_t *attr);
+unsigned hwitag_find_ivec(unsigned off, unsigned *instance);
+hwi_tag *hwi_tag_find(unsigned off, const char *name, unsigned *instance);
+
+/*
+ * Harness side. The virtual clock runs in ns. The driver threads run one at
+ * a time, and only while the harness waits in sim_wait_idle(); sim_start()
+ * is called before the driver's main().
+ */
+void sim_start(void);
+void sim_wait_idle(void);
+uint64_t sim_now(void);
+void sim_set_time(uint64_t ns);
+uint64_t sim_next_wakeup(void);
+int sim_channel_create_external(void);
+int sim_channel_pulse(int chid, struct _pulse *pulse);
+void sim_deliver(const struct sigevent *event);
+int sim_intr(int (*asserted)(int vector));
+
+/* Status register polling seen by in32() */
+#define SIM_SPIN_LIMIT              16      /* Reads of an unchanged register without a sleep that make a spin */
+#define SIM_POLL_MAX                8
+
+typedef struct {
+    uint32_t            offset;             /* Register polled */
+    uint32_t            count;              /* Spins, or reads after a sleep */
+} sim_poll_t;
+
+typedef struct {
+    sim_poll_t          spin[SIM_POLL_MAX];
+    sim_poll_t          sleep[SIM_POLL_MAX];
+    uint32_t            nsleeps;            /* nanosleep() calls of driver threads */
+    uint64_t            isr_regs;           /* in32()/out32() calls of the ISR */
+    uint64_t            isr_calls;
+    uint64_t            isr_cycles;         /* ClockCycles() around the handler, as the kernel sees it */
+} sim_stats_t;
+
+extern sim_stats_t sim_stats;
+
+#endif
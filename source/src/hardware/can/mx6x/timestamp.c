@@ -0,0 +1,136 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * 64 bit receive timestamps.
+ *
+ * Mailboxes stamp frames with the 16 bit free running timer, which counts
+ * nominal bit times and wraps every 65536 bits (65 ms at 1 Mbit/s). Each
+ * ISR pass samples the timer together with ClockCycles(); the age of a
+ * frame is the signed 16 bit difference to that sample, so frames up to
+ * half a wrap old (or stamped while the pass runs) map onto the
+ * ClockCycles() nanosecond timebase shared by all units.
+ *
+ * On the S32G the mailboxes can also capture a 32 bit high resolution
+ * timestamp from an external timebase (-H <Hz>). It is extended to 64 bits
+ * by picking the value nearest to the tick count expected from the
+ * ClockCycles() time elapsed since the previous frame, which also accounts
+ * for wraps missed while the bus was idle.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <hw/inout.h>
+#include <sys/neutrino.h>
+#include <sys/syspage.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+/* Convert ClockCycles() to nanoseconds without overflowing */
+static inline uint64_t can_cycles2ns(CANDEV_RINGO_INFO *devinfo, uint64_t cycles)
+{
+    return (cycles / devinfo->cycles_per_sec) * 1000000000ULL +
+           (cycles % devinfo->cycles_per_sec) * 1000000000ULL / devinfo->cycles_per_sec;
+}
+
+/* Set up the timestamp conversion for the bit timing, before interrupts are attached */
+void can_timestamp_init(CANDEV_RINGO_INFO *devinfo, CANDEV_RINGO_INIT *devinit)
+{
+    devinfo->cycles_per_sec = SYSPAGE_ENTRY(qtime)->cycles_per_sec;
+    devinfo->bit_ps = (uint64_t)1000000000000ULL * (devinit->br_presdiv + 1) *
+                      (devinit->br_propseg + devinit->br_pseg1 + devinit->br_pseg2 + 4) / devinit->clk;
+    devinfo->hrts_ns = 0;
+}
+
+/* Sample the free running timer against ClockCycles(). Called from the ISR */
+void can_timestamp_sync(CANDEV_RINGO_INFO *devinfo)
+{
+    devinfo->ts_timer = in32(devinfo->base + RINGO_CANTIMER) & 0x0000FFFF;
+    devinfo->ts_cycles = ClockCycles();
+    devinfo->ts_ns = can_cycles2ns(devinfo, devinfo->ts_cycles);
+}
+
+#if defined(S32G_FLEXCAN)
+/* Index of a mailbox from its message buffer, the inverse of can_mb() */
+static inline uint32_t can_mb_index(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb)
+{
+    uintptr_t       off = (uintptr_t)mb - (uintptr_t)devinfo->canmsg;
+
+    return (off / RINGO_CAN_MB_REGION_SIZE) * devinfo->mbs_per_region +
+           (off % RINGO_CAN_MB_REGION_SIZE) / devinfo->mbsize;
+}
+
+/* Convert high resolution timebase ticks to nanoseconds, ticks may be negative */
+static inline int64_t can_hrts2ns(CANDEV_RINGO_INFO *devinfo, int64_t ticks)
+{
+    return (ticks / devinfo->hrts_freq) * 1000000000LL +
+           (ticks % devinfo->hrts_freq) * 1000000000LL / devinfo->hrts_freq;
+}
+
+/* Extend a 32 bit high resolution timestamp */
+static uint64_t can_hrts_extend(CANDEV_RINGO_INFO *devinfo, uint32_t hrts)
+{
+    uint64_t        elapsed;
+    int64_t         expected;
+
+    if(devinfo->hrts_ns == 0)
+    {
+        // First frame: tick 0 of the extended count is its reception
+        devinfo->hrts_base_ns = devinfo->ts_ns;
+        devinfo->hrts_ticks = 0;
+    }
+    else
+    {
+        elapsed = devinfo->ts_ns - devinfo->hrts_ns;
+        expected = devinfo->hrts_ticks + (elapsed / 1000000000ULL) * devinfo->hrts_freq +
+                   (elapsed % 1000000000ULL) * devinfo->hrts_freq / 1000000000ULL;
+        // Mailboxes are drained by index rather than by age, the nearest value may be the older one
+        devinfo->hrts_ticks = expected + (int32_t)(hrts - (uint32_t)expected);
+    }
+    devinfo->hrts_ns = devinfo->ts_ns;
+
+    return devinfo->hrts_base_ns + can_hrts2ns(devinfo, devinfo->hrts_ticks);
+}
+#endif
+
+/* Receive time of a frame read from a mailbox or Rx FIFO element, in ns */
+uint64_t can_timestamp(CANDEV_RINGO_INFO *devinfo, can_msg_obj_t *mb, uint32_t ctrl)
+{
+    int16_t         age;
+
+#if defined(S32G_FLEXCAN)
+    // High resolution timestamps are only used with mailbox reception
+    if(devinfo->hrts_freq)
+        return can_hrts_extend(devinfo, in32(devinfo->base + FLEXCAN_HR_TIME_STAMP(can_mb_index(devinfo, mb))));
+#endif
+
+    age = (int16_t)(devinfo->ts_timer - (ctrl & 0x0000FFFF));
+
+    return devinfo->ts_ns - (int64_t)age * devinfo->bit_ps / 1000;
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
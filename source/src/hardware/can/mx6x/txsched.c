@@ -0,0 +1,266 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Scheduled transmission.
+ *
+ * Scheduled frames live in devinfo->sched, at most CAN_TX_SCHED_MAX of
+ * them, tracked by the sched_used and sched_ready bit masks under txlock.
+ * The scheduler thread, started by the first CAN_DEVCTL_TX_SCHED_ADD,
+ * sleeps until the next frame is due, marks due frames ready and starts
+ * transmission. can_tx_fill(), from that thread, the devctls or the tx
+ * interrupt, takes ready frames lowest message ID first through
+ * can_txsched_get() before the libcan queue, and drops those past their
+ * deadline.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/neutrino.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+/* Serializes the scheduler start */
+static pthread_mutex_t  can_txsched_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Convert microseconds to ClockCycles() */
+static inline uint64_t can_us2cycles(CANDEV_RINGO_INFO *devinfo, uint32_t us)
+{
+    return (uint64_t)us * devinfo->cycles_per_sec / 1000000;
+}
+
+/*
+ * Take the ready frame with the lowest message ID, called with txlock held.
+ * Ready frames past their deadline are dropped on the way.
+ *
+ * Returns: 1 when txmsg holds a frame to send, 0 otherwise.
+ */
+int can_txsched_get(CANDEV_RINGO_INFO *devinfo, canmsg_t *txmsg)
+{
+    CAN_TX_SCHED_ENTRY  *e;
+    uint64_t             now = ClockCycles();
+    uint64_t             ready, bit;
+    int                  i, best = -1;
+
+    for(ready = devinfo->sched_ready; ready; ready &= ready - 1)
+    {
+        i = __builtin_ctzll(ready);
+        e = &devinfo->sched[i];
+        if(e->deadline && now - e->ready_due > e->deadline)
+        {
+            bit = 1ULL << i;
+            devinfo->sched_ready &= ~bit;
+            if(!e->period)
+                devinfo->sched_used &= ~bit;
+            devinfo->sched_expired++;
+            continue;
+        }
+        if(best < 0 || (e->frame.mid & RINGO_CANMID_MASK_EXT) < (devinfo->sched[best].frame.mid & RINGO_CANMID_MASK_EXT))
+            best = i;
+    }
+    if(best < 0)
+        return(0);
+
+    e = &devinfo->sched[best];
+    txmsg->cmsg.mid = e->frame.mid;
+    txmsg->cmsg.len = e->frame.len;
+    txmsg->cmsg.ext.is_extended_mid = (e->frame.flags & CAN_BATCH_FLAG_IDE) ? 1 : 0;
+    txmsg->cmsg.ext.is_remote_frame = 0;
+    memcpy(txmsg->cmsg.dat, e->frame.dat, CAN_MSG_DATA_MAX);
+
+    bit = 1ULL << best;
+    devinfo->sched_ready &= ~bit;
+    if(!e->period)
+        devinfo->sched_used &= ~bit;
+
+    return(1);
+}
+
+/* Scheduler thread: marks due frames ready and sleeps until the next one */
+static void *can_txsched_thread(void *arg)
+{
+    CANDEV_RINGO_INFO   *devinfo = arg;
+    CANDEV_RINGO        *dev = &devinfo->devlist[devinfo->txmbxstart];
+    CAN_TX_SCHED_ENTRY  *e;
+    struct _pulse        pulse;
+    uint64_t             now, next, used, bit, ns;
+    int                  i, ready;
+
+    // Register access and InterruptLock() need I/O privileges
+    ThreadCtl(PRIVITY_FLAGS, 0);
+
+    for(;;)
+    {
+        InterruptLock(&devinfo->txlock);
+        now = ClockCycles();
+        next = UINT64_MAX;
+        for(used = devinfo->sched_used; used; used &= used - 1)
+        {
+            i = __builtin_ctzll(used);
+            bit = 1ULL << i;
+            e = &devinfo->sched[i];
+            if(e->due <= now)
+            {
+                // A frame still waiting from the previous period is sent once
+                if(!(devinfo->sched_ready & bit))
+                {
+                    devinfo->sched_ready |= bit;
+                    e->ready_due = e->due;
+                }
+                if(e->period)
+                    e->due = (e->due + e->period > now) ? e->due + e->period : now + e->period;
+                else
+                    e->due = UINT64_MAX;
+            }
+            if(e->due < next)
+                next = e->due;
+        }
+        ready = (devinfo->sched_ready != 0);
+        InterruptUnlock(&devinfo->txlock);
+
+        if(ready)
+            can_drvr_transmit(&dev->cdev);
+
+        // Sleep until the next due frame or a change of the schedule
+        if(next != UINT64_MAX)
+        {
+            ns = (next - now) / devinfo->cycles_per_sec * 1000000000ULL +
+                 (next - now) % devinfo->cycles_per_sec * 1000000000ULL / devinfo->cycles_per_sec;
+            TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_RECEIVE, NULL, &ns, NULL);
+        }
+        MsgReceivePulse(devinfo->sched_chid, &pulse, sizeof(pulse), NULL);
+    }
+
+    return(NULL);
+}
+
+/* Allocate the schedule and start the scheduler thread, on first use */
+static int can_txsched_start(CANDEV_RINGO_INFO *devinfo)
+{
+    pthread_t            tid;
+    int                  status = EOK;
+
+    pthread_mutex_lock(&can_txsched_mutex);
+    if(!devinfo->sched)
+    {
+        devinfo->sched_chid = ChannelCreate(0);
+        if(devinfo->sched_chid == -1)
+        {
+            status = errno;
+        }
+        else if((devinfo->sched_coid = ConnectAttach(0, 0, devinfo->sched_chid, _NTO_SIDE_CHANNEL, 0)) == -1)
+        {
+            status = errno;
+            ChannelDestroy(devinfo->sched_chid);
+        }
+        else
+        {
+            devinfo->sched = calloc(CAN_TX_SCHED_MAX, sizeof(CAN_TX_SCHED_ENTRY));
+            if(!devinfo->sched || (status = pthread_create(&tid, NULL, can_txsched_thread, devinfo)) != EOK)
+            {
+                status = devinfo->sched ? status : ENOMEM;
+                free(devinfo->sched);
+                devinfo->sched = NULL;
+                ConnectDetach(devinfo->sched_coid);
+                ChannelDestroy(devinfo->sched_chid);
+            }
+        }
+    }
+    pthread_mutex_unlock(&can_txsched_mutex);
+
+    return(status);
+}
+
+/* Scheduled transmission devctls, raw tx device only */
+int can_txsched_devctl(CANDEV_RINGO *dev, int dcmd, DCMD_DATA *data)
+{
+    CANDEV_RINGO_INFO   *devinfo = dev->devinfo;
+    CAN_TX_SCHED        *s = (CAN_TX_SCHED *)data;
+    CAN_TX_SCHED_ENTRY  *e;
+    uint64_t             bit;
+    int                  status = EOK, i;
+
+    // CAN FD frames are sent from the driver's own tx queue
+    if(devinfo->mode != CANDEV_MODE_RAW_FRAME || (devinfo->iflags & INFO_FLAGS_FD) ||
+       dev->mbxid != (int)devinfo->txmbxstart)
+        return(EINVAL);
+
+    switch(dcmd)
+    {
+        case CAN_DEVCTL_TX_SCHED_ADD:
+            if(s->frame.len > CAN_MSG_DATA_MAX)
+                return(EINVAL);
+            if((status = can_txsched_start(devinfo)) != EOK)
+                return(status);
+
+            InterruptLock(&devinfo->txlock);
+            if(devinfo->sched_used == UINT64_MAX)
+            {
+                status = ENOSPC;
+            }
+            else
+            {
+                i = __builtin_ctzll(~devinfo->sched_used);
+                e = &devinfo->sched[i];
+                e->frame = s->frame;
+                e->due = ClockCycles() + can_us2cycles(devinfo, s->delay_us);
+                e->period = can_us2cycles(devinfo, s->period_us);
+                e->deadline = can_us2cycles(devinfo, s->deadline_us);
+                devinfo->sched_used |= 1ULL << i;
+                s->handle = i;
+            }
+            InterruptUnlock(&devinfo->txlock);
+            break;
+
+        case CAN_DEVCTL_TX_SCHED_CANCEL:
+            if(s->handle < 0 || s->handle >= CAN_TX_SCHED_MAX || !devinfo->sched)
+                return(EINVAL);
+            bit = 1ULL << s->handle;
+            InterruptLock(&devinfo->txlock);
+            if(!(devinfo->sched_used & bit))
+                status = EINVAL;
+            devinfo->sched_used &= ~bit;
+            devinfo->sched_ready &= ~bit;
+            InterruptUnlock(&devinfo->txlock);
+            break;
+
+        default:
+            return(ENOTSUP);
+    }
+
+    // The scheduler thread recomputes its next wakeup
+    if(status == EOK)
+        MsgSendPulse(devinfo->sched_coid, -1, _PULSE_CODE_MINAVAIL, 0);
+
+    return(status);
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
@@ -0,0 +1,137 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+
+/*
+ * Wakeups of an interrupt.
+ *
+ * An ISR pass may find clients to wake on any number of devices, but the
+ * handler returns a single event. The pass collects the devices in a bitmap
+ * indexed like devlist. A single device gets its libcan event returned
+ * directly, otherwise the devices are added to devinfo->wake and the
+ * wakeup thread is pulsed, which delivers the event of each.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/neutrino.h>
+
+#include "canmx6x.h"
+#include "proto.h"
+
+/* Event for the ISR to return for the devices collected in wake during a pass */
+const struct sigevent *can_wake_event(CANDEV_RINGO_INFO *devinfo, const uint32_t *wake)
+{
+    uint32_t             i, n = 0, last = 0;
+
+    for(i = 0; i < CAN_WAKE_WORDS; i++)
+    {
+        if(wake[i])
+        {
+            n += __builtin_popcount(wake[i]);
+            last = i;
+        }
+    }
+    if(n == 0)
+        return(NULL);
+    // A single device, no need for the wakeup thread
+    if(n == 1)
+        return(can_dev_event(&devinfo->devlist[last * 32 + __builtin_ctz(wake[last])]));
+
+    InterruptLock(&devinfo->wake_lock);
+    for(i = 0; i <= last; i++)
+        devinfo->wake[i] |= wake[i];
+    InterruptUnlock(&devinfo->wake_lock);
+
+    return(&devinfo->wake_event);
+}
+
+/* Wakeup thread: delivers the events of the devices collected by the ISR */
+static void *can_wake_thread(void *arg)
+{
+    CANDEV_RINGO_INFO       *devinfo = arg;
+    const struct sigevent   *event;
+    struct _pulse            pulse;
+    uint32_t                 wake[CAN_WAKE_WORDS], bits, i;
+
+    // InterruptLock() needs I/O privileges
+    ThreadCtl(PRIVITY_FLAGS, 0);
+
+    for(;;)
+    {
+        if(MsgReceivePulse(devinfo->wake_chid, &pulse, sizeof(pulse), NULL) == -1)
+            continue;
+
+        InterruptLock(&devinfo->wake_lock);
+        for(i = 0; i < CAN_WAKE_WORDS; i++)
+        {
+            wake[i] = devinfo->wake[i];
+            devinfo->wake[i] = 0;
+        }
+        InterruptUnlock(&devinfo->wake_lock);
+
+        for(i = 0; i < CAN_WAKE_WORDS; i++)
+        {
+            for(bits = wake[i]; bits; bits &= bits - 1)
+            {
+                // NULL when the rx ring was disarmed meanwhile
+                event = can_dev_event(&devinfo->devlist[i * 32 + __builtin_ctz(bits)]);
+                if(event)
+                    can_deliver_event(event);
+            }
+        }
+    }
+
+    return(NULL);
+}
+
+/* Set up the wakeup thread, before interrupts are attached */
+void can_wake_init(CANDEV_RINGO_INFO *devinfo)
+{
+    pthread_t            tid;
+    int                  coid;
+
+    devinfo->wake_chid = ChannelCreate(0);
+    if(devinfo->wake_chid == -1)
+    {
+        perror("Wakeup thread: ChannelCreate failed");
+        exit(EXIT_FAILURE);
+    }
+    coid = ConnectAttach(0, 0, devinfo->wake_chid, _NTO_SIDE_CHANNEL, 0);
+    if(coid == -1)
+    {
+        perror("Wakeup thread: ConnectAttach failed");
+        exit(EXIT_FAILURE);
+    }
+    // Wakeups go out at the priority of the first rx device
+    SIGEV_PULSE_INIT(&devinfo->wake_event, coid,
+                     devinfo->devlist[devinfo->rxmbxstart].cdev.event.sigev_priority,
+                     _PULSE_CODE_MINAVAIL, 0);
+
+    if(pthread_create(&tid, NULL, can_wake_thread, devinfo) != EOK)
+    {
+        fprintf(stderr, "Wakeup thread: pthread_create failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
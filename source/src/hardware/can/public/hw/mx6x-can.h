@@ -24,6 +24,7 @@
 
 #include <hw/libcan.h>
 #include <hw/mini_driver.h>
+#include <sys/neutrino.h>
 
 #define RAW_MODE_RX_NUM_MBOX 1
 #define RAW_MODE_TX_NUM_MBOX 1
@@ -40,7 +41,10 @@
 #define RINGO_CANLAM_MEM_SIZE            0x100
 #define RINGO_CAN_NUM_MAILBOX_FLEXCAN    64
 #define RINGO_CAN_MAILBOX_SIZE           4
+#define RINGO_CAN_IFLAG_REGS_MAX         4      /* IFLAG1-IFLAG4 on 128 mailbox parts */
+#define RINGO_CAN_MB_REGION_SIZE         0x200  /* Mailboxes never straddle a 512 byte RAM region */
 #define FLEXCAN_SET_MODE_RETRIES         255
+#define FLEXCAN_MB_BUSY_RETRIES          64     /* Reads of a BUSY rx mailbox before the ISR moves on */
 
 /* Errata ERR005829 requires reserving the first physical CAN mailbox and setting
  * its 'message buffer not ready for transmit' bit twice each time a CAN message
@@ -93,6 +97,8 @@
  */
 #define RINGO_CAN_CLK_EXTAL              24576000
 #define RINGO_CAN_CLK_PLL                30000000
+/* Protocol engine clock the predefined bit timings are computed for */
+#define RINGO_CAN_CLK_PE                 60000000
 
 /* RINGO CAN Register Offsets */
 #define RINGO_CANMC               0x00
@@ -315,6 +321,30 @@
 /* Bit definitions for RINGO CAN Control 2 (CTRL2) Register */
 #define RINGO_CANCTRL2_EACEN                    (0x01 << 16)
 #define RINGO_CANCTRL2_ECRWRE                   (0x01 << 29)
+#define RINGO_CANCTRL2_RFFN_MASK                (0x0F << 24)
+#define RINGO_CANCTRL2_RFFN_SHIFT                24
+#define RINGO_CANCTRL2_RFFN_MAXVAL               0xF
+
+/* Legacy Rx FIFO:
+ * MB0-5 hold the FIFO output, the ID filter table starts at MB6 and takes
+ * 2 mailboxes for every 8 filter elements (8 * (RFFN + 1) elements).
+ */
+#define RX_FIFO_OUTPUT_MBX                       0
+#define RX_FIFO_FILTER_MBX                       6
+#define RX_FIFO_FILTERS_PER_RFFN                 8
+#define RX_FIFO_MAX_FILTERS                      (RX_FIFO_FILTERS_PER_RFFN * (RINGO_CANCTRL2_RFFN_MAXVAL + 1))
+#define RX_FIFO_RFFN(nfilters)                   (((nfilters) + RX_FIFO_FILTERS_PER_RFFN - 1) / RX_FIFO_FILTERS_PER_RFFN - 1)
+#define RX_FIFO_FIRST_FREE_MBX(rffn)             (RX_FIFO_FILTER_MBX + 2 * ((rffn) + 1))
+#define RX_FIFO_NUM_INDIVIDUAL_MASKS             32
+#define IFLAG_RX_FIFO_OVERFLOW                   (0x01 << 7)
+#define IFLAG_RX_FIFO_WARNING                    (0x01 << 6)
+#define IFLAG_RX_FIFO_AVAILABLE                  (0x01 << 5)
+#define RINGO_CANRXFIR_IDHIT_MASK                0x000001FF
+
+/* Legacy Rx FIFO ID filter table element, format A (ID in CANMID layout shifted left by one) */
+#define RX_FIFO_FILTER_RTR                       (0x01 << 31)
+#define RX_FIFO_FILTER_IDE                       (0x01 << 30)
+#define RX_FIFO_FILTER_ID(mid)                   (((mid) & RINGO_CANMID_MASK_EXT) << 1)
 
 
 /* FlexCAN Error Counter Register */
@@ -338,6 +368,7 @@
 #define RINGO_CANES_FCS_SHIFT                      4
 #define RINGO_CANES_FCS_ERROR_ACTIVE              (0x00 << 4)
 #define RINGO_CANES_FCS_ERROR_PASSIVE             (0x01 << 4)
+#define RINGO_CANES_FCS_BUS_OFF                   (0x02 << 4)
 #define RINGO_CANES_BOFFINT                       (0x01 << 2)
 #define RINGO_CANES_ERRINT                        (0x01 << 1)
 #define RINGO_CANES_WAKEINT                       (0x01 << 0)
@@ -353,6 +384,9 @@
 #define IFLAG_BUFnM(x)                            (0x1<<(x))
 
 /* Message Buffers */
+#define MB_CNT_EDL                                (0x80000000)    /* CAN FD: extended data length */
+#define MB_CNT_BRS                                (0x40000000)    /* CAN FD: bit rate switch */
+#define MB_CNT_ESI                                (0x20000000)    /* CAN FD: error state indicator */
 #define MB_CNT_CODE(x)                            (((x)&0x0F)<<24)
 #define MB_CNT_SRR                                (0x00400000)
 #define MB_CNT_IDE                                (0x00200000)
@@ -440,10 +474,290 @@
 #define INIT_FLAGS_TSYN              0x00000200    /* Enable Timer Sync feature */
 #define INIT_FLAGS_LOM               0x00000400    /* Listen Only Mode */
 #define INIT_FLAGS_LBUF              0x00000800    /* Lowest number buffer is transmitted first */
+#define INIT_FLAGS_RX_FIFO           0x00001000    /* Receive through the legacy Rx FIFO */
+#define INIT_FLAGS_RX_EFIFO          0x00002000    /* Receive through the Enhanced Rx FIFO */
+#define INIT_FLAGS_FD                0x00004000    /* CAN FD operation */
+#define INIT_FLAGS_FD_BRS            0x00008000    /* CAN FD data phase bit rate switching */
+#define INIT_FLAGS_RX_DROP_NEW       0x00010000    /* Drop received frames when the rx queue is full */
 
 #define INFO_FLAGS_RX_FULL_MSG       0x00000001    /* Receiver should store message ID, timestamp, etc. */
 #define INFO_FLAGS_ENDIAN_SWAP       0x00000002    /* Data is TX/RX'd MSB, need to perform ENDIAN conversions */
+#define INFO_FLAGS_RX_FIFO           0x00000004    /* Rx devices are backed by legacy Rx FIFO filters */
+#define INFO_FLAGS_RX_EFIFO          0x00000008    /* Rx devices are backed by Enhanced Rx FIFO filters */
+#define INFO_FLAGS_EXTENDED_MID      0x00000010    /* 29 bit extended message ID */
+#define INFO_FLAGS_RX_ANY_FIFO       (INFO_FLAGS_RX_FIFO | INFO_FLAGS_RX_EFIFO)
+#define INFO_FLAGS_FD                0x00000020    /* CAN FD frames, mailbox payload is fd_payload bytes */
+#define INFO_FLAGS_FD_BRS            0x00000040    /* CAN FD data phase bit rate switching enabled */
+#define INFO_FLAGS_LBUF              0x00000080    /* Lowest number tx mailbox is transmitted first */
+#define INFO_FLAGS_RX_DROP_NEW       0x00000100    /* Full rx queues drop new frames instead of the oldest */
+
+#define CAN_INTR_THREAD_PRIO         21            /* Default priority of an interrupt thread (-I) */
+
+/*
+ * CAN FD raw frames.
+ * libcan messages carry at most 8 data bytes, so in CAN FD mode raw frames
+ * are exchanged with the driver specific devctls below. struct can_fd_msg
+ * is smaller than DCMD_DATA, so it travels in the regular devctl buffer.
+ */
+#define CAN_FD_DATA_MAX              64
+
+#define CAN_FD_FLAG_EDL              0x00000001    /* CAN FD frame format (classic CAN frame when clear) */
+#define CAN_FD_FLAG_BRS              0x00000002    /* Data phase sent at the data bit rate */
+#define CAN_FD_FLAG_ESI              0x00000004    /* Transmitter is error passive (rx only) */
+#define CAN_FD_FLAG_IDE              0x00000008    /* 29 bit extended message ID */
+#define CAN_FD_FLAG_RTR              0x00000010    /* Remote frame (classic CAN frames only) */
+
+typedef struct can_fd_msg
+{
+    uint32_t        mid;                    /* Message ID, CANMID register layout as for raw canmsg_t */
+    uint32_t        flags;                  /* CAN_FD_FLAG_* */
+    uint32_t        timestamp;              /* Receive timestamp, 16 bit free running timer */
+    uint8_t         len;                    /* Data length in bytes, rounded up to a valid CAN FD length */
+    uint8_t         reserved[3];
+    uint64_t        timestamp_ns;           /* Receive time in ClockCycles() nanoseconds (rx only) */
+    uint8_t         dat[CAN_FD_DATA_MAX];
+} CAN_FD_MSG;
+
+/* Queue a CAN FD frame on a tx device, EAGAIN when the queue is full */
+#define CAN_DEVCTL_TX_FRAME_RAW_FD   __DIOT(_DCMD_MISC, CAN_CMD_CODE + 64, struct can_fd_msg)
+/* Read a CAN FD frame from an rx device without blocking, EAGAIN when none is queued */
+#define CAN_DEVCTL_RX_FRAME_RAW_FD   __DIOF(_DCMD_MISC, CAN_CMD_CODE + 65, struct can_fd_msg)
+
+/*
+ * Shared memory rx ring (-r, raw mode).
+ * The ISR writes every received raw frame straight into a ring in the
+ * shared memory object CAN_RX_RING_NAME (unit number substituted), which
+ * clients map read-only. The ring never blocks the driver: the oldest
+ * frames are overwritten and each reader tracks its own tail:
+ *
+ *     while(tail != ring->head) {
+ *         if(ring->head - tail >= ring->size)    // Overrun, frames lost
+ *             tail = ring->head - ring->size + 1;
+ *         frame = ring->frame[tail & (ring->size - 1)];
+ *         if(ring->head - tail >= ring->size)    // Overwritten while copied
+ *             continue;
+ *         tail++;
+ *     }
+ *
+ * A client waits for the ring to stop being empty through the raw rx
+ * device, so libcan wakes it and the driver never sends anything to a
+ * process it was only told about. After draining, the client arms with
+ * CAN_DEVCTL_RX_RING_NOTIFY and the tail it reached. EAGAIN means frames
+ * past tail are already in the ring. Otherwise the next frame written to
+ * the ring is also queued once on the raw rx device, with at most 8 bytes
+ * of payload, and the client blocks until it gets it:
+ *
+ *     if(devctl(fd, CAN_DEVCTL_RX_RING_NOTIFY, &notify, sizeof(notify), NULL) == EOK)
+ *         devctl(fd, CAN_DEVCTL_RX_FRAME_RAW_BLOCK, &canmsg, sizeof(canmsg), NULL);
+ *
+ * Arming drops a frame queued by an earlier arming the client did not
+ * wait for. One client per ring can wait this way, others poll.
+ */
+#define CAN_RX_RING_NAME             "/can%d-rx"
+#define CAN_RX_RING_MAGIC            0x47524143    /* "CARG" */
+
+typedef struct can_rx_ring
+{
+    uint32_t            magic;
+    uint32_t            size;                   /* Number of frames, a power of two */
+    volatile uint32_t   head;                   /* Free running count of frames written */
+    uint32_t            reserved;
+    CAN_FD_MSG          frame[];                /* Next frame goes to frame[head & (size - 1)] */
+} CAN_RX_RING;
+
+typedef struct can_rx_ring_notify
+{
+    uint32_t            tail;                   /* Client's next frame to read */
+} CAN_RX_RING_NOTIFY;
+
+/* Queue the next frame of the rx ring on the raw rx device, EAGAIN if one past tail is already in the ring */
+#define CAN_DEVCTL_RX_RING_NOTIFY    __DIOT(_DCMD_MISC, CAN_CMD_CODE + 66, struct can_rx_ring_notify)
+
+/*
+ * Software acceptance filters (-k, raw mode).
+ * Besides the raw rx device the driver exposes software filter rx devices,
+ * each with its own libcan queue. A client opens one of them and adds the
+ * message ID ranges it wants; received frames are copied to every device
+ * that accepts them and only the clients of those devices are woken. The
+ * raw rx device keeps the frames no software filter accepts. IDs are plain
+ * 11 or 29 bit identifiers, not the CANMID register layout.
+ */
+#define CAN_SWF_MAX_DEVS             64
+#define CAN_SWF_MAX_RANGES           256    /* Per software filter device */
+#define CAN_SWF_NUM_STD_IDS          2048
+
+#define CAN_SWF_RANGE_EXT            0x00000001    /* 29 bit extended message IDs */
+
+typedef struct can_swf_range
+{
+    uint32_t            first;                  /* First and last accepted message ID */
+    uint32_t            last;
+    uint32_t            flags;                  /* CAN_SWF_RANGE_* */
+} CAN_SWF_RANGE;
+
+/* Accept a message ID range on a software filter device */
+#define CAN_DEVCTL_SWF_ADD           __DIOT(_DCMD_MISC, CAN_CMD_CODE + 67, struct can_swf_range)
+/* Remove all ranges of a software filter device, it no longer receives frames */
+#define CAN_DEVCTL_SWF_CLEAR         __DION(_DCMD_MISC, CAN_CMD_CODE + 68)
+
+/*
+ * Per device statistics.
+ * struct can_devctl_stats counts for the whole controller. These counters
+ * are kept for each device, i.e. each mailbox in I/O mode and each client
+ * facing device in raw mode, so queue overwrites can be pinned on the
+ * consumer that does not keep up.
+ *
+ * latency[] is a log2 histogram in ClockCycles() of the time from the ISR
+ * pass that read a frame out of its mailbox to its delivery: the read reply
+ * for frames the driver hands out itself (CAN_DEVCTL_RX_FRAME_RAW_FD), the
+ * client wakeup sent to libcan otherwise, timed from the first pass that
+ * queued it. Bucket 0 counts 0 cycles, bucket
+ * n latencies of 2^(n-1) to 2^n - 1 cycles and the last bucket everything
+ * above. The structure fits the regular devctl buffer (DCMD_DATA).
+ */
+#define CAN_MB_STATS_BUCKETS         24
+
+typedef struct can_mb_stats
+{
+    uint32_t        frames;                 /* Frames received or transmitted */
+    uint32_t        q_full;                 /* Received frames overwriting the oldest queued one */
+    uint32_t        queued_max;             /* Most frames waiting in the receive queue */
+    uint32_t        wakeups;                /* Client wakeups */
+    uint32_t        busy_skips;             /* ISR passes that left an rx mailbox pending as it stayed BUSY */
+    uint32_t        latency[CAN_MB_STATS_BUCKETS];
+} CAN_MB_STATS;
+
+/* Read the statistics of the device */
+#define CAN_DEVCTL_GET_MB_STATS      __DIOF(_DCMD_MISC, CAN_CMD_CODE + 69, struct can_mb_stats)
+/* Reset the statistics of the device */
+#define CAN_DEVCTL_CLEAR_MB_STATS    __DION(_DCMD_MISC, CAN_CMD_CODE + 70)
+
+/*
+ * Batched raw frames (raw mode).
+ * CAN_DEVCTL_RX_FRAME_RAW_BLOCK/_NOBLOCK and CAN_DEVCTL_TX_FRAME_RAW move
+ * one frame per message pass. The batch devctls move up to CAN_BATCH_MAX
+ * frames through the same libcan queues; a batch fits the regular devctl
+ * buffer (DCMD_DATA). count holds the number of frames to send, or the
+ * most frames to read, and returns the number actually sent or read.
+ *
+ * Neither devctl blocks, both fail with EAGAIN when no frame could be
+ * moved. To block until at least one frame is there, a reader waits with
+ * CAN_DEVCTL_RX_FRAME_RAW_BLOCK and then fetches what else is queued:
+ *
+ *     devctl(fd, CAN_DEVCTL_RX_FRAME_RAW_BLOCK, &canmsg, sizeof(canmsg), NULL);
+ *     batch.count = CAN_BATCH_MAX;
+ *     devctl(fd, CAN_DEVCTL_RX_FRAME_RAW_BATCH, &batch, sizeof(batch), NULL);
+ *
+ * A tx batch is queued as a whole before transmission starts, so it fills
+ * all free tx mailboxes of the raw tx device (-T) at once. When the tx
+ * queue runs full only the first count frames are taken.
+ */
+#define CAN_BATCH_MAX                7
+
+#define CAN_BATCH_FLAG_IDE           0x01          /* 29 bit extended message ID */
+
+typedef struct can_batch_frame
+{
+    uint32_t        mid;                    /* Message ID, CANMID register layout as for raw canmsg_t */
+    uint16_t        timestamp;              /* Receive timestamp, 16 bit free running timer (rx only) */
+    uint8_t         len;                    /* Data length, 0 to 8 bytes */
+    uint8_t         flags;                  /* CAN_BATCH_FLAG_* */
+    uint8_t         dat[CAN_MSG_DATA_MAX];
+} CAN_BATCH_FRAME;
+
+typedef struct can_batch
+{
+    uint32_t        count;
+    CAN_BATCH_FRAME frame[CAN_BATCH_MAX];
+} CAN_BATCH;
+
+/* Read up to count queued frames from a raw rx device */
+#define CAN_DEVCTL_RX_FRAME_RAW_BATCH __DIOTF(_DCMD_MISC, CAN_CMD_CODE + 71, struct can_batch)
+/* Queue count frames on the raw tx device */
+#define CAN_DEVCTL_TX_FRAME_RAW_BATCH __DIOTF(_DCMD_MISC, CAN_CMD_CODE + 72, struct can_batch)
+
+/*
+ * Scheduled transmission (raw mode, raw tx device).
+ * A scheduled frame becomes due delay_us after it is added and then every
+ * period_us, so periodic frames go out without a client write per cycle.
+ * Due frames are loaded into the free tx mailboxes ahead of the frames
+ * queued with the write devctls, lowest message ID first. A due frame that
+ * could not be loaded into a mailbox within deadline_us is dropped for
+ * that cycle. CAN_DEVCTL_TX_SCHED_ADD returns the handle that
+ * CAN_DEVCTL_TX_SCHED_CANCEL takes; ENOSPC once CAN_TX_SCHED_MAX frames
+ * are scheduled.
+ */
+#define CAN_TX_SCHED_MAX             64
+
+typedef struct can_tx_sched
+{
+    CAN_BATCH_FRAME frame;
+    uint32_t        delay_us;               /* First due time after the devctl */
+    uint32_t        period_us;              /* Repeat period, 0 to send once */
+    uint32_t        deadline_us;            /* Drop when not sent this long after due, 0 for never */
+    int32_t         handle;                 /* Returned by CAN_DEVCTL_TX_SCHED_ADD */
+} CAN_TX_SCHED;
+
+#define CAN_DEVCTL_TX_SCHED_ADD      __DIOTF(_DCMD_MISC, CAN_CMD_CODE + 73, struct can_tx_sched)
+#define CAN_DEVCTL_TX_SCHED_CANCEL   __DIOT(_DCMD_MISC, CAN_CMD_CODE + 74, struct can_tx_sched)
+
+/* Scheduled frame, due and deadline in ClockCycles() */
+typedef struct can_tx_sched_entry
+{
+    CAN_BATCH_FRAME frame;
+    uint64_t        due;                    /* Next due time */
+    uint64_t        period;
+    uint64_t        deadline;               /* Relative to due, 0 for never */
+    uint64_t        ready_due;              /* Due time of the pending transmission */
+} CAN_TX_SCHED_ENTRY;
+
+/*
+ * Software filter lookup tables, rebuilt from the ranges of all devices on
+ * every change. Values are masks of accepting software filter devices.
+ */
+typedef struct can_swf_hash
+{
+    uint32_t            id;                     /* CAN_SWF_HASH_EMPTY when unused */
+    uint64_t            mask;
+} CAN_SWF_HASH;
+
+typedef struct can_swf_seg
+{
+    uint32_t            first;                  /* Segment covers first up to the next segment */
+    uint64_t            mask;
+} CAN_SWF_SEG;
+
+#define CAN_SWF_HASH_EMPTY           0xFFFFFFFF
+
+typedef struct can_swf_table
+{
+    uint64_t            std[CAN_SWF_NUM_STD_IDS]; /* 11 bit IDs */
+    CAN_SWF_HASH        *hash;                  /* Single 29 bit IDs, open addressing */
+    uint32_t            hash_mask;
+    uint32_t            hash_shift;             /* 32 - log2(number of hash slots) */
+    CAN_SWF_SEG         *seg;                   /* 29 bit ID ranges, sorted disjoint segments */
+    uint32_t            nseg;
+} CAN_SWF_TABLE;
+
+#define CAN_CACHE_LINE               64
+
+/*
+ * CAN FD frame queue shared by the ISR and the CAN FD devctls. The tx queue
+ * is protected by fdlock. The rx queue is a lock free single producer, single
+ * consumer ring: the ISR only writes head, the devctl only writes tail, and
+ * the two sit in separate cache lines.
+ */
+typedef struct can_fd_queue
+{
+    CAN_FD_MSG      *msg;                   /* Array of size frames */
+    uint64_t        *cycles;                /* ClockCycles() of the ISR pass that read each frame (rx only) */
+    uint32_t        size;                   /* A power of two */
+    volatile uint32_t head __attribute__((aligned(CAN_CACHE_LINE)));   /* Free running fill index */
+    volatile uint32_t tail __attribute__((aligned(CAN_CACHE_LINE)));   /* Free running drain index */
+} CAN_FD_QUEUE;
 
+/* Words of a bitmap with one bit per device: mailbox devices, then software filter devices */
+#define CAN_WAKE_WORDS               ((RINGO_CAN_IFLAG_REGS_MAX * 32 + CAN_SWF_MAX_DEVS) / 32)
 
 struct candev_ringo_entry;
 
@@ -468,6 +782,22 @@ typedef struct candev_ringo_init_entry
     uint32_t         midrx;        /* RX Message ID */
     uint32_t         midtx;        /* TX Message ID */
     uint32_t         timestamp;    /* Initial value for local network time */
+    /* CAN FD data phase bitrate related parameters */
+    uint32_t         fd_payload;   /* Mailbox payload size in CAN FD mode (8, 16, 32 or 64) */
+    uint16_t         fbr_presdiv;  /* Data phase Bitrate Prescaler */
+    uint8_t          fbr_propseg;  /* Data phase Propagation Segment Time */
+    uint8_t          fbr_rjw;      /* Data phase Bitrate Resync Jump Width */
+    uint8_t          fbr_pseg1;    /* Data phase Phase Buffer Segment 1 */
+    uint8_t          fbr_pseg2;    /* Data phase Phase Buffer Segment 2 */
+    uint32_t         rxring_size;  /* Shared memory rx ring frames, 0 when disabled */
+    uint32_t         hrts_freq;    /* High resolution timestamp timebase frequency in Hz, 0 when unused */
+    uint32_t         swf_ndevs;    /* Software filter rx devices, 0 when disabled */
+    uint32_t         raw_txmbs;    /* Tx mailboxes of the raw tx device */
+    uint32_t         intr_runmask; /* Runmask of the interrupt thread, 0 to service interrupts in the ISR */
+    int              intr_prio;    /* Priority of the interrupt thread */
+    uint32_t         busoff_min_ms; /* Bus-off recovery backoff, 0 for automatic recovery by the FlexCAN */
+    uint32_t         busoff_max_ms;
+    uint32_t         busoff_age_ms; /* Bus-off time after which queued tx frames are flushed, 0 to keep them */
 } CANDEV_RINGO_INIT;
 
 typedef struct candev_ringo_init_info
@@ -505,6 +835,62 @@ typedef struct candev_ringo_info_entry
     uint32_t                        txmbxstart;
     uint32_t                        rxmbxstart;
     uint32_t                        num_mailboxes;
+    uint32_t                        mbxmask[RINGO_CAN_IFLAG_REGS_MAX];  /* Mailboxes serviced by the ISR, per IFLAG register */
+    uint32_t                        rffn;       /* Legacy Rx FIFO filter table size (8 * (rffn + 1) elements) */
+    volatile uint32_t               *erfifo;    /* Enhanced Rx FIFO output and filter memory */
+    uint32_t                        mbsize;     /* Mailbox size in bytes (header + payload) */
+    uint32_t                        mbs_per_region; /* Mailboxes per RAM region */
+    uint32_t                        fd_payload; /* CAN FD mailbox payload size */
+    CAN_FD_QUEUE                    fdrxq;      /* CAN FD received frames */
+    CAN_FD_QUEUE                    fdtxq;      /* CAN FD frames waiting for the tx mailbox */
+    intrspin_t                      fdlock;     /* Protects fdrxq and fdtxq against the ISR */
+    intrspin_t                      txlock;     /* Protects the tx mailbox busy masks against the ISR */
+    CAN_RX_RING                     *rxring;    /* Shared memory rx ring, raw mode only */
+    volatile uint32_t               rxring_armed; /* Next frame also goes to the raw rx device */
+    uint64_t                        cycles_per_sec; /* ClockCycles() rate */
+    uint32_t                        bit_ps;     /* Nominal bit time (free running timer tick) in ps */
+    uint32_t                        ts_timer;   /* Free running timer sampled at ts_ns */
+    uint64_t                        ts_ns;      /* ClockCycles() time of the current ISR pass in ns */
+    uint64_t                        ts_cycles;  /* ClockCycles() of the current ISR pass */
+    uint32_t                        hrts_freq;  /* High resolution timestamp timebase frequency, 0 when unused */
+    int64_t                         hrts_ticks; /* Extended high resolution timestamp sampled at hrts_ns */
+    uint64_t                        hrts_ns;
+    uint64_t                        hrts_base_ns; /* ClockCycles() time of high resolution timestamp tick 0 */
+    int16_t                         *midhash;   /* Message ID index buckets, first rx mailbox of each chain */
+    int16_t                         *midnext;   /* Next rx mailbox in the same bucket, per mailbox */
+    uint32_t                        midhash_shift; /* 32 - log2(number of buckets) */
+    struct candev_ringo_entry       *swf_devs;  /* Software filter rx devices, after the mailbox devices */
+    uint32_t                        swf_ndevs;
+    CAN_SWF_TABLE                   *swf;       /* Software filter lookup tables */
+    intrspin_t                      swf_lock;   /* Protects swf against the ISR */
+    intrspin_t                      wake_lock;  /* Protects wake against the ISR */
+    uint32_t                        wake[CAN_WAKE_WORDS]; /* Devices with clients to wake, by devlist index */
+    int                             wake_chid;  /* Channel of the wakeup thread */
+    struct sigevent                 wake_event; /* Wakes the wakeup thread */
+    int                             erroractive; /* Fault confinement state seen by the last error interrupt */
+    uint64_t                        isr_cycles; /* ClockCycles() spent handling interrupts */
+    uint64_t                        isr_frames; /* Mailboxes and Rx FIFO frames the ISR serviced */
+    volatile uint32_t               busoff;     /* Bus-off, tx mailboxes held until recovered */
+    uint64_t                        busoff_cycles; /* ClockCycles() of the last bus-off */
+    uint32_t                        busoff_held[RINGO_CAN_IFLAG_REGS_MAX]; /* Tx mailboxes held at bus-off */
+    uint32_t                        busoff_min_ms; /* Recovery backoff, 0 for automatic recovery */
+    uint32_t                        busoff_max_ms;
+    uint32_t                        busoff_age_ms; /* Flush tx frames older than this, 0 to keep them */
+    int                             busoff_chid; /* Channel of the recovery thread */
+    struct sigevent                 busoff_event; /* Wakes the recovery thread */
+    const struct sigevent           *busoff_wake; /* Client wakeup delayed by busoff_event */
+    CAN_TX_SCHED_ENTRY              *sched;     /* Scheduled frames, CAN_TX_SCHED_MAX entries */
+    uint64_t                        sched_used; /* Entries in use, changed under txlock */
+    uint64_t                        sched_ready; /* Entries due and not yet in a mailbox */
+    uint32_t                        sched_expired; /* Due frames dropped at their deadline */
+    int                             sched_coid; /* Wakes the scheduler thread */
+    int                             sched_chid;
+    int                             intr_chid;  /* Channel of the interrupt thread, -1 when interrupts use the ISR */
+    int                             intr_coid;
+    uint32_t                        intr_runmask; /* Cores the interrupt thread may run on */
+    int                             intr_prio;  /* Priority of the interrupt thread */
+    int                             intr_vec[3]; /* Interrupt vectors and ids of the thread, indexed by pulse value */
+    int                             intr_iid[3];
 } CANDEV_RINGO_INFO;
 
 /* Device specific extension of CANDEV struct */
@@ -514,6 +900,15 @@ typedef struct candev_ringo_entry
     int                           mbxid;        /* Index into mailbox memory */
     volatile uint32_t             dflags;       /* Device specific flags */
     CANDEV_RINGO_INFO            *devinfo;      /* Common device information */
+    uint32_t                      mid;          /* Rx FIFO filter message ID (Rx FIFO receive modes) */
+    uint32_t                      mfilter;      /* Rx FIFO filter acceptance mask (Rx FIFO receive modes) */
+    CAN_SWF_RANGE                 *swf_ranges;  /* Accepted message IDs (software filter devices) */
+    uint32_t                      swf_nranges;
+    struct candev_ringo_entry     *owner;       /* Device serviced when the mailbox interrupts */
+    uint32_t                      txmbs;        /* Tx mailboxes from mbxid on, used as a hardware queue */
+    uint32_t                      txbusy;       /* Tx mailboxes holding a frame, protected by txlock */
+    CAN_MB_STATS                  mbstats;      /* Per device statistics */
+    uint64_t                      wake_cycles;  /* ts_cycles of the ISR pass that queued the pending wakeup, or 0 */
 } CANDEV_RINGO;
 
 #endif
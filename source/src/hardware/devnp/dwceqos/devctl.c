@@ -23,6 +23,32 @@
 #include <net/ifdrvcom.h>
 #include <sys/sockio.h>
 
+/*
+ * The Rx threads of the queues count on their own, add their counts up
+ * into the nic stats and the ifnet. Called from the stack context only.
+ */
+void dwceqos_rx_stats (dwceqos_dev_t *dwceqos)
+{
+    struct ifnet          *ifp = &dwceqos->ecom.ec_if;
+    dwceqos_queue_t       *queue;
+    uint32_t              i, cnt;
+
+    dwceqos->stats.rxed_ok = 0;
+    dwceqos->stats.rx_failed_allocs = 0;
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        queue = &dwceqos->queue[i];
+        dwceqos->stats.rxed_ok += queue->rxed_ok;
+        dwceqos->stats.rx_failed_allocs += queue->rx_failed_allocs;
+
+        cnt = queue->rxed_ok;
+        ifp->if_ipackets += cnt - queue->rxed_ok_ifp;
+        queue->rxed_ok_ifp = cnt;
+        cnt = queue->rx_errors;
+        ifp->if_ierrors += cnt - queue->rx_errors_ifp;
+        queue->rx_errors_ifp = cnt;
+    }
+}
+
 static void dwceqos_get_stats (dwceqos_dev_t *dwceqos)
 {
     nic_stats_t           *stats = &dwceqos->stats;
@@ -60,7 +86,9 @@ static void dwceqos_get_stats (dwceqos_dev_t *dwceqos)
         NIC_ETHER_STAT_TOTAL_COLLISION_FRAMES;
 
     /* Get status */
-    stats->txed_ok = in32(mac_base + TX_PKT_COUNT_G); /* rxed_ok is in event */
+    stats->txed_ok = in32(mac_base + TX_PKT_COUNT_G);
+    /* rxed_ok is counted per queue in event */
+    dwceqos_rx_stats(dwceqos);
     stats->octets_txed_ok = in32(mac_base + TX_OCTET_COUNT_G);
     stats->octets_rxed_ok = in32(mac_base + RX_OCTET_COUNT_G);
     stats->txed_multicast = in32(mac_base + TX_MULTICAST_PKTS_G);
@@ -107,6 +135,20 @@ static void dwceqos_disable_mac_addr (dwceqos_dev_t *dwceqos, unsigned int i)
     }
 }
 
+/* Hash filter bin of an address, the upper bits of the bit reversed CRC32 */
+static uint32_t dwceqos_hash_bin (const uint8_t *addr, uint32_t bits)
+{
+    uint32_t    crc = ~ether_crc32_le(addr, ETHER_ADDR_LEN);
+    uint32_t    bin = 0;
+    uint32_t    i;
+
+    for (i = 0; i < bits; i++) {
+        bin = (bin << 1) | ((crc >> i) & 1);
+    }
+
+    return bin;
+}
+
 static void dwceqos_set_multicast (dwceqos_dev_t *dwceqos)
 {
     struct ethercom         *ec = &dwceqos->ecom;
@@ -114,10 +156,18 @@ static void dwceqos_set_multicast (dwceqos_dev_t *dwceqos)
     struct ether_multi      *enm;
     struct ether_multistep  step;
     int                     i;
-    uint32_t                reg;
+    uint32_t                reg, bin, hash_bits;
+    uint32_t                hash[HASH_TABLE_REGS];
 
     reg = in32(dwceqos->mac_base + MAC_PACKET_FILTER);
-    reg &= ~PM;
+    reg &= ~(PM | HMC | HPF);
+
+    /* 64, 128 or 256 bins, none if the hash filter is not implemented */
+    hash_bits = (in32(dwceqos->mac_base + MAC_HW_FEATURE1) & HASHTBLSZ_MASK) >> HASHTBLSZ_SHIFT;
+    if (hash_bits != 0) {
+        hash_bits += 5;
+    }
+    memset(hash, 0, sizeof(hash));
 
     ifp->if_flags &= ~IFF_ALLMULTI;
 
@@ -141,17 +191,26 @@ static void dwceqos_set_multicast (dwceqos_dev_t *dwceqos)
             break;
         }
 
-        if (i >= MAC_ADDR_TBL_SZ) {
+        if (i < MAC_ADDR_TBL_SZ) {
+            /* Perfect filters first */
+            dwceqos_set_mac_addr(dwceqos, enm->enm_addrlo, i);
+            i++;
+        } else if (hash_bits != 0) {
+            /* Then the hash filter, in addition to the perfect ones */
+            bin = dwceqos_hash_bin(enm->enm_addrlo, hash_bits);
+            hash[bin >> 5] |= (1 << (bin & 0x1F));
+            reg |= HMC | HPF;
+        } else {
             reg |= PM;
             ifp->if_flags |= IFF_ALLMULTI;
             break;
         }
 
-        dwceqos_set_mac_addr(dwceqos, enm->enm_addrlo, i);
-
         ETHER_NEXT_MULTI(step, enm);
+    }
 
-        i++;
+    for (i = 0; i < (1 << hash_bits) / 32; i++) {
+        out32(dwceqos->mac_base + MAC_HASH_TABLE(i), hash[i]);
     }
 
     out32(dwceqos->mac_base + MAC_PACKET_FILTER, reg);
@@ -159,6 +218,64 @@ static void dwceqos_set_multicast (dwceqos_dev_t *dwceqos)
     return;
 }
 
+/*****************************************************************************/
+/* Data of a driver specific command, it follows the struct ifdrv            */
+/*****************************************************************************/
+int dwceqos_drvspec_copyin (struct ifdrv *ifd, void *buf, size_t len)
+{
+    void  *data = (uint8_t *)ifd + sizeof(*ifd);
+
+    if (ifd->ifd_len != len) {
+        return EINVAL;
+    }
+
+    if (ISSTACK) {
+        return (copyin(data, buf, len) != 0) ? EINVAL : EOK;
+    }
+    memcpy(buf, data, len);
+
+    return EOK;
+}
+
+int dwceqos_drvspec_copyout (struct ifdrv *ifd, const void *buf, size_t len)
+{
+    void  *data = (uint8_t *)ifd + sizeof(*ifd);
+
+    if (ifd->ifd_len != len) {
+        return EINVAL;
+    }
+
+    if (ISSTACK) {
+        return copyout(buf, data, len);
+    }
+    memcpy(data, buf, len);
+
+    return EOK;
+}
+
+static int dwceqos_coalesce_ioctl (dwceqos_dev_t *dwceqos, struct ifdrv *ifd)
+{
+    dwceqos_coalesce_t  coal;
+    int                 err;
+
+    if (ifd->ifd_cmd == DWCEQOS_GET_COALESCE) {
+        return dwceqos_drvspec_copyout(ifd, &dwceqos->coal, sizeof(coal));
+    }
+
+    if ((err = dwceqos_drvspec_copyin(ifd, &coal, sizeof(coal))) != EOK) {
+        return err;
+    }
+
+    if (!dwceqos_coalesce_valid(dwceqos, &coal)) {
+        return EINVAL;
+    }
+
+    dwceqos->coal = coal;
+    dwceqos_coalesce_apply(dwceqos);
+
+    return EOK;
+}
+
 int dwceqos_ioctl (struct ifnet * ifp, unsigned long cmd, caddr_t data)
 {
     int                   error = 0;
@@ -166,6 +283,7 @@ int dwceqos_ioctl (struct ifnet * ifp, unsigned long cmd, caddr_t data)
     struct drvcom_config  *dcfgp;
     struct drvcom_stats   *dstp;
     struct ifdrv_com      *ifdc;
+    struct ifdrv          *ifd;
 
     switch (cmd) {
         case SIOCGDRVCOM:
@@ -199,6 +317,39 @@ int dwceqos_ioctl (struct ifnet * ifp, unsigned long cmd, caddr_t data)
             }
             break;
 
+        case SIOCGDRVSPEC:
+        case SIOCSDRVSPEC:
+            ifd = (struct ifdrv *)data;
+            switch (ifd->ifd_cmd) {
+                case DWCEQOS_GET_COALESCE:
+                case DWCEQOS_SET_COALESCE:
+                    error = dwceqos_coalesce_ioctl(dwceqos, ifd);
+                    break;
+
+                case PTP_GET_RX_TIMESTAMP:
+                case PTP_GET_TX_TIMESTAMP:
+                case PTP_GET_TIME:
+                case PTP_SET_TIME:
+                case PTP_GET_COMPENSATION:
+                case PTP_SET_COMPENSATION:
+                    error = dwceqos_ptp_ioctl(dwceqos, ifd);
+                    break;
+
+                case DWCEQOS_GET_CBS:
+                case DWCEQOS_SET_CBS:
+                    error = dwceqos_cbs_ioctl(dwceqos, ifd);
+                    break;
+
+                case DWCEQOS_GET_EST:
+                case DWCEQOS_SET_EST:
+                    error = dwceqos_est_ioctl(dwceqos, ifd);
+                    break;
+
+                default:
+                    error = ENOTTY;
+            }
+            break;
+
         case SIOCSIFMEDIA:
         case SIOCGIFMEDIA: {
             struct ifreq *ifr = (struct ifreq *)data;
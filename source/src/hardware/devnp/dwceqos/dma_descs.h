@@ -43,6 +43,7 @@
 	#define DES_IPPPCSUM	(3 << 16)
 #define TDES3_TCP_PKT_PAYLOAD_MASK	0x3FFFF
 #define TDES3_TSE			(1 << 18)
+#define TDES3_THL_MASK			0xF
 #define TDES3_THL_SHIFT			19
 #define TDES3_SLOTNUM_MASK		0xF
 #define TDES3_SLOTNUM_SHIFT		19
@@ -79,6 +80,15 @@
 #define TDES3_OWN			(1 << 31)
 
 
+/* Transmit context descriptor */
+
+/* TDES2 */
+#define TDES2_CTXT_MSS_MASK		0x3FFF
+
+/* TDES3 */
+#define TDES3_CTXT_TCMSSV		(1 << 26)
+
+
 /* Normal receive descriptor */
 
 /* RDES0 (write back format) */
@@ -146,14 +156,16 @@
 #define RDES3_OWN			(1 << 31)
 
 
-/* Transmit and receive descriptors */
+/*
+ * Transmit and receive descriptors, in the native 16 byte layout. The
+ * mbuf of each descriptor is kept in a cacheable shadow array of the
+ * queue instead, the descriptors themselves are uncached.
+ */
 typedef struct {
     uint32_t    des0;
     uint32_t    des1;
     uint32_t    des2;
     uint32_t    des3;
-    struct mbuf *m;
-    char        pad[16 - sizeof(struct mbuf *)];
 } dwceqos_desc_t;
 
 
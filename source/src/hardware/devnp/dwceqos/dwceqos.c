@@ -61,6 +61,18 @@ static char *dwceqos_opts[] = {
 #define DWCOPT_RX	0
 	"transmit",
 #define DWCOPT_TX	1
+	"queues",
+#define DWCOPT_QUEUES	2
+	"typed_mem",
+#define DWCOPT_TYPED_MEM	3
+	"rx_frames",
+#define DWCOPT_RX_FRAMES	4
+	"rx_usecs",
+#define DWCOPT_RX_USECS	5
+	"tx_frames",
+#define DWCOPT_TX_FRAMES	6
+	"adaptive",
+#define DWCOPT_ADAPTIVE	7
         NULL
 };
 
@@ -135,6 +147,49 @@ static int dwceqos_parse_options (dwceqos_dev_t *dwceqos, const char *optstring,
 	        }
 	        break;
 
+            case DWCOPT_QUEUES:
+                if (dwceqos != NULL) {
+		    dwceqos->num_queues = strtoul(value, 0, 0);
+		    if ((dwceqos->num_queues < 1) || (dwceqos->num_queues > DWCEQOS_MAX_QUEUES)) {
+			dwceqos->num_queues = 1;
+			free(freeptr, M_DEVBUF);
+			slogf(_SLOGC_NETWORK, _SLOG_WARNING, "devnp-dwceqos: %s: Invalid option %s", __func__, c);
+			errno = EINVAL;
+			return -1;
+		    }
+	        }
+	        break;
+
+            case DWCOPT_TYPED_MEM:
+                if (dwceqos != NULL) {
+		    strlcpy(dwceqos->typed_mem, value, sizeof(dwceqos->typed_mem));
+	        }
+	        break;
+
+            case DWCOPT_RX_FRAMES:
+                if (dwceqos != NULL) {
+		    dwceqos->coal.rx_frames = strtoul(value, 0, 0);
+	        }
+	        break;
+
+            case DWCOPT_RX_USECS:
+                if (dwceqos != NULL) {
+		    dwceqos->coal.rx_usecs = strtoul(value, 0, 0);
+	        }
+	        break;
+
+            case DWCOPT_TX_FRAMES:
+                if (dwceqos != NULL) {
+		    dwceqos->coal.tx_frames = strtoul(value, 0, 0);
+	        }
+	        break;
+
+            case DWCOPT_ADAPTIVE:
+                if (dwceqos != NULL) {
+		    dwceqos->coal.adaptive = strtoul(value, 0, 0);
+	        }
+	        break;
+
             default:
                 /* Not one of ours, may be a generic driver option */
                 if (nic_parse_options(cfg, value) != EOK) {
@@ -151,12 +206,12 @@ static int dwceqos_parse_options (dwceqos_dev_t *dwceqos, const char *optstring,
     return EOK;
 }
 
-static bool dweqos_tx_dma_complete(dwceqos_dev_t *dwceqos)
+static bool dweqos_tx_dma_complete(dwceqos_dev_t *dwceqos, uint32_t chan)
 {
     uint32_t reg;
 
-    reg = in32(dwceqos->mac_base + DMA_DEBUG_STS0);
-    reg = DMA_GET_TX_STATE_CH0(reg);
+    reg = in32(dwceqos->mac_base + DMA_DEBUG_STS_CH(chan));
+    reg = DMA_GET_TX_STATE_CHi(reg, chan);
 
     return (reg == DMA_TX_CH_SUSPENDED);
 }
@@ -166,10 +221,14 @@ static void dwceqos_drain_dma(dwceqos_dev_t *dwceqos)
     /* Wait for all pending TX buffers to be sent.
      * 2ms is the maximum time for one packet transmission on 10Mbit link
      */
-    size_t limit = dwceqos->tx_desc_num;
+    size_t   limit;
+    uint32_t i;
 
-    while (!dweqos_tx_dma_complete(dwceqos) && limit--) {
-        nic_delay(2);
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        limit = dwceqos->tx_desc_num;
+        while (!dweqos_tx_dma_complete(dwceqos, i) && limit--) {
+            nic_delay(2);
+        }
     }
 }
 
@@ -269,8 +328,9 @@ static void dwceqos_stop (struct ifnet *ifp, int disable)
     dwceqos_dev_t          *dwceqos = ifp->if_softc;
     struct _iopkt_self     *iopkt = dwceqos->iopkt;
     struct nw_work_thread  *wtp = WTP;
-    uint32_t               value, i;
+    uint32_t               value, i, q;
     struct mbuf            *m;
+    dwceqos_queue_t        *queue;
 
     callout_stop(&dwceqos->mii_callout);
 
@@ -292,23 +352,33 @@ static void dwceqos_stop (struct ifnet *ifp, int disable)
     /* Wait for DMA to complete */
     dwceqos_drain_dma(dwceqos);
 
-    /* Release transmission queued mbuf */
-    if (dwceqos->tq_mbuf) {
-        m_freem(dwceqos->tq_mbuf);
-        dwceqos->tq_mbuf = NULL;
+    /* Release the packets the Tx queues hold */
+    for (q = 0; q < dwceqos->num_queues; q++) {
+        queue = &dwceqos->queue[q];
+        if (queue->tq_mbuf) {
+            m_freem(queue->tq_mbuf);
+            queue->tq_mbuf = NULL;
+        }
+        IF_PURGE(&queue->tq_held);
     }
 
     /* Release Tx mbuf and reset Tx descriptors */
-    for (i = 0; i < dwceqos->tx_desc_num; i++) {
-        dwceqos->tx_desc[i].des0 = 0;
-        dwceqos->tx_desc[i].des1 = 0;
-        dwceqos->tx_desc[i].des2 = 0;
-        dwceqos->tx_desc[i].des3 = 0;
-
-        if ((m = dwceqos->tx_desc[i].m) != NULL) {
-            m_free (m);
-            dwceqos->tx_desc[i].m = NULL;
+    for (q = 0; q < dwceqos->num_queues; q++) {
+        queue = &dwceqos->queue[q];
+        for (i = 0; i < dwceqos->tx_desc_num; i++) {
+            queue->tx_desc[i].des0 = 0;
+            queue->tx_desc[i].des1 = 0;
+            queue->tx_desc[i].des2 = 0;
+            queue->tx_desc[i].des3 = 0;
+
+            if ((m = queue->tx_mbuf[i]) != NULL) {
+                m_free (m);
+                queue->tx_mbuf[i] = NULL;
+            }
+            queue->tx_ts_req[i] = 0;
         }
+        queue->tx_mss = 0;
+        queue->tx_ts_head = queue->tx_ts_tail = 0;
     }
 
     IFQ_PURGE(&ifp->if_snd);
@@ -397,42 +467,88 @@ static paddr_t vtophys (void *addr)
 }
 
 /*****************************************************************************/
-/* DMA initialization                                                        */
+/* Check a ring size option, rings are indexed with a mask                   */
 /*****************************************************************************/
-static int dwceqos_dma_init (dwceqos_dev_t *dwceqos)
+static int dwceqos_ring_size_valid (uint32_t num)
+{
+    return ((num >= MIN_NUM_DESCRIPTORS) && (num <= MAX_NUM_DESCRIPTORS) &&
+            ((num & (num - 1)) == 0));
+}
+
+/*****************************************************************************/
+/* The DMA list and tail pointers only hold 32 bits of the address           */
+/*****************************************************************************/
+static void *dwceqos_desc_below_4g (void *descs, size_t size, const char *from)
+{
+    paddr_t phys;
+
+    phys = vtophys (descs);
+    if ((phys == (paddr_t)-1) || ((uint64_t)phys + size > DWCEQOS_DMA_ADDR_LIMIT)) {
+        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: Descriptor memory from %s at 0x%llx is not below 4G, set typed_mem= to memory that is",
+              __func__, from, (unsigned long long)phys);
+        munmap (descs, size);
+        errno = ENOMEM;
+        return MAP_FAILED;
+    }
+
+    return descs;
+}
+
+/*****************************************************************************/
+/* Allocate physically contiguous descriptor memory, from the typed memory   */
+/* pool if there is one and from the system RAM otherwise                    */
+/*****************************************************************************/
+static void *dwceqos_desc_alloc (dwceqos_dev_t *dwceqos, size_t size)
+{
+    int     fd;
+    void    *descs;
+
+    if (dwceqos->typed_mem[0] != '\0') {
+        fd = posix_typed_mem_open(dwceqos->typed_mem, O_RDWR, POSIX_TYPED_MEM_ALLOCATE_CONTIG);
+        if (fd != -1) {
+            descs = mmap (NULL, size, PROT_READ | PROT_WRITE | PROT_NOCACHE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (descs != MAP_FAILED) {
+                /* A typed memory object that is not below 4G is a configuration error, no fallback */
+                return dwceqos_desc_below_4g (descs, size, dwceqos->typed_mem);
+            }
+        }
+
+        if (dwceqos->cfg.verbose) {
+            slogf(_SLOGC_NETWORK, _SLOG_WARNING, "devnp-dwceqos: %s: Typed memory %s not usable: %s, using system RAM",
+                  __func__, dwceqos->typed_mem, strerror(errno));
+        }
+    }
+
+    descs = mmap (NULL, size, PROT_READ | PROT_WRITE | PROT_NOCACHE, MAP_ANON | MAP_PHYS | MAP_SHARED, NOFD, 0);
+    if (descs == MAP_FAILED) {
+        return descs;
+    }
+
+    return dwceqos_desc_below_4g (descs, size, "system RAM");
+}
+
+/*****************************************************************************/
+/* DMA initialization of one channel and its descriptor rings                */
+/*****************************************************************************/
+static int dwceqos_dma_queue_init (dwceqos_dev_t *dwceqos, dwceqos_queue_t *queue)
 {
     int                     i = 0;
-    int                     size = sizeof (dwceqos_desc_t);
-    uint32_t                reg, bw, dma_skip;
+    uint32_t                reg, chan = queue->idx;
     struct nw_work_thread   *wtp = WTP;
     struct mbuf             *m;
     off64_t                 phys;
     int                     pbl;
     dwceqos_desc_t          *tx_desc_phys, *rx_desc_phys;
 
-    /* Allocate descriptors */
-    dwceqos->descs = mmap (NULL, sizeof (dwceqos_desc_t) * (dwceqos->tx_desc_num + dwceqos->rx_desc_num),
-                           PROT_READ | PROT_WRITE | PROT_NOCACHE, MAP_ANON | MAP_PHYS | MAP_SHARED,
-                           NOFD, 0);
-
-    if (dwceqos->descs == MAP_FAILED) {
-        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: Descriptor memory mmap failed: %s(%d)", __func__, strerror(errno), errno);
-        return ENOBUFS;
-    }
-
-    memset((char *)dwceqos->descs, 0, size * (dwceqos->tx_desc_num + dwceqos->rx_desc_num));
+    queue->tx_desc_avail = dwceqos->tx_desc_num;
+    queue->tx_desc_head = 0;
+    queue->rx_desc_head = 0;
 
-    dwceqos->tx_desc = dwceqos->descs;
-    dwceqos->rx_desc = (dwceqos->descs + dwceqos->tx_desc_num);
-    dwceqos->tx_desc_avail = dwceqos->tx_desc_num;
-
-    dwceqos->tx_desc_head = 0;
-    dwceqos->rx_desc_head = 0;
-
-    tx_desc_phys = (dwceqos_desc_t *)vtophys((void *)dwceqos->tx_desc);
-    rx_desc_phys = (dwceqos_desc_t *)vtophys((void *)dwceqos->rx_desc);
-    dwceqos->tx_desc_tail = rx_desc_phys;
-    dwceqos->rx_desc_tail = rx_desc_phys + dwceqos->rx_desc_num;
+    tx_desc_phys = (dwceqos_desc_t *)vtophys((void *)queue->tx_desc);
+    rx_desc_phys = (dwceqos_desc_t *)vtophys((void *)queue->rx_desc);
+    queue->tx_desc_tail = tx_desc_phys + dwceqos->tx_desc_num;
+    queue->rx_desc_tail = rx_desc_phys + dwceqos->rx_desc_num;
 
     /* Pre-allocate a receive buffer for each receive descriptor */
     for (i = 0; i < dwceqos->rx_desc_num; i++) {
@@ -446,60 +562,211 @@ static int dwceqos_dma_init (dwceqos_dev_t *dwceqos)
         CACHE_INVAL (&dwceqos->cachectl, m->m_data, phys, m->m_ext.ext_size);
 
         /* Let DMA controller own the Rx Descriptors */
-        dwceqos->rx_desc[i].des0 = phys;
-        dwceqos->rx_desc[i].des1 = 0;
-        dwceqos->rx_desc[i].des2 = 0;
-        dwceqos->rx_desc[i].des3 = (RDES3_OWN | RDES3_BUF1V | RDES3_IOC);
-        dwceqos->rx_desc[i].m = m;
+        queue->rx_desc[i].des0 = phys;
+        queue->rx_desc[i].des1 = 0;
+        queue->rx_desc[i].des2 = 0;
+        queue->rx_desc[i].des3 = (RDES3_OWN | RDES3_BUF1V | dwceqos_rx_ioc(queue, i));
+        queue->rx_mbuf[i] = m;
     }
 
-    /* Probe data bus width, 32/64/128 bits. */
-    out32(dwceqos->mac_base + DMA_CHi_TXDESC_TAIL_PTR(0), 0xF);
-    reg = in32(dwceqos->mac_base + DMA_CHi_TXDESC_TAIL_PTR(0));
-    bw = (reg ^ 0xF) + 1;
+    /* And as many spare ones, the receive path takes its replacements from there */
+    dwceqos_rx_pool_refill(queue, wtp);
 
-    /* Cache-align dma descriptors */
-    /* set Descriptor Skip Length to skip between two unchained descriptors */
-    dma_skip = (sizeof(dwceqos_desc_t) - 16) / bw;
-    out32(dwceqos->mac_base + DMA_CHi_CTRL(0), (DSL_SHIFT(dma_skip) & DSL_MASK) | PBLX8);
+    /* Descriptors are contiguous, no Descriptor Skip Length */
+    out32(dwceqos->mac_base + DMA_CHi_CTRL(chan), PBLX8);
 
     /* Setup DMA descriptor ring */
-    out32(dwceqos->mac_base + DMA_CHi_TXDESC_RING_LEN(0), dwceqos->tx_desc_num - 1);
-    out32(dwceqos->mac_base + DMA_CHi_RXDESC_RING_LEN(0), dwceqos->rx_desc_num - 1);
-    out32(dwceqos->mac_base + DMA_CHi_RXDESC_LIST_ADDR(0), (uintptr_t)rx_desc_phys);
-    out32(dwceqos->mac_base + DMA_CHi_TXDESC_LIST_ADDR(0), (uintptr_t)tx_desc_phys);
-    out32(dwceqos->mac_base + DMA_CHi_RXDESC_TAIL_PTR(0), (uintptr_t)dwceqos->rx_desc_tail);
-
-    dwceqos->tq_mbuf = NULL;
+    out32(dwceqos->mac_base + DMA_CHi_TXDESC_RING_LEN(chan), dwceqos->tx_desc_num - 1);
+    out32(dwceqos->mac_base + DMA_CHi_RXDESC_RING_LEN(chan), dwceqos->rx_desc_num - 1);
+    out32(dwceqos->mac_base + DMA_CHi_RXDESC_LIST_ADDR(chan), (uintptr_t)rx_desc_phys);
+    out32(dwceqos->mac_base + DMA_CHi_TXDESC_LIST_ADDR(chan), (uintptr_t)tx_desc_phys);
+    out32(dwceqos->mac_base + DMA_CHi_RXDESC_TAIL_PTR(chan), (uintptr_t)queue->rx_desc_tail);
 
     pbl = tqs + 1;
     if (pbl > 32) {
         pbl = 32;
     }
-    /* Set transmit programmable burst length */
-    out32(dwceqos->mac_base + DMA_CHi_TX_CTRL(0), (TXPBL_MASK & TXPBL(pbl)));
+    /* Set transmit programmable burst length, TSO per packet through the descriptors */
+    out32(dwceqos->mac_base + DMA_CHi_TX_CTRL(chan), (TXPBL_MASK & TXPBL(pbl)) | (dwceqos->tso ? TSE : 0));
+    queue->tx_mss = 0;
 
     /* Set receive programmable burst length */
-    out32(dwceqos->mac_base + DMA_CHi_RX_CTRL(0), (RXPBL_MASK & RXPBL(8)) | (RBSZ_MASK & RBSZ(RX_BUF_SIZE)));
+    out32(dwceqos->mac_base + DMA_CHi_RX_CTRL(chan), (RXPBL_MASK & RXPBL(8)) | (RBSZ_MASK & RBSZ(RX_BUF_SIZE)));
+
+    /* Start DMA Rx */
+    reg = in32(dwceqos->mac_base + DMA_CHi_RX_CTRL(chan));
+    out32(dwceqos->mac_base + DMA_CHi_RX_CTRL(chan), reg | SR);
+
+    /* Start DMA Tx */
+    reg = in32(dwceqos->mac_base + DMA_CHi_TX_CTRL(chan));
+    out32(dwceqos->mac_base + DMA_CHi_TX_CTRL(chan), reg | ST);
+
+    /* Clear DMA intr status */
+    out32 (dwceqos->mac_base + DMA_CHi_STATUS(chan), 0xFFFF);
+
+    return EOK;
+}
+
+/*****************************************************************************/
+/* DMA initialization                                                        */
+/*****************************************************************************/
+static int dwceqos_dma_init (dwceqos_dev_t *dwceqos)
+{
+    int                     err;
+    uint32_t                i, n;
+    size_t                  size;
+    uint32_t                reg;
+    dwceqos_queue_t         *queue;
+
+    /* Allocate descriptors, the Tx ring of each queue is followed by its Rx ring */
+    size = sizeof (dwceqos_desc_t) * (dwceqos->tx_desc_num + dwceqos->rx_desc_num) * dwceqos->num_queues;
+    dwceqos->descs = dwceqos_desc_alloc (dwceqos, size);
+
+    if (dwceqos->descs == MAP_FAILED) {
+        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: Descriptor memory mmap failed: %s(%d)", __func__, strerror(errno), errno);
+        return ENOBUFS;
+    }
+
+    dwceqos->descs_size = size;
+    memset((char *)dwceqos->descs, 0, size);
+
+    /*
+     * The mbuf shadow arrays, laid out like the rings, each Rx one followed by the Rx pool.
+     * The Tx timestamp request flags of all queues come after them.
+     */
+    n = (dwceqos->tx_desc_num + 2 * dwceqos->rx_desc_num) * dwceqos->num_queues;
+    size = sizeof (struct mbuf *) * n + dwceqos->tx_desc_num * dwceqos->num_queues;
+    dwceqos->mbufs = malloc (size, M_DEVBUF, M_NOWAIT);
+    if (dwceqos->mbufs == NULL) {
+        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: mbuf array allocation failed", __func__);
+        return ENOBUFS;
+    }
+    memset(dwceqos->mbufs, 0, size);
+
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        queue = &dwceqos->queue[i];
+        queue->tx_desc = dwceqos->descs + i * (dwceqos->tx_desc_num + dwceqos->rx_desc_num);
+        queue->rx_desc = queue->tx_desc + dwceqos->tx_desc_num;
+        queue->tx_mbuf = dwceqos->mbufs + i * (dwceqos->tx_desc_num + 2 * dwceqos->rx_desc_num);
+        queue->rx_mbuf = queue->tx_mbuf + dwceqos->tx_desc_num;
+        queue->rx_pool = queue->rx_mbuf + dwceqos->rx_desc_num;
+        queue->rx_pool_head = 0;
+        queue->rx_pool_tail = 0;
+        queue->rx_pool_low = 0;
+        queue->tx_ts_req = (uint8_t *)(dwceqos->mbufs + n) + i * dwceqos->tx_desc_num;
+        queue->tq_mbuf = NULL;
+        memset(&queue->tq_held, 0, sizeof(queue->tq_held));
+        queue->tq_held.ifq_maxlen = dwceqos->tx_desc_num;
+    }
 
     /* Enable Enhanced Address Mode and set AXI Burst Length */
     reg = EAME | BLEN16 | BLEN8 | BLEN4;
     out32(dwceqos->mac_base + DMA_SYSBUS_MODE, reg);
 
-    /* Start DMA Rx */
-    reg = in32(dwceqos->mac_base + DMA_CHi_RX_CTRL(0));
-    out32(dwceqos->mac_base + DMA_CHi_RX_CTRL(0), reg | SR);
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        if ((err = dwceqos_dma_queue_init(dwceqos, &dwceqos->queue[i])) != EOK) {
+            return err;
+        }
+    }
 
-    /* Start DMA Tx */
-    reg = in32(dwceqos->mac_base + DMA_CHi_TX_CTRL(0));
-    out32(dwceqos->mac_base + DMA_CHi_TX_CTRL(0), reg | ST);
+    return EOK;
+}
 
-    /* Clear DMA intr status */
-    out32 (dwceqos->mac_base + DMA_CHi_STATUS(0), 0xFFFF);
+/*****************************************************************************/
+/* Rx pool refill thread. The interrupt threads only take clusters from the  */
+/* pools and ask this thread, running below their priority, to allocate.     */
+/*****************************************************************************/
+static void dwceqos_rx_refill_quiesce (void *arg, int die)
+{
+    dwceqos_dev_t   *dwceqos = arg;
+
+    MsgSendPulse(dwceqos->rx_refill_coid, -1, DWCEQOS_QUIESCE_PULSE, die);
+}
+
+static int dwceqos_rx_refill_init (void *arg)
+{
+    struct nw_work_thread   *wtp = WTP;
+
+    pthread_setname_np(0, "dwceqos rx refill");
+    wtp->quiesce_callout = dwceqos_rx_refill_quiesce;
+    wtp->quiesce_arg = arg;
+
+    return EOK;
+}
+
+static void *dwceqos_rx_refill_thread (void *arg)
+{
+    dwceqos_dev_t           *dwceqos = arg;
+    struct nw_work_thread   *wtp = WTP;
+    dwceqos_queue_t         *queue;
+    struct _pulse           pulse;
+
+    while (1) {
+        if (MsgReceivePulse(dwceqos->rx_refill_chid, &pulse, sizeof(pulse), NULL) == -1) {
+            continue;
+        }
+
+        switch (pulse.code) {
+            case DWCEQOS_RX_REFILL_PULSE:
+                /* Cleared first, a pass that finds the pool low after this asks again */
+                queue = &dwceqos->queue[pulse.value.sival_int];
+                queue->rx_pool_low = 0;
+                __sync_synchronize();
+                dwceqos_rx_pool_refill(queue, wtp);
+                break;
+
+            case DWCEQOS_QUIESCE_PULSE:
+                quiesce_block(pulse.value.sival_int);
+                break;
+
+            case DWCEQOS_STOP_PULSE:
+                return NULL;
+
+            default:
+                break;
+        }
+    }
+}
+
+static int dwceqos_rx_refill_start (dwceqos_dev_t *dwceqos)
+{
+    int     err;
+
+    /* The refill pulses run it just below the interrupt threads */
+    dwceqos->rx_refill_prio = dwceqos->cfg.priority - 1;
+
+    if ((dwceqos->rx_refill_chid = ChannelCreate(0)) == -1) {
+        return errno;
+    }
+    if ((dwceqos->rx_refill_coid = ConnectAttach(0, 0, dwceqos->rx_refill_chid, _NTO_SIDE_CHANNEL, 0)) == -1) {
+        return errno;
+    }
+    if ((err = nw_pthread_create(&dwceqos->rx_refill_tid, NULL, dwceqos_rx_refill_thread, dwceqos, 0,
+                                 dwceqos_rx_refill_init, dwceqos)) != EOK) {
+        return err;
+    }
+    dwceqos->rx_refill_running = 1;
 
     return EOK;
 }
 
+static void dwceqos_rx_refill_stop (dwceqos_dev_t *dwceqos)
+{
+    if (dwceqos->rx_refill_running) {
+        MsgSendPulse(dwceqos->rx_refill_coid, -1, DWCEQOS_STOP_PULSE, 0);
+        nw_pthread_reap(dwceqos->rx_refill_tid);
+        dwceqos->rx_refill_running = 0;
+    }
+    if (dwceqos->rx_refill_coid != -1) {
+        ConnectDetach(dwceqos->rx_refill_coid);
+        dwceqos->rx_refill_coid = -1;
+    }
+    if (dwceqos->rx_refill_chid != -1) {
+        ChannelDestroy(dwceqos->rx_refill_chid);
+        dwceqos->rx_refill_chid = -1;
+    }
+}
+
 /*****************************************************************************/
 /* Detach                                                                    */
 /*****************************************************************************/
@@ -507,8 +774,9 @@ static int dwceqos_detach (struct device *dev, int how)
 {
     struct ifnet    *ifp;
     struct mbuf     *m;
-    uint32_t        i, size, value;
+    uint32_t        i, q, value;
     dwceqos_dev_t   *dwceqos;
+    dwceqos_queue_t *queue;
     struct _iopkt_self     *iopkt;
     struct nw_work_thread  *wtp = WTP;
 
@@ -546,8 +814,15 @@ static int dwceqos_detach (struct device *dev, int how)
         dwceqos->iid = -1;
     }
 
-    /* Remove interrupt worker from io-pkt */
-    interrupt_entry_remove (&dwceqos->inter, NULL);
+    /* Remove interrupt workers from io-pkt */
+    for (q = 0; q < dwceqos->num_queues; q++) {
+        if (dwceqos->queue[q].inter.func != NULL) {
+            interrupt_entry_remove (&dwceqos->queue[q].inter, NULL);
+        }
+    }
+
+    /* No more Rx, the pools can go once the refill thread is gone too */
+    dwceqos_rx_refill_stop (dwceqos);
 
     /* Reset hardware to stop the DMA */
     dwceqos_reset (dwceqos);
@@ -564,32 +839,54 @@ static int dwceqos_detach (struct device *dev, int how)
     bsd_mii_finimedia(dwceqos);
     dwceqos_fini_phy(dwceqos);
 
-    /* Release transmission queued mbuf */
-    if (dwceqos->tq_mbuf) {
-        m_freem(dwceqos->tq_mbuf);
-        dwceqos->tq_mbuf = NULL;
+    /* Release the packets the Tx queues hold */
+    for (q = 0; q < dwceqos->num_queues; q++) {
+        queue = &dwceqos->queue[q];
+        if (queue->tq_mbuf) {
+            m_freem(queue->tq_mbuf);
+            queue->tq_mbuf = NULL;
+        }
+        IF_PURGE(&queue->tq_held);
     }
 
-    /* Release Tx mbuf */
-    for (i = 0; i < dwceqos->tx_desc_num; i++) {
-        if ((m = dwceqos->tx_desc[i].m) != NULL) {
-            m_free (m);
-            dwceqos->tx_desc[i].m = NULL;
+    for (q = 0; q < dwceqos->num_queues; q++) {
+        queue = &dwceqos->queue[q];
+        if (queue->tx_mbuf == NULL) {
+            continue;
         }
-    }
 
-    /* Release Rx mbuf */
-    for (i = 0; i < dwceqos->rx_desc_num; i++) {
-        if ((m = dwceqos->rx_desc[i].m) != NULL) {
-            m_free (m);
-            dwceqos->rx_desc[i].m = NULL;
+        /* Release Tx mbuf */
+        for (i = 0; i < dwceqos->tx_desc_num; i++) {
+            if ((m = queue->tx_mbuf[i]) != NULL) {
+                m_free (m);
+                queue->tx_mbuf[i] = NULL;
+            }
         }
+
+        /* Release Rx mbuf */
+        for (i = 0; i < dwceqos->rx_desc_num; i++) {
+            if ((m = queue->rx_mbuf[i]) != NULL) {
+                m_free (m);
+                queue->rx_mbuf[i] = NULL;
+            }
+        }
+
+        /* Release the Rx pool */
+        dwceqos_rx_pool_free (queue);
+    }
+
+    if (dwceqos->mbufs != NULL) {
+        free (dwceqos->mbufs, M_DEVBUF);
+        dwceqos->mbufs = NULL;
     }
 
     /* Free Tx and Rx descriptors */
-    if (dwceqos->descs != MAP_FAILED) {
-        size = sizeof (dwceqos_desc_t);
-        munmap((void*)dwceqos->rx_desc, size * (dwceqos->rx_desc_num + dwceqos->tx_desc_num));
+    if (dwceqos->descs != NULL && dwceqos->descs != MAP_FAILED) {
+        munmap((void*)dwceqos->descs, dwceqos->descs_size);
+    }
+
+    if (dwceqos->is_ptp_enabled) {
+        pthread_mutex_destroy(&dwceqos->ptp_ts_mutex);
     }
 
     /* Done with cache control */
@@ -614,8 +911,9 @@ static int dwceqos_attach (struct device *parent, struct device *self, void *aux
     char                   *options;
     int                    err;
     const char             zaddr[6] = {0,};
-    uint32_t               reg;
+    uint32_t               reg, i, max_queues;
     uintptr_t              mac_base;
+    dwceqos_queue_t        *queue;
 
 #ifdef S32G_FLEXCAN
     if (ThreadCtl(_NTO_TCTL_IO_PRIV, 0) == -1) {
@@ -625,6 +923,8 @@ static int dwceqos_attach (struct device *parent, struct device *self, void *aux
 #endif
     dwceqos = (dwceqos_dev_t *)self;
     dwceqos->iopkt = iopkt_selfp;
+    dwceqos->rx_refill_chid = -1;
+    dwceqos->rx_refill_coid = -1;
 
     /* Setup ethercomm */
     ifp = &dwceqos->ecom.ec_if;
@@ -636,6 +936,12 @@ static int dwceqos_attach (struct device *parent, struct device *self, void *aux
     cfg->flags |= NIC_FLAG_MULTICAST;
     dwceqos->rx_desc_num = DEFAULT_NUM_RX_DESCRIPTORS;
     dwceqos->tx_desc_num = DEFAULT_NUM_TX_DESCRIPTORS;
+    dwceqos->num_queues = 1;
+    strlcpy(dwceqos->typed_mem, DWCEQOS_TYPED_MEM, sizeof(dwceqos->typed_mem));
+    dwceqos->coal.rx_frames = DEFAULT_RX_COAL_FRAMES;
+    dwceqos->coal.rx_usecs = DEFAULT_RX_COAL_USECS;
+    dwceqos->coal.tx_frames = DEFAULT_TX_COAL_FRAMES;
+    dwceqos->coal.adaptive = DEFAULT_COAL_ADAPTIVE;
     cfg->mtu = ETHERMTU;
     cfg->mru = ETHERMTU;
     cfg->lan = dwceqos->dev.dv_unit;
@@ -662,6 +968,19 @@ static int dwceqos_attach (struct device *parent, struct device *self, void *aux
         goto _fail;
     }
 
+    if (!dwceqos_ring_size_valid(dwceqos->rx_desc_num) || !dwceqos_ring_size_valid(dwceqos->tx_desc_num)) {
+        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: receive and transmit must be a power of two from %d to %d",
+              __func__, MIN_NUM_DESCRIPTORS, MAX_NUM_DESCRIPTORS);
+        err = EINVAL;
+        goto _fail;
+    }
+
+    if (!dwceqos_coalesce_valid(dwceqos, &dwceqos->coal)) {
+        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: Invalid rx_frames, rx_usecs, tx_frames or adaptive", __func__);
+        err = EINVAL;
+        goto _fail;
+    }
+
     cfg->media = NIC_MEDIA_802_3;
     cfg->num_irqs = 1;
     cfg->num_mem_windows = 1;
@@ -725,6 +1044,12 @@ static int dwceqos_attach (struct device *parent, struct device *self, void *aux
         ifp->if_capabilities_tx = IFCAP_CSUM_IPv4 | IFCAP_CSUM_TCPv4 |
                                   IFCAP_CSUM_UDPv4 | IFCAP_CSUM_TCPv6 |
                                   IFCAP_CSUM_UDPv6;
+
+        /* TSO inserts the checksums of each segment, it needs the checksum engine */
+        if (in32(mac_base + MAC_HW_FEATURE1) & TSOEN) {
+            dwceqos->tso = 1;
+            ifp->if_capabilities_tx |= IFCAP_TSOv4 | IFCAP_TSOv6;
+        }
     }
     if (reg & RXCOESEL) {
         ifp->if_capabilities_rx = IFCAP_CSUM_IPv4 | IFCAP_CSUM_TCPv4 |
@@ -732,16 +1057,36 @@ static int dwceqos_attach (struct device *parent, struct device *self, void *aux
                                   IFCAP_CSUM_UDPv6;
     }
 
-    /* Setup interrupt related info */
-    dwceqos->inter.func = dwceqos_process_interrupt;
-    dwceqos->inter.enable = dwceqos_enable_interrupt;
+    /* Use as many queues as there are DMA channels and MTL queues on both sides */
+    reg = in32(mac_base + MAC_HW_FEATURE2);
+    max_queues = min(((reg & TXCHCNT_MASK) >> TXCHCNT_SHIFT), ((reg & RXCHCNT_MASK) >> RXCHCNT_SHIFT));
+    max_queues = min(max_queues, ((reg & TXQCNT_MASK) >> TXQCNT_SHIFT));
+    max_queues = min(max_queues, ((reg & RXQCNT_MASK) >> RXQCNT_SHIFT)) + 1;
+    max_queues = min(max_queues, DWCEQOS_MAX_QUEUES);
+    if ((dwceqos->num_queues < 1) || (dwceqos->num_queues > max_queues)) {
+        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: queues must be 1 to %d", __func__, max_queues);
+        dwceqos->num_queues = 1;
+        err = EINVAL;
+        goto _fail;
+    }
+
+    /* Setup interrupt related info, one io-pkt interrupt entry per queue */
     dwceqos->isrp = dwceqos_isr;
-    dwceqos->inter.arg = dwceqos;
     dwceqos->iid = -1; /* Not yet attached */
 
-    if ((err = interrupt_entry_init (&dwceqos->inter, 0, NULL, IRUPT_PRIO_DEFAULT)) != EOK) {
-        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: interrupt_entry_init failed", __func__);
-        goto _fail;
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        queue = &dwceqos->queue[i];
+        queue->dwceqos = dwceqos;
+        queue->idx = i;
+        queue->inter.func = dwceqos_process_interrupt;
+        queue->inter.enable = dwceqos_enable_interrupt;
+        queue->inter.arg = queue;
+
+        if ((err = interrupt_entry_init (&queue->inter, 0, NULL, IRUPT_PRIO_DEFAULT)) != EOK) {
+            slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: interrupt_entry_init failed", __func__);
+            queue->inter.func = NULL;
+            goto _fail;
+        }
     }
 
     /* Cache init */
@@ -762,7 +1107,9 @@ static int dwceqos_attach (struct device *parent, struct device *self, void *aux
     out32(mac_base + MAC_CFG, ACS | CST);
 
     /* Clear interrupts, make sure there is no interrupt */
-    out32(mac_base + DMA_CHi_INTR_EN(0), 0);
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        out32(mac_base + DMA_CHi_INTR_EN(i), 0);
+    }
     out32(mac_base + MAC_INTR_ENABLE, 0);
 
 #ifndef S32G_FLEXCAN
@@ -773,34 +1120,80 @@ static int dwceqos_attach (struct device *parent, struct device *self, void *aux
 
     /*
      * r/tx_fifo_sz is encoded as log2(n / 128). Undo that by shifting.
-     * r/tqs is encoded as (n / 256) - 1.
+     * r/tqs is encoded as (n / 256) - 1. The FIFOs are split evenly between the queues.
      */
-     tqs = (128 << mtl_tx_fifo_sz) / 256 - 1;
-     rqs = (128 << mtl_rx_fifo_sz) / 256 - 1;
+     tqs = (128 << mtl_tx_fifo_sz) / dwceqos->num_queues / 256 - 1;
+     rqs = (128 << mtl_rx_fifo_sz) / dwceqos->num_queues / 256 - 1;
 
 #else
     /* FIFO queue size is reported as 32KB, but actual size is 20KB. Hence tqs & rqs are calculated differently */
-    rqs = tqs = MTL_MEMORY_SIZE / 256 - 1;
+    rqs = tqs = MTL_MEMORY_SIZE / dwceqos->num_queues / 256 - 1;
 #endif
 
+    /* IEEE 1588 system time and timestamping */
+    if (in32(mac_base + MAC_HW_FEATURE0) & TSSEL) {
+        if ((err = dwceqos_ptp_init(dwceqos)) != EOK) {
+            slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: dwceqos_ptp_init failed", __func__);
+            goto _fail;
+        }
+        dwceqos->is_ptp_enabled = 1;
+    }
+
+    /* Interrupt moderation, before the Rx descriptors are set up and once PTP is known */
+    dwceqos_coalesce_apply(dwceqos);
+
     /* Initialize DMA */
     if ((err = dwceqos_dma_init(dwceqos)) != EOK) {
         slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: dwceqos_dma_init failed", __func__);
         goto _fail;
     }
 
-    /* Initialize the queue */
-    /* Pause time */
-    out32(mac_base + MAC_Qi_TX_FLOW_CTRL(0), (PT_SHIFT(256) & PT_MASK) | TFE);
+    /* The pools are full, from now on the refill thread tops them up */
+    if ((err = dwceqos_rx_refill_start(dwceqos)) != EOK) {
+        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: Rx refill thread failed: %s", __func__, strerror(err));
+        goto _fail;
+    }
+
+    /* Initialize the queues */
     out32(mac_base + MAC_RX_FLOW_CTRL, RFE);
 
-    /* Enable receive queue */
-    out32(mac_base + MAC_RXQ_CTRL0, 2 & RXQ0EN_MASK);
+    /*
+     * Rx queue i is serviced by DMA channel i. Untagged packets go to queue 0,
+     * tagged ones are steered by their VLAN priority, higher priorities to higher queues.
+     */
+    reg = 0;
+    out32(mac_base + MAC_RXQ_CTRL2, 0);
+    out32(mac_base + MAC_RXQ_CTRL3, 0);
+    out32(mac_base + MTL_RXQ_DMA_MAP0, 0);
+    out32(mac_base + MTL_RXQ_DMA_MAP1, 0);
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        uint32_t prio, prio_map = 0;
+
+        for (prio = 0; prio < 8; prio++) {
+            if (DWCEQOS_PRIO_QUEUE(prio, dwceqos->num_queues) == i) {
+                prio_map |= (1 << prio);
+            }
+        }
+        if (dwceqos->num_queues > 1) {
+            out32(mac_base + MAC_RXQ_CTRL_PSRQ(i), in32(mac_base + MAC_RXQ_CTRL_PSRQ(i)) | PSRQi(i, prio_map));
+        }
+        out32(mac_base + MTL_RXQ_DMA_MAP(i), in32(mac_base + MTL_RXQ_DMA_MAP(i)) | QiMDMACH(i, i));
 
-    /* Initialize MTL */
-    out32(mac_base + MTL_TXQi_OPERATION_MODE(0), (TQS(tqs) & TQS_MASK) | TXQEN(TX_EN) | TSF | EHFC);
-    out32(mac_base + MTL_TXQi_QUANTUM_WEIGHT(0), 0x10);
-    out32(mac_base + MTL_RXQi_OPERATION_MODE(0), (RQS(rqs) & RQS_MASK) | RSF | FEP);
+        /* Enable receive queue */
+        reg |= MAC_RXQ_CTRL0_RXQEN(i, MAC_RXQ_CTRL0_RXQEN_DCB);
+
+        /* Pause time */
+        out32(mac_base + MAC_Qi_TX_FLOW_CTRL(i), (PT_SHIFT(256) & PT_MASK) | TFE);
+
+        /* Initialize MTL */
+        out32(mac_base + MTL_TXQi_OPERATION_MODE(i), (TQS(tqs) & TQS_MASK) | TXQEN(TX_EN) | TSF | EHFC);
+        out32(mac_base + MTL_TXQi_QUANTUM_WEIGHT(i), 0x10);
+        out32(mac_base + MTL_RXQi_OPERATION_MODE(i), (RQS(rqs) & RQS_MASK) | RSF | FEP);
+    }
+    out32(mac_base + MAC_RXQ_CTRL0, reg);
+
+    /* Tx queues are served in strict priority order, matching the Rx priority steering */
+    out32(mac_base + MTL_OPERATION_MODE, MTL_OPERATION_MODE_SCHALG_STRICT);
 
     /* Initialize PHY */
     dwceqos_init_phy(dwceqos);
@@ -812,7 +1205,9 @@ static int dwceqos_attach (struct device *parent, struct device *self, void *aux
     }
 
     /* Enable the DMA RX/TX interrupts */
-    out32(dwceqos->mac_base + DMA_CHi_INTR_EN(0),(NIE| RIE | TBUE | FBEE));
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        out32(dwceqos->mac_base + DMA_CHi_INTR_EN(i), dwceqos->dma_intr_en);
+    }
 
    if (cfg->verbose) {
         nic_dump_config (cfg);
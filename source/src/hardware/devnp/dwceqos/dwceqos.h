@@ -31,6 +31,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/siginfo.h>
@@ -55,6 +56,7 @@
 #include <netdrvr/ptp.h>
 #include <hw/nicinfo.h>
 #include <sys/device.h>
+#include <hw/dwceqos.h>
 
 #include "dma_descs.h"
 
@@ -67,8 +69,52 @@
  * -------------------------------------------------------------------------
  */
 
-#define DEFAULT_NUM_RX_DESCRIPTORS  32
-#define DEFAULT_NUM_TX_DESCRIPTORS  32
+#define DEFAULT_NUM_RX_DESCRIPTORS  256
+#define DEFAULT_NUM_TX_DESCRIPTORS  256
+/* Ring sizes are powers of two, the upper bound is set by TDRL/RDRL */
+#define MIN_NUM_DESCRIPTORS         8
+#define MAX_NUM_DESCRIPTORS         (RDRL_MASK + 1)
+
+/* Descriptors are addressed with 32 bits, allocate them below 4G */
+#define DWCEQOS_TYPED_MEM           "/memory/below4G"
+#define DWCEQOS_DMA_ADDR_LIMIT      0x100000000ULL
+
+#define DWCEQOS_MAX_QUEUES          DMA_CHAN_NUM
+
+/* VLAN priority to queue mapping, the same for the Rx and Tx side, see hw/dwceqos.h */
+#define DWCEQOS_PRIO_QUEUE(prio, n) (((prio) * (n)) / 8)
+
+/* Pulses of the Rx pool refill thread, a refill carries the queue index */
+#define DWCEQOS_RX_REFILL_PULSE     (_PULSE_CODE_MINAVAIL + 0)
+#define DWCEQOS_QUIESCE_PULSE       (_PULSE_CODE_MINAVAIL + 1)
+#define DWCEQOS_STOP_PULSE          (_PULSE_CODE_MINAVAIL + 2)
+
+/* Interrupt moderation defaults, see dwceqos_coalesce_t: off, an Rx interrupt per frame */
+#define DEFAULT_RX_COAL_FRAMES      1
+#define DEFAULT_RX_COAL_USECS       0
+#define DEFAULT_TX_COAL_FRAMES      0
+#define DEFAULT_COAL_ADAPTIVE       0
+
+/* System clock the Rx interrupt watchdog counts */
+#define DWCEQOS_SYS_CLK_MHZ         125
+
+/* PTP reference clock of the system time generator */
+#define DWCEQOS_PTP_CLK_MHZ         DWCEQOS_SYS_CLK_MHZ
+
+/* Rx and Tx timestamps kept for the PTP daemon to look up */
+#define DWCEQOS_PTP_TS_NUM          32
+/* Timestamped packets in flight per Tx queue, a power of two */
+#define DWCEQOS_PTP_TX_PEND         8
+
+/* PTP messages, see IEEE 1588-2008 */
+#define DWCEQOS_PTP_ETHERTYPE       0x88F7
+#define DWCEQOS_PTP_EVENT_PORT      319
+#define DWCEQOS_PTP_HDR_LEN         34
+#define DWCEQOS_PTP_MSG_TYPE(hdr)   ((hdr)[0] & 0x0F)
+#define DWCEQOS_PTP_MSG_IS_EVENT(t) ((t) < 8)
+#define DWCEQOS_PTP_CLOCK_ID_OFF    20
+#define DWCEQOS_PTP_PORT_NUM_OFF    28
+#define DWCEQOS_PTP_SEQ_ID_OFF      30
 
 #define MAX_MII_RW_TIMEOUT          128
 #define RX_BUF_SIZE                 2048
@@ -136,10 +182,13 @@
     #define VTFE                  (1 << 16)        /* VLAN Tag Filter Enable */
     #define SAFE                  (1 << 9)         /* Source Address Filter Enable */
     #define SAIF                  (1 << 8)         /* SA Inverse Filtering */
+    #define HPF                   (1 << 10)        /* Hash or Perfect Filter */
     #define PCF_MASK              (0x3 << 6)       /* Pass Control Packets */
     #define DBF                   (1 << 5)         /* Disable Broadcast Packets */
     #define PM                    (1 << 4)         /* Pass All Multicast */
     #define DAIF                  (1 << 3)         /* DA Inverse Filtering */
+    #define HMC                   (1 << 2)         /* Hash Multicast */
+    #define HUC                   (1 << 1)         /* Hash Unicast */
     #define PR                    (1 << 0)         /* Promiscuous Mode */
 
 #define MAC_WATCHGOD_TIMEOUT  0x000C           /* The Watchdog Timeout register */
@@ -148,6 +197,8 @@
 
 #define HASTABLE_LO           0x0010
 #define HASTABLE_HI           0x0014
+#define MAC_HASH_TABLE(i)     (HASTABLE_LO + ((i) * 4)) /* The Hash Table i register. i = {0...HASH_TABLE_REGS-1} */
+#define HASH_TABLE_REGS       8                /* Registers of the largest, 256 bin, hash table */
 
 #define MAC_VLAN_TAG          0x0050           /* The VLAN Tag register */
     #define EIVLRXS               (1 << 31)        /* Enable Inner VLAN Tag in Rx Status */
@@ -228,6 +279,7 @@
 #define MAC_RXQ_CTRL0_RXQEN_OFF   0x0
 #define MAC_RXQ_CTRL0_RXQEN_AV    0x1
 #define MAC_RXQ_CTRL0_RXQEN_DCB   0x2
+#define MAC_RXQ_CTRL0_RXQEN(i, x) ((x) << ((i) * 2))
 
 #define MAC_RXQ_CTRL1         0x00A4           /* The Receive Queue Control 1 register */
     #define TPQC_MASK             (0x3 << 22)      /* Tagged PTP over Ethernet Packets Queuing Control. */
@@ -250,6 +302,9 @@
     #define PSRQ5_MASK            (0xFF << 8)      /* Priorities Selected in the Receive Queue 5 */
     #define PSRQ4_MASK            (0xFF << 0)      /* Priorities Selected in the Receive Queue 4 */
 
+#define MAC_RXQ_CTRL_PSRQ(i)      ((i) < 4 ? MAC_RXQ_CTRL2 : MAC_RXQ_CTRL3)
+    #define PSRQi(i, x)           (((x) & 0xFF) << (((i) & 0x3) * 8))   /* Priorities Selected in the Receive Queue i */
+
 #define MAC_INTR_STATUS       0x00B0           /* The Interrupt Status register */
     #define RXSTSIS               (1 << 14)        /* Receive Status Interrupt */
     #define TXSTSIS               (1 << 13)        /* Transmit Status Interrupt */
@@ -366,6 +421,7 @@
 #define MAC_HW_FEATURE1       0x0120           /* The HW Feature1 Register */
     #define L3L4FNUM_MASK         (0xF << 27)      /* Total number of L3 or L4 Filters */
     #define HASHTBLSZ_MASK        (0x3 << 24)      /* Hash Table Size */
+    #define HASHTBLSZ_SHIFT       24               /* 0 none, 1 64 bins, 2 128 bins, 3 256 bins */
     #define POUOST                (1 << 23)        /* One Step for PTP over UDP/IP Feature Enable */
     #define RAVSEL                (1 << 21)        /* Rx Side Only AV Feature Enable */
     #define AVSEL                 (1 << 20)        /* AV Feature Enable */
@@ -390,8 +446,17 @@
     #define RXCHCNT_MASK          (0xF << 12)      /* Number of DMA Receive Channels */
     #define TXQCNT_MASK           (0xF << 6)       /* Number of MTL Transmit Queues */
     #define RXQCNT_MASK           (0xF << 0)       /* Number of MTL Receive Queues */
+    #define TXCHCNT_SHIFT         18
+    #define RXCHCNT_SHIFT         12
+    #define TXQCNT_SHIFT          6
+    #define RXQCNT_SHIFT          0
 
 #define MAC_HW_FEATURE3       0x0128           /* The HW Feature3 register */
+    #define ESTWID_MASK           (0x3 << 20)      /* Width of the Time Interval field in the GCL */
+    #define ESTWID_SHIFT          20               /* 0 no EST, 1 16 bits, 2 20 bits, 3 24 bits */
+    #define ESTDEP_MASK           (0x7 << 13)      /* Depth of the Gate Control List */
+    #define ESTDEP_SHIFT          13               /* 1 64, 2 128, 3 256, 4 512, 5 1024 entries */
+    #define ESTSEL                (1 << 16)        /* Enhancements to Scheduled Traffic Enable */
     #define CBTISEL               (1 << 4)         /* Queues/Channel based VLAN tag insertion on Tx Enable */
     #define NRVF_MASK             (0x7 << 0)       /* Number of Extended VLAN Tag Filters Enabled */
 
@@ -970,6 +1035,7 @@
     #define CSC                       (1 << 19)                /* Enable checksum correction during OST to PTP over UDP/IPv4 packets. */
     #define TSENMACADDR               (1 << 18)                /* Enable MAC Address to PTP Packet Filtering. */
     #define SNAPTYPSEL_MASK           (0x3 << 16)              /* Select PTP packets for Taking Snapshots */
+    #define SNAPTYPSEL_1              (0x1 << 16)              /* SYNC, Delay_Req, Pdelay_Req, Pdelay_Resp with TSEVNTENA */
     #define TSMSTRENA                 (1 << 15)                /* Enable Snapshot to Messages Relevant to Master */
     #define TSEVNTENA                 (1 << 14)                /* Enable Timestamp Snapshot for Event Messages */
     #define TSIPV4ENA                 (1 << 13)                /* Enable Processing of PTP Packets Sent over IPv4-UDP */
@@ -988,6 +1054,7 @@
 #define MAC_SUB_SECOND_INC        0x0B04       /* The Sub-Second Increment register */
     #define SSINC_MASK                (0xFF << 16)             /* Sub-second Increment Value. */
     #define SNSINC_MASK               (0xFF << 8)              /* Sub-nanosecond Incremnet Value */
+    #define SSINC_SHIFT               16
 
 #define MAC_SYSTEM_TIME_SEC       0x0B08       /* The System Time Seconds register */
 
@@ -1155,6 +1222,45 @@
     #define Q4DDMACH                  (1 << 4)                 /* Queue 4 Enabled to Dynamic (per packet) DMA Channel Selection */
     #define Q4MDMACH_MASK             (0x7 << 0)               /* Queue 4 Mapped to DMA Channel */
 
+#define MTL_RXQ_DMA_MAP(i)        ((i) < 4 ? MTL_RXQ_DMA_MAP0 : MTL_RXQ_DMA_MAP1)
+    #define QiMDMACH(i, ch)           (((ch) & 0x7) << (((i) & 0x3) * 8))   /* Queue i Mapped to DMA Channel ch */
+
+/* The Enhancements to Scheduled Transmission Control register */
+#define MTL_EST_CONTROL           0x0C50
+    #define PTOV_MASK                 (0xFF << 24)             /* PTP Time Offset Value, ns */
+    #define PTOV_SHIFT                24
+    #define CTOV_MASK                 (0xFFF << 12)            /* Current Time Offset Value */
+    #define SSWL                      (1 << 1)                 /* Switch to S/W Owned List */
+    #define EEST                      (1 << 0)                 /* Enable EST */
+
+/* The EST Status register */
+#define MTL_EST_STATUS            0x0C58
+    #define CGSN_MASK                 (0xF << 16)              /* Current GCL Slot Number */
+    #define SWOL                      (1 << 7)                 /* S/W Owned List */
+    #define CGCE                      (1 << 4)                 /* Constant Gate Control Error */
+    #define HLBS                      (1 << 3)                 /* Head-Of-Line Blocking due to Scheduling */
+    #define HLBF                      (1 << 2)                 /* Head-Of-Line Blocking due to Frame Size */
+    #define BTRE                      (1 << 1)                 /* BTR Error */
+    #define SWLC                      (1 << 0)                 /* Switch to S/W Owned List Complete */
+
+/* The EST GCL Control register, indirect access to the GCL and its related registers */
+#define MTL_EST_GCL_CONTROL       0x0C80
+    #define GCL_ADDR_SHIFT            8                        /* GCL entry or related register address */
+    #define GCL_ERR0                  (1 << 20)                /* Error during the read or write */
+    #define GCRR                      (1 << 2)                 /* GCL Related Registers */
+    #define R1W0                      (1 << 1)                 /* Read 1, Write 0 */
+    #define SRWO                      (1 << 0)                 /* Start Read/Write Op */
+    /* GCL related registers, with GCRR */
+    #define GCL_BTR_LOW               0x0                      /* Base Time, ns */
+    #define GCL_BTR_HIGH              0x1                      /* Base Time, s */
+    #define GCL_CTR_LOW               0x2                      /* Cycle Time, ns */
+    #define GCL_CTR_HIGH              0x3                      /* Cycle Time, s */
+    #define GCL_TER                   0x4                      /* Time Extension */
+    #define GCL_LLR                   0x5                      /* List Length */
+
+/* The EST GCL Data register */
+#define MTL_EST_GCL_DATA          0x0C84
+
 /* The Queue i Transmit Operation Mode register */
 #define MTL_TXQi_OPERATION_MODE(i)      (0x0D00 + ((i) * 0x0040))   /* i = {1...TXQCNT-1} */
     #define TQS_MASK                        (0x7F << 16)            /* Transmit Queue Size */
@@ -1198,7 +1304,7 @@
 
 /* The Queue i Transmit Quantum or Weights register */
 #define MTL_TXQi_QUANTUM_WEIGHT(i)      (0x0D18 + ((i) * 0x0040))   /* i = {1...TXQCNT-1} */
-    #define ISCQW_MASK                       (0x1FFFFF)            * Quanturn or Weights */
+    #define ISCQW_MASK                       (0x1FFFFF)            /* Quanturn or Weights, idleSlopeCredit in AV mode */
 
 /* The Queue i sendSlopeCredit register */
 #define MTL_TXQi_SENDSLOPECREDIT(i)     (0x0D1C + ((i) * 0x0040))   /* i = {1...TXQCNT-1} */
@@ -1322,6 +1428,10 @@
 #define DMA_TX_CH_STOPPED         0
 #define DMA_TX_CH_SUSPENDED       6
 #define DMA_GET_TX_STATE_CH0(status0) ((status0 & 0xF000) >> 12)
+/* Channels 0-2 are reported in DMA_DEBUG_STS0, channels 3-6 in DMA_DEBUG_STS1 */
+#define DMA_DEBUG_STS_CH(i)       ((i) < 3 ? DMA_DEBUG_STS0 : DMA_DEBUG_STS1)
+#define DMA_GET_TX_STATE_CHi(status, i) \
+    (((status) >> ((i) < 3 ? 12 + 8 * (i) : 4 + 8 * ((i) - 3))) & 0xF)
 
 /* This register is used to control the AXI4 Cache Coherency Signals for read transactions by all the Transmit DMA channels */
 #define AXI4_TX_AR_ACE_CTRL       0x1020
@@ -1431,10 +1541,14 @@
     #define TXSE                          (1 <<  1)                /* Transmit Stopped Enable */
     #define TIE                           (1 <<  0)                /* Transmit Interrupt Enable */
 
+#define DMA_CHi_INTR_DEFAULT          (NIE | RIE | TBUE | FBEE)
+
 /* The Channel i Rx Interrupt Watchdog Timer register */
 #define DMA_CHi_RX_INTR_WDG_TIMER(i)  (0x1138  + ((i) * 0x0080)) /* i = {0...RXDMACNT-1} */
     #define RWTU_MASK                     (0x3 << 16)            /* Receive Interrupt Watchdog Tier Count Units  */
     #define RWT_MASK                      (0xFF << 0)            /* Receive Interrupt Watchdog Tier Count */
+    #define RWTU(x)                       ((x) << 16)            /* Units of 256 << x system clock cycles */
+    #define RWT_MAX_CYCLES                (0xFF * (256 << 3))
 
 /* The Channel i Slot Function Control and Status register */
 #define DMA_CHi_SLOT_FUNC_CTRL_STS(i) (0x113C  + ((i) * 0x0080))  /* i = {0...TXDMACNT-1} */
@@ -1541,6 +1655,64 @@
 /****/
 
 /* Structure  */
+struct dwceqos_dev_s;
+
+/* One Rx/Tx descriptor ring pair, serviced by DMA channel and MTL queue idx */
+typedef struct dwceqos_queue_s {
+      struct dwceqos_dev_s    *dwceqos;
+      struct _iopkt_inter     inter;
+      uint32_t                idx;
+
+      /* Rx */
+      uint32_t                rx_desc_head;
+      dwceqos_desc_t          *rx_desc;
+      struct mbuf             **rx_mbuf;      /* mbuf of each Rx descriptor */
+      struct mbuf             **rx_pool;      /* Pre-invalidated clusters to replace them, a ring of rx_desc_num */
+      uint32_t                rx_pool_head;   /* Added to by the refill thread only */
+      uint32_t                rx_pool_tail;   /* Taken from by the receive path only */
+      int                     rx_pool_low;    /* Refill asked for, cleared by the refill thread */
+      dwceqos_desc_t          *rx_desc_tail;
+      /* Rx counters of this queue's thread, dwceqos_rx_stats() adds them up */
+      uint32_t                rxed_ok;
+      uint32_t                rx_errors;
+      uint32_t                rx_failed_allocs;
+      uint32_t                rxed_ok_ifp;    /* Part of rxed_ok and rx_errors already in if_ipackets */
+      uint32_t                rx_errors_ifp;  /* and if_ierrors */
+      uint32_t                rx_coal_cur;    /* Frames per Rx interrupt, power of two */
+
+      /* Tx */
+      uint32_t                tx_desc_head;
+      uint32_t                tx_desc_avail;
+      dwceqos_desc_t          *tx_desc;
+      struct mbuf             **tx_mbuf;      /* mbuf of each Tx descriptor */
+      uint8_t                 *tx_ts_req;     /* Last descriptor of a frame sent with a timestamp request */
+      dwceqos_desc_t          *tx_desc_tail;
+      uint32_t                tx_coal_cnt;    /* Frames since the last Tx completion interrupt */
+      uint32_t                tx_mss;         /* MSS of the last Tx context descriptor, 0 if none */
+
+      /* Packets waiting for ring space, and the one being put on the ring: its len and sent bytes */
+      struct ifqueue          tq_held;
+      struct mbuf             *tq_mbuf;
+      uint32_t                tq_pkt_len;
+      uint32_t                tq_pkt_xbytes;
+
+      /* TSO of tq_mbuf: MSS (0 without TSO), L2-L4 header and TCP header length */
+      uint32_t                tq_tso_mss;
+      uint32_t                tq_tso_hlen;
+      uint32_t                tq_tso_thlen;
+
+      /* tq_mbuf is a PTP event message to timestamp, and its identity */
+      int                     tq_ptp;
+      ptp_extts_t             tq_ptp_id;
+
+      uint32_t                cbs_idle_slope; /* Credit based shaper reservation in kbit/s, 0 if not shaped */
+
+      /* PTP messages sent with a timestamp request, in completion order */
+      ptp_extts_t             tx_ts_pend[DWCEQOS_PTP_TX_PEND];
+      uint32_t                tx_ts_head;
+      uint32_t                tx_ts_tail;
+} dwceqos_queue_t;
+
 typedef struct dwceqos_dev_s {
       struct device           dev;  /* Common device */
       struct ethercom         ecom;
@@ -1558,9 +1730,16 @@ typedef struct dwceqos_dev_s {
       int                     iid;
       int                     dying;
       unsigned int            is_ptp_enabled;
+      unsigned int            tso;            /* TCP segmentation offload is supported */
 
       struct callout          mii_callout;
-      struct _iopkt_inter     inter;
+
+      /* Rx pool refill thread, below the priority of the interrupt threads */
+      pthread_t               rx_refill_tid;
+      int                     rx_refill_chid;
+      int                     rx_refill_coid;
+      int                     rx_refill_prio;
+      int                     rx_refill_running;
       const struct sigevent   *(*isrp)(void *, int);
       mdi_t                   *mdi;
       uint16_t                *phy_regs;
@@ -1568,26 +1747,43 @@ typedef struct dwceqos_dev_s {
       uint32_t                flow;
 
       dwceqos_desc_t          *descs;
+      size_t                  descs_size;
+      struct mbuf             **mbufs;        /* Shadow arrays of all queues */
+      char                    typed_mem[64];
 
-      /* Rx */
+      /* Ring sizes, the same for every queue */
       uint32_t                rx_desc_num;
-      uint32_t                rx_desc_head;
-      dwceqos_desc_t          *rx_desc;
-      dwceqos_desc_t          *rx_desc_tail;
-
-      /* Tx */
       uint32_t                tx_desc_num;
-      uint32_t                tx_desc_head;
-      uint32_t                tx_desc_avail;
-      dwceqos_desc_t          *tx_desc;
-      dwceqos_desc_t          *tx_desc_tail;
 
-      /* Transmission queued mbuf, len and sent bytes */
-      struct mbuf             *tq_mbuf;
-      uint32_t                tq_pkt_len;
-      uint32_t                tq_pkt_xbytes;
+      uint32_t                num_queues;
+      dwceqos_queue_t         queue[DWCEQOS_MAX_QUEUES];
+
+      /* Interrupt moderation and the DMA channel interrupts it enables */
+      dwceqos_coalesce_t      coal;
+      uint32_t                dma_intr_en;
+
+      /*
+       * PTP clock frequency correction and the timestamps for the daemon. The
+       * queue threads add to the rings and the stack searches them, under ptp_ts_mutex.
+       */
+      uint32_t                ptp_addend;
+      ptp_comp_t              ptp_comp;
+      pthread_mutex_t         ptp_ts_mutex;
+      ptp_extts_t             ptp_rx_ts[DWCEQOS_PTP_TS_NUM];
+      uint32_t                ptp_rx_ts_cnt;
+      ptp_extts_t             ptp_tx_ts[DWCEQOS_PTP_TS_NUM];
+      uint32_t                ptp_tx_ts_cnt;
+
+      /* The gate control list last set */
+      dwceqos_est_t           est;
 } dwceqos_dev_t;
 
+/* Rx descriptor IOC bit, set only on every rx_coal_cur-th descriptor of the ring */
+static inline uint32_t dwceqos_rx_ioc (const dwceqos_queue_t *queue, uint32_t idx)
+{
+    return (((idx + 1) & (queue->rx_coal_cur - 1)) == 0) ? RDES3_IOC : 0;
+}
+
 /*****************************************************************************/
 /* Function prototypes                                                       */
 /*****************************************************************************/
@@ -1597,11 +1793,18 @@ void bsd_mii_finimedia(dwceqos_dev_t *dwceqos);
 
 /* devctl.c */
 int dwceqos_ioctl (struct ifnet *, unsigned long, caddr_t);
+int dwceqos_drvspec_copyin (struct ifdrv *ifd, void *buf, size_t len);
+int dwceqos_drvspec_copyout (struct ifdrv *ifd, const void *buf, size_t len);
+void dwceqos_rx_stats (dwceqos_dev_t *dwceqos);
 
 /* event.c */
 int dwceqos_process_interrupt (void *, struct nw_work_thread *);
 const struct sigevent *dwceqos_isr (void *, int);
 int dwceqos_enable_interrupt (void *);
+void dwceqos_rx_pool_refill (dwceqos_queue_t *queue, struct nw_work_thread *wtp);
+void dwceqos_rx_pool_free (dwceqos_queue_t *queue);
+int dwceqos_coalesce_valid (dwceqos_dev_t *dwceqos, const dwceqos_coalesce_t *coal);
+void dwceqos_coalesce_apply (dwceqos_dev_t *dwceqos);
 
 /* mii.c */
 void dwceqos_mdi_start_monitor(dwceqos_dev_t *dwceqos);
@@ -1609,9 +1812,22 @@ void dwceqos_mdi_stop_monitor(dwceqos_dev_t *dwceqos);
 void dwceqos_init_phy(dwceqos_dev_t *dwceqos);
 void dwceqos_fini_phy(dwceqos_dev_t *dwceqos);
 
+/* ptp.c */
+int dwceqos_ptp_init (dwceqos_dev_t *dwceqos);
+void dwceqos_ptp_get_time (dwceqos_dev_t *dwceqos, ptp_time_t *ts);
+int dwceqos_ptp_ioctl (dwceqos_dev_t *dwceqos, struct ifdrv *ifd);
+int dwceqos_ptp_get_id (struct mbuf *m, ptp_extts_t *id);
+void dwceqos_ptp_add_rx_ts (dwceqos_dev_t *dwceqos, struct mbuf *m, uint32_t sec, uint32_t nsec);
+void dwceqos_ptp_add_tx_ts (dwceqos_queue_t *queue, int valid, uint32_t sec, uint32_t nsec);
+
+/* tsn.c */
+void dwceqos_cbs_apply (dwceqos_dev_t *dwceqos, uint32_t q);
+int dwceqos_cbs_ioctl (dwceqos_dev_t *dwceqos, struct ifdrv *ifd);
+int dwceqos_est_ioctl (dwceqos_dev_t *dwceqos, struct ifdrv *ifd);
+
 /* transmit.c */
 void dwceqos_start (struct ifnet *);
-void dwceqos_reap_pkts (dwceqos_dev_t *dwceqos);
+void dwceqos_reap_pkts (dwceqos_queue_t *queue);
 
 #ifdef __cplusplus
     };
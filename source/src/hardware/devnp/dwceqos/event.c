@@ -32,11 +32,73 @@
 #include <stdio.h>
 #include <string.h>
 
+/*****************************************************************************/
+/* Top up the pool of Rx clusters, invalidated once here and not per packet. */
+/* The pool is a ring: the refill thread adds at the head while the receive  */
+/* path takes from the tail, each publishes its index after a barrier.       */
+/*****************************************************************************/
+void dwceqos_rx_pool_refill (dwceqos_queue_t *queue, struct nw_work_thread *wtp)
+{
+    dwceqos_dev_t   *dwceqos = queue->dwceqos;
+    struct mbuf     *m;
+    uint32_t        head = queue->rx_pool_head;
+
+    while (head - queue->rx_pool_tail < dwceqos->rx_desc_num) {
+        m = m_getcl_wtp (M_DONTWAIT, MT_DATA, M_PKTHDR, wtp);
+        if (m == NULL) {
+            queue->rx_failed_allocs++;
+            break;
+        }
+
+        CACHE_INVAL (&dwceqos->cachectl, m->m_data, mbuf_phys(m), m->m_ext.ext_size);
+        queue->rx_pool[head++ & (dwceqos->rx_desc_num - 1)] = m;
+    }
+
+    __sync_synchronize();
+    queue->rx_pool_head = head;
+}
+
+/* Once the Rx threads and the refill thread are gone */
+void dwceqos_rx_pool_free (dwceqos_queue_t *queue)
+{
+    dwceqos_dev_t   *dwceqos = queue->dwceqos;
+
+    while (queue->rx_pool_tail != queue->rx_pool_head) {
+        m_free (queue->rx_pool[queue->rx_pool_tail++ & (dwceqos->rx_desc_num - 1)]);
+    }
+}
+
+/*****************************************************************************/
+/* Rx timestamp, in the context descriptor following the packet             */
+/*****************************************************************************/
+static void dwceqos_rx_timestamp (dwceqos_queue_t *queue, struct mbuf *m)
+{
+    dwceqos_desc_t  *cdesc = &(queue->rx_desc[queue->rx_desc_head]);
+    int             cnt = 10;
+
+    /* The DMA writes it back right after the packet descriptor */
+    while ((cdesc->des3 & RDES3_OWN) && --cnt) {
+        nanospin_ns(100);
+    }
+
+    if ((cdesc->des3 & (RDES3_OWN | RDES3_CTXT)) != RDES3_CTXT) {
+        return;
+    }
+
+    /* All ones is a corrupted timestamp */
+    if ((cdesc->des0 == 0xFFFFFFFF) && (cdesc->des1 == 0xFFFFFFFF)) {
+        return;
+    }
+
+    dwceqos_ptp_add_rx_ts(queue->dwceqos, m, cdesc->des1, cdesc->des0);
+}
+
 /*****************************************************************************/
 /*                                                                           */
 /*****************************************************************************/
-static int dwceqos_receive (dwceqos_dev_t *dwceqos, struct nw_work_thread *wtp)
+static int dwceqos_receive (dwceqos_queue_t *queue, struct nw_work_thread *wtp)
 {
+    dwceqos_dev_t   *dwceqos = queue->dwceqos;
     struct mbuf     *new, *m;
     int             pkt_len;
     struct ifnet    *ifp;
@@ -44,62 +106,78 @@ static int dwceqos_receive (dwceqos_dev_t *dwceqos, struct nw_work_thread *wtp)
     uint32_t        rdes1;
     uint32_t        mtu;
     struct ether_vlan_header    *vlan_hdr;
+    uint32_t        idx, ioc;
+    uint32_t        pool_tail, pool_cnt;
+    int             pkts = 0;
 
     ifp = &dwceqos->ecom.ec_if;
 
+    /* The clusters the refill thread published so far */
+    pool_tail = queue->rx_pool_tail;
+    pool_cnt = queue->rx_pool_head - pool_tail;
+    __sync_synchronize();
+
     while (1) {
-        rdesc = &(dwceqos->rx_desc[dwceqos->rx_desc_head]);
+        idx = queue->rx_desc_head;
+        rdesc = &(queue->rx_desc[idx]);
         if (rdesc->des3 & RDES3_OWN) {
             break;
         }
 
-        dwceqos->rx_desc_head = (dwceqos->rx_desc_head + 1) % dwceqos->rx_desc_num;
+        ioc = dwceqos_rx_ioc(queue, idx);
+        queue->rx_desc_head = (queue->rx_desc_head + 1) & (dwceqos->rx_desc_num - 1);
+
+        /* A context descriptor, its timestamp was taken with the previous packet */
+        if (rdesc->des3 & RDES3_CTXT) {
+            rdesc->des0 = mbuf_phys(queue->rx_mbuf[idx]);
+            rdesc->des1 = 0;
+            rdesc->des2 = 0;
+            __sync_synchronize();
+            rdesc->des3 = (RDES3_OWN | RDES3_BUF1V | ioc);
+            __sync_synchronize();
+            continue;
+        }
+
+        pkts++;
 
         pkt_len = rdesc->des3 & RDES3_PL_MASK;
 
         mtu = ifp->if_mtu + ETHER_HDR_LEN;
 
         /* Extra bytes for VLAN packet */
-        vlan_hdr = mtod(rdesc->m, struct ether_vlan_header*);
+        vlan_hdr = mtod(queue->rx_mbuf[idx], struct ether_vlan_header*);
         if (ntohs(vlan_hdr->evl_encap_proto) == ETHERTYPE_VLAN) {
             mtu += ETHER_VLAN_ENCAP_LEN;
         }
 
-        /* Drop the packet, reinitialize the desc */
-        if ((rdesc->des3 & RDES3_ES) || (pkt_len > mtu)) {
-            rdesc->des0 = mbuf_phys(rdesc->m);
+        /*
+         * Drop the packet, reinitialize the desc. Also when the pool has no
+         * cluster to replace it, the descriptor goes back to the DMA either way.
+         */
+        if ((rdesc->des3 & RDES3_ES) || (pkt_len > mtu) || (pool_cnt == 0)) {
+            rdesc->des0 = mbuf_phys(queue->rx_mbuf[idx]);
             rdesc->des1 = 0;
             rdesc->des2 = 0;
             __sync_synchronize();
-            rdesc->des3 = (RDES3_OWN | RDES3_BUF1V | RDES3_IOC);
+            rdesc->des3 = (RDES3_OWN | RDES3_BUF1V | ioc);
             __sync_synchronize();
-            ifp->if_ierrors++;
+            queue->rx_errors++;
             continue;
         }
 
-        /* Get a new mbuf for the desc */
-        new = m_getcl_wtp (M_DONTWAIT, MT_DATA, M_PKTHDR, wtp);
-        if (new == NULL) {
-            if (dwceqos->cfg.verbose) {
-                slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: Line %d m_getcl_wtp returned NULL", __func__, __LINE__);
-            }
-
-            ifp->if_ierrors++;
-            dwceqos->stats.rx_failed_allocs++;
-            break;
-        }
-
-        CACHE_INVAL (&dwceqos->cachectl, new->m_data, mbuf_phys(new), new->m_ext.ext_size);
+        /* Take a new mbuf for the desc from the pool */
+        new = queue->rx_pool[pool_tail++ & (dwceqos->rx_desc_num - 1)];
+        pool_cnt--;
 
-        m = rdesc->m;
-        rdesc->m = new;
+        m = queue->rx_mbuf[idx];
+        queue->rx_mbuf[idx] = new;
         rdes1 = rdesc->des1;
 
         rdesc->des0 = mbuf_phys(new);
         rdesc->des1 = 0;
         rdesc->des2 = 0;
         __sync_synchronize();
-        rdesc->des3 = (RDES3_OWN | RDES3_BUF1V | RDES3_IOC);
+        rdesc->des3 = (RDES3_OWN | RDES3_BUF1V | ioc);
         __sync_synchronize();
 
         m->m_pkthdr.len = pkt_len;
@@ -124,67 +202,170 @@ static int dwceqos_receive (dwceqos_dev_t *dwceqos, struct nw_work_thread *wtp)
 
         CACHE_INVAL(&dwceqos->cachectl, m->m_data, mbuf_phys(m), pkt_len);
 
+        /* Timestamp of a PTP event message */
+        if ((rdes1 & RDES1_TSA) && dwceqos->is_ptp_enabled) {
+            dwceqos_rx_timestamp(queue, m);
+        }
+
 #if NBPFILTER > 0
         /* Pass this up to any BPF listeners. */
         if (ifp->if_bpf) {
             bpf_mtap (ifp->if_bpf, m);
         }
 #endif
-        dwceqos->stats.rxed_ok++;
-        ifp->if_ipackets++;
+        queue->rxed_ok++;
         (*ifp->if_input)(ifp, m);
     }
 
+    /* Done with the clusters taken, the refill thread may reuse their slots */
+    __sync_synchronize();
+    queue->rx_pool_tail = pool_tail;
+
     /* DMA maybe in suspect mode, poll to wake it */
-    out32(dwceqos->mac_base + DMA_CHi_RXDESC_TAIL_PTR(0), (uintptr_t)dwceqos->rx_desc_tail);
+    out32(dwceqos->mac_base + DMA_CHi_RXDESC_TAIL_PTR(queue->idx), (uintptr_t)queue->rx_desc_tail);
 
-    return EOK;
+    return pkts;
 }
 
 /*****************************************************************************/
-/*                                                                           */
+/* Check interrupt moderation settings against the ring sizes                */
+/*****************************************************************************/
+int dwceqos_coalesce_valid (dwceqos_dev_t *dwceqos, const dwceqos_coalesce_t *coal)
+{
+    if ((coal->rx_frames == 0) || (coal->rx_frames & (coal->rx_frames - 1)) ||
+        (coal->rx_frames > dwceqos->rx_desc_num / 2)) {
+        return 0;
+    }
+
+    /* Without the watchdog the last frames of a burst would wait for more traffic */
+    if ((coal->rx_frames > 1) && (coal->rx_usecs == 0)) {
+        return 0;
+    }
+
+    if (coal->rx_usecs * DWCEQOS_SYS_CLK_MHZ > RWT_MAX_CYCLES) {
+        return 0;
+    }
+
+    if ((coal->tx_frames > dwceqos->tx_desc_num / 2) || (coal->adaptive > 1)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/*****************************************************************************/
+/* Program the Rx watchdog of every queue. The frame counts take effect as   */
+/* the Rx descriptors are refilled and the Tx interrupt enable on the next   */
+/* unmask.                                                                   */
+/*****************************************************************************/
+void dwceqos_coalesce_apply (dwceqos_dev_t *dwceqos)
+{
+    dwceqos_coalesce_t  *coal = &dwceqos->coal;
+    uint32_t            cycles, rwtu, riwt = 0;
+    uint32_t            i;
+
+    if (coal->rx_usecs != 0) {
+        cycles = coal->rx_usecs * DWCEQOS_SYS_CLK_MHZ;
+        for (rwtu = 0; rwtu < 3; rwtu++) {
+            if (cycles / (256 << rwtu) <= 0xFF) {
+                break;
+            }
+        }
+        riwt = max(cycles / (256 << rwtu), 1);
+        riwt = RWTU(rwtu) | (riwt & RWT_MASK);
+    }
+
+    /* Timestamped PTP frames always ask for a completion interrupt */
+    dwceqos->dma_intr_en = DMA_CHi_INTR_DEFAULT;
+    if ((coal->tx_frames != 0) || dwceqos->is_ptp_enabled) {
+        dwceqos->dma_intr_en |= TIE;
+    }
+
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        dwceqos->queue[i].rx_coal_cur = coal->adaptive ? 1 : coal->rx_frames;
+        dwceqos->queue[i].tx_coal_cnt = 0;
+        out32(dwceqos->mac_base + DMA_CHi_RX_INTR_WDG_TIMER(i), riwt);
+    }
+}
+
+/*****************************************************************************/
+/* Adaptive moderation: a queue that finds twice its frame count waiting     */
+/* doubles it, one whose watchdog fired before the count was reached halves  */
+/* it, down to an interrupt per frame for latency sensitive traffic.         */
+/*****************************************************************************/
+static void dwceqos_coalesce_adapt (dwceqos_queue_t *queue, int pkts)
+{
+    dwceqos_dev_t   *dwceqos = queue->dwceqos;
+
+    if (pkts >= queue->rx_coal_cur * 2) {
+        if (queue->rx_coal_cur < dwceqos->coal.rx_frames) {
+            queue->rx_coal_cur <<= 1;
+        }
+    } else if (pkts < queue->rx_coal_cur) {
+        if (queue->rx_coal_cur > 1) {
+            queue->rx_coal_cur >>= 1;
+        }
+    }
+}
+
+/*****************************************************************************/
+/* Service one queue, arg is the dwceqos_queue_t its interrupt entry is for  */
 /*****************************************************************************/
 int dwceqos_process_interrupt (void *arg, struct nw_work_thread *wtp)
 {
-    dwceqos_dev_t   *dwceqos = arg;
+    dwceqos_queue_t *queue = arg;
+    dwceqos_dev_t   *dwceqos = queue->dwceqos;
     struct ifnet    *ifp;
     uint32_t        status;
     uintptr_t       mac_base;
+    int             pkts = 0;
 
     ifp = &dwceqos->ecom.ec_if;
     mac_base = dwceqos->mac_base;
 
     /* Fetch and clear current DMA channel interrupt status */
-    status = in32(mac_base + DMA_CHi_STATUS(0));
+    status = in32(mac_base + DMA_CHi_STATUS(queue->idx));
 
     do {
 
         if (status & RI) {
-            out32 (mac_base + DMA_CHi_STATUS(0), RI);
-            dwceqos_receive (dwceqos, wtp);
+            out32 (mac_base + DMA_CHi_STATUS(queue->idx), RI);
+            pkts += dwceqos_receive (queue, wtp);
+
+            /* Have the pool refilled in bulk once half of it is used, not in this thread */
+            if ((queue->rx_pool_head - queue->rx_pool_tail < dwceqos->rx_desc_num / 2) &&
+                !queue->rx_pool_low) {
+                queue->rx_pool_low = 1;
+                MsgSendPulse (dwceqos->rx_refill_coid, dwceqos->rx_refill_prio,
+                              DWCEQOS_RX_REFILL_PULSE, queue->idx);
+            }
         }
 
-        if (status & TBU) {
-            out32(mac_base + DMA_CHi_STATUS(0), TBU);
+        if (status & (TBU | TI)) {
+            out32(mac_base + DMA_CHi_STATUS(queue->idx), status & (TBU | TI));
             /* If out of Tx descriptors call start to reap and Tx more */
             NW_SIGLOCK_P(&ifp->if_snd_ex, dwceqos->iopkt, wtp);
             if (ifp->if_flags_tx & IFF_OACTIVE) {
                 dwceqos_start(ifp);
             } else {
-                dwceqos_reap_pkts (dwceqos);
+                dwceqos_reap_pkts (queue);
                 NW_SIGUNLOCK_P(&ifp->if_snd_ex, dwceqos->iopkt, wtp);
             }
         }
 
         if (status & FBE) {
-            out32(mac_base + DMA_CHi_STATUS(0), REB | TEB);
+            out32(mac_base + DMA_CHi_STATUS(queue->idx), REB | TEB);
         }
 
-        status = in32(mac_base + DMA_CHi_STATUS(0));
-    } while (status & (TBU | RI));
+        status = in32(mac_base + DMA_CHi_STATUS(queue->idx));
+    } while (status & (TBU | TI | RI));
 
     /* Clean other status */
-    out32(mac_base + DMA_CHi_STATUS(0), status);
+    out32(mac_base + DMA_CHi_STATUS(queue->idx), status);
+
+    if (dwceqos->coal.adaptive && (pkts != 0)) {
+        dwceqos_coalesce_adapt (queue, pkts);
+    }
 
     return 1;
 }
@@ -194,25 +375,41 @@ int dwceqos_process_interrupt (void *arg, struct nw_work_thread *wtp)
 /**************************************************************************/
 int dwceqos_enable_interrupt (void *arg)
 {
-    dwceqos_dev_t  *dwceqos = arg;
+    dwceqos_queue_t  *queue = arg;
 
-    /* Re-enable interrupt enables */
-    InterruptUnmask(dwceqos->cfg.irq[0], dwceqos->iid);
+    /* Re-enable the DMA channel interrupts masked by the ISR */
+    out32(queue->dwceqos->mac_base + DMA_CHi_INTR_EN(queue->idx), queue->dwceqos->dma_intr_en);
     return 1;
 }
 
 /*****************************************************************************/
-/*                                                                           */
+/* All DMA channels share one vector. Mask each channel that is interrupting */
+/* and queue its own interrupt entry, so io-pkt can service the queues from  */
+/* different threads.                                                        */
 /*****************************************************************************/
 const struct sigevent *dwceqos_isr (void *arg, int iid)
 {
-    dwceqos_dev_t         *dwceqos = arg;
-    struct _iopkt_inter   *ient = &dwceqos->inter;
+    dwceqos_dev_t           *dwceqos = arg;
+    const struct sigevent   *evp = NULL, *ev;
+    uint32_t                status;
+    uint32_t                i;
+
+    status = in32(dwceqos->mac_base + DMA_INTR_STS);
 
-    /* Mask all dma interrupts */
-    InterruptMask(dwceqos->cfg.irq[0], dwceqos->iid);
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        if ((status & DCiIS(i)) == 0) {
+            continue;
+        }
+
+        out32(dwceqos->mac_base + DMA_CHi_INTR_EN(i), 0);
+
+        ev = interrupt_queue (dwceqos->iopkt, &dwceqos->queue[i].inter);
+        if (ev != NULL) {
+            evp = ev;
+        }
+    }
 
-    return interrupt_queue (dwceqos->iopkt, ient);
+    return evp;
 }
 
 
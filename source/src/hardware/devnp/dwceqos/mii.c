@@ -111,27 +111,30 @@ static void dwceqos_set_rx_control (dwceqos_dev_t *dwceqos, int enable)
 
 static void dwceqos_set_tx_control (dwceqos_dev_t *dwceqos, int enable)
 {
-    uint32_t reg;
+    uint32_t reg, i;
+
+    /* Every queue sends pause frames on its own threshold, enable all of them */
+    for (i = 0; i < dwceqos->num_queues; i++) {
+        /* MTL */
+        reg = in32(dwceqos->mac_base + MTL_RXQi_OPERATION_MODE(i));
+        if (enable) {
+            reg |= EHFC;
+        } else {
+            reg &= ~EHFC;
+        }
 
-    /* MTL */
-    reg = in32(dwceqos->mac_base + MTL_RXQi_OPERATION_MODE(0));
-    if (enable) {
-        reg |= EHFC;
-    } else {
-        reg &= ~EHFC;
-    }
+        out32(dwceqos->mac_base + MTL_RXQi_OPERATION_MODE(i), reg);
 
-    out32(dwceqos->mac_base + MTL_RXQi_OPERATION_MODE(0), reg);
+        /* MAC */
+        reg = in32(dwceqos->mac_base + MAC_Qi_TX_FLOW_CTRL(i));
+        if (enable) {
+            reg |= TFE;
+        } else {
+            reg &= ~TFE;
+        }
 
-    /* MAC */
-    reg = in32(dwceqos->mac_base + MAC_Qi_TX_FLOW_CTRL(0));
-    if (enable) {
-        reg |= TFE;
-    } else {
-        reg &= ~TFE;
+        out32(dwceqos->mac_base + MAC_Qi_TX_FLOW_CTRL(i), reg);
     }
-
-    out32(dwceqos->mac_base + MAC_Qi_TX_FLOW_CTRL(0), reg);
 }
 
 /*****************************************************************************/
@@ -141,7 +144,7 @@ static void dwceqos_linkup(dwceqos_dev_t *dwceqos, uint32_t mode, uint32_t flow)
 {
     const char      *s;
     nic_config_t    *cfg = &dwceqos->cfg;
-    uint32_t        maccontrol;
+    uint32_t        maccontrol, i;
 
     cfg->media_rate = -1;   /* Unknown */
     cfg->duplex = -1;       /* Unknown */
@@ -226,6 +229,11 @@ static void dwceqos_linkup(dwceqos_dev_t *dwceqos, uint32_t mode, uint32_t flow)
 
         out32(dwceqos->mac_base + MAC_CFG, maccontrol);
 
+        /* The shaper slopes depend on the speed */
+        for (i = 1; i < dwceqos->num_queues; i++) {
+            dwceqos_cbs_apply(dwceqos, i);
+        }
+
         if (cfg->verbose) {
             slogf(_SLOGC_NETWORK, _SLOG_INFO, "devnp-dwceqos: Link up (%s) %s", __func__, s);
         }
@@ -312,6 +320,9 @@ static void dwceqos_MDI_MonitorPhy (void *arg)
 
     MDI_MonitorPhy(dwceqos->mdi);
 
+    /* Keep the interface counters current for netstat */
+    dwceqos_rx_stats(dwceqos);
+
     callout_msec(&dwceqos->mii_callout, 3 * 1000, dwceqos_MDI_MonitorPhy, arg);
 }
 
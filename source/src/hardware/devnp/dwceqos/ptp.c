@@ -0,0 +1,351 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2019, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+#include <dwceqos.h>
+#include <net/ifdrvcom.h>
+#include <net/if_vlanvar.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/udp.h>
+#include <time.h>
+
+#define NSEC_PER_SEC    1000000000ULL
+
+/*****************************************************************************/
+/* Wait for a self clearing MAC_TIMESTAMP_CTRL bit                           */
+/*****************************************************************************/
+static int dwceqos_ptp_wait (dwceqos_dev_t *dwceqos, uint32_t bit)
+{
+    int  cnt = 100;
+
+    while ((in32(dwceqos->mac_base + MAC_TIMESTAMP_CTRL) & bit) && --cnt) {
+        nic_delay(1);
+    }
+
+    if (cnt <= 0) {
+        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: timeout!", __func__);
+        return ETIMEDOUT;
+    }
+
+    return EOK;
+}
+
+/*****************************************************************************/
+/* Load the frequency correction, the addend scaled by comp ppb              */
+/*****************************************************************************/
+static int dwceqos_ptp_set_addend (dwceqos_dev_t *dwceqos, const ptp_comp_t *comp)
+{
+    uint64_t  delta, addend;
+
+    if (comp->comp >= NSEC_PER_SEC) {
+        return EINVAL;
+    }
+
+    delta = ((uint64_t)dwceqos->ptp_addend * comp->comp) / NSEC_PER_SEC;
+    addend = comp->positive ? (dwceqos->ptp_addend + delta) : (dwceqos->ptp_addend - delta);
+    if (addend > UINT32_MAX) {
+        return EINVAL;
+    }
+
+    out32(dwceqos->mac_base + MAC_TIMESTAMPADDEND, (uint32_t)addend);
+    out32(dwceqos->mac_base + MAC_TIMESTAMP_CTRL, in32(dwceqos->mac_base + MAC_TIMESTAMP_CTRL) | TSADDREG);
+    dwceqos->ptp_comp = *comp;
+
+    return dwceqos_ptp_wait(dwceqos, TSADDREG);
+}
+
+/*****************************************************************************/
+/* Read the system time, the seconds again in case the nanoseconds wrapped   */
+/*****************************************************************************/
+void dwceqos_ptp_get_time (dwceqos_dev_t *dwceqos, ptp_time_t *ts)
+{
+    uint32_t  sec, nsec;
+
+    do {
+        sec = in32(dwceqos->mac_base + MAC_SYSTEM_TIME_SEC);
+        nsec = in32(dwceqos->mac_base + MAC_SYSTEM_TIME_NANO) & TSSS_MASK;
+    } while (sec != in32(dwceqos->mac_base + MAC_SYSTEM_TIME_SEC));
+
+    ts->seconds = sec;
+    ts->nanoseconds = nsec;
+}
+
+static int dwceqos_ptp_set_time (dwceqos_dev_t *dwceqos, const ptp_time_t *ts)
+{
+    if (ts->nanoseconds >= NSEC_PER_SEC) {
+        return EINVAL;
+    }
+
+    out32(dwceqos->mac_base + MAC_SYSTEM_TIME_SEC_UP, (uint32_t)ts->seconds);
+    out32(dwceqos->mac_base + MAC_SYSTEM_TIME_NANO_UP, ts->nanoseconds);
+    out32(dwceqos->mac_base + MAC_TIMESTAMP_CTRL, in32(dwceqos->mac_base + MAC_TIMESTAMP_CTRL) | TSINIT);
+
+    return dwceqos_ptp_wait(dwceqos, TSINIT);
+}
+
+/*****************************************************************************/
+/* Start the system time generator with fine correction                     */
+/*****************************************************************************/
+int dwceqos_ptp_init (dwceqos_dev_t *dwceqos)
+{
+    struct timespec  now;
+    ptp_time_t       ts;
+    ptp_comp_t       comp;
+    uint32_t         ssinc;
+    int              err;
+
+    /*
+     * In fine mode the accumulator overflows at half the reference clock,
+     * every ssinc ns, when the addend is 2^32 * (1000 / ssinc) / clock MHz.
+     * Digital rollover keeps the nanoseconds register in ns.
+     */
+    ssinc = 2000 / DWCEQOS_PTP_CLK_MHZ;
+    dwceqos->ptp_addend = (uint32_t)((((uint64_t)1 << 32) * 1000 / ssinc) / DWCEQOS_PTP_CLK_MHZ);
+    memset(&comp, 0, sizeof(comp));
+
+    out32(dwceqos->mac_base + MAC_TIMESTAMP_CTRL, TSENA | TSCTRLSSR | TSCFUPDT);
+    out32(dwceqos->mac_base + MAC_SUB_SECOND_INC, (ssinc << SSINC_SHIFT) & SSINC_MASK);
+
+    if ((err = dwceqos_ptp_set_addend(dwceqos, &comp)) != EOK) {
+        return err;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    ts.seconds = now.tv_sec;
+    ts.nanoseconds = now.tv_nsec;
+    if ((err = dwceqos_ptp_set_time(dwceqos, &ts)) != EOK) {
+        return err;
+    }
+
+    /* Snapshot the event messages of PTPv2 over Ethernet, IPv4 and IPv6 */
+    out32(dwceqos->mac_base + MAC_TIMESTAMP_CTRL, TSENA | TSCTRLSSR | TSCFUPDT | TSVER2ENA |
+          TSIPENA | TSIPV4ENA | TSIPV6ENA | TSEVNTENA | SNAPTYPSEL_1);
+
+    dwceqos->ptp_rx_ts_cnt = 0;
+    dwceqos->ptp_tx_ts_cnt = 0;
+
+    return pthread_mutex_init(&dwceqos->ptp_ts_mutex, NULL);
+}
+
+/*****************************************************************************/
+/* Identity of a PTP event message, 0 if the packet is not one              */
+/*****************************************************************************/
+int dwceqos_ptp_get_id (struct mbuf *m, ptp_extts_t *id)
+{
+    uint8_t             *data = mtod(m, uint8_t *);
+    uint8_t             *hdr;
+    uint32_t            off = ETHER_HDR_LEN;
+    uint16_t            type;
+    struct ip           *ip;
+    struct ip6_hdr      *ip6;
+    struct udphdr       *udp = NULL;
+
+    if (m->m_len < off) {
+        return 0;
+    }
+
+    type = ntohs(((struct ether_header *)data)->ether_type);
+    if (type == ETHERTYPE_VLAN) {
+        if (m->m_len < off + ETHER_VLAN_ENCAP_LEN) {
+            return 0;
+        }
+        type = ntohs(((struct ether_vlan_header *)data)->evl_proto);
+        off += ETHER_VLAN_ENCAP_LEN;
+    }
+
+    switch (type) {
+        case DWCEQOS_PTP_ETHERTYPE:
+            break;
+
+        case ETHERTYPE_IP:
+            ip = (struct ip *)(data + off);
+            if ((m->m_len < off + sizeof(*ip)) || (ip->ip_p != IPPROTO_UDP)) {
+                return 0;
+            }
+            off += ip->ip_hl << 2;
+            udp = (struct udphdr *)(data + off);
+            off += sizeof(*udp);
+            break;
+
+        case ETHERTYPE_IPV6:
+            ip6 = (struct ip6_hdr *)(data + off);
+            if ((m->m_len < off + sizeof(*ip6)) || (ip6->ip6_nxt != IPPROTO_UDP)) {
+                return 0;
+            }
+            off += sizeof(*ip6);
+            udp = (struct udphdr *)(data + off);
+            off += sizeof(*udp);
+            break;
+
+        default:
+            return 0;
+    }
+
+    if (m->m_len < off + DWCEQOS_PTP_HDR_LEN) {
+        return 0;
+    }
+    if ((udp != NULL) && (ntohs(udp->uh_dport) != DWCEQOS_PTP_EVENT_PORT)) {
+        return 0;
+    }
+
+    hdr = data + off;
+    if (!DWCEQOS_PTP_MSG_IS_EVENT(DWCEQOS_PTP_MSG_TYPE(hdr))) {
+        return 0;
+    }
+
+    id->msg_type = DWCEQOS_PTP_MSG_TYPE(hdr);
+    memcpy(id->clock_identity, hdr + DWCEQOS_PTP_CLOCK_ID_OFF, sizeof(id->clock_identity));
+    id->source_port_id = (hdr[DWCEQOS_PTP_PORT_NUM_OFF] << 8) | hdr[DWCEQOS_PTP_PORT_NUM_OFF + 1];
+    id->sequence_id = (hdr[DWCEQOS_PTP_SEQ_ID_OFF] << 8) | hdr[DWCEQOS_PTP_SEQ_ID_OFF + 1];
+
+    return 1;
+}
+
+/*****************************************************************************/
+/* Timestamps are kept in rings, the oldest overwritten, ptp_ts_mutex held   */
+/*****************************************************************************/
+static void dwceqos_ptp_add_ts (ptp_extts_t *ring, uint32_t *cnt, const ptp_extts_t *id,
+                                uint32_t sec, uint32_t nsec)
+{
+    ptp_extts_t  *ts = &ring[*cnt % DWCEQOS_PTP_TS_NUM];
+
+    *ts = *id;
+    ts->ts.seconds = sec;
+    ts->ts.nanoseconds = nsec;
+    (*cnt)++;
+}
+
+void dwceqos_ptp_add_rx_ts (dwceqos_dev_t *dwceqos, struct mbuf *m, uint32_t sec, uint32_t nsec)
+{
+    ptp_extts_t  id;
+
+    if (dwceqos_ptp_get_id(m, &id)) {
+        pthread_mutex_lock(&dwceqos->ptp_ts_mutex);
+        dwceqos_ptp_add_ts(dwceqos->ptp_rx_ts, &dwceqos->ptp_rx_ts_cnt, &id, sec, nsec);
+        pthread_mutex_unlock(&dwceqos->ptp_ts_mutex);
+    }
+}
+
+/*
+ * A frame sent with a timestamp request completed, the requests complete in
+ * the order they were queued. The request is consumed even when the MAC did
+ * not capture a timestamp (valid 0), so the later ones stay paired.
+ */
+void dwceqos_ptp_add_tx_ts (dwceqos_queue_t *queue, int valid, uint32_t sec, uint32_t nsec)
+{
+    dwceqos_dev_t  *dwceqos = queue->dwceqos;
+    ptp_extts_t    *id;
+
+    if (queue->tx_ts_head == queue->tx_ts_tail) {
+        return;
+    }
+
+    id = &queue->tx_ts_pend[queue->tx_ts_tail & (DWCEQOS_PTP_TX_PEND - 1)];
+    queue->tx_ts_tail++;
+    if (valid) {
+        pthread_mutex_lock(&dwceqos->ptp_ts_mutex);
+        dwceqos_ptp_add_ts(dwceqos->ptp_tx_ts, &dwceqos->ptp_tx_ts_cnt, id, sec, nsec);
+        pthread_mutex_unlock(&dwceqos->ptp_ts_mutex);
+    }
+}
+
+/* The newest timestamp of the message, ENOENT if it is not (yet) there */
+static int dwceqos_ptp_find_ts (const ptp_extts_t *ring, uint32_t cnt, ptp_extts_t *id)
+{
+    uint32_t     i, n;
+    ptp_extts_t  ts;
+
+    n = min(cnt, DWCEQOS_PTP_TS_NUM);
+    for (i = 1; i <= n; i++) {
+        ts = ring[(cnt - i) % DWCEQOS_PTP_TS_NUM];
+        if ((ts.msg_type == id->msg_type) && (ts.sequence_id == id->sequence_id) &&
+            (ts.source_port_id == id->source_port_id) &&
+            (memcmp(ts.clock_identity, id->clock_identity, sizeof(ts.clock_identity)) == 0)) {
+            id->ts = ts.ts;
+            return EOK;
+        }
+    }
+
+    return ENOENT;
+}
+
+/*****************************************************************************/
+/* PTP SIOCGDRVSPEC/SIOCSDRVSPEC commands                                    */
+/*****************************************************************************/
+int dwceqos_ptp_ioctl (dwceqos_dev_t *dwceqos, struct ifdrv *ifd)
+{
+    ptp_extts_t  ts;
+    ptp_time_t   time;
+    ptp_comp_t   comp;
+    int          err;
+
+    if (!dwceqos->is_ptp_enabled) {
+        return ENOTSUP;
+    }
+
+    switch (ifd->ifd_cmd) {
+        case PTP_GET_RX_TIMESTAMP:
+        case PTP_GET_TX_TIMESTAMP:
+            if ((err = dwceqos_drvspec_copyin(ifd, &ts, sizeof(ts))) != EOK) {
+                return err;
+            }
+            pthread_mutex_lock(&dwceqos->ptp_ts_mutex);
+            if (ifd->ifd_cmd == PTP_GET_RX_TIMESTAMP) {
+                err = dwceqos_ptp_find_ts(dwceqos->ptp_rx_ts, dwceqos->ptp_rx_ts_cnt, &ts);
+            } else {
+                err = dwceqos_ptp_find_ts(dwceqos->ptp_tx_ts, dwceqos->ptp_tx_ts_cnt, &ts);
+            }
+            pthread_mutex_unlock(&dwceqos->ptp_ts_mutex);
+            if (err != EOK) {
+                return err;
+            }
+            return dwceqos_drvspec_copyout(ifd, &ts, sizeof(ts));
+
+        case PTP_GET_TIME:
+            dwceqos_ptp_get_time(dwceqos, &time);
+            return dwceqos_drvspec_copyout(ifd, &time, sizeof(time));
+
+        case PTP_SET_TIME:
+            if ((err = dwceqos_drvspec_copyin(ifd, &time, sizeof(time))) != EOK) {
+                return err;
+            }
+            return dwceqos_ptp_set_time(dwceqos, &time);
+
+        case PTP_GET_COMPENSATION:
+            return dwceqos_drvspec_copyout(ifd, &dwceqos->ptp_comp, sizeof(dwceqos->ptp_comp));
+
+        case PTP_SET_COMPENSATION:
+            if ((err = dwceqos_drvspec_copyin(ifd, &comp, sizeof(comp))) != EOK) {
+                return err;
+            }
+            return dwceqos_ptp_set_addend(dwceqos, &comp);
+
+        default:
+            return ENOTTY;
+    }
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
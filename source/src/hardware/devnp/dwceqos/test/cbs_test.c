@@ -0,0 +1,79 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Credit based shaper register values at 10M, 100M and 1G. The expected
+ * values follow the 802.1Q Annex L credits with the MAC's bits per cycle
+ * and 1024 scaling, for a 1522 byte tagged frame.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "tsn_calc.h"
+
+#define FRAME_LEN   1522
+
+static const struct {
+    uint32_t            port_rate;      /* kbit/s */
+    uint32_t            idle_slope;     /* kbit/s */
+    dwceqos_cbs_regs_t  regs;
+} cases[] = {
+    /* 20% of the link, the slopes only depend on the share and bits per cycle */
+    {   10000,   2000, { 0x333,  0xccc,  0x260ccc, 0xff67cccd } },
+    {  100000,  20000, { 0x333,  0xccc,  0x260ccc, 0xff67cccd } },
+    { 1000000, 200000, { 0x666,  0x1999, 0x260ccc, 0xff67cccd } },
+    /* 75% of the link */
+    {   10000,   7500, { 0xc00,  0x400,  0x8eb000, 0xffd07000 } },
+    {  100000,  75000, { 0xc00,  0x400,  0x8eb000, 0xffd07000 } },
+    { 1000000, 750000, { 0x1800, 0x800,  0x8eb000, 0xffd07000 } },
+    /* A single kbit/s is rounded up to the smallest slope, nearly all of a gigabit */
+    { 1000000,      1, { 0x1,    0x1fff, 0xc,      0xff41c00d } },
+    { 1000000, 999999, { 0x1fff, 0x0,    0xbe3ff3, 0xfffffff4 } },
+};
+
+int main (void)
+{
+    dwceqos_cbs_regs_t  regs;
+    unsigned            i, fail = 0;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        dwceqos_cbs_regs(cases[i].idle_slope, cases[i].port_rate, FRAME_LEN, &regs);
+
+        printf("%7u/%7u kbit/s: idle 0x%04x send 0x%04x hi 0x%08x lo 0x%08x",
+               cases[i].idle_slope, cases[i].port_rate,
+               regs.idle_slope, regs.send_slope, regs.hi_credit, regs.lo_credit);
+
+        if ((regs.idle_slope != cases[i].regs.idle_slope) || (regs.send_slope != cases[i].regs.send_slope) ||
+            (regs.hi_credit != cases[i].regs.hi_credit) || (regs.lo_credit != cases[i].regs.lo_credit)) {
+            printf("  FAIL, expected idle 0x%04x send 0x%04x hi 0x%08x lo 0x%08x\n",
+                   cases[i].regs.idle_slope, cases[i].regs.send_slope,
+                   cases[i].regs.hi_credit, cases[i].regs.lo_credit);
+            fail++;
+        } else {
+            printf("  ok\n");
+        }
+    }
+
+    printf("cbs_test: %u of %u failed\n", fail, i);
+
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * EST gate control list checks: validation, the start time a list gets
+ * from its base time, and the longest time each queue waits for its gate
+ * over a cycle, within a list, from the ioctl and across a list change.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tsn_calc.h"
+
+#define US              1000ULL
+#define NUM_QUEUES      4
+#define DEPTH           64
+#define WID             24
+
+static unsigned     fail, checks;
+
+static void check (int ok, const char *what)
+{
+    checks++;
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        fail++;
+    }
+}
+
+static void gcl (dwceqos_est_t *est, uint32_t cycle_time, uint32_t n, const dwceqos_gcl_entry_t *e)
+{
+    memset(est, 0, sizeof(*est));
+    est->enable = 1;
+    est->cycle_time = cycle_time;
+    est->num_entries = n;
+    memcpy(est->gcl, e, n * sizeof(*e));
+}
+
+static void print_waits (const char *name, const dwceqos_est_t *est)
+{
+    dwceqos_est_wait_t  w;
+    uint32_t            q;
+
+    printf("%s, cycle %u ns:\n", name, est->cycle_time);
+    for (q = 0; q < NUM_QUEUES; q++) {
+        dwceqos_est_wait(est, q, &w);
+        if (w.max == DWCEQOS_EST_NEVER) {
+            printf("  queue %u: gate never opens\n", q);
+        } else {
+            printf("  queue %u: longest wait %llu ns, closed %llu ns at cycle start, %llu ns at its end\n",
+                   q, (unsigned long long)w.max, (unsigned long long)w.head, (unsigned long long)w.tail);
+        }
+    }
+}
+
+static void test_valid (void)
+{
+    static const dwceqos_gcl_entry_t  e[] = { { 0x3, 500 * US }, { 0xc, 500 * US } };
+    dwceqos_est_t                     est;
+
+    gcl(&est, 1000 * US, 2, e);
+    check(dwceqos_est_valid(&est, NUM_QUEUES, DEPTH, WID), "list filling the cycle is valid");
+
+    est.cycle_time = 999 * US;
+    check(!dwceqos_est_valid(&est, NUM_QUEUES, DEPTH, WID), "intervals longer than the cycle");
+
+    est.cycle_time = 1000 * US;
+    check(!dwceqos_est_valid(&est, 3, DEPTH, WID), "gate of a queue that does not exist");
+    check(!dwceqos_est_valid(&est, NUM_QUEUES, 1, WID), "more entries than the list depth");
+    check(!dwceqos_est_valid(&est, NUM_QUEUES, DEPTH, 16), "interval wider than the hardware field");
+
+    est.gcl[1].interval = 0;
+    check(!dwceqos_est_valid(&est, NUM_QUEUES, DEPTH, WID), "zero interval");
+
+    est.enable = 0;
+    check(dwceqos_est_valid(&est, NUM_QUEUES, DEPTH, WID), "disabling needs no list");
+}
+
+static void test_wait (void)
+{
+    /* Queue 0 and 1 together, then 2, then all; queue 3 only in the last slot */
+    static const dwceqos_gcl_entry_t  a[] = { { 0x3, 500 * US }, { 0x4, 300 * US }, { 0xf, 200 * US } };
+    /* Intervals short of the cycle, the last entry holds until it ends */
+    static const dwceqos_gcl_entry_t  b[] = { { 0x2, 100 * US }, { 0x1, 100 * US } };
+    dwceqos_est_t                     est;
+    dwceqos_est_wait_t                w;
+
+    gcl(&est, 1000 * US, 3, a);
+    print_waits("list a", &est);
+    dwceqos_est_wait(&est, 0, &w);
+    check((w.max == 300 * US) && (w.head == 0) && (w.tail == 0), "a: queue 0 closed in the middle");
+    dwceqos_est_wait(&est, 2, &w);
+    check((w.max == 500 * US) && (w.head == 500 * US) && (w.tail == 0), "a: queue 2 closed at the start");
+    dwceqos_est_wait(&est, 3, &w);
+    check((w.max == 800 * US) && (w.head == 800 * US) && (w.tail == 0), "a: queue 3 open at the end only");
+
+    gcl(&est, 1000 * US, 2, b);
+    print_waits("list b", &est);
+    dwceqos_est_wait(&est, 0, &w);
+    check((w.max == 100 * US) && (w.head == 100 * US), "b: queue 0 held open to the cycle end");
+    dwceqos_est_wait(&est, 1, &w);
+    check((w.max == 900 * US) && (w.tail == 900 * US), "b: queue 1 waits over the cycle end");
+    dwceqos_est_wait(&est, 2, &w);
+    check(w.max == DWCEQOS_EST_NEVER, "b: queue 2 never opens");
+}
+
+static void test_base (void)
+{
+    static const dwceqos_gcl_entry_t  a[] = { { 0x3, 500 * US }, { 0x4, 300 * US }, { 0xf, 200 * US } };
+    static const uint64_t             offs[] = { 0, 1, 999 * US, 1000 * US, 2500 * US, 1000000 * US };
+    dwceqos_est_t                     est;
+    dwceqos_est_wait_t                w;
+    uint64_t                          base, now, start, first;
+    uint32_t                          i, q;
+    char                              what[96];
+
+    gcl(&est, 1000 * US, 3, a);
+    base = 1700000000ULL * 1000000000ULL + 123 * US;
+
+    /* A base time in the future is kept */
+    est.base_time = base;
+    check(dwceqos_est_base(&est, base - 5000 * US) == base, "future base time kept");
+
+    /*
+     * A past one moves to the next cycle boundary: at most a cycle away and in
+     * phase with the base time. A queue then first opens at most a cycle plus
+     * its head wait after the ioctl.
+     */
+    for (i = 0; i < sizeof(offs) / sizeof(offs[0]); i++) {
+        now = base + offs[i];
+        start = dwceqos_est_base(&est, now);
+        snprintf(what, sizeof(what), "base time %llu ns in the past", (unsigned long long)offs[i]);
+        check((start >= now) && (start - now <= est.cycle_time) && ((start - base) % est.cycle_time == 0), what);
+        printf("base time %9llu ns in the past: list starts %7llu ns later, first opens",
+               (unsigned long long)offs[i], (unsigned long long)(start - now));
+        for (q = 0; q < NUM_QUEUES; q++) {
+            dwceqos_est_wait(&est, q, &w);
+            first = start - now + w.head;
+            printf(" q%u %7llu", q, (unsigned long long)first);
+            check(first <= est.cycle_time + w.head, "first opening within a cycle plus the head wait");
+        }
+        printf(" ns\n");
+    }
+}
+
+static void test_switch (void)
+{
+    static const dwceqos_gcl_entry_t  a[] = { { 0x3, 500 * US }, { 0x4, 300 * US }, { 0xf, 200 * US } };
+    static const dwceqos_gcl_entry_t  b[] = { { 0x2, 100 * US }, { 0x1, 100 * US } };
+    dwceqos_est_t                     from, to;
+    dwceqos_est_wait_t                wf, wt;
+    uint64_t                          wait;
+    uint32_t                          q;
+
+    /* The new list takes over at a cycle end, the closed end of the old one runs into the closed start of the new */
+    gcl(&from, 1000 * US, 2, b);
+    gcl(&to, 1000 * US, 3, a);
+    printf("switch from list b to list a:");
+    for (q = 0; q < NUM_QUEUES; q++) {
+        dwceqos_est_wait(&from, q, &wf);
+        dwceqos_est_wait(&to, q, &wt);
+        wait = (wf.max == DWCEQOS_EST_NEVER) ? wf.head + wt.head : wf.tail + wt.head;
+        printf(" q%u %llu", q, (unsigned long long)wait);
+    }
+    printf(" ns\n");
+
+    dwceqos_est_wait(&from, 1, &wf);
+    dwceqos_est_wait(&to, 1, &wt);
+    check(wf.tail + wt.head == 900 * US, "switch: queue 1 closed tail, open head");
+    dwceqos_est_wait(&from, 3, &wf);
+    dwceqos_est_wait(&to, 3, &wt);
+    check(wf.head + wt.head == 1800 * US, "switch: queue 3 closed for a cycle and most of the next");
+}
+
+int main (void)
+{
+    test_valid();
+    test_wait();
+    test_base();
+    test_switch();
+
+    printf("est_test: %u of %u checks failed\n", fail, checks);
+
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Cycles per packet of dwceqos_receive() and dwceqos_reap_pkts() on a host.
+ *
+ * The driver sources are built against the shim in shim/, with one queue of
+ * RING descriptors in ordinary memory. A DMA model completes a burst of
+ * descriptors, then each function is timed with ClockCycles() as it handles
+ * the burst. Received packets are handed to a sink that frees them after the
+ * measurement, so the stack's cost is not included.
+ *
+ * Host memory is cached, unlike the PROT_NOCACHE descriptors on the target.
+ * The "cold" runs flush the descriptor and packet header lines before each
+ * call, like a DMA write would; the "hot" runs leave them cached. Neither is
+ * an uncached access, use the numbers to compare code changes on one host.
+ *
+ *   rxtx_bench [rounds]
+ */
+
+#include "../event.c"
+#include "../transmit.c"
+
+#include <time.h>
+
+#undef malloc
+#undef free
+
+#define RING        256
+#define PKT_LEN     1514
+
+static const unsigned   bursts[] = { 1, 8, 32, 64 };
+
+/* PTP is off, the driver never calls these */
+void dwceqos_ptp_add_rx_ts (dwceqos_dev_t *dwceqos, struct mbuf *m, uint32_t sec, uint32_t nsec)
+{
+    (void)dwceqos; (void)m; (void)sec; (void)nsec;
+}
+
+void dwceqos_ptp_add_tx_ts (dwceqos_queue_t *queue, int valid, uint32_t sec, uint32_t nsec)
+{
+    (void)queue; (void)valid; (void)sec; (void)nsec;
+}
+
+int dwceqos_ptp_get_id (struct mbuf *m, ptp_extts_t *id)
+{
+    (void)m; (void)id;
+    return 0;
+}
+
+/* Packets passed up, freed once the measurement is done */
+static struct mbuf  *sink_head;
+
+static void sink_input (struct ifnet *ifp, struct mbuf *m)
+{
+    (void)ifp;
+    m->m_next = sink_head;
+    sink_head = m;
+}
+
+static void sink_drain (void)
+{
+    struct mbuf     *m;
+
+    while ((m = sink_head) != NULL) {
+        sink_head = m->m_next;
+        m->m_next = NULL;
+        m_free(m);
+    }
+}
+
+static void flush_lines (const void *p, size_t len)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    const char      *c = (const char *)((uintptr_t)p & ~(uintptr_t)63);
+
+    for (; c < (const char *)p + len; c += 64) {
+        __builtin_ia32_clflush(c);
+    }
+    __builtin_ia32_mfence();
+#else
+    (void)p; (void)len;
+#endif
+}
+
+static int cmp_u64 (const void *a, const void *b)
+{
+    uint64_t    x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static dwceqos_dev_t *bench_dev (void)
+{
+    dwceqos_dev_t       *dwceqos = calloc(1, sizeof(*dwceqos));
+    dwceqos_queue_t     *queue;
+    struct mbuf         *m;
+    uint32_t            i;
+
+    mbuf_pool_init(8 * RING);
+
+    dwceqos->mac_base = mmap_device_io(0x10000, 0);
+    dwceqos->num_queues = 1;
+    dwceqos->rx_desc_num = RING;
+    dwceqos->tx_desc_num = RING;
+    dwceqos->ecom.ec_if.if_softc = dwceqos;
+    dwceqos->ecom.ec_if.if_mtu = ETHERMTU;
+    dwceqos->ecom.ec_if.if_input = sink_input;
+    dwceqos->ecom.ec_if.if_flags_tx = IFF_RUNNING;
+    dwceqos->coal.rx_frames = 1;
+
+    queue = &dwceqos->queue[0];
+    queue->dwceqos = dwceqos;
+    queue->idx = 0;
+    queue->rx_coal_cur = 1;
+
+    /* Rings and shadow arrays laid out as dwceqos_dma_init() does */
+    queue->tx_desc = aligned_alloc(64, sizeof(dwceqos_desc_t) * 2 * RING);
+    memset(queue->tx_desc, 0, sizeof(dwceqos_desc_t) * 2 * RING);
+    queue->rx_desc = queue->tx_desc + RING;
+    queue->tx_mbuf = calloc(3 * RING, sizeof(struct mbuf *));
+    queue->rx_mbuf = queue->tx_mbuf + RING;
+    queue->rx_pool = queue->rx_mbuf + RING;
+    queue->tx_ts_req = calloc(RING, 1);
+    queue->tx_desc_avail = RING;
+    queue->tx_desc_tail = queue->tx_desc + RING;
+    queue->rx_desc_tail = queue->rx_desc + RING;
+
+    for (i = 0; i < RING; i++) {
+        m = m_getcl_wtp(M_DONTWAIT, MT_DATA, M_PKTHDR, WTP);
+        queue->rx_mbuf[i] = m;
+        queue->rx_desc[i].des0 = mbuf_phys(m);
+        queue->rx_desc[i].des3 = RDES3_OWN | RDES3_BUF1V | dwceqos_rx_ioc(queue, i);
+    }
+    dwceqos_rx_pool_refill(queue, WTP);
+
+    return dwceqos;
+}
+
+/* The DMA receives n packets into the descriptors from the head on */
+static void dma_rx (dwceqos_queue_t *queue, unsigned n, int cold)
+{
+    uint32_t                    idx, i;
+    struct ether_header         *eh;
+
+    for (i = 0; i < n; i++) {
+        idx = (queue->rx_desc_head + i) & (RING - 1);
+        eh = mtod(queue->rx_mbuf[idx], struct ether_header *);
+        memset(eh, 0xff, ETHER_ADDR_LEN * 2);
+        eh->ether_type = htons(ETHERTYPE_IP);
+
+        queue->rx_desc[idx].des1 = 0;
+        queue->rx_desc[idx].des2 = 0;
+        queue->rx_desc[idx].des3 = RDES3_FD | RDES3_LD | PKT_LEN;
+        if (cold) {
+            flush_lines(eh, sizeof(*eh));
+        }
+    }
+    if (cold) {
+        flush_lines(queue->rx_desc, sizeof(dwceqos_desc_t) * RING);
+    }
+}
+
+/* n single mbuf packets were queued as dwceqos_send_mbuf() does, the DMA sent them */
+static void dma_tx (dwceqos_queue_t *queue, unsigned n, int cold)
+{
+    dwceqos_desc_t  *tdesc;
+    struct mbuf     *m;
+    uint32_t        i;
+
+    for (i = 0; i < n; i++) {
+        m = m_getcl_wtp(M_DONTWAIT, MT_DATA, M_PKTHDR, WTP);
+        m->m_len = PKT_LEN;
+        tdesc = &queue->tx_desc[queue->tx_desc_head];
+        queue->tx_mbuf[queue->tx_desc_head] = m;
+        queue->tx_desc_head = (queue->tx_desc_head + 1) & (RING - 1);
+        queue->tx_desc_avail--;
+
+        tdesc->des0 = mbuf_phys(m);
+        tdesc->des1 = 0;
+        tdesc->des2 = m->m_len;
+        tdesc->des3 = TDES3_FD | TDES3_LD | PKT_LEN;
+    }
+    if (cold) {
+        flush_lines(queue->tx_desc, sizeof(dwceqos_desc_t) * RING);
+    }
+}
+
+/* Cycle counter ticks per ns */
+static double cycles_per_ns (void)
+{
+    struct timespec ts0, ts1;
+    uint64_t        c0, c1;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts0);
+    c0 = ClockCycles();
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &ts1);
+    } while ((ts1.tv_sec - ts0.tv_sec) * 1000000000LL + (ts1.tv_nsec - ts0.tv_nsec) < 100000000LL);
+    c1 = ClockCycles();
+
+    return (double)(c1 - c0) / ((ts1.tv_sec - ts0.tv_sec) * 1e9 + (ts1.tv_nsec - ts0.tv_nsec));
+}
+
+int main (int argc, char *argv[])
+{
+    dwceqos_dev_t       *dwceqos;
+    dwceqos_queue_t     *queue;
+    unsigned            rounds = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+    unsigned            b, r, n, cold;
+    uint64_t            *rx, *tx, t0;
+    double              cpn;
+
+    dwceqos = bench_dev();
+    queue = &dwceqos->queue[0];
+    rx = calloc(rounds, sizeof(*rx));
+    tx = calloc(rounds, sizeof(*tx));
+    cpn = cycles_per_ns();
+
+    printf("ring %u, %u rounds, %.2f cycles per ns, median cycles per packet\n", RING, rounds, cpn);
+    printf("burst        receive hot   cold       reap hot   cold\n");
+
+    for (b = 0; b < sizeof(bursts) / sizeof(bursts[0]); b++) {
+        n = bursts[b];
+        printf("%5u    ", n);
+        for (cold = 0; cold < 2; cold++) {
+            for (r = 0; r < rounds; r++) {
+                dma_rx(queue, n, cold);
+                t0 = ClockCycles();
+                if (dwceqos_receive(queue, WTP) != (int)n) {
+                    fprintf(stderr, "receive: lost packets\n");
+                    return EXIT_FAILURE;
+                }
+                rx[r] = ClockCycles() - t0;
+                sink_drain();
+                dwceqos_rx_pool_refill(queue, WTP);
+            }
+            qsort(rx, rounds, sizeof(*rx), cmp_u64);
+            printf("%s%6llu", cold ? " " : "       ", (unsigned long long)(rx[rounds / 2] / n));
+        }
+        printf("     ");
+        for (cold = 0; cold < 2; cold++) {
+            for (r = 0; r < rounds; r++) {
+                dma_tx(queue, n, cold);
+                t0 = ClockCycles();
+                dwceqos_reap_pkts(queue);
+                tx[r] = ClockCycles() - t0;
+                if (queue->tx_desc_avail != RING) {
+                    fprintf(stderr, "reap: descriptors left\n");
+                    return EXIT_FAILURE;
+                }
+            }
+            qsort(tx, rounds, sizeof(*tx), cmp_u64);
+            printf("%s%6llu", cold ? " " : "    ", (unsigned long long)(tx[rounds / 2] / n));
+        }
+        printf("\n");
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1 @@
+#include <qnx_host.h>
@@ -0,0 +1,221 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Host side of the shim: cycle counter, a fixed pool of mbuf clusters and
+ * no-op versions of the io-pkt calls the transmit path makes.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include <qnx_host.h>
+
+#undef malloc
+#undef free
+
+struct _iopkt_self  *iopkt_selfp;
+
+uint64_t ClockCycles (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t    cnt;
+
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r" (cnt));
+    return cnt;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+int nanospin_ns (unsigned long nsec)
+{
+    (void)nsec;
+    return EOK;
+}
+
+/* No refill thread, the bench refills the pool itself */
+int MsgSendPulse (int coid, int priority, int code, int value)
+{
+    (void)coid; (void)priority; (void)code; (void)value;
+    return 0;
+}
+
+int InterruptMask (int intr, int id) { (void)intr; (void)id; return 0; }
+int InterruptUnmask (int intr, int id) { (void)intr; (void)id; return 0; }
+int InterruptDetach (int id) { (void)id; return 0; }
+
+const struct sigevent *interrupt_queue (struct _iopkt_self *iopkt, struct _iopkt_inter *ient)
+{
+    (void)iopkt;
+    (void)ient;
+    return NULL;
+}
+
+int mem_offset64 (const void *addr, int fd, size_t len, off64_t *off, size_t *contig)
+{
+    (void)fd;
+    *off = (uintptr_t)addr;
+    if (contig != NULL) {
+        *contig = len;
+    }
+    return 0;
+}
+
+int posix_typed_mem_open (const char *name, int oflag, int tflag)
+{
+    (void)name; (void)oflag; (void)tflag;
+    return -1;
+}
+
+uintptr_t mmap_device_io (size_t len, uint64_t io)
+{
+    (void)io;
+    return (uintptr_t)calloc(1, len);
+}
+
+int munmap_device_io (uintptr_t io, size_t len)
+{
+    (void)len;
+    free((void *)io);
+    return 0;
+}
+
+int slogf (int code, int severity, const char *fmt, ...)
+{
+    va_list     ap;
+
+    (void)code;
+    if (severity > _SLOG_WARNING) {
+        return 0;
+    }
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    return 0;
+}
+
+int cache_init (int flags, struct cache_ctrl *cinfo, const char *dllname)
+{
+    (void)flags; (void)dllname;
+    cinfo->flags = 0;
+    return 0;
+}
+
+void cache_fini (struct cache_ctrl *cinfo)
+{
+    (void)cinfo;
+}
+
+int copyin (const void *uaddr, void *kaddr, size_t len) { memcpy(kaddr, uaddr, len); return 0; }
+int copyout (const void *kaddr, void *uaddr, size_t len) { memcpy(uaddr, kaddr, len); return 0; }
+
+/*
+ * mbufs with a cluster each, from a free list. The pool is sized by the
+ * first allocation of mbuf_pool_init(), it never grows.
+ */
+static struct mbuf  *mbuf_free;
+
+void mbuf_pool_init (unsigned n)
+{
+    struct mbuf     *m;
+    char            *clusters;
+    unsigned        i;
+
+    m = calloc(n, sizeof(*m));
+    clusters = aligned_alloc(64, (size_t)n * MCLBYTES);
+    if ((m == NULL) || (clusters == NULL)) {
+        fprintf(stderr, "mbuf pool of %u failed\n", n);
+        exit(EXIT_FAILURE);
+    }
+    memset(clusters, 0, (size_t)n * MCLBYTES);
+
+    for (i = 0; i < n; i++) {
+        m[i].m_ext.ext_buf = clusters + (size_t)i * MCLBYTES;
+        m[i].m_ext.ext_size = MCLBYTES;
+        m[i].m_next = mbuf_free;
+        mbuf_free = &m[i];
+    }
+}
+
+struct mbuf *m_getcl_wtp (int how, int type, int flags, struct nw_work_thread *wtp)
+{
+    struct mbuf     *m = mbuf_free;
+
+    (void)how; (void)type; (void)wtp;
+    if (m == NULL) {
+        return NULL;
+    }
+    mbuf_free = m->m_next;
+
+    m->m_next = NULL;
+    m->m_flags = flags | M_EXT;
+    m->m_data = m->m_ext.ext_buf;
+    m->m_len = m->m_ext.ext_size;
+    memset(&m->m_pkthdr, 0, sizeof(m->m_pkthdr));
+    return m;
+}
+
+struct mbuf *m_getcl (int how, int type, int flags)
+{
+    return m_getcl_wtp(how, type, flags, WTP);
+}
+
+void m_free (struct mbuf *m)
+{
+    m->m_next = mbuf_free;
+    mbuf_free = m;
+}
+
+void m_freem (struct mbuf *m)
+{
+    struct mbuf     *n;
+
+    for (; m != NULL; m = n) {
+        n = m->m_next;
+        m_free(m);
+    }
+}
+
+struct mbuf *m_pullup (struct mbuf *m, int len)
+{
+    (void)len;
+    return m;
+}
+
+struct mbuf *m_defrag (struct mbuf *m, int how)
+{
+    (void)how;
+    return m;
+}
+
+void m_copydata (struct mbuf *m, int off, int len, void *buf)
+{
+    memcpy(buf, m->m_data + off, len);
+}
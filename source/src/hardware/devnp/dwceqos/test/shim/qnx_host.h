@@ -0,0 +1,273 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Just enough of the QNX and io-pkt interfaces to build the receive and
+ * transmit paths of the driver on a Linux host for rxtx_bench. Registers
+ * are plain memory, mbufs come from a fixed pool of clusters.
+ */
+
+#ifndef    __QNX_HOST_H__
+#define    __QNX_HOST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+
+#define EOK                     0
+#define NOFD                    (-1)
+#define PROT_NOCACHE            0
+#define MAP_PHYS                0
+#define POSIX_TYPED_MEM_ALLOCATE_CONTIG 0
+#define ENETRESET               1000
+
+typedef uint64_t    paddr_t;
+typedef char        *caddr_t_;
+
+/* Neutrino */
+#define _NTO_INTR_FLAGS_TRK_MSK 0
+#define _NTO_TCTL_IO            0
+#define IRUPT_PRIO_DEFAULT      21
+#define HWI_NULL_OFF            0xffffffff
+#define HWI_ILLEGAL_VECTOR      0xffffffff
+
+#define _PULSE_CODE_MINAVAIL    0
+
+uint64_t ClockCycles (void);
+int MsgSendPulse (int coid, int priority, int code, int value);
+int nanospin_ns (unsigned long nsec);
+int InterruptMask (int intr, int id);
+int InterruptUnmask (int intr, int id);
+int InterruptDetach (int id);
+int mem_offset64 (const void *addr, int fd, size_t len, off64_t *off, size_t *contig);
+int posix_typed_mem_open (const char *name, int oflag, int tflag);
+
+static inline uint32_t in32 (uintptr_t addr) { return *(volatile uint32_t *)addr; }
+static inline void out32 (uintptr_t addr, uint32_t val) { *(volatile uint32_t *)addr = val; }
+uintptr_t mmap_device_io (size_t len, uint64_t io);
+int munmap_device_io (uintptr_t io, size_t len);
+#define MAP_DEVICE_FAILED       ((uintptr_t)-1)
+
+#define atomic_add(p, v)        __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_sub(p, v)        __atomic_fetch_sub((p), (v), __ATOMIC_SEQ_CST)
+
+#define _SLOGC_NETWORK          0
+#define _SLOG_ERROR             2
+#define _SLOG_WARNING           3
+#define _SLOG_INFO              5
+#define _SLOG_DEBUG1            6
+int slogf (int code, int severity, const char *fmt, ...);
+
+#define min(a, b)               ((a) < (b) ? (a) : (b))
+#define max(a, b)               ((a) > (b) ? (a) : (b))
+
+/* io-pkt kernel malloc */
+#define M_DEVBUF                0
+#define M_NOWAIT                1
+#define malloc(s, t, f)         malloc(s)
+#define free(p, t)              free(p)
+
+/* mbufs */
+#define M_DONTWAIT              0
+#define MT_DATA                 1
+#define M_PKTHDR                2
+#define M_EXT                   4
+#define MCLBYTES                2048
+
+#define M_CSUM_IPv4             0x0001
+#define M_CSUM_TCPv4            0x0002
+#define M_CSUM_UDPv4            0x0004
+#define M_CSUM_TCPv6            0x0010
+#define M_CSUM_UDPv6            0x0020
+#define M_CSUM_TSOv4            0x0040
+#define M_CSUM_TSOv6            0x0080
+#define M_CSUM_IPv4_BAD         0x0100
+#define M_CSUM_TCP_UDP_BAD      0x0200
+#define M_CSUM_DATA_IPv4_IPHL(x)    ((x) >> 16)
+#define M_CSUM_DATA_IPv6_HL(x)      ((x) >> 16)
+
+struct ifnet;
+
+struct mbuf {
+    struct mbuf     *m_next;
+    struct mbuf     *m_nextpkt;
+    int             m_len;
+    int             m_flags;
+    char            *m_data;
+    struct {
+        int             len;
+        int             csum_flags;
+        uint32_t        csum_data;
+        struct ifnet    *rcvif;
+        int             segsz;
+    } m_pkthdr;
+    struct {
+        int             ext_size;
+        char            *ext_buf;
+    } m_ext;
+};
+
+#define mtod(m, t)              ((t)((m)->m_data))
+
+struct nw_work_thread { int tid; };
+#define WTP                     ((struct nw_work_thread *)0)
+
+struct mbuf *m_getcl_wtp (int how, int type, int flags, struct nw_work_thread *wtp);
+struct mbuf *m_getcl (int how, int type, int flags);
+void m_free (struct mbuf *m);
+void m_freem (struct mbuf *m);
+struct mbuf *m_pullup (struct mbuf *m, int len);
+struct mbuf *m_defrag (struct mbuf *m, int how);
+void m_copydata (struct mbuf *m, int off, int len, void *buf);
+void mbuf_pool_init (unsigned n);
+static inline paddr_t mbuf_phys (struct mbuf *m) { return (uintptr_t)m->m_data; }
+
+struct cache_ctrl { int flags; };
+#define CACHE_INVAL(c, v, p, l) ((void)(c), (void)(v), (void)(p), (void)(l))
+#define CACHE_FLUSH(c, v, p, l) ((void)(c), (void)(v), (void)(p), (void)(l))
+int cache_init (int flags, struct cache_ctrl *cinfo, const char *dllname);
+void cache_fini (struct cache_ctrl *cinfo);
+
+/* io-pkt */
+struct _iopkt_self { int unused; };
+struct _iopkt_inter {
+    int                     (*func)(void *, struct nw_work_thread *);
+    int                     (*enable)(void *);
+    void                    *arg;
+    int                     spurious;
+};
+const struct sigevent *interrupt_queue (struct _iopkt_self *iopkt, struct _iopkt_inter *ient);
+#define ISSTACK                 0
+extern struct _iopkt_self *iopkt_selfp;
+
+/* Single threaded, the transmit lock is never contended */
+static inline void nw_siglock_host (void *l, void *i, void *w) { (void)l; (void)i; (void)w; }
+#define NW_SIGLOCK_P(l, i, w)   nw_siglock_host((l), (i), (w))
+#define NW_SIGUNLOCK_P(l, i, w) nw_siglock_host((l), (i), (w))
+int copyin (const void *uaddr, void *kaddr, size_t len);
+int copyout (const void *kaddr, void *uaddr, size_t len);
+
+struct ifdrv;
+
+struct device { int dv_unit; char dv_xname[16]; void *dv_dll_hdl; };
+struct callout { int unused; };
+
+/* Interfaces */
+struct ifqueue { struct mbuf *ifq_head, *ifq_tail; int ifq_len, ifq_maxlen; };
+#define IF_QFULL(q)             ((q)->ifq_len >= (q)->ifq_maxlen)
+#define IF_ENQUEUE(q, m)        do { (m)->m_nextpkt = NULL; \
+                                     if ((q)->ifq_tail) (q)->ifq_tail->m_nextpkt = (m); else (q)->ifq_head = (m); \
+                                     (q)->ifq_tail = (m); (q)->ifq_len++; } while (0)
+#define IF_DEQUEUE(q, m)        do { (m) = (q)->ifq_head; \
+                                     if (m) { if (((q)->ifq_head = (m)->m_nextpkt) == NULL) (q)->ifq_tail = NULL; \
+                                              (m)->m_nextpkt = NULL; (q)->ifq_len--; } } while (0)
+#define IF_PURGE(q)             do { struct mbuf *__m; \
+                                     for (;;) { IF_DEQUEUE((q), __m); if (__m == NULL) break; m_freem(__m); } } while (0)
+#define IFQ_POLL(q, m)          ((m) = (q)->ifq_head)
+#define IFQ_DEQUEUE(q, m)       IF_DEQUEUE((q), (m))
+#define IFQ_PURGE(q)            IF_PURGE((q))
+
+#define IFF_RUNNING             0x0040
+#define IFF_OACTIVE             0x0400
+
+struct ifnet {
+    void            *if_softc;
+    int             if_flags;
+    int             if_flags_tx;
+    int             if_mtu;
+    struct ifqueue  if_snd;
+    int             if_snd_ex;
+    void            *if_bpf;
+    void            (*if_input)(struct ifnet *, struct mbuf *);
+    uint64_t        if_ipackets, if_opackets, if_ierrors, if_oerrors;
+};
+
+struct ethercom { struct ifnet ec_if; };
+
+#define ETHER_ADDR_LEN          6
+#define ETHER_HDR_LEN           14
+#define ETHER_CRC_LEN           4
+#define ETHER_VLAN_ENCAP_LEN    4
+#define ETHERMTU                1500
+#define ETHERTYPE_IP            0x0800
+#define ETHERTYPE_IPV6          0x86dd
+#define ETHERTYPE_VLAN          0x8100
+
+struct ether_header {
+    uint8_t     ether_dhost[ETHER_ADDR_LEN];
+    uint8_t     ether_shost[ETHER_ADDR_LEN];
+    uint16_t    ether_type;
+};
+
+struct ether_vlan_header {
+    uint8_t     evl_dhost[ETHER_ADDR_LEN];
+    uint8_t     evl_shost[ETHER_ADDR_LEN];
+    uint16_t    evl_encap_proto;
+    uint16_t    evl_tag;
+    uint16_t    evl_proto;
+};
+#define EVL_PRIOFTAG(tag)       (((tag) >> 13) & 7)
+
+/* Network driver library */
+typedef struct {
+    int         media_rate;
+    int         duplex;
+    int         verbose;
+    int         phy_addr;
+    uint32_t    flags;
+} nic_config_t;
+
+typedef struct {
+    uint64_t    txed_ok;
+    uint64_t    rxed_ok;
+    uint32_t    tx_failed_allocs;
+    uint32_t    rx_failed_allocs;
+} nic_stats_t;
+
+#define NIC_FLAG_LINK_DOWN      0x0002
+
+typedef struct mdi mdi_t;
+struct mii_data { int unused; };
+
+/* PTP */
+typedef struct {
+    uint32_t    nanoseconds;
+    uint64_t    seconds;
+} ptp_time_t;
+
+typedef struct {
+    uint32_t    comp;
+    uint8_t     positive;
+} ptp_comp_t;
+
+typedef struct {
+    uint8_t     msg_type;
+    uint8_t     clock_identity[8];
+    uint16_t    source_port_id;
+    uint16_t    sequence_id;
+    ptp_time_t  ts;
+} ptp_extts_t;
+
+#endif
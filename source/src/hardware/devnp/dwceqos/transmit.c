@@ -21,6 +21,11 @@
 
 #include "bpfilter.h"
 #include <dwceqos.h>
+#include <net/if_vlanvar.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/tcp.h>
 
 #if NBPFILTER > 0
 #include <net/bpf.h>
@@ -94,23 +99,30 @@ void fdump (char *buffer, long cnt, FILE *fp)
 /*****************************************************************************/
 /*                                                                           */
 /*****************************************************************************/
-void dwceqos_reap_pkts (dwceqos_dev_t *dwceqos)
+void dwceqos_reap_pkts (dwceqos_queue_t *queue)
 {
+    dwceqos_dev_t   *dwceqos = queue->dwceqos;
     int             i, idx;
     dwceqos_desc_t  *tdesc;
-    int             expect = dwceqos->tx_desc_num - dwceqos->tx_desc_avail;
+    int             expect = dwceqos->tx_desc_num - queue->tx_desc_avail;
 
     for(i = 0; i < expect; i++)
     {
-        idx = (dwceqos->tx_desc_head + dwceqos->tx_desc_avail) % dwceqos->tx_desc_num;
-        tdesc = &(dwceqos->tx_desc[idx]);
+        idx = (queue->tx_desc_head + queue->tx_desc_avail) & (dwceqos->tx_desc_num - 1);
+        tdesc = &(queue->tx_desc[idx]);
         if (tdesc->des3 & TDES3_OWN){
             break;
         }
 
-        if (tdesc->m != NULL) {
-            m_free(tdesc->m);
-            tdesc->m = NULL;
+        /* The Tx timestamp is written back in the last descriptor of a frame that asked for one */
+        if (queue->tx_ts_req[idx]) {
+            queue->tx_ts_req[idx] = 0;
+            dwceqos_ptp_add_tx_ts(queue, tdesc->des3 & TDES3_TTSS, tdesc->des1, tdesc->des0);
+        }
+
+        if (queue->tx_mbuf[idx] != NULL) {
+            m_free(queue->tx_mbuf[idx]);
+            queue->tx_mbuf[idx] = NULL;
         }
 
         tdesc->des0 = 0;
@@ -118,22 +130,93 @@ void dwceqos_reap_pkts (dwceqos_dev_t *dwceqos)
         tdesc->des2 = 0;
         tdesc->des3 = 0;
 
-        dwceqos->tx_desc_avail++;
+        queue->tx_desc_avail++;
+    }
+}
+
+/*****************************************************************************/
+/* Pick the Tx queue from the 802.1Q priority, untagged packets use queue 0  */
+/*****************************************************************************/
+static uint32_t dwceqos_tx_queue (dwceqos_dev_t *dwceqos, struct mbuf *m)
+{
+    struct ether_vlan_header  *vlan_hdr;
+
+    if (dwceqos->num_queues == 1 || m->m_len < sizeof(*vlan_hdr)) {
+        return 0;
+    }
+
+    vlan_hdr = mtod(m, struct ether_vlan_header *);
+    if (ntohs(vlan_hdr->evl_encap_proto) != ETHERTYPE_VLAN) {
+        return 0;
     }
+
+    return DWCEQOS_PRIO_QUEUE(EVL_PRIOFTAG(ntohs(vlan_hdr->evl_tag)), dwceqos->num_queues);
+}
+
+/*****************************************************************************/
+/* Header lengths of a TSO packet, all its headers are pulled into one mbuf  */
+/*****************************************************************************/
+static struct mbuf *dwceqos_tso_prepare (dwceqos_queue_t *queue, struct mbuf *m)
+{
+    struct ether_header     *eh;
+    struct ip               *ip;
+    struct tcphdr           *th;
+    uint32_t                l2len, l3len, thlen;
+
+    queue->tq_tso_mss = 0;
+    if ((m->m_pkthdr.csum_flags & (M_CSUM_TSOv4 | M_CSUM_TSOv6)) == 0) {
+        return m;
+    }
+
+    l2len = sizeof(struct ether_header);
+    if ((m->m_len < l2len) && ((m = m_pullup(m, l2len)) == NULL)) {
+        return NULL;
+    }
+    eh = mtod(m, struct ether_header *);
+    if (ntohs(eh->ether_type) == ETHERTYPE_VLAN) {
+        l2len += ETHER_VLAN_ENCAP_LEN;
+    }
+
+    if (m->m_pkthdr.csum_flags & M_CSUM_TSOv4) {
+        if ((m->m_len < l2len + sizeof(struct ip)) && ((m = m_pullup(m, l2len + sizeof(struct ip))) == NULL)) {
+            return NULL;
+        }
+        ip = (struct ip *)(mtod(m, char *) + l2len);
+        l3len = ip->ip_hl << 2;
+    } else {
+        l3len = sizeof(struct ip6_hdr);
+    }
+
+    if ((m->m_len < l2len + l3len + sizeof(struct tcphdr)) &&
+        ((m = m_pullup(m, l2len + l3len + sizeof(struct tcphdr))) == NULL)) {
+        return NULL;
+    }
+    th = (struct tcphdr *)(mtod(m, char *) + l2len + l3len);
+    thlen = th->th_off << 2;
+
+    if ((m->m_len < l2len + l3len + thlen) && ((m = m_pullup(m, l2len + l3len + thlen)) == NULL)) {
+        return NULL;
+    }
+
+    queue->tq_tso_mss = m->m_pkthdr.segsz & TDES2_CTXT_MSS_MASK;
+    queue->tq_tso_hlen = l2len + l3len + thlen;
+    queue->tq_tso_thlen = thlen;
+
+    return m;
 }
 
 /*****************************************************************************/
 /*                                                                           */
 /*****************************************************************************/
-static struct mbuf* dwceqos_send_mbuf (struct ifnet *ifp, struct mbuf *mb)
+static struct mbuf* dwceqos_send_mbuf (struct ifnet *ifp, dwceqos_queue_t *queue, struct mbuf *mb)
 {
     dwceqos_dev_t           *dwceqos = ifp->if_softc;
     struct mbuf             *m = mb, *m_temp;
     dwceqos_desc_t          *tdesc;
 
-    dwceqos_reap_pkts(dwceqos);
+    dwceqos_reap_pkts(queue);
 
-    while (m && (dwceqos->tx_desc_avail > 0)) {
+    while (m && (queue->tx_desc_avail > 0)) {
         if (!m->m_len) {
             m_temp = m;
             m = m->m_next;
@@ -142,26 +225,79 @@ static struct mbuf* dwceqos_send_mbuf (struct ifnet *ifp, struct mbuf *mb)
             continue;
         }
 
-        tdesc = &(dwceqos->tx_desc[dwceqos->tx_desc_head]);
-        dwceqos->tx_desc_head = (dwceqos->tx_desc_head + 1) % dwceqos->tx_desc_num;
+        /* A TSO packet with a new MSS is preceded by a context descriptor carrying it */
+        if ((queue->tq_pkt_xbytes == 0) && (queue->tq_tso_mss != 0) &&
+            (queue->tq_tso_mss != queue->tx_mss)) {
+            if (queue->tx_desc_avail < 2) {
+                break;
+            }
+
+            tdesc = &(queue->tx_desc[queue->tx_desc_head]);
+            queue->tx_desc_head = (queue->tx_desc_head + 1) & (dwceqos->tx_desc_num - 1);
+
+            tdesc->des0 = 0;
+            tdesc->des1 = 0;
+            tdesc->des2 = queue->tq_tso_mss;
+            tdesc->des3 = TDES3_CTXT | TDES3_CTXT_TCMSSV;
+
+            queue->tx_desc_avail--;
+            queue->tx_mss = queue->tq_tso_mss;
+
+            __sync_synchronize();
+            tdesc->des3 |= TDES3_OWN;
+        }
+
+        tdesc = &(queue->tx_desc[queue->tx_desc_head]);
+        queue->tx_mbuf[queue->tx_desc_head] = m;
+        queue->tx_desc_head = (queue->tx_desc_head + 1) & (dwceqos->tx_desc_num - 1);
 
-        tdesc->m = m;
         tdesc->des0 = mbuf_phys(m);
         tdesc->des1 = 0;
         tdesc->des2 = m->m_len;
-        tdesc->des3 = dwceqos->tq_pkt_len;
+        tdesc->des3 = queue->tq_pkt_len;
+
+        if (queue->tq_tso_mss != 0) {
+            /*
+             * TSO: the first descriptor has the headers alone in buffer 1 and the
+             * rest of the mbuf in buffer 2, its length field is the TCP payload.
+             * The checksums of each segment are always inserted.
+             */
+            if (queue->tq_pkt_xbytes == 0) {
+                tdesc->des2 = queue->tq_tso_hlen;
+                if (m->m_len > queue->tq_tso_hlen) {
+                    tdesc->des1 = mbuf_phys(m) + queue->tq_tso_hlen;
+                    tdesc->des2 |= (m->m_len - queue->tq_tso_hlen) << TDES2_B2L_SHIFT;
+                }
+                tdesc->des3 = TDES3_FD | TDES3_TSE |
+                              (((queue->tq_tso_thlen >> 2) & TDES3_THL_MASK) << TDES3_THL_SHIFT) |
+                              ((queue->tq_pkt_len - queue->tq_tso_hlen) & TDES3_TCP_PKT_PAYLOAD_MASK);
+            } else {
+                tdesc->des3 = 0;
+            }
+        } else {
+            /* First packet */
+            if (queue->tq_pkt_xbytes == 0) {
+                tdesc->des3 |= TDES3_FD;
+
+                /* Timestamp a PTP event message, unless too many are in flight already */
+                if (queue->tq_ptp) {
+                    if (queue->tx_ts_head - queue->tx_ts_tail < DWCEQOS_PTP_TX_PEND) {
+                        queue->tx_ts_pend[queue->tx_ts_head & (DWCEQOS_PTP_TX_PEND - 1)] = queue->tq_ptp_id;
+                        queue->tx_ts_head++;
+                        tdesc->des2 |= TDES2_TTSE_TMWD;
+                    } else {
+                        queue->tq_ptp = 0;
+                    }
+                }
+            }
 
-        /* First packet */
-        if (dwceqos->tq_pkt_xbytes == 0) {
-            tdesc->des3 |= TDES3_FD;
+            /* M_CSUM_IPv4 */
+            if (m->m_pkthdr.csum_flags != 0) {
+                tdesc->des3 |= DES_IPPPCSUM;
+            }
         }
 
-        dwceqos->tq_pkt_xbytes += m->m_len;
-
-        /* M_CSUM_IPv4 */
-        if (m->m_pkthdr.csum_flags != 0) {
-            tdesc->des3 |= DES_IPPPCSUM;
-        }
+        queue->tq_pkt_xbytes += m->m_len;
 
         CACHE_FLUSH (&dwceqos->cachectl, m->m_data, mbuf_phys(m), m->m_len);
 
@@ -179,32 +315,85 @@ static struct mbuf* dwceqos_send_mbuf (struct ifnet *ifp, struct mbuf *mb)
         m = m->m_next;
 
         /* Last packet */
-        if (m == NULL || dwceqos->tq_pkt_xbytes >= dwceqos->tq_pkt_len) {
+        if (m == NULL || queue->tq_pkt_xbytes >= queue->tq_pkt_len) {
             ifp->if_opackets++;
             tdesc->des3 |= TDES3_LD;
+
+            /* Ask for a completion interrupt every tx_frames packets */
+            if ((dwceqos->coal.tx_frames != 0) && (++queue->tx_coal_cnt >= dwceqos->coal.tx_frames)) {
+                tdesc->des2 |= TDES2_IOC;
+                queue->tx_coal_cnt = 0;
+            }
+
+            /* A timestamped frame is reaped on its own interrupt, its timestamp is read then */
+            if (queue->tq_ptp) {
+                queue->tx_ts_req[(queue->tx_desc_head - 1) & (dwceqos->tx_desc_num - 1)] = 1;
+                tdesc->des2 |= TDES2_IOC;
+            }
         }
 
-        dwceqos->tx_desc_avail--;
+        queue->tx_desc_avail--;
         dwceqos->stats.txed_ok++;
 
         __sync_synchronize();
         tdesc->des3 |= TDES3_OWN;
         __sync_synchronize();
-        out32(dwceqos->mac_base + DMA_CHi_TXDESC_TAIL_PTR(0), (uintptr_t)dwceqos->tx_desc_tail);
+        out32(dwceqos->mac_base + DMA_CHi_TXDESC_TAIL_PTR(queue->idx), (uintptr_t)queue->tx_desc_tail);
     }
 
     return m;
 }
 
 /*****************************************************************************/
-/*                                                                           */
+/* Put the held packets of a queue on its ring, 1 when the ring filled up    */
+/*****************************************************************************/
+static int dwceqos_tx_drain (struct ifnet *ifp, dwceqos_queue_t *queue)
+{
+    dwceqos_dev_t           *dwceqos = ifp->if_softc;
+    struct mbuf             *m;
+
+    while (1) {
+        if (!queue->tq_mbuf) {
+            IF_DEQUEUE(&queue->tq_held, m);
+            if (m == NULL) {
+                return 0;
+            }
+
+            /* m_pullup() frees the chain when it fails */
+            if ((m = dwceqos_tso_prepare(queue, m)) == NULL) {
+                ifp->if_oerrors++;
+                continue;
+            }
+
+            queue->tq_mbuf = m;
+            queue->tq_pkt_len = m->m_pkthdr.len;
+            queue->tq_pkt_xbytes = 0;
+            queue->tq_ptp = dwceqos->is_ptp_enabled && (queue->tq_tso_mss == 0) &&
+                            dwceqos_ptp_get_id(m, &queue->tq_ptp_id);
+        }
+
+        /* Just part of the m is sent, let's come back from TX interrupt */
+        queue->tq_mbuf = dwceqos_send_mbuf(ifp, queue, queue->tq_mbuf);
+        if (queue->tq_mbuf) {
+            return 1;
+        }
+    }
+}
+
+/*****************************************************************************/
+/* Each Tx queue holds the packets for it while its ring is full, so one     */
+/* full ring does not stop the others. if_snd only waits when the queue of   */
+/* its next packet holds a ring's worth already.                             */
 /*****************************************************************************/
 void dwceqos_start (struct ifnet *ifp)
 {
     dwceqos_dev_t           *dwceqos = ifp->if_softc;
     struct _iopkt_self      *iopkt = dwceqos->iopkt;
     struct nw_work_thread   *wtp = WTP;
+    dwceqos_queue_t         *queue;
     struct mbuf             *m;
+    uint32_t                q;
+    int                     full = 0;
 
     if ((ifp->if_flags_tx & IFF_RUNNING) == 0 ||
         (dwceqos->cfg.flags & NIC_FLAG_LINK_DOWN) != 0) {
@@ -215,32 +404,30 @@ void dwceqos_start (struct ifnet *ifp)
 
     ifp->if_flags_tx |= IFF_OACTIVE;
 
-    while (1) {
-        if (!dwceqos->tq_mbuf) {
-            IFQ_DEQUEUE(&ifp->if_snd, dwceqos->tq_mbuf);
-
-            m = dwceqos->tq_mbuf;
-            if (m) {
-                dwceqos->tq_pkt_len = m->m_pkthdr.len;
-                dwceqos->tq_pkt_xbytes = 0;
-            }
-        }
-
-        m = dwceqos->tq_mbuf;
+    /* Rings with room again take their held packets first */
+    for (q = 0; q < dwceqos->num_queues; q++) {
+        full |= dwceqos_tx_drain(ifp, &dwceqos->queue[q]);
+    }
 
+    while (1) {
+        IFQ_POLL(&ifp->if_snd, m);
         if (m == NULL) {
             break;
         }
 
-        /* Just part of the m is sent, let's come back from TX interrupt */
-        dwceqos->tq_mbuf = dwceqos_send_mbuf(ifp, m);
-        if (dwceqos->tq_mbuf) {
-            NW_SIGUNLOCK_P(&ifp->if_snd_ex, iopkt, wtp);
-            return;
+        queue = &dwceqos->queue[dwceqos_tx_queue(dwceqos, m)];
+        if (IF_QFULL(&queue->tq_held)) {
+            break;
         }
+
+        IFQ_DEQUEUE(&ifp->if_snd, m);
+        IF_ENQUEUE(&queue->tq_held, m);
+        full |= dwceqos_tx_drain(ifp, queue);
     }
 
-    ifp->if_flags_tx &= ~IFF_OACTIVE;
+    if (!full) {
+        ifp->if_flags_tx &= ~IFF_OACTIVE;
+    }
     NW_SIGUNLOCK_P(&ifp->if_snd_ex, iopkt, wtp);
 }
 
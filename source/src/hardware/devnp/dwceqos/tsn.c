@@ -0,0 +1,270 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+#include <dwceqos.h>
+#include <net/ifdrvcom.h>
+#include <net/if_vlanvar.h>
+#include "tsn_calc.h"
+
+/*****************************************************************************/
+/* Program the shaper of a queue for the current link speed                  */
+/*****************************************************************************/
+void dwceqos_cbs_apply (dwceqos_dev_t *dwceqos, uint32_t q)
+{
+    dwceqos_queue_t     *queue = &dwceqos->queue[q];
+    struct ifnet        *ifp = &dwceqos->ecom.ec_if;
+    uintptr_t           mac_base = dwceqos->mac_base;
+    dwceqos_cbs_regs_t  regs;
+    uint32_t            reg, port_rate;
+
+    /* Speed unknown, the link up will set it */
+    if (dwceqos->cfg.media_rate == -1) {
+        return;
+    }
+    port_rate = dwceqos->cfg.media_rate;
+
+    reg = in32(mac_base + MTL_TXQi_OPERATION_MODE(q)) & ~TXQEN_MASK;
+
+    if ((queue->cbs_idle_slope == 0) || (queue->cbs_idle_slope >= port_rate)) {
+        if (queue->cbs_idle_slope != 0) {
+            slogf(_SLOGC_NETWORK, _SLOG_WARNING, "devnp-dwceqos: %s: queue %u reservation %u kbit/s exceeds the link, not shaped",
+                  __func__, q, queue->cbs_idle_slope);
+        }
+        out32(mac_base + MTL_TXQi_ETS_CONTROL(q), in32(mac_base + MTL_TXQi_ETS_CONTROL(q)) & ~(AVALG | CC));
+        out32(mac_base + MTL_TXQi_QUANTUM_WEIGHT(q), 0x10);
+        out32(mac_base + MTL_TXQi_SENDSLOPECREDIT(q), 0);
+        out32(mac_base + MTL_TXQi_HICREDIT(q), 0);
+        out32(mac_base + MTL_TXQi_LOCREDIT(q), 0);
+        out32(mac_base + MTL_TXQi_OPERATION_MODE(q), reg | TXQEN(TX_EN));
+        return;
+    }
+
+    /* The largest frame, tagged, with its FCS */
+    dwceqos_cbs_regs(queue->cbs_idle_slope, port_rate,
+                     ifp->if_mtu + ETHER_HDR_LEN + ETHER_VLAN_ENCAP_LEN + ETHER_CRC_LEN, &regs);
+    regs.idle_slope &= ISCQW_MASK;
+    regs.send_slope &= SSC_MASK;
+    regs.hi_credit &= HC_MASK;
+    regs.lo_credit &= LC_MASK;
+
+    out32(mac_base + MTL_TXQi_OPERATION_MODE(q), reg | TXQEN(TX_AV_EN));
+    out32(mac_base + MTL_TXQi_ETS_CONTROL(q), in32(mac_base + MTL_TXQi_ETS_CONTROL(q)) | AVALG | CC);
+    out32(mac_base + MTL_TXQi_QUANTUM_WEIGHT(q), regs.idle_slope);
+    out32(mac_base + MTL_TXQi_SENDSLOPECREDIT(q), regs.send_slope);
+    out32(mac_base + MTL_TXQi_HICREDIT(q), regs.hi_credit);
+    out32(mac_base + MTL_TXQi_LOCREDIT(q), regs.lo_credit);
+
+    if (dwceqos->cfg.verbose) {
+        slogf(_SLOGC_NETWORK, _SLOG_INFO, "devnp-dwceqos: queue %u CBS %u kbit/s: idle 0x%x send 0x%x hi 0x%x lo 0x%x",
+              q, queue->cbs_idle_slope, regs.idle_slope, regs.send_slope, regs.hi_credit, regs.lo_credit);
+    }
+}
+
+/*****************************************************************************/
+/* DWCEQOS_GET_CBS/DWCEQOS_SET_CBS commands                                  */
+/*****************************************************************************/
+int dwceqos_cbs_ioctl (dwceqos_dev_t *dwceqos, struct ifdrv *ifd)
+{
+    dwceqos_cbs_t   cbs;
+    uint32_t        i, total;
+    int             err;
+
+    if ((err = dwceqos_drvspec_copyin(ifd, &cbs, sizeof(cbs))) != EOK) {
+        return err;
+    }
+
+    /* Queue 0 carries untagged and best effort traffic */
+    if ((cbs.queue == 0) || (cbs.queue >= dwceqos->num_queues)) {
+        return EINVAL;
+    }
+
+    if (ifd->ifd_cmd == DWCEQOS_GET_CBS) {
+        cbs.idle_slope = dwceqos->queue[cbs.queue].cbs_idle_slope;
+        return dwceqos_drvspec_copyout(ifd, &cbs, sizeof(cbs));
+    }
+
+    /* The reservations of all queues together have to fit a gigabit link */
+    if (cbs.idle_slope >= 1000 * 1000) {
+        return EINVAL;
+    }
+    total = cbs.idle_slope;
+    for (i = 1; i < dwceqos->num_queues; i++) {
+        if (i != cbs.queue) {
+            total += dwceqos->queue[i].cbs_idle_slope;
+        }
+    }
+    if (total >= 1000 * 1000) {
+        return EINVAL;
+    }
+
+    dwceqos->queue[cbs.queue].cbs_idle_slope = cbs.idle_slope;
+    dwceqos_cbs_apply(dwceqos, cbs.queue);
+
+    return EOK;
+}
+
+
+/*****************************************************************************/
+/* 802.1Qbv time aware shaper, EST                                           */
+/*****************************************************************************/
+/* Gate control list depth and interval width, 0 without EST */
+static void dwceqos_est_caps (dwceqos_dev_t *dwceqos, uint32_t *depth, uint32_t *wid)
+{
+    uint32_t  reg = in32(dwceqos->mac_base + MAC_HW_FEATURE3);
+    uint32_t  dep = (reg & ESTDEP_MASK) >> ESTDEP_SHIFT;
+    uint32_t  w = (reg & ESTWID_MASK) >> ESTWID_SHIFT;
+
+    if (((reg & ESTSEL) == 0) || (dep == 0) || (w == 0)) {
+        *depth = *wid = 0;
+        return;
+    }
+
+    /* 64 to 1024 entries, 16 to 24 bits */
+    *depth = min(32 << dep, DWCEQOS_EST_MAX_GCL);
+    *wid = 12 + 4 * w;
+}
+
+/* Indirect write of a gate control list entry, or of a related register with GCRR */
+static int dwceqos_est_write (dwceqos_dev_t *dwceqos, uint32_t addr, uint32_t val, uint32_t gcrr)
+{
+    uintptr_t  mac_base = dwceqos->mac_base;
+    uint32_t   ctrl = (addr << GCL_ADDR_SHIFT) | gcrr;
+    int        cnt = 100;
+
+    out32(mac_base + MTL_EST_GCL_DATA, val);
+    out32(mac_base + MTL_EST_GCL_CONTROL, ctrl);
+    out32(mac_base + MTL_EST_GCL_CONTROL, ctrl | SRWO);
+
+    while ((in32(mac_base + MTL_EST_GCL_CONTROL) & SRWO) && --cnt) {
+        nanospin_ns(1000);
+    }
+
+    if ((cnt <= 0) || (in32(mac_base + MTL_EST_GCL_CONTROL) & GCL_ERR0)) {
+        slogf(_SLOGC_NETWORK, _SLOG_ERROR, "devnp-dwceqos: %s: GCL write %u failed", __func__, addr);
+        return EIO;
+    }
+
+    return EOK;
+}
+
+/*
+ * The list is written to the software owned copy, SSWL swaps it with the
+ * running one at the end of its cycle, once the base time is reached.
+ */
+static int dwceqos_est_apply (dwceqos_dev_t *dwceqos, uint32_t wid)
+{
+    dwceqos_est_t   *est = &dwceqos->est;
+    uintptr_t       mac_base = dwceqos->mac_base;
+    ptp_time_t      now;
+    uint64_t        now_ns, base;
+    uint32_t        ctrl, i;
+    int             err;
+    dwceqos_est_wait_t  wait;
+
+    ctrl = in32(mac_base + MTL_EST_CONTROL);
+    if (!est->enable) {
+        out32(mac_base + MTL_EST_CONTROL, ctrl & ~EEST);
+        return EOK;
+    }
+
+    dwceqos_ptp_get_time(dwceqos, &now);
+    now_ns = (uint64_t)now.seconds * 1000000000ULL + now.nanoseconds;
+    base = dwceqos_est_base(est, now_ns);
+
+    for (i = 0; i < est->num_entries; i++) {
+        if ((err = dwceqos_est_write(dwceqos, i, (est->gcl[i].gates << wid) | est->gcl[i].interval, 0)) != EOK) {
+            return err;
+        }
+    }
+
+    if (((err = dwceqos_est_write(dwceqos, GCL_BTR_LOW, base % 1000000000ULL, GCRR)) != EOK) ||
+        ((err = dwceqos_est_write(dwceqos, GCL_BTR_HIGH, base / 1000000000ULL, GCRR)) != EOK) ||
+        ((err = dwceqos_est_write(dwceqos, GCL_CTR_LOW, est->cycle_time % 1000000000UL, GCRR)) != EOK) ||
+        ((err = dwceqos_est_write(dwceqos, GCL_CTR_HIGH, est->cycle_time / 1000000000UL, GCRR)) != EOK) ||
+        ((err = dwceqos_est_write(dwceqos, GCL_TER, 0, GCRR)) != EOK) ||
+        ((err = dwceqos_est_write(dwceqos, GCL_LLR, est->num_entries, GCRR)) != EOK)) {
+        return err;
+    }
+
+    /* The PTP time offset covers the synchronisation delay, 6 PTP clock cycles */
+    ctrl &= ~PTOV_MASK;
+    ctrl |= (((1000 / DWCEQOS_PTP_CLK_MHZ) * 6) << PTOV_SHIFT) & PTOV_MASK;
+    out32(mac_base + MTL_EST_CONTROL, ctrl | EEST | SSWL);
+
+    if (dwceqos->cfg.verbose) {
+        for (i = 0; i < dwceqos->num_queues; i++) {
+            dwceqos_est_wait(est, i, &wait);
+            slogf(_SLOGC_NETWORK, _SLOG_INFO, "devnp-dwceqos: queue %u EST from %llu ns: longest gate wait %lld ns",
+                  i, (unsigned long long)base, (wait.max == DWCEQOS_EST_NEVER) ? -1LL : (long long)wait.max);
+        }
+    }
+
+    return EOK;
+}
+
+/*****************************************************************************/
+/* DWCEQOS_GET_EST/DWCEQOS_SET_EST commands                                  */
+/*****************************************************************************/
+int dwceqos_est_ioctl (dwceqos_dev_t *dwceqos, struct ifdrv *ifd)
+{
+    dwceqos_est_t   *est;
+    uint32_t        depth, wid;
+    int             err;
+
+    /* The gates run on the PTP clock */
+    dwceqos_est_caps(dwceqos, &depth, &wid);
+    if (!dwceqos->is_ptp_enabled || (depth == 0)) {
+        return ENOTSUP;
+    }
+
+    if (ifd->ifd_cmd == DWCEQOS_GET_EST) {
+        dwceqos->est.depth = depth;
+        return dwceqos_drvspec_copyout(ifd, &dwceqos->est, sizeof(dwceqos->est));
+    }
+
+    /* The previous list has not taken over yet */
+    if (in32(dwceqos->mac_base + MTL_EST_CONTROL) & SSWL) {
+        return EBUSY;
+    }
+
+    if ((est = malloc(sizeof(*est), M_DEVBUF, M_NOWAIT)) == NULL) {
+        return ENOMEM;
+    }
+
+    if ((err = dwceqos_drvspec_copyin(ifd, est, sizeof(*est))) == EOK) {
+        if (dwceqos_est_valid(est, dwceqos->num_queues, depth, wid)) {
+            dwceqos->est = *est;
+            err = dwceqos_est_apply(dwceqos, wid);
+        } else {
+            err = EINVAL;
+        }
+    }
+
+    free(est, M_DEVBUF);
+
+    return err;
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
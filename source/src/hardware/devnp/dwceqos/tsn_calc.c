@@ -0,0 +1,134 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+#include "tsn_calc.h"
+
+/*****************************************************************************/
+/* 802.1Qav credit based shaper, see 802.1Q Annex L for the credits. The     */
+/* rates are in kbit/s, frame_len is the largest interfering frame in bytes. */
+/*****************************************************************************/
+void dwceqos_cbs_regs (uint32_t idle_slope, uint32_t port_rate, uint32_t frame_len,
+                       dwceqos_cbs_regs_t *regs)
+{
+    /* Bits the MAC sends per clock cycle: 8 at 1G, 4 at 100M and 10M */
+    uint64_t  bpc = (port_rate >= 1000 * 1000) ? 8 : 4;
+    uint64_t  frame_bits = (uint64_t)frame_len * 8;
+
+    /* The slopes are in bits per cycle, the credits in bits, all scaled by 1024 */
+    regs->idle_slope = (uint32_t)((idle_slope * 1024 * bpc) / port_rate);
+    regs->send_slope = (uint32_t)(((uint64_t)(port_rate - idle_slope) * 1024 * bpc) / port_rate);
+
+    /* Below 1/1024 of a bit per cycle a reservation would never gain credit */
+    if (regs->idle_slope == 0) {
+        regs->idle_slope = 1;
+    }
+
+    /* hiCredit builds up while a lower priority frame is sent, loCredit drains while one of ours is */
+    regs->hi_credit = (uint32_t)((frame_bits * 1024 * idle_slope) / port_rate);
+    regs->lo_credit = (uint32_t)(-(int64_t)((frame_bits * 1024 * (port_rate - idle_slope)) / port_rate));
+}
+
+/*****************************************************************************/
+/* 802.1Qbv gate control list checks, num_queues Tx queues, a list of up to  */
+/* depth entries with wid bit intervals                                      */
+/*****************************************************************************/
+int dwceqos_est_valid (const dwceqos_est_t *est, uint32_t num_queues, uint32_t depth, uint32_t wid)
+{
+    uint64_t  sum = 0;
+    uint32_t  i;
+
+    if (!est->enable) {
+        return 1;
+    }
+
+    if ((est->num_entries == 0) || (est->num_entries > depth) || (est->cycle_time == 0)) {
+        return 0;
+    }
+
+    for (i = 0; i < est->num_entries; i++) {
+        if ((est->gcl[i].interval == 0) || (est->gcl[i].interval >= (1U << wid)) ||
+            ((est->gcl[i].gates >> num_queues) != 0)) {
+            return 0;
+        }
+        sum += est->gcl[i].interval;
+    }
+
+    return (sum <= est->cycle_time);
+}
+
+/* The PTP time the list starts at, a base time in the past moves to the next cycle boundary */
+uint64_t dwceqos_est_base (const dwceqos_est_t *est, uint64_t now)
+{
+    uint64_t  base = est->base_time;
+
+    if (base < now) {
+        base += ((now - base) / est->cycle_time + 1) * est->cycle_time;
+    }
+
+    return base;
+}
+
+/*
+ * Gate closed times of queue q in a valid list. When the intervals add up to
+ * less than the cycle the last entry holds until the cycle ends. The longest
+ * wait runs across the cycle end, from the closed tail into the closed head.
+ */
+void dwceqos_est_wait (const dwceqos_est_t *est, uint32_t q, dwceqos_est_wait_t *wait)
+{
+    uint64_t  run = 0, t = 0, len;
+    uint32_t  i;
+    int       opened = 0;
+
+    wait->head = 0;
+    wait->max = 0;
+
+    for (i = 0; i < est->num_entries; i++) {
+        len = (i == est->num_entries - 1) ? (est->cycle_time - t) : est->gcl[i].interval;
+        t += len;
+
+        if (est->gcl[i].gates & (1 << q)) {
+            if (!opened) {
+                wait->head = run;
+                opened = 1;
+            }
+            if (run > wait->max) {
+                wait->max = run;
+            }
+            run = 0;
+        } else {
+            run += len;
+        }
+    }
+
+    wait->tail = run;
+    if (!opened) {
+        wait->head = run;
+        wait->max = DWCEQOS_EST_NEVER;
+    } else if (wait->tail + wait->head > wait->max) {
+        wait->max = wait->tail + wait->head;
+    }
+}
+
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif
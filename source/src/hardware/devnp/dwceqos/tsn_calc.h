@@ -0,0 +1,57 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * Register values of the 802.1Qav and 802.1Qbv shapers. Only integer
+ * arithmetic, no io-pkt or hardware access, so test/ builds it on a host.
+ */
+
+#ifndef    __TSN_CALC_H__
+#define    __TSN_CALC_H__
+
+#include <stdint.h>
+#include <hw/dwceqos.h>
+
+/* Credit based shaper register values of a queue, before masking to the fields */
+typedef struct {
+    uint32_t    idle_slope;
+    uint32_t    send_slope;
+    uint32_t    hi_credit;
+    uint32_t    lo_credit;      /* Negative, two's complement */
+} dwceqos_cbs_regs_t;
+
+void dwceqos_cbs_regs (uint32_t idle_slope, uint32_t port_rate, uint32_t frame_len,
+                       dwceqos_cbs_regs_t *regs);
+
+/* Gate closed times of a Tx queue over one EST cycle, in ns */
+typedef struct {
+    uint64_t    head;           /* Closed from the start of the cycle */
+    uint64_t    tail;           /* Closed up to the end of the cycle */
+    uint64_t    max;            /* Longest wait for the gate, DWCEQOS_EST_NEVER if it never opens */
+} dwceqos_est_wait_t;
+
+#define DWCEQOS_EST_NEVER           UINT64_MAX
+
+int dwceqos_est_valid (const dwceqos_est_t *est, uint32_t num_queues, uint32_t depth, uint32_t wid);
+uint64_t dwceqos_est_base (const dwceqos_est_t *est, uint64_t now);
+void dwceqos_est_wait (const dwceqos_est_t *est, uint32_t q, dwceqos_est_wait_t *wait);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * $QNXLicenseC:
+ * Copyright 2020, QNX Software Systems.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You
+ * may not reproduce, modify or distribute this software except in
+ * compliance with the License. You may obtain a copy of the License
+ * at: http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTIES OF ANY KIND, either express or implied.
+ *
+ * This file may contain contributions from others, either as
+ * contributors under the License or as licensors under other terms.
+ * Please review this entire file for other proprietary rights or license
+ * notices, as well as the QNX Development Suite License Guide at
+ * http://licensing.qnx.com/license-guide/ for other information.
+ * $
+ */
+
+/*
+ * devnp-dwceqos driver specific commands, sent with the SIOCGDRVSPEC and
+ * SIOCSDRVSPEC ioctls. ifd_cmd is one of the commands below, ifd_len the
+ * size of its structure and the structure follows the struct ifdrv.
+ */
+
+#ifndef _HW_DWCEQOS_H_INCLUDED
+#define _HW_DWCEQOS_H_INCLUDED
+
+#include <stdint.h>
+
+#define DWCEQOS_GET_COALESCE        0x1001
+#define DWCEQOS_SET_COALESCE        0x1002
+#define DWCEQOS_GET_CBS             0x1003
+#define DWCEQOS_SET_CBS             0x1004
+#define DWCEQOS_GET_EST             0x1005
+#define DWCEQOS_SET_EST             0x1006
+
+/* Interrupt moderation, applies to every queue */
+typedef struct {
+    uint32_t    rx_frames;      /* Rx interrupt every rx_frames frames, power of two, 1 for every frame */
+    uint32_t    rx_usecs;       /* Rx watchdog, interrupt this long after a frame without one, 0 off */
+    uint32_t    tx_frames;      /* Tx completion interrupt every tx_frames frames, 0 off */
+    uint32_t    adaptive;       /* Adapt the Rx frame count to the load, up to rx_frames */
+} dwceqos_coalesce_t;
+
+/*
+ * 802.1Qav credit based shaper of a Tx queue. Packets of VLAN priority p are
+ * sent on queue p * queues / 8, untagged ones on queue 0 which is never shaped.
+ * DWCEQOS_GET_CBS returns the reservation of the given queue.
+ */
+typedef struct {
+    uint32_t    queue;          /* Tx queue, 1 to queues - 1 */
+    uint32_t    idle_slope;     /* Reserved bandwidth in kbit/s, 0 for strict priority */
+} dwceqos_cbs_t;
+
+/* Gate control list entries of the largest EST implementation */
+#define DWCEQOS_EST_MAX_GCL         1024
+
+typedef struct {
+    uint32_t    gates;          /* Bit q opens the gate of Tx queue q */
+    uint32_t    interval;       /* Time the gates stay so, in ns */
+} dwceqos_gcl_entry_t;
+
+/*
+ * 802.1Qbv time aware shaper, Enhancements to Scheduled Traffic. The list
+ * takes effect at the first cycle boundary from base_time on, in PTP time,
+ * replacing the running one at its cycle end. DWCEQOS_SET_EST fails with
+ * EBUSY while a previous list is still waiting to take over.
+ */
+typedef struct {
+    uint32_t    enable;         /* 0 turns the shaper off, all gates open */
+    uint32_t    depth;          /* DWCEQOS_GET_EST: gate control list depth of the hardware */
+    uint64_t    base_time;      /* ns */
+    uint32_t    cycle_time;     /* ns, at least the sum of the intervals */
+    uint32_t    num_entries;    /* 1 to depth */
+    dwceqos_gcl_entry_t gcl[DWCEQOS_EST_MAX_GCL];
+} dwceqos_est_t;
+
+#endif
+
+#if defined(__QNXNTO__) && defined(__USESRCVERSION)
+#include <sys/srcversion.h>
+__SRCVERSION("$URL$ $Rev$")
+#endif